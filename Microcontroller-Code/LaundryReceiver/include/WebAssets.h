@@ -0,0 +1,148 @@
+/*
+  WasherWatcher LaundryReceiver code
+  "WebAssets.h"
+
+  GENERATED by tools/embed_assets.py from the files in data/. Do not edit by hand.
+  Each asset is stored gzipped in flash and served with Content-Encoding: gzip.
+*/
+
+#ifndef WEB_ASSETS_H
+#define WEB_ASSETS_H
+
+#include <Arduino.h>
+
+// One gzipped website file kept in flash
+typedef struct {
+  const char *url;
+  const char *contentType;
+  const char *cacheControl;
+  const char *etag;              // Quoted, ready to compare with If-None-Match
+  const uint8_t *data;
+  size_t length;
+} WebAsset;
+
+// index.html: 416 bytes minified, 282 bytes gzipped
+const uint8_t INDEX_HTML_GZ[] PROGMEM = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x6d, 0x51, 0x4b, 0x4f, 0xc3, 0x30,
+  0x0c, 0xfe, 0x2b, 0x21, 0xe7, 0x6d, 0x55, 0xe8, 0x56, 0x51, 0xd4, 0x94, 0x03, 0x20, 0x71, 0x00,
+  0xc1, 0x61, 0xd2, 0xc4, 0xd1, 0x4b, 0x8c, 0x12, 0x48, 0x1f, 0x4a, 0xac, 0x8e, 0xfe, 0x7b, 0xdc,
+  0xae, 0x3b, 0x4c, 0xe2, 0xf4, 0x39, 0xb6, 0xbf, 0x87, 0x95, 0xea, 0xe6, 0xe9, 0xfd, 0x71, 0xff,
+  0xf9, 0xf1, 0x2c, 0x5e, 0xf6, 0x6f, 0xaf, 0x75, 0xe5, 0xa8, 0x09, 0xb5, 0xa8, 0x1c, 0x82, 0x65,
+  0x20, 0x4f, 0x01, 0xeb, 0xbd, 0x43, 0x71, 0x80, 0xe4, 0x30, 0x1e, 0x80, 0x0c, 0x43, 0x95, 0x9d,
+  0x07, 0xa2, 0x6a, 0x90, 0x40, 0xb4, 0xd0, 0xa0, 0x96, 0x83, 0xc7, 0x53, 0xdf, 0x45, 0x92, 0xc2,
+  0x74, 0x2d, 0x61, 0x4b, 0x5a, 0x9e, 0xbc, 0x25, 0xa7, 0x2d, 0x0e, 0xde, 0xe0, 0x7a, 0x7e, 0xac,
+  0x84, 0x6f, 0x3d, 0x79, 0x08, 0xeb, 0x64, 0x20, 0xa0, 0x56, 0x92, 0x45, 0x82, 0x6f, 0x7f, 0x44,
+  0xc4, 0xa0, 0xa5, 0x67, 0xaa, 0x14, 0x2e, 0xe2, 0x97, 0x96, 0x16, 0x08, 0xee, 0x57, 0xd7, 0xf3,
+  0x44, 0x63, 0x40, 0x0e, 0x82, 0xec, 0x42, 0x63, 0xcf, 0xae, 0x84, 0xbf, 0x94, 0x99, 0x94, 0x2e,
+  0xac, 0x79, 0x63, 0xc3, 0x8d, 0x87, 0x41, 0x97, 0x90, 0x9b, 0x72, 0x57, 0x94, 0xb7, 0x60, 0x0d,
+  0xe6, 0x45, 0x3e, 0x69, 0x65, 0xcb, 0x65, 0xc7, 0xce, 0x8e, 0x0c, 0xd6, 0x0f, 0xc2, 0x04, 0x48,
+  0x89, 0x95, 0xba, 0xbe, 0x85, 0x61, 0xda, 0x71, 0xea, 0xbf, 0x93, 0xb9, 0xcb, 0x74, 0x26, 0x5c,
+  0xd3, 0x96, 0x63, 0xa5, 0xf0, 0x56, 0xcb, 0xd8, 0x75, 0x4d, 0x92, 0xf5, 0x65, 0x2d, 0x99, 0xe8,
+  0x7b, 0x12, 0x29, 0x1a, 0x0e, 0x36, 0xd7, 0x9b, 0xef, 0x29, 0xd8, 0xae, 0xdc, 0x2a, 0x0b, 0xea,
+  0x0e, 0x4a, 0x55, 0xaa, 0xa2, 0xd8, 0x4e, 0x8c, 0xf3, 0x7c, 0xb2, 0x58, 0xa2, 0x65, 0xf3, 0x57,
+  0xfc, 0x01, 0x99, 0xbb, 0xf1, 0x36, 0xa0, 0x01, 0x00, 0x00,
+};
+
+// style.css: 719 bytes minified, 332 bytes gzipped
+const uint8_t STYLE_CSS_GZ[] PROGMEM = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xbd, 0x90, 0xbd, 0x6e, 0x83, 0x30,
+  0x14, 0x46, 0x5f, 0x05, 0x29, 0x43, 0x96, 0x80, 0x08, 0x24, 0xa9, 0x64, 0x4f, 0xf9, 0x29, 0xdd,
+  0x3a, 0x54, 0xdd, 0x2b, 0x07, 0x5f, 0xc3, 0x55, 0x6c, 0x5f, 0x64, 0x4c, 0x48, 0x8a, 0x78, 0xf7,
+  0x52, 0x4a, 0xa4, 0x48, 0xe9, 0x1c, 0x0f, 0x96, 0x6c, 0xeb, 0xbb, 0x3e, 0xe7, 0x2b, 0xbd, 0xd1,
+  0x9d, 0x22, 0xeb, 0x43, 0x25, 0x0c, 0xea, 0x2b, 0xdb, 0x3a, 0x14, 0x9a, 0x4b, 0xac, 0x2b, 0x2d,
+  0xae, 0x0c, 0xad, 0x46, 0x0b, 0xe1, 0x51, 0x53, 0x7e, 0xe2, 0x1e, 0x2e, 0x3e, 0x14, 0x1a, 0x0b,
+  0xcb, 0x72, 0xb0, 0x1e, 0x5c, 0x5f, 0xfd, 0x45, 0x6b, 0xfc, 0x06, 0xb6, 0x8c, 0x12, 0x07, 0xa6,
+  0x3f, 0x92, 0xbc, 0x76, 0x46, 0xb8, 0x02, 0x2d, 0x8b, 0xfb, 0xc8, 0x53, 0x65, 0xc5, 0xb9, 0xa3,
+  0x33, 0x38, 0xa5, 0xa9, 0x65, 0x25, 0x4a, 0x09, 0x96, 0x1f, 0x45, 0x7e, 0x2a, 0x1c, 0x35, 0x56,
+  0x86, 0x39, 0x69, 0x72, 0x6c, 0x16, 0xc7, 0x69, 0xba, 0xd9, 0xf0, 0xe9, 0x94, 0x65, 0x87, 0x55,
+  0xba, 0xe3, 0x77, 0xd3, 0x87, 0xd9, 0xfc, 0x9e, 0xf3, 0x0d, 0x68, 0xf8, 0x43, 0x2c, 0xe6, 0x9f,
+  0x68, 0xa0, 0x0e, 0xde, 0xa1, 0x0d, 0x3e, 0xc8, 0x08, 0x3b, 0x5f, 0x8c, 0x17, 0x8b, 0x1a, 0x1c,
+  0xaa, 0x3e, 0xca, 0x87, 0xc8, 0xc0, 0xda, 0xdd, 0x84, 0x94, 0x86, 0x0b, 0xff, 0xdd, 0x42, 0x89,
+  0x0e, 0x72, 0x8f, 0x34, 0xc8, 0x90, 0x6e, 0x8c, 0xe5, 0x95, 0x90, 0x12, 0x6d, 0xc1, 0x92, 0xb8,
+  0xba, 0xf0, 0x51, 0x33, 0x44, 0x0f, 0xa6, 0xbe, 0xc9, 0x46, 0x46, 0xe4, 0xe5, 0xd0, 0xc6, 0x17,
+  0x29, 0xd5, 0x3d, 0x0a, 0xac, 0xf6, 0xdb, 0x6c, 0x1d, 0xf3, 0x23, 0x39, 0x09, 0x8e, 0x45, 0x4b,
+  0x30, 0x41, 0x4d, 0x1a, 0x65, 0x30, 0xdb, 0x1d, 0xf6, 0xe9, 0xfe, 0x65, 0x7a, 0x09, 0x9d, 0x90,
+  0xd8, 0xd4, 0x2c, 0x5a, 0xdf, 0x84, 0x46, 0x3f, 0x3d, 0x34, 0x06, 0x7c, 0xea, 0x6d, 0xc8, 0xf2,
+  0x16, 0xa5, 0x2f, 0xd9, 0x2a, 0x3e, 0xb7, 0x13, 0x4b, 0x0d, 0x5a, 0x3d, 0xa2, 0xd8, 0x7f, 0x48,
+  0x0e, 0x69, 0x92, 0x25, 0xd9, 0x93, 0x49, 0x1a, 0x7b, 0xb2, 0xd4, 0xfe, 0x87, 0xf3, 0x3a, 0xae,
+  0xe7, 0xe0, 0xfc, 0x00, 0x35, 0xbe, 0x2b, 0x1d, 0xcf, 0x02, 0x00, 0x00,
+};
+
+// script.js: 3209 bytes minified, 1052 bytes gzipped
+const uint8_t SCRIPT_JS_GZ[] PROGMEM = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xcd, 0x56, 0xdb, 0x6e, 0xe3, 0x36,
+  0x10, 0x7d, 0xf7, 0x57, 0x30, 0x7a, 0x31, 0x85, 0xb8, 0xcc, 0x6e, 0x17, 0xe8, 0x43, 0x02, 0x6f,
+  0xd1, 0xcd, 0x06, 0xd8, 0x2d, 0x72, 0x29, 0xd6, 0xe9, 0x53, 0x10, 0x14, 0x8c, 0x34, 0x8a, 0xd4,
+  0xd2, 0xa4, 0x40, 0x52, 0x4e, 0x8c, 0xc0, 0xff, 0xde, 0xe1, 0x45, 0xb2, 0x64, 0x39, 0x59, 0x6f,
+  0x9f, 0x6a, 0xc0, 0x80, 0x34, 0x3a, 0x3c, 0x73, 0x38, 0x9c, 0x0b, 0x05, 0x58, 0xb2, 0xe4, 0x59,
+  0x59, 0x49, 0xf8, 0xa4, 0x9e, 0xc1, 0x90, 0x39, 0xb9, 0xbb, 0x3f, 0x9b, 0x08, 0x34, 0x17, 0x95,
+  0xac, 0x4c, 0x79, 0x5b, 0x2d, 0xbd, 0x55, 0xc2, 0x13, 0xb9, 0xe2, 0x35, 0x4d, 0xc3, 0x47, 0xc1,
+  0xd7, 0xaa, 0xb1, 0xdf, 0x40, 0x28, 0x9e, 0x57, 0xf2, 0x11, 0x01, 0x05, 0x17, 0x06, 0xf0, 0x23,
+  0x1a, 0x2e, 0xfd, 0x47, 0x9a, 0x4e, 0x98, 0x2d, 0x41, 0xd2, 0x4c, 0x49, 0x09, 0x99, 0xbd, 0x58,
+  0x81, 0xb4, 0x06, 0x8d, 0x19, 0xb7, 0x59, 0x49, 0x29, 0x68, 0xad, 0x74, 0x4a, 0xe6, 0x1f, 0x09,
+  0x02, 0x8c, 0x12, 0xc0, 0x84, 0x7a, 0xa4, 0xc9, 0xb9, 0x6a, 0x44, 0x2e, 0xa7, 0xe8, 0x02, 0x99,
+  0x08, 0x12, 0xb4, 0xfa, 0xa2, 0xcf, 0x53, 0x92, 0xcc, 0x48, 0x58, 0x8b, 0x5a, 0x8a, 0x46, 0x66,
+  0xb6, 0x52, 0x92, 0xf4, 0xfd, 0x92, 0x97, 0x89, 0x06, 0xdb, 0x68, 0x49, 0x0a, 0x70, 0xae, 0xa6,
+  0x27, 0xbc, 0xae, 0x4e, 0xc2, 0xf2, 0x69, 0xab, 0x8a, 0x6a, 0x30, 0x35, 0x3a, 0x06, 0x2f, 0xa1,
+  0x7d, 0x61, 0x7f, 0x1b, 0x25, 0x69, 0xda, 0x81, 0xc2, 0x22, 0x0f, 0x79, 0xf1, 0x1b, 0x47, 0xad,
+  0x16, 0xf7, 0x81, 0x1b, 0xce, 0x55, 0xd6, 0x2c, 0xf1, 0x91, 0x3d, 0x82, 0xbd, 0x10, 0xe0, 0x1e,
+  0x3f, 0xad, 0xbf, 0xe6, 0x34, 0xd1, 0x4a, 0x2d, 0x4d, 0x82, 0xe2, 0x22, 0x96, 0x69, 0xa8, 0x05,
+  0xcf, 0xe0, 0xbc, 0xac, 0x44, 0xae, 0x91, 0x15, 0x3f, 0xed, 0x89, 0x79, 0x2f, 0xde, 0x2c, 0x13,
+  0xc0, 0xb5, 0x8f, 0xb5, 0xf7, 0xcf, 0x3c, 0x25, 0x2b, 0x94, 0xbe, 0xe0, 0x2e, 0x74, 0xee, 0x35,
+  0x6a, 0xaa, 0x0a, 0xe2, 0x5f, 0x59, 0x64, 0x34, 0x4c, 0x80, 0x7c, 0xb4, 0x25, 0x99, 0xcf, 0xc9,
+  0xbb, 0x6d, 0x24, 0xce, 0x26, 0x1b, 0x2f, 0xbf, 0x84, 0xf6, 0xbc, 0x3a, 0xf9, 0x99, 0x06, 0x6e,
+  0x21, 0xee, 0x80, 0x26, 0xe5, 0xcf, 0x4e, 0x7a, 0xc4, 0x31, 0x0b, 0xcf, 0xf6, 0xbc, 0xdb, 0xb2,
+  0x77, 0x24, 0xf9, 0x12, 0x42, 0x12, 0xb4, 0x2e, 0xdf, 0x60, 0xcb, 0xab, 0x55, 0xb2, 0xdd, 0xae,
+  0xdb, 0x18, 0x37, 0xe6, 0x1a, 0x19, 0x70, 0x4d, 0xd2, 0x5a, 0x93, 0xb3, 0xc9, 0x70, 0x0b, 0xdd,
+  0x46, 0xa3, 0xa5, 0x17, 0x7f, 0x19, 0xd6, 0xbe, 0xe6, 0xcf, 0xd4, 0x5c, 0x3a, 0x87, 0x0e, 0xb6,
+  0x23, 0x3e, 0x72, 0x31, 0xc1, 0x1f, 0x40, 0x90, 0x63, 0x92, 0x9c, 0x26, 0x61, 0x1b, 0xc6, 0x72,
+  0xdb, 0x98, 0x03, 0x48, 0x03, 0x70, 0x87, 0x36, 0xf9, 0x53, 0xfe, 0x23, 0xd5, 0x93, 0x8c, 0x64,
+  0x0f, 0xea, 0xf9, 0xfb, 0xe1, 0x40, 0xd0, 0xde, 0x48, 0xfc, 0xd5, 0x74, 0x5c, 0x0e, 0xc2, 0xeb,
+  0x1a, 0x64, 0x4e, 0xdd, 0x5e, 0x66, 0x24, 0x71, 0x79, 0x1f, 0x14, 0xf4, 0x03, 0x1a, 0x30, 0x3e,
+  0xb5, 0x28, 0xae, 0xd9, 0x49, 0xad, 0xbb, 0x76, 0xd3, 0x46, 0x28, 0x7b, 0x8f, 0x9e, 0x10, 0x82,
+  0xa9, 0xd0, 0xcb, 0xcd, 0xe8, 0x23, 0x9e, 0xf7, 0xac, 0x3b, 0xd3, 0x34, 0xc0, 0xfc, 0x7f, 0x5b,
+  0x65, 0x83, 0x52, 0xf6, 0x85, 0xe6, 0xf2, 0xef, 0xe8, 0xa9, 0x92, 0xb9, 0x7a, 0x62, 0xde, 0xbc,
+  0x50, 0x8d, 0xce, 0x60, 0x9c, 0x79, 0xc6, 0xdb, 0x63, 0x27, 0xe9, 0x21, 0xb1, 0x3a, 0xc1, 0xd3,
+  0x4d, 0x5d, 0x84, 0xbd, 0x89, 0xf1, 0x3c, 0xf7, 0x88, 0xcb, 0xca, 0xa0, 0x48, 0xd0, 0x74, 0xaa,
+  0x50, 0xe5, 0x74, 0x46, 0x68, 0xcc, 0x84, 0x41, 0xc7, 0x08, 0x6a, 0xc8, 0x79, 0xd0, 0x06, 0xb9,
+  0x8b, 0xf0, 0x66, 0x16, 0x1a, 0xd2, 0x5b, 0x9c, 0xbe, 0x89, 0x38, 0x52, 0xef, 0xbf, 0x57, 0x4f,
+  0xfe, 0x9d, 0x59, 0xae, 0xb1, 0xb2, 0xb1, 0x78, 0x79, 0xbe, 0x5e, 0x60, 0xdc, 0x81, 0x1c, 0xcd,
+  0xfb, 0xc2, 0xd9, 0xcd, 0x1f, 0x17, 0xd7, 0xe9, 0x2b, 0x62, 0x3e, 0x57, 0x26, 0x1b, 0xe8, 0x39,
+  0x48, 0x91, 0x91, 0xbc, 0x36, 0xa5, 0xb2, 0xbb, 0xa2, 0x06, 0x1e, 0x16, 0x11, 0x14, 0x1a, 0xa1,
+  0x97, 0x9a, 0x73, 0xcb, 0xd3, 0x51, 0x4d, 0xfe, 0xbe, 0xb8, 0xb9, 0x66, 0x35, 0xd7, 0x06, 0xe8,
+  0x00, 0x36, 0x2a, 0x33, 0xcc, 0x01, 0xb1, 0xbe, 0x0a, 0xd6, 0x45, 0x9b, 0x61, 0x87, 0xe8, 0x6d,
+  0xd3, 0x36, 0xa4, 0xe5, 0x9b, 0xaa, 0x23, 0x3d, 0x09, 0xfc, 0xff, 0x03, 0xed, 0x0f, 0x8d, 0x59,
+  0xbf, 0x96, 0x51, 0xdf, 0x20, 0x83, 0x6a, 0x05, 0x9a, 0x38, 0xd0, 0x0c, 0x87, 0x83, 0xd5, 0x6b,
+  0xd7, 0x35, 0x05, 0x66, 0x81, 0x76, 0xc7, 0xe9, 0xa6, 0x8d, 0xcf, 0x09, 0x3a, 0xf4, 0xb6, 0x19,
+  0x0e, 0xa4, 0x08, 0x41, 0xfa, 0xfe, 0x20, 0x72, 0xd1, 0x82, 0x1f, 0x9c, 0x43, 0x5d, 0x59, 0x3a,
+  0xd0, 0x21, 0x41, 0x18, 0x8a, 0x19, 0x03, 0xb6, 0xad, 0xf5, 0xa5, 0x1f, 0xfb, 0x2f, 0x76, 0x29,
+  0x62, 0xb7, 0xda, 0xb6, 0xcc, 0x3d, 0xad, 0xe4, 0xcc, 0x17, 0xca, 0xbe, 0x45, 0x38, 0x77, 0x1a,
+  0x99, 0x03, 0x4e, 0x33, 0xc8, 0xbb, 0x06, 0xb1, 0x73, 0x5d, 0xf0, 0x4e, 0x47, 0x37, 0x08, 0xab,
+  0x9b, 0xfd, 0x17, 0x88, 0x2e, 0x94, 0x68, 0x40, 0x5e, 0x2e, 0xc4, 0x9a, 0xc6, 0x73, 0x7b, 0xf5,
+  0x22, 0x42, 0x42, 0xe7, 0xda, 0xf6, 0xa0, 0x9e, 0x5e, 0x16, 0xdb, 0x68, 0x54, 0xd7, 0x5a, 0x35,
+  0x2c, 0x39, 0xce, 0x60, 0x24, 0x39, 0xda, 0xdd, 0x44, 0x7f, 0x36, 0x1b, 0xb0, 0xb4, 0x1f, 0x8b,
+  0x19, 0xf9, 0x8c, 0xd2, 0x18, 0xf6, 0x6d, 0xd4, 0x74, 0x4c, 0x46, 0x6c, 0x5e, 0x07, 0xa0, 0xa6,
+  0x1d, 0x9e, 0x1c, 0x30, 0xee, 0x30, 0xa0, 0xf2, 0xd0, 0x71, 0x50, 0xf7, 0xcf, 0x0a, 0xe5, 0xc6,
+  0xc4, 0x3e, 0x70, 0xbc, 0x66, 0xdc, 0xbd, 0xbf, 0x67, 0x15, 0xb6, 0x20, 0xfd, 0xe5, 0xf6, 0xea,
+  0x12, 0x17, 0xaa, 0x2c, 0x6b, 0xea, 0x0a, 0xf2, 0x5b, 0x1c, 0x5f, 0x63, 0xaf, 0x07, 0x0b, 0x3c,
+  0x58, 0x5e, 0x51, 0xfc, 0x98, 0xbe, 0xe4, 0xb7, 0x15, 0xaf, 0x70, 0x38, 0x0b, 0x48, 0x7c, 0xbf,
+  0xdc, 0x66, 0xef, 0x40, 0xb9, 0x97, 0x11, 0x93, 0x36, 0xa8, 0x75, 0x67, 0xde, 0x93, 0x8d, 0x4d,
+  0x9b, 0x46, 0xad, 0xee, 0x74, 0x5b, 0xcc, 0xee, 0x91, 0xc6, 0x1b, 0x62, 0x72, 0x13, 0xc9, 0x93,
+  0x76, 0x50, 0x2d, 0x2b, 0xd9, 0x58, 0xdf, 0x84, 0xae, 0xb8, 0x2d, 0x19, 0x76, 0x02, 0x41, 0x5b,
+  0x96, 0x9f, 0x7a, 0x67, 0x9d, 0x92, 0x13, 0xf2, 0xcb, 0x3b, 0xfc, 0xa1, 0xa3, 0x48, 0x46, 0xdb,
+  0xb5, 0x1f, 0xc9, 0xfb, 0x94, 0xfc, 0xba, 0x25, 0x9f, 0x11, 0xfe, 0x80, 0x69, 0x8a, 0x43, 0xfc,
+  0xb8, 0xe3, 0xc7, 0x1b, 0x88, 0x7b, 0x26, 0x02, 0x0a, 0x9b, 0x90, 0xd3, 0x3e, 0x38, 0x78, 0x73,
+  0x99, 0x68, 0x94, 0x3f, 0xe6, 0xcd, 0x04, 0xb3, 0xee, 0x2b, 0x4e, 0x6c, 0xbd, 0xe2, 0xa2, 0xcd,
+  0xfd, 0xc1, 0x61, 0x75, 0x57, 0xa6, 0x60, 0xc4, 0xab, 0x82, 0x8f, 0x53, 0x77, 0x6f, 0xfa, 0x7e,
+  0x7d, 0xbf, 0x5d, 0xd7, 0xa3, 0x92, 0xf8, 0xaf, 0x99, 0xd7, 0x65, 0xdc, 0x26, 0xb4, 0xce, 0x0f,
+  0x21, 0x84, 0xff, 0x02, 0xb5, 0xab, 0x30, 0x9f, 0x89, 0x0c, 0x00, 0x00,
+};
+
+const WebAsset WEB_ASSETS[] = {
+  { "/", "text/html", "no-cache", "\"ac5241969396e279\"", INDEX_HTML_GZ, sizeof(INDEX_HTML_GZ) },
+  { "/style.css", "text/css", "public, max-age=31536000, immutable", "\"9a3c95692adce363\"", STYLE_CSS_GZ, sizeof(STYLE_CSS_GZ) },
+  { "/script.js", "application/javascript", "public, max-age=31536000, immutable", "\"5941da18a9191664\"", SCRIPT_JS_GZ, sizeof(SCRIPT_JS_GZ) },
+};
+const size_t WEB_ASSET_COUNT = sizeof(WEB_ASSETS) / sizeof(WEB_ASSETS[0]);
+
+#endif
@@ -0,0 +1,57 @@
+/*
+  WasherWatcher LaundryReceiver library
+  "CycleModel.cpp"
+*/
+
+#include "CycleModel.h"
+
+// Constructor, tracking the median and 90th percentile cycle length
+CycleModel::CycleModel() : median(0.5), upper(0.9) {}
+
+/*
+  Feeds the machine's latest on/off status. Starting a cycle needs an off -> on edge,
+  so a machine that was already running when the receiver booted isn't timed from the wrong start.
+*/
+void CycleModel::observe(bool machineOn, uint32_t nowMs) {
+  if (this->seen && machineOn != this->machineOn) {
+    if (machineOn) {
+      this->timing = true;
+      this->startMs = nowMs;
+    } else if (this->timing) {
+      uint32_t length = nowMs - this->startMs;
+      if (length >= MIN_CYCLE_MS && length <= MAX_CYCLE_MS) {
+        this->median.add(length);
+        this->upper.add(length);
+      }
+      this->timing = false;
+    }
+  }
+  this->seen = true;
+  this->machineOn = machineOn;
+}
+
+// Picks up a machine's status from before a receiver restart: one that has been running since sinceMs is timed from then
+void CycleModel::resume(bool machineOn, uint32_t sinceMs) {
+  this->seen = true;
+  this->machineOn = machineOn;
+  this->timing = machineOn;
+  this->startMs = sinceMs;
+}
+
+// Estimates the time left in the running cycle. Returns false if the machine is off or there's too little history.
+bool CycleModel::estimateRemaining(uint32_t nowMs, uint32_t &remainingMs) const {
+  if (!this->timing || this->median.count() < MIN_CYCLES) { return false; }
+
+  float elapsed = nowMs - this->startMs;
+  float typical = this->median.get();
+  float longest = this->upper.get();
+
+  if (elapsed < typical) {
+    remainingMs = typical - elapsed;
+  } else if (elapsed < longest) {
+    remainingMs = longest - elapsed;
+  } else {
+    remainingMs = 0;
+  }
+  return true;
+}
@@ -0,0 +1,49 @@
+/*
+  WasherWatcher LaundryReceiver library
+  "CycleModel.h"
+
+  Learns how long one machine's cycles usually take from the on -> off transitions it sees,
+  and uses that to estimate how much time is left in a running cycle.
+*/
+
+#ifndef CYCLE_MODEL_H
+#define CYCLE_MODEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "P2Quantile.h"
+
+/******************* CycleModel Class Definition **************************
+ * Cycle lengths go into two streaming quantile sketches (median and 90th
+ * percentile), so memory stays constant however long the receiver runs.
+ * The time left is the median minus the time elapsed; a cycle that has
+ * already run past the median is given until the 90th percentile, and one
+ * past that is reported as about to finish. Cycles only count when both
+ * their start and their end were seen, and implausibly short or long ones
+ * (false starts, missed "off" frames) are ignored.
+ *************************************************************************/
+class CycleModel {
+  public:
+    static const uint32_t MIN_CYCLE_MS = 120000;      // Shorter runs are someone opening the door, not a cycle
+    static const uint32_t MAX_CYCLE_MS = 14400000;    // Longer runs mean the "off" frame was missed
+    static const uint32_t MIN_CYCLES = 3;             // Cycles needed before estimating anything
+
+    CycleModel();
+
+    void observe(bool machineOn, uint32_t nowMs);
+    void resume(bool machineOn, uint32_t sinceMs);
+    bool estimateRemaining(uint32_t nowMs, uint32_t &remainingMs) const;
+    uint32_t getCycleCount() const { return median.count(); }
+    float getMedianMs() const { return median.get(); }
+    float getUpperMs() const { return upper.get(); }
+
+  private:
+    P2Quantile median;
+    P2Quantile upper;
+    bool seen = false;          // Whether any status has been observed yet
+    bool machineOn = false;
+    bool timing = false;        // Whether the running cycle's start was seen
+    uint32_t startMs = 0;
+};
+
+#endif
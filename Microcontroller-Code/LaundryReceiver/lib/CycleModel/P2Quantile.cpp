@@ -0,0 +1,102 @@
+/*
+  WasherWatcher LaundryReceiver library
+  "P2Quantile.cpp"
+*/
+
+#include "P2Quantile.h"
+
+// Constructor, given the quantile to track (0 to 1, e.g. 0.5 for the median)
+P2Quantile::P2Quantile(float quantile) : quantile(quantile) {
+  clear();
+}
+
+// Forgets every value added so far
+void P2Quantile::clear() {
+  samples = 0;
+  for (size_t i = 0; i < MARKERS; i++) {
+    heights[i] = 0.0;
+    positions[i] = i + 1;
+  }
+  desired[0] = 1;
+  desired[1] = 1 + 2 * quantile;
+  desired[2] = 1 + 4 * quantile;
+  desired[3] = 3 + 2 * quantile;
+  desired[4] = 5;
+  increments[0] = 0;
+  increments[1] = quantile / 2;
+  increments[2] = quantile;
+  increments[3] = (1 + quantile) / 2;
+  increments[4] = 1;
+}
+
+// Adds a value to the estimate in O(1) time
+void P2Quantile::add(float value) {
+
+  // Until there are five values, keep them sorted exactly
+  if (samples < MARKERS) {
+    size_t i = samples++;
+    while (i > 0 && heights[i - 1] > value) {
+      heights[i] = heights[i - 1];
+      i--;
+    }
+    heights[i] = value;
+    return;
+  }
+
+  // Find the cell the value falls in, stretching the outer markers if it's a new extreme
+  size_t cell;
+  if (value < heights[0]) {
+    heights[0] = value;
+    cell = 0;
+  } else if (value >= heights[MARKERS - 1]) {
+    heights[MARKERS - 1] = value;
+    cell = MARKERS - 2;
+  } else {
+    cell = 0;
+    while (cell < MARKERS - 2 && value >= heights[cell + 1]) { cell++; }
+  }
+
+  for (size_t i = cell + 1; i < MARKERS; i++) { positions[i]++; }
+  for (size_t i = 0; i < MARKERS; i++) { desired[i] += increments[i]; }
+  samples++;
+
+  // Move the middle markers by one position if they've drifted at least that far from where they should be
+  for (size_t i = 1; i < MARKERS - 1; i++) {
+    float offset = desired[i] - positions[i];
+    if ((offset >= 1 && positions[i + 1] - positions[i] > 1) || (offset <= -1 && positions[i - 1] - positions[i] < -1)) {
+      float direction = (offset > 0) ? 1.0 : -1.0;
+      float height = parabolic(i, direction);
+      if (heights[i - 1] < height && height < heights[i + 1]) {
+        heights[i] = height;
+      } else {
+        heights[i] = linear(i, direction);
+      }
+      positions[i] += direction;
+    }
+  }
+}
+
+// Returns the current estimate (exact while there are five values or fewer, 0 if there are none)
+float P2Quantile::get() const {
+  if (samples == 0) { return 0.0; }
+  if (samples <= MARKERS) {
+    size_t rank = (size_t) (quantile * (samples - 1) + 0.5);
+    return heights[rank];
+  }
+  return heights[2];
+}
+
+// Piecewise-parabolic prediction of marker i's height after moving it one position in direction
+float P2Quantile::parabolic(size_t i, float direction) const {
+  float below = positions[i] - positions[i - 1];
+  float above = positions[i + 1] - positions[i];
+  return heights[i] + direction / (positions[i + 1] - positions[i - 1]) *
+         ((below + direction) * (heights[i + 1] - heights[i]) / above +
+          (above - direction) * (heights[i] - heights[i - 1]) / below);
+}
+
+// Linear prediction, used when the parabola would overshoot a neighbouring marker
+float P2Quantile::linear(size_t i, float direction) const {
+  size_t neighbour = (direction > 0) ? i + 1 : i - 1;
+  return heights[i] + direction * (heights[neighbour] - heights[i]) / (positions[neighbour] - positions[i]);
+}
@@ -0,0 +1,44 @@
+/*
+  WasherWatcher LaundryReceiver library
+  "P2Quantile.h"
+
+  Streaming estimate of one quantile (e.g. the median) using the P-squared algorithm
+  (Jain & Chlamtac, 1985): five markers and constant memory, no matter how many values are added.
+*/
+
+#ifndef P2_QUANTILE_H
+#define P2_QUANTILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/******************* P2Quantile Class Definition **************************
+ * The first five values are kept exactly. After that, five marker heights
+ * track the minimum, the p/2, p and (1+p)/2 quantiles and the maximum; each
+ * add() moves the markers towards their ideal positions, adjusting heights
+ * with a piecewise-parabolic (or, if that would break ordering, linear) fit.
+ *************************************************************************/
+class P2Quantile {
+  public:
+    explicit P2Quantile(float quantile);
+
+    void add(float value);
+    float get() const;
+    uint32_t count() const { return samples; }
+    void clear();
+
+  private:
+    static const size_t MARKERS = 5;
+
+    float quantile;
+    float heights[MARKERS];
+    float positions[MARKERS];   // Actual marker positions (1 based sample ranks)
+    float desired[MARKERS];     // Where each marker should ideally be
+    float increments[MARKERS];  // How far each desired position moves per sample
+    uint32_t samples = 0;
+
+    float parabolic(size_t i, float direction) const;
+    float linear(size_t i, float direction) const;
+};
+
+#endif
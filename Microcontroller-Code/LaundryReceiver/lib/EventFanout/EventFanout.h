@@ -0,0 +1,322 @@
+/*
+  WasherWatcher LaundryReceiver library
+  "EventFanout.h"
+
+  Writes the website's Server-Sent Events to every connected browser from shared buffers, so each
+  event is serialized once however many browsers are watching. A browser that falls behind skips
+  straight to each machine's newest status instead of queueing the ones in between, and only as
+  much is handed to a connection as it has room for. Connections are reached through
+  EventTransport only, so it also runs on a PC.
+*/
+
+#ifndef EVENT_FANOUT_H
+#define EVENT_FANOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <MachineStateTable.h>
+
+// One browser's connection, as the fan-out sees it
+class EventTransport {
+  public:
+    virtual ~EventTransport() {}
+
+    // Takes up to length bytes to send. Returns how many it took, 0 while its send buffer is full.
+    virtual size_t write(const char *data, size_t length) = 0;
+    // Sends whatever write() took since the last flush
+    virtual void flush() = 0;
+};
+
+/*
+  One serialized event, in the text/event-stream format. The fan-out holds a reference while it is a
+  machine's latest event or the current snapshot, and so does every client that has written part of it.
+*/
+typedef struct {
+  char *data;
+  uint16_t capacity;
+  uint16_t length;
+  uint16_t refs;            // 0 while the buffer is free
+  uint32_t sequence;        // Publish order, to tell which machines changed after a snapshot was taken
+} SharedEvent;
+
+// Totals since boot
+typedef struct {
+  uint32_t published;       // Machine events serialized
+  uint32_t snapshots;       // Snapshots serialized (each shared by every browser connecting soon after)
+  uint32_t connections;     // Browsers accepted
+  uint32_t rejected;        // Browsers turned away because every client slot was taken
+  uint32_t superseded;      // Events a browser skipped because a newer one for the same machine came first
+  uint32_t bytesWritten;    // Bytes handed to connections
+  uint32_t peakClients;
+} FanoutStats;
+
+// Where one browser is in the stream
+typedef struct {
+  EventTransport *transport;  // NULL while the slot is free
+  SharedEvent *current;       // Event partly written, holding a reference, or NULL
+  uint16_t offset;            // Bytes of current already written
+  uint8_t nextMachine;        // Where the round robin over pending machines resumes
+  uint32_t pending;           // Machines (one bit per state table entry) whose latest event it still needs
+} FanoutClient;
+
+
+/******************* EventFanout Class Definition *************************
+ * Every machine has one latest "machine_status" event, published by the
+ * frame worker, and a client keeps a bit per machine it hasn't been sent
+ * the latest event of yet. A newer event for a machine just replaces the
+ * latest, so a client that was still waiting for the older one is sent
+ * the newer one only. A new client starts with a "snapshot" of every
+ * machine, reused by every client connecting within SNAPSHOT_REUSE_MS,
+ * followed by whatever was published after it was taken.
+ *
+ * All buffers are fixed: EVENT_SLOTS covers every machine's latest event
+ * plus one partly written event per client, so publish() always finds one.
+ * A client past MAX_CLIENTS is refused, and should be sent busyEvent()
+ * and closed so its browser retries later.
+ * Not thread safe: share a fan-out between tasks only under a lock.
+ *************************************************************************/
+template <size_t MAX_CLIENTS>
+class EventFanout {
+  public:
+    static const size_t MAX_MACHINES = MachineStateTable::MAX_MACHINES;
+    static const size_t HEADER_BYTES = 64;          // "retry: 10000\nevent: machine_status\nid: 4294967295\ndata: " and "\n\n"
+    static const size_t EVENT_BYTES = MachineStateTable::JSON_BYTES_PER_MACHINE + 3 + HEADER_BYTES;
+    static const size_t SNAPSHOT_BYTES = MAX_MACHINES * MachineStateTable::JSON_BYTES_PER_MACHINE + 3 + HEADER_BYTES;
+    static const size_t EVENT_SLOTS = MAX_MACHINES + MAX_CLIENTS + 1;
+    static const size_t SNAPSHOT_SLOTS = 2;
+    static const uint32_t SNAPSHOT_REUSE_MS = 1000;
+    static const uint32_t RECONNECT_MS = 10000;     // Retry delay new browsers are given with their snapshot
+    static const uint32_t BUSY_RETRY_MS = 30000;    // Retry delay refused browsers are given
+
+    EventFanout();
+
+    bool publish(size_t machine, const char *json, uint32_t id);
+    bool snapshotDue(uint32_t nowMs) const;
+    bool publishSnapshot(const char *json, uint32_t id, uint32_t nowMs);
+
+    int connect(EventTransport *transport);
+    void disconnect(int client);
+    void pump(int client);
+    void pumpAll();
+
+    size_t count() const { return clientCount; }
+    const FanoutStats &getStats() const { return stats; }
+    static const char *busyEvent() { return "retry: 30000\nevent: busy\ndata: {}\n\n"; }
+
+  private:
+    char eventData[EVENT_SLOTS][EVENT_BYTES];
+    char snapshotData[SNAPSHOT_SLOTS][SNAPSHOT_BYTES];
+    SharedEvent events[EVENT_SLOTS];
+    SharedEvent snapshots[SNAPSHOT_SLOTS];
+    SharedEvent *latest[MAX_MACHINES];
+    SharedEvent *snapshot = NULL;
+    uint32_t snapshotMs = 0;
+    uint32_t sequence = 0;
+    uint32_t knownMask = 0;         // Machines with a latest event
+
+    FanoutClient clients[MAX_CLIENTS];
+    size_t clientCount = 0;
+    FanoutStats stats = {};
+
+    static SharedEvent *acquire(SharedEvent *pool, size_t size);
+    static void release(SharedEvent *event);
+    static bool format(SharedEvent *event, const char *name, const char *json, uint32_t id, uint32_t retryMs);
+    static int nextPending(FanoutClient &client);
+};
+
+// Constructor, pointing every shared event at its buffer
+template <size_t MAX_CLIENTS>
+EventFanout<MAX_CLIENTS>::EventFanout() {
+  for (size_t i = 0; i < EVENT_SLOTS; i++) {
+    this->events[i] = {this->eventData[i], (uint16_t) EVENT_BYTES, 0, 0, 0};
+  }
+  for (size_t i = 0; i < SNAPSHOT_SLOTS; i++) {
+    this->snapshots[i] = {this->snapshotData[i], (uint16_t) SNAPSHOT_BYTES, 0, 0, 0};
+  }
+  for (size_t i = 0; i < MAX_MACHINES; i++) { this->latest[i] = NULL; }
+  for (size_t i = 0; i < MAX_CLIENTS; i++) { this->clients[i] = {NULL, NULL, 0, 0, 0}; }
+}
+
+/*
+  Serializes json (a JSON array holding the state table entry at index machine) once as the machine's new
+  latest "machine_status" event, replacing the previous one for every client that hadn't been sent it yet.
+  Nothing is written until pump() or pumpAll(). Returns false if json doesn't fit in an event.
+*/
+template <size_t MAX_CLIENTS>
+bool EventFanout<MAX_CLIENTS>::publish(size_t machine, const char *json, uint32_t id) {
+  if (machine >= MAX_MACHINES) { return false; }
+  SharedEvent *event = acquire(this->events, EVENT_SLOTS);
+  if (event == NULL) { return false; }
+  if (!format(event, "machine_status", json, id, 0)) {
+    release(event);
+    return false;
+  }
+
+  event->sequence = ++this->sequence;
+  release(this->latest[machine]);
+  this->latest[machine] = event;
+  uint32_t bit = 1UL << machine;
+  this->knownMask |= bit;
+  this->stats.published++;
+
+  for (FanoutClient &client : this->clients) {
+    if (client.transport == NULL) { continue; }
+    if (client.pending & bit) { this->stats.superseded++; }
+    client.pending |= bit;
+  }
+  return true;
+}
+
+// Returns true if a client connecting now needs a new snapshot built for it
+template <size_t MAX_CLIENTS>
+bool EventFanout<MAX_CLIENTS>::snapshotDue(uint32_t nowMs) const {
+  return this->snapshot == NULL || nowMs - this->snapshotMs >= SNAPSHOT_REUSE_MS;
+}
+
+/*
+  Serializes json (every machine, as on the snapshot route) as the "snapshot" event clients are sent when
+  they connect. Returns false if it doesn't fit, or if slow clients still hold every snapshot buffer;
+  new clients are then sent the previous snapshot, or every machine's latest event if there is none.
+*/
+template <size_t MAX_CLIENTS>
+bool EventFanout<MAX_CLIENTS>::publishSnapshot(const char *json, uint32_t id, uint32_t nowMs) {
+  SharedEvent *event = acquire(this->snapshots, SNAPSHOT_SLOTS);
+  if (event == NULL) { return false; }
+  if (!format(event, "snapshot", json, id, RECONNECT_MS)) {
+    release(event);
+    return false;
+  }
+
+  event->sequence = this->sequence;
+  release(this->snapshot);
+  this->snapshot = event;
+  this->snapshotMs = nowMs;
+  this->stats.snapshots++;
+  return true;
+}
+
+// Adds a client and writes it the snapshot. Returns its slot, or -1 if every slot is taken.
+template <size_t MAX_CLIENTS>
+int EventFanout<MAX_CLIENTS>::connect(EventTransport *transport) {
+  for (size_t slot = 0; slot < MAX_CLIENTS; slot++) {
+    FanoutClient &client = this->clients[slot];
+    if (client.transport != NULL) { continue; }
+
+    client = {transport, this->snapshot, 0, 0, this->knownMask};
+    if (this->snapshot != NULL) {
+      this->snapshot->refs++;
+      client.pending = 0;
+      for (size_t machine = 0; machine < MAX_MACHINES; machine++) {
+        if (this->latest[machine] != NULL && this->latest[machine]->sequence > this->snapshot->sequence) {
+          client.pending |= 1UL << machine;
+        }
+      }
+    }
+
+    this->clientCount++;
+    this->stats.connections++;
+    if (this->clientCount > this->stats.peakClients) { this->stats.peakClients = this->clientCount; }
+    pump(slot);
+    return slot;
+  }
+  this->stats.rejected++;
+  return -1;
+}
+
+// Removes a client whose connection closed, letting go of anything it was partway through
+template <size_t MAX_CLIENTS>
+void EventFanout<MAX_CLIENTS>::disconnect(int client) {
+  if (client < 0 || (size_t) client >= MAX_CLIENTS || this->clients[client].transport == NULL) { return; }
+  release(this->clients[client].current);
+  this->clients[client] = {NULL, NULL, 0, 0, 0};
+  this->clientCount--;
+}
+
+// Writes a client as much of what it still needs as its connection takes, then flushes it
+template <size_t MAX_CLIENTS>
+void EventFanout<MAX_CLIENTS>::pump(int slot) {
+  if (slot < 0 || (size_t) slot >= MAX_CLIENTS) { return; }
+  FanoutClient &client = this->clients[slot];
+  if (client.transport == NULL) { return; }
+
+  bool wrote = false;
+  for (;;) {
+    if (client.current == NULL) {
+      int machine = nextPending(client);
+      if (machine < 0) { break; }
+      client.current = this->latest[machine];
+      client.current->refs++;
+      client.offset = 0;
+    }
+
+    size_t written = client.transport->write(client.current->data + client.offset, client.current->length - client.offset);
+    if (written == 0) { break; }
+    client.offset += written;
+    this->stats.bytesWritten += written;
+    wrote = true;
+    if (client.offset < client.current->length) { break; }    // The connection is full
+
+    release(client.current);
+    client.current = NULL;
+  }
+  if (wrote) { client.transport->flush(); }
+}
+
+// Pumps every client, after publishing
+template <size_t MAX_CLIENTS>
+void EventFanout<MAX_CLIENTS>::pumpAll() {
+  for (size_t slot = 0; slot < MAX_CLIENTS; slot++) { pump(slot); }
+}
+
+// Takes a free buffer from pool, with one reference, or returns NULL if every one is in use
+template <size_t MAX_CLIENTS>
+SharedEvent *EventFanout<MAX_CLIENTS>::acquire(SharedEvent *pool, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    if (pool[i].refs == 0) {
+      pool[i].refs = 1;
+      pool[i].length = 0;
+      return &pool[i];
+    }
+  }
+  return NULL;
+}
+
+// Drops one reference to event (if any), freeing its buffer with the last
+template <size_t MAX_CLIENTS>
+void EventFanout<MAX_CLIENTS>::release(SharedEvent *event) {
+  if (event != NULL && event->refs > 0) { event->refs--; }
+}
+
+// Writes one event in the text/event-stream format. Returns false if it doesn't fit.
+template <size_t MAX_CLIENTS>
+bool EventFanout<MAX_CLIENTS>::format(SharedEvent *event, const char *name, const char *json, uint32_t id, uint32_t retryMs) {
+  int length;
+  if (retryMs != 0) {
+    length = snprintf(event->data, event->capacity, "retry: %u\nevent: %s\nid: %u\ndata: %s\n\n",
+                      (unsigned) retryMs, name, (unsigned) id, json);
+  } else {
+    length = snprintf(event->data, event->capacity, "event: %s\nid: %u\ndata: %s\n\n", name, (unsigned) id, json);
+  }
+  if (length < 0 || (size_t) length >= event->capacity) { return false; }
+  event->length = (uint16_t) length;
+  return true;
+}
+
+// Takes the next machine a client is waiting for, round robin so one busy machine can't hold up the rest.
+// Returns -1 if it is waiting for none.
+template <size_t MAX_CLIENTS>
+int EventFanout<MAX_CLIENTS>::nextPending(FanoutClient &client) {
+  if (client.pending == 0) { return -1; }
+  for (size_t i = 0; i < MAX_MACHINES; i++) {
+    size_t machine = (client.nextMachine + i) % MAX_MACHINES;
+    if (client.pending & (1UL << machine)) {
+      client.pending &= ~(1UL << machine);
+      client.nextMachine = (uint8_t) ((machine + 1) % MAX_MACHINES);
+      return (int) machine;
+    }
+  }
+  return -1;
+}
+
+#endif
@@ -0,0 +1,153 @@
+/*
+  WasherWatcher LaundryReceiver library
+  "HistoryRing.cpp"
+*/
+
+#include "HistoryRing.h"
+#include <string.h>
+
+namespace {
+  // Writes an unsigned LEB128 varint (7 bits per byte), returning its length
+  size_t writeVarint(uint8_t *out, uint32_t value) {
+    size_t length = 0;
+    while (value >= 0x80) {
+      out[length++] = (uint8_t) (value | 0x80);
+      value >>= 7;
+    }
+    out[length++] = (uint8_t) value;
+    return length;
+  }
+
+  // Maps small signed deltas to small unsigned numbers (0, -1, 1, -2, ... -> 0, 1, 2, 3, ...)
+  uint32_t zigzag(int32_t value) {
+    return ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+  }
+
+  int32_t unzigzag(uint32_t value) {
+    return (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+  }
+}
+
+// Records a change in the machine's status or phase
+void HistoryRing::addState(uint32_t nowMs, uint8_t state) {
+  uint8_t record[MAX_RECORD_BYTES];
+  size_t length = encodeHeader(record, HISTORY_STATE, nowMs);
+  record[length++] = state;
+  headState.state = state;
+  append(record, length);
+}
+
+// Records a feature summary, stored as differences from the previous one
+void HistoryRing::addSummary(uint32_t nowMs, const FeatureSummary &summary) {
+  uint8_t record[MAX_RECORD_BYTES];
+  size_t length = encodeHeader(record, HISTORY_SUMMARY, nowMs);
+  record[length++] = summary.phase;
+  length += writeVarint(record + length, zigzag((int32_t) summary.peakFreqDeciHz - headState.summary.peakFreqDeciHz));
+  length += writeVarint(record + length, zigzag((int32_t) summary.meanCms2 - headState.summary.meanCms2));
+  length += writeVarint(record + length, zigzag((int32_t) summary.stdDevMms2 - headState.summary.stdDevMms2));
+  headState.summary = summary;
+  lastSummaryMs = nowMs;
+  hasSummary = true;
+  append(record, length);
+}
+
+// True if no summary has been recorded in the last intervalMs
+bool HistoryRing::isSummaryDue(uint32_t nowMs, uint32_t intervalMs) const {
+  return !hasSummary || nowMs - lastSummaryMs >= intervalMs;
+}
+
+// Forgets every record
+void HistoryRing::clear() {
+  head = tail = 0;
+  memset(&tailBase, 0, sizeof(tailBase));
+  memset(&headState, 0, sizeof(headState));
+  hasSummary = false;
+  recordCount = 0;
+  evictedCount = 0;
+}
+
+// Points a cursor at the oldest stored record
+void HistoryRing::beginRead(HistoryCursor &cursor) const {
+  cursor = tailBase;
+  cursor.position = tail;
+  cursor.started = true;
+}
+
+/*
+  Decodes the record at the cursor and advances it, returning false once the cursor has caught up with the newest record.
+  A cursor whose records were overwritten since its last call skips ahead to the oldest record still stored.
+*/
+bool HistoryRing::next(HistoryCursor &cursor, HistoryRecord &record) const {
+  if (!cursor.started || (int32_t) (cursor.position - tail) < 0) { beginRead(cursor); }
+  if (cursor.position == head) { return false; }
+
+  cursor.position += decodeAt(cursor.position, cursor, record);
+  return true;
+}
+
+// Writes the tag and time delta shared by every record, returning its length
+size_t HistoryRing::encodeHeader(uint8_t *out, uint8_t kind, uint32_t nowMs) {
+  if (recordCount == 0 && evictedCount == 0) {
+    // First record: the time base starts here
+    headState.timeMs = nowMs;
+    tailBase.timeMs = nowMs;
+  }
+
+  // Advance the time base by whole ticks only, so the decoder lands on exactly the same times
+  uint32_t ticks = (nowMs - headState.timeMs) / TICK_MS;
+  headState.timeMs += ticks * TICK_MS;
+
+  out[0] = kind;
+  return 1 + writeVarint(out + 1, ticks);
+}
+
+// Copies an encoded record in at the head, overwriting the oldest records until it fits
+void HistoryRing::append(const uint8_t *record, size_t length) {
+  while (CAPACITY - (head - tail) < length) {
+    HistoryRecord evicted;
+    tail += decodeAt(tail, tailBase, evicted);
+    recordCount--;
+    evictedCount++;
+  }
+
+  for (size_t i = 0; i < length; i++) {
+    bytes[(head + i) % CAPACITY] = record[i];
+  }
+  head += length;
+  recordCount++;
+}
+
+// Reads an unsigned varint starting at position, advancing position past it
+uint32_t HistoryRing::readVarint(uint32_t &position) const {
+  uint32_t value = 0;
+  uint8_t shift = 0;
+  uint8_t b;
+  do {
+    b = byteAt(position++);
+    value |= (uint32_t) (b & 0x7F) << shift;
+    shift += 7;
+  } while ((b & 0x80) && shift < 35);
+  return value;
+}
+
+// Decodes the record at position, applying its deltas to state. Returns the record's length in bytes.
+size_t HistoryRing::decodeAt(uint32_t position, HistoryCursor &state, HistoryRecord &record) const {
+  uint32_t start = position;
+  uint8_t kind = byteAt(position++);
+  state.timeMs += readVarint(position) * TICK_MS;
+
+  if (kind == HISTORY_STATE) {
+    state.state = byteAt(position++);
+  } else {
+    state.summary.phase = byteAt(position++);
+    state.summary.peakFreqDeciHz = (uint8_t) (state.summary.peakFreqDeciHz + unzigzag(readVarint(position)));
+    state.summary.meanCms2 = (uint16_t) (state.summary.meanCms2 + unzigzag(readVarint(position)));
+    state.summary.stdDevMms2 = (uint16_t) (state.summary.stdDevMms2 + unzigzag(readVarint(position)));
+  }
+
+  record.kind = kind;
+  record.timeMs = state.timeMs;
+  record.state = state.state;
+  record.summary = state.summary;
+  return position - start;
+}
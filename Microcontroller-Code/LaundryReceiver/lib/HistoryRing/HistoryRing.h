@@ -0,0 +1,90 @@
+/*
+  WasherWatcher LaundryReceiver library
+  "HistoryRing.h"
+
+  Compact, fixed-size history of one machine: its state transitions plus periodic feature summaries.
+  Records are delta encoded into a byte ring, and the oldest are overwritten once it fills up,
+  so a day of a busy washer fits in about a kilobyte without ever allocating.
+*/
+
+#ifndef HISTORY_RING_H
+#define HISTORY_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <LaundryProtocol.h>
+
+// Kinds of history record
+enum HistoryKind : uint8_t {
+  HISTORY_STATE = 0,    // The machine's on/off status or phase changed
+  HISTORY_SUMMARY = 1   // Periodic vibration features while the machine runs
+};
+
+// One decoded history record
+typedef struct {
+  uint8_t kind;             // HistoryKind
+  uint32_t timeMs;          // Receiver uptime when it was recorded, to TICK_MS resolution
+  uint8_t state;            // State code (LaundryProtocol::stateCode()) as of this record
+  FeatureSummary summary;   // Only meaningful for HISTORY_SUMMARY
+} HistoryRecord;
+
+// Read position in a ring. Holds the absolute values the next record's deltas apply to.
+typedef struct {
+  uint32_t position;        // Logical byte offset of the next record
+  uint32_t timeMs;
+  uint8_t state;
+  FeatureSummary summary;
+  bool started;
+} HistoryCursor;
+
+
+/******************* HistoryRing Class Definition *************************
+ * Record layout (little endian varints, zigzag for signed deltas):
+ *   tag byte (HistoryKind), varint ticks since the previous record, then
+ *   HISTORY_STATE:   state code byte
+ *   HISTORY_SUMMARY: phase byte, zigzag deltas of peakFreqDeciHz, meanCms2
+ *                    and stdDevMms2 from the previous summary
+ * A state record costs 3-5 bytes and a summary typically 6-9. Positions are
+ * logical byte offsets that only grow, so a cursor can tell when the records
+ * it was about to read have been overwritten. The values at the oldest
+ * record are kept in tailBase, so evicting never breaks the delta chain.
+ * Not thread safe: share a ring between tasks only under a lock.
+ *************************************************************************/
+class HistoryRing {
+  public:
+    static const size_t CAPACITY = 1536;        // Bytes of encoded records per machine
+    static const uint32_t TICK_MS = 100;        // Time resolution of stored records
+    static const size_t MAX_RECORD_BYTES = 16;
+
+    void addState(uint32_t nowMs, uint8_t state);
+    void addSummary(uint32_t nowMs, const FeatureSummary &summary);
+    bool isSummaryDue(uint32_t nowMs, uint32_t intervalMs) const;
+    void clear();
+
+    void beginRead(HistoryCursor &cursor) const;
+    bool next(HistoryCursor &cursor, HistoryRecord &record) const;
+
+    size_t getUsedBytes() const { return head - tail; }
+    uint32_t getWrittenBytes() const { return head; }    // Every byte encoded since the last clear(), evicted or not
+    uint32_t getRecordCount() const { return recordCount; }
+    uint32_t getEvictedCount() const { return evictedCount; }
+
+  private:
+    uint8_t bytes[CAPACITY];
+    uint32_t head = 0;                // Logical offset the next record is written at
+    uint32_t tail = 0;                // Logical offset of the oldest record still stored
+    HistoryCursor tailBase = {};      // Values the oldest record's deltas apply to
+    HistoryCursor headState = {};     // Values after the newest record (what new deltas are taken from)
+    uint32_t lastSummaryMs = 0;
+    bool hasSummary = false;
+    uint32_t recordCount = 0;         // Records currently stored
+    uint32_t evictedCount = 0;
+
+    void append(const uint8_t *record, size_t length);
+    size_t decodeAt(uint32_t position, HistoryCursor &state, HistoryRecord &record) const;
+    uint8_t byteAt(uint32_t position) const { return bytes[position % CAPACITY]; }
+    uint32_t readVarint(uint32_t &position) const;
+    size_t encodeHeader(uint8_t *out, uint8_t kind, uint32_t nowMs);
+};
+
+#endif
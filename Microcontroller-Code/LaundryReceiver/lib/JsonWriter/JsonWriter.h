@@ -0,0 +1,216 @@
+/*
+  WasherWatcher LaundryReceiver library
+  "JsonWriter.h"
+
+  Minimal streaming JSON writer that formats straight into a caller-owned buffer.
+  It never touches the heap, so building events all day long can't fragment the ESP32's memory
+  the way a DynamicJsonDocument plus an Arduino String per packet does.
+*/
+
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/******************** JsonWriter Class Definition *************************
+ * Writes values in order, inserting commas and colons as needed. If the
+ * buffer runs out, the writer stops, remembers that it overflowed and keeps
+ * the buffer terminated, so callers only need to check overflowed() at the end.
+ *************************************************************************/
+class JsonWriter {
+  public:
+    static const size_t MAX_DEPTH = 8;
+
+    JsonWriter(char *buffer, size_t capacity);
+    void reset();
+
+    JsonWriter &beginObject() { return open('{'); }
+    JsonWriter &endObject() { return close('}'); }
+    JsonWriter &beginArray() { return open('['); }
+    JsonWriter &endArray() { return close(']'); }
+    JsonWriter &key(const char *name);
+
+    JsonWriter &value(const char *text);
+    JsonWriter &value(bool flag);
+    JsonWriter &value(uint32_t number);
+    JsonWriter &value(int32_t number);
+    JsonWriter &value(float number, uint8_t decimals);
+
+    // Shorthand for "name": value inside an object
+    template <typename T>
+    JsonWriter &field(const char *name, T fieldValue) { return key(name).value(fieldValue); }
+
+    const char *c_str() const { return buffer; }
+    size_t length() const { return used; }
+    size_t getCapacity() const { return capacity; }
+    bool overflowed() const { return overflow; }
+
+    // mark() and rollback() let a caller drop an element that only partly fit
+    size_t mark() const { return used; }
+    void rollback(size_t markedLength, bool wasFirst);
+    bool isFirstInContainer() const { return depth == 0 || first[depth - 1]; }
+
+  private:
+    char *buffer;
+    size_t capacity;
+    size_t used = 0;
+    bool overflow = false;
+
+    size_t depth = 0;
+    bool first[MAX_DEPTH];        // No element written yet at each open nesting level
+    bool afterKey = false;
+
+    JsonWriter &open(char bracket);
+    JsonWriter &close(char bracket);
+    void separate();
+    void put(char c);
+    void putRaw(const char *text);
+};
+
+// Constructor, given the buffer to write into (at least 1 byte)
+inline JsonWriter::JsonWriter(char *buffer, size_t capacity) : buffer(buffer), capacity(capacity) {
+  reset();
+}
+
+// Empties the buffer so the writer can be reused
+inline void JsonWriter::reset() {
+  used = 0;
+  overflow = (capacity == 0);
+  depth = 0;
+  afterKey = false;
+  if (capacity > 0) { buffer[0] = '\0'; }
+}
+
+// Writes an object key; the next call must write its value
+inline JsonWriter &JsonWriter::key(const char *name) {
+  value(name);
+  put(':');
+  afterKey = true;
+  return *this;
+}
+
+// Writes a string, escaping quotes, backslashes and control characters
+inline JsonWriter &JsonWriter::value(const char *text) {
+  separate();
+  put('"');
+  for (const char *c = text; *c; c++) {
+    unsigned char ch = (unsigned char) *c;
+    if (ch == '"' || ch == '\\') {
+      put('\\');
+      put(ch);
+    } else if (ch < 0x20) {
+      char escaped[7];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", ch);
+      putRaw(escaped);
+    } else {
+      put(ch);
+    }
+  }
+  put('"');
+  return *this;
+}
+
+// Writes true or false
+inline JsonWriter &JsonWriter::value(bool flag) {
+  separate();
+  putRaw(flag ? "true" : "false");
+  return *this;
+}
+
+// Writes an unsigned integer
+inline JsonWriter &JsonWriter::value(uint32_t number) {
+  separate();
+  char digits[11];
+  snprintf(digits, sizeof(digits), "%lu", (unsigned long) number);
+  putRaw(digits);
+  return *this;
+}
+
+// Writes a signed integer
+inline JsonWriter &JsonWriter::value(int32_t number) {
+  separate();
+  char digits[12];
+  snprintf(digits, sizeof(digits), "%ld", (long) number);
+  putRaw(digits);
+  return *this;
+}
+
+// Writes a number with a fixed number of decimals, up to 6 (without pulling in printf's float support)
+inline JsonWriter &JsonWriter::value(float number, uint8_t decimals) {
+  separate();
+  if (decimals > 6) { decimals = 6; }
+  if (number < 0) {
+    put('-');
+    number = -number;
+  }
+
+  uint32_t scale = 1;
+  for (uint8_t i = 0; i < decimals; i++) { scale *= 10; }
+  uint32_t scaled = (uint32_t) (number * scale + 0.5);
+
+  char digits[24];
+  if (decimals > 0) {
+    snprintf(digits, sizeof(digits), "%lu.%0*lu", (unsigned long) (scaled / scale), (int) (decimals & 7), (unsigned long) (scaled % scale));
+  } else {
+    snprintf(digits, sizeof(digits), "%lu", (unsigned long) scaled);
+  }
+  putRaw(digits);
+  return *this;
+}
+
+// Drops everything written after mark(), restoring the container's "first element" state
+inline void JsonWriter::rollback(size_t markedLength, bool wasFirst) {
+  if (markedLength > used) { return; }
+  used = markedLength;
+  overflow = false;
+  afterKey = false;
+  if (depth > 0) { first[depth - 1] = wasFirst; }
+  if (capacity > 0) { buffer[used] = '\0'; }
+}
+
+// Starts an object or array
+inline JsonWriter &JsonWriter::open(char bracket) {
+  separate();
+  put(bracket);
+  if (depth < MAX_DEPTH) { first[depth++] = true; }
+  else { overflow = true; }
+  return *this;
+}
+
+// Ends the innermost object or array
+inline JsonWriter &JsonWriter::close(char bracket) {
+  if (depth > 0) { depth--; }
+  put(bracket);
+  return *this;
+}
+
+// Writes the comma between elements (nothing after a key or before the first element)
+inline void JsonWriter::separate() {
+  if (afterKey) {
+    afterKey = false;
+    return;
+  }
+  if (depth > 0) {
+    if (!first[depth - 1]) { put(','); }
+    first[depth - 1] = false;
+  }
+}
+
+// Appends one character, always leaving room for the terminator
+inline void JsonWriter::put(char c) {
+  if (used + 1 >= capacity) {
+    overflow = true;
+    return;
+  }
+  buffer[used++] = c;
+  buffer[used] = '\0';
+}
+
+// Appends a string with no quoting or escaping
+inline void JsonWriter::putRaw(const char *text) {
+  for (const char *c = text; *c; c++) { put(*c); }
+}
+
+#endif
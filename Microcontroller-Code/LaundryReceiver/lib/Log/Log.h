@@ -0,0 +1,29 @@
+/*
+  WasherWatcher LaundryReceiver library
+  "Log.h"
+
+  Serial logging that can be compiled out. Printing from the frame worker takes the Serial lock and
+  waits on the UART, so a deployed receiver is built with -D WASHERWATCHER_LOG=0 and reports through
+  /metrics instead. With logging off, the arguments aren't evaluated at all.
+*/
+
+#ifndef WASHERWATCHER_LOG_H
+#define WASHERWATCHER_LOG_H
+
+#include <Arduino.h>
+
+#ifndef WASHERWATCHER_LOG
+#define WASHERWATCHER_LOG 1
+#endif
+
+#if WASHERWATCHER_LOG
+#define LOG_PRINT(...) Serial.print(__VA_ARGS__)
+#define LOG_PRINTLN(...) Serial.println(__VA_ARGS__)
+#define LOG_PRINTF(...) Serial.printf(__VA_ARGS__)
+#else
+#define LOG_PRINT(...) do {} while (0)
+#define LOG_PRINTLN(...) do {} while (0)
+#define LOG_PRINTF(...) do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,286 @@
+/*
+  WasherWatcher LaundryReceiver library
+  "MachineRegistry.h"
+
+  Maps every sender's MAC address to a compact slot, with the name and room the dashboard shows for it.
+  Machines are listed in a config file on flash, and senders that aren't listed get a slot of their own
+  the first time they are heard. Slots index the state table, the history and the website's events.
+*/
+
+#ifndef MACHINE_REGISTRY_H
+#define MACHINE_REGISTRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <LaundryProtocol.h>
+#include <JsonWriter.h>
+
+// Smallest power of two that is at least n
+constexpr size_t registryTableSize(size_t n, size_t size = 1) {
+  return (size >= n) ? size : registryTableSize(n, size * 2);
+}
+
+// One machine on the dashboard
+typedef struct {
+  uint8_t mac[6];
+  bool hasMac;              // Bound to a sender's MAC address (from the config file, or the first frame it sent)
+  bool configured;          // Listed in the config file
+  uint8_t room;             // Index into the registry's rooms
+  uint16_t machineId;       // LaundryProtocol::machineIdFromName(id)
+  char id[32];              // The sender's BOARD_ID
+  char label[32];           // Name shown on the dashboard
+} RegistrySlot;
+
+
+/******************* MachineRegistry Class Definition *********************
+ * Config file, one machine per line (blank lines and lines starting with # are skipped):
+ *   room,label,id[,mac]
+ *   Farris Hall,Washer 1,FARRIS_WASHER_1,24:6F:28:AA:BB:01
+ * where id is the sender's BOARD_ID. A machine listed without a MAC is
+ * bound to the first sender that sends its id; once bound (or if listed
+ * with one) its slot only ever takes frames from that MAC, whatever id
+ * they carry. Listed machines get slots in the order they are listed,
+ * then unlisted senders in the order they are first heard, in room "Other".
+ *
+ * MAC addresses are found through an open-addressing table (linear probing,
+ * never more than half full), so dispatching a frame costs a hash and
+ * usually one comparison however many machines there are. Slots are never
+ * freed while the receiver runs.
+ * Not thread safe: share a registry between tasks only under a lock.
+ *************************************************************************/
+template <size_t MAX_SLOTS>
+class MachineRegistry {
+  public:
+    static const size_t TABLE_SIZE = registryTableSize(2 * MAX_SLOTS);
+    static const size_t MAX_ROOMS = 8;                    // Including "Other"
+    static const size_t ROOM_BYTES = 32;
+    static const size_t LAYOUT_BYTES_PER_MACHINE = 112;   // Longest entry written by writeLayout(), with its comma
+    static const size_t LAYOUT_BYTES_PER_ROOM = 64;
+    static const size_t LAYOUT_BYTES = MAX_SLOTS * LAYOUT_BYTES_PER_MACHINE + MAX_ROOMS * LAYOUT_BYTES_PER_ROOM + 16;
+
+    size_t loadConfig(const char *text);
+    int lookup(const uint8_t mac[6]) const;
+    int resolve(const uint8_t mac[6], uint16_t machineId, const char *name);
+
+    size_t count() const { return slotCount; }
+    const RegistrySlot &at(size_t slot) const { return slots[slot]; }
+    size_t roomCount() const { return roomTotal; }
+    const char *room(size_t index) const { return rooms[index]; }
+    uint32_t getRejectedLines() const { return rejectedLines; }
+    bool writeLayout(JsonWriter &writer) const;
+
+  private:
+    RegistrySlot slots[MAX_SLOTS];
+    uint16_t table[TABLE_SIZE] = {};    // Slot + 1 of a bound MAC, 0 where empty
+    char rooms[MAX_ROOMS][ROOM_BYTES];
+    size_t slotCount = 0;
+    size_t roomTotal = 0;
+    uint32_t rejectedLines = 0;
+
+    static uint32_t hash(const uint8_t mac[6]);
+    static bool parseMac(const char *text, uint8_t mac[6]);
+    static char *trim(char *text);
+    int findRoom(const char *name, bool add);
+    int addSlot(int room, const char *label, const char *id);
+    void bind(size_t slot, const uint8_t mac[6]);
+    bool parseLine(char *line);
+};
+
+/*
+  Adds every machine listed in text (the config file's contents) after any already registered.
+  Lines that don't parse, or list an id or MAC already registered, are skipped and counted.
+  Returns the number of machines added.
+*/
+template <size_t MAX_SLOTS>
+size_t MachineRegistry<MAX_SLOTS>::loadConfig(const char *text) {
+  size_t before = this->slotCount;
+  char line[160];
+
+  while (*text != '\0') {
+    const char *end = strchr(text, '\n');
+    size_t length = (end != NULL) ? (size_t) (end - text) : strlen(text);
+    if (length < sizeof(line)) {
+      memcpy(line, text, length);
+      line[length] = '\0';
+      char *content = trim(line);
+      if (content[0] != '\0' && content[0] != '#' && !parseLine(content)) { this->rejectedLines++; }
+    } else {
+      this->rejectedLines++;
+    }
+    text += length;
+    if (*text == '\n') { text++; }
+  }
+  return this->slotCount - before;
+}
+
+// Returns the slot bound to a MAC address, or -1 if it has none
+template <size_t MAX_SLOTS>
+int MachineRegistry<MAX_SLOTS>::lookup(const uint8_t mac[6]) const {
+  size_t index = hash(mac) & (TABLE_SIZE - 1);
+  for (size_t probe = 0; probe < TABLE_SIZE; probe++) {
+    uint16_t entry = this->table[index];
+    if (entry == 0) { return -1; }
+    if (memcmp(this->slots[entry - 1].mac, mac, 6) == 0) { return entry - 1; }
+    index = (index + 1) & (TABLE_SIZE - 1);
+  }
+  return -1;
+}
+
+/*
+  Returns the slot for a frame from mac: its bound slot, else the listed machine with its id that no sender has
+  claimed yet, else a new slot in "Other" named after the frame (v1) or its machine id (v2).
+  Returns -1 if every slot is taken.
+*/
+template <size_t MAX_SLOTS>
+int MachineRegistry<MAX_SLOTS>::resolve(const uint8_t mac[6], uint16_t machineId, const char *name) {
+  int slot = lookup(mac);
+  if (slot >= 0) { return slot; }
+
+  for (size_t i = 0; i < this->slotCount; i++) {
+    if (this->slots[i].configured && !this->slots[i].hasMac && this->slots[i].machineId == machineId) {
+      bind(i, mac);
+      return i;
+    }
+  }
+
+  char id[sizeof(this->slots[0].id)];
+  if (name != NULL && name[0] != '\0') {
+    snprintf(id, sizeof(id), "%s", name);
+  } else {
+    snprintf(id, sizeof(id), "MACHINE_%04X", machineId);
+  }
+  slot = addSlot(findRoom("Other", true), id, id);
+  if (slot < 0) { return -1; }
+  this->slots[slot].machineId = machineId;
+  bind(slot, mac);
+  return slot;
+}
+
+/*
+  Writes the dashboard layout, every room with its machines in slot order, e.g.
+    {"rooms":[{"name":"Farris Hall","machines":[{"slot":0,"id":"FARRIS_WASHER_1","label":"Washer 1"}, ...]}, ...]}
+  Returns false if it didn't fit.
+*/
+template <size_t MAX_SLOTS>
+bool MachineRegistry<MAX_SLOTS>::writeLayout(JsonWriter &writer) const {
+  writer.beginObject().key("rooms").beginArray();
+  for (size_t room = 0; room < this->roomTotal; room++) {
+    writer.beginObject().field("name", this->rooms[room]).key("machines").beginArray();
+    for (size_t slot = 0; slot < this->slotCount; slot++) {
+      const RegistrySlot &machine = this->slots[slot];
+      if (machine.room != room) { continue; }
+      writer.beginObject()
+            .field("slot", (uint32_t) slot)
+            .field("id", machine.id)
+            .field("label", machine.label)
+            .endObject();
+    }
+    writer.endArray().endObject();
+  }
+  writer.endArray().endObject();
+  return !writer.overflowed();
+}
+
+// FNV-1a over the address, with the high bits folded in since only the low ones pick a bucket
+template <size_t MAX_SLOTS>
+uint32_t MachineRegistry<MAX_SLOTS>::hash(const uint8_t mac[6]) {
+  uint32_t value = 2166136261UL;
+  for (size_t i = 0; i < 6; i++) {
+    value = (value ^ mac[i]) * 16777619UL;
+  }
+  return value ^ (value >> 16);
+}
+
+// Parses "24:6F:28:AA:BB:01" (either case). Returns false if text isn't exactly a MAC address.
+template <size_t MAX_SLOTS>
+bool MachineRegistry<MAX_SLOTS>::parseMac(const char *text, uint8_t mac[6]) {
+  unsigned bytes[6];
+  char extra;
+  if (sscanf(text, "%2x:%2x:%2x:%2x:%2x:%2x%c", &bytes[0], &bytes[1], &bytes[2], &bytes[3], &bytes[4], &bytes[5], &extra) != 6) {
+    return false;
+  }
+  for (size_t i = 0; i < 6; i++) { mac[i] = (uint8_t) bytes[i]; }
+  return true;
+}
+
+// Strips spaces (and a carriage return) from both ends of text, in place
+template <size_t MAX_SLOTS>
+char *MachineRegistry<MAX_SLOTS>::trim(char *text) {
+  while (*text == ' ' || *text == '\t') { text++; }
+  size_t length = strlen(text);
+  while (length > 0 && (text[length - 1] == ' ' || text[length - 1] == '\t' || text[length - 1] == '\r')) {
+    text[--length] = '\0';
+  }
+  return text;
+}
+
+// Returns a room's index, adding it if add is set and there is room. Returns -1 if it isn't there.
+// The last room is kept for "Other", so senders nobody listed always have somewhere to go.
+template <size_t MAX_SLOTS>
+int MachineRegistry<MAX_SLOTS>::findRoom(const char *name, bool add) {
+  for (size_t i = 0; i < this->roomTotal; i++) {
+    if (strcmp(this->rooms[i], name) == 0) { return i; }
+  }
+  bool other = (strcmp(name, "Other") == 0);
+  if (!add || strlen(name) >= ROOM_BYTES || this->roomTotal == (other ? MAX_ROOMS : MAX_ROOMS - 1)) { return -1; }
+  strcpy(this->rooms[this->roomTotal], name);
+  return this->roomTotal++;
+}
+
+// Adds an unbound slot. Returns its index, or -1 if every slot is taken.
+template <size_t MAX_SLOTS>
+int MachineRegistry<MAX_SLOTS>::addSlot(int room, const char *label, const char *id) {
+  if (room < 0 || this->slotCount == MAX_SLOTS) { return -1; }
+  RegistrySlot &slot = this->slots[this->slotCount];
+  memset(&slot, 0, sizeof(slot));
+  slot.room = (uint8_t) room;
+  slot.machineId = LaundryProtocol::machineIdFromName(id);
+  snprintf(slot.id, sizeof(slot.id), "%s", id);
+  snprintf(slot.label, sizeof(slot.label), "%s", label);
+  return this->slotCount++;
+}
+
+// Binds a slot to a MAC address that no slot has yet
+template <size_t MAX_SLOTS>
+void MachineRegistry<MAX_SLOTS>::bind(size_t slot, const uint8_t mac[6]) {
+  memcpy(this->slots[slot].mac, mac, 6);
+  this->slots[slot].hasMac = true;
+
+  size_t index = hash(mac) & (TABLE_SIZE - 1);
+  while (this->table[index] != 0) { index = (index + 1) & (TABLE_SIZE - 1); }
+  this->table[index] = (uint16_t) (slot + 1);
+}
+
+// Adds the machine on one config line (already trimmed). Returns false if it doesn't parse or can't be added.
+template <size_t MAX_SLOTS>
+bool MachineRegistry<MAX_SLOTS>::parseLine(char *line) {
+  char *fields[4] = {NULL, NULL, NULL, NULL};
+  size_t fieldCount = 0;
+  for (char *field = line; field != NULL && fieldCount < 4; fieldCount++) {
+    char *comma = strchr(field, ',');
+    if (comma != NULL) { *comma = '\0'; }
+    fields[fieldCount] = trim(field);
+    field = (comma != NULL) ? comma + 1 : NULL;
+    if (fieldCount == 3 && field != NULL) { return false; }   // More than 4 fields
+  }
+  if (fieldCount < 3 || fields[1][0] == '\0' || fields[2][0] == '\0') { return false; }
+  if (strlen(fields[1]) >= sizeof(this->slots[0].label) || strlen(fields[2]) >= sizeof(this->slots[0].id)) { return false; }
+
+  uint8_t mac[6];
+  bool hasMac = (fieldCount == 4 && fields[3][0] != '\0');
+  if (hasMac && (!parseMac(fields[3], mac) || lookup(mac) >= 0)) { return false; }
+  uint16_t machineId = LaundryProtocol::machineIdFromName(fields[2]);
+  for (size_t i = 0; i < this->slotCount; i++) {
+    if (this->slots[i].machineId == machineId) { return false; }
+  }
+
+  int slot = addSlot(findRoom(fields[0], true), fields[1], fields[2]);
+  if (slot < 0) { return false; }
+  this->slots[slot].configured = true;
+  if (hasMac) { bind(slot, mac); }
+  return true;
+}
+
+#endif
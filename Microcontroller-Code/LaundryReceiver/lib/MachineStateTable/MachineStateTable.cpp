@@ -0,0 +1,192 @@
+/*
+  WasherWatcher LaundryReceiver library
+  "MachineStateTable.cpp"
+*/
+
+#include "MachineStateTable.h"
+#include <stdio.h>
+#include <string.h>
+
+// Applies a received frame to the entry in slot (below MAX_MACHINES), starting it if it's the slot's first
+StateUpdate MachineStateTable::update(size_t slot, const DecodedFrame &frame, const uint8_t mac[6], uint32_t nowMs) {
+  MachineState *state = has(slot) ? &machines[slot] : NULL;
+  uint32_t bit = (uint32_t) 1 << slot;
+  bool restored = (restoredMask & bit) != 0;
+  restoredMask &= ~bit;
+  StateUpdate result;
+
+  // Resent copies of the last frame, and frames older than it, only show that the machine is still there
+  if (state != NULL && !restored && frame.version == LaundryProtocol::VERSION_2) {
+    uint16_t sequencesBehind = (uint16_t) (state->lastSequence - frame.sequence);
+    uint32_t msBehind = state->lastUptimeMs - frame.uptimeMs;
+    bool duplicate = (sequencesBehind == 0 && msBehind == 0);
+    bool older = (sequencesBehind != 0 && sequencesBehind < 0x8000 && msBehind != 0 && msBehind <= REORDER_WINDOW_MS);
+    if (duplicate || older) {
+      state->lastSeenMs = nowMs;
+      state->frames++;
+      if (duplicate) {
+        state->duplicates++;
+        linkStats.duplicates++;
+      } else {
+        state->outOfOrder++;
+      }
+      return STATE_DUPLICATE;
+    }
+  }
+
+  if (state == NULL) {
+    heardMask |= (uint32_t) 1 << slot;
+    state = &machines[slot];
+    state->machineId = frame.machineId;
+    snprintf(state->name, sizeof(state->name), "%s", frame.name);
+    state->lastTransitionMs = nowMs;
+    state->frames = 0;
+    state->duplicates = 0;
+    state->lostFrames = 0;
+    state->outOfOrder = 0;
+    result = STATE_NEW;
+  } else if (state->machineOn != frame.machineOn || state->phase != frame.phase) {
+    state->lastTransitionMs = nowMs;
+    result = STATE_CHANGED;
+  } else {
+    result = STATE_REPEAT;
+  }
+  if (result != STATE_REPEAT) { dirtyMask |= (uint32_t) 1 << (state - machines); }
+  cycles[state - machines].observe(frame.machineOn, nowMs);
+  if (frame.version == LaundryProtocol::VERSION_2) { trackDelivery(*state, frame, nowMs, result == STATE_NEW || restored); }
+
+  state->frames++;
+  memcpy(state->mac, mac, sizeof(state->mac));
+  state->machineOn = frame.machineOn;
+  state->phase = frame.phase;
+  state->lastSequence = frame.sequence;
+  state->lastSeenMs = nowMs;
+  return result;
+}
+
+/*
+  Puts back a machine's state from before a restart into slot (below MAX_MACHINES): state is its
+  LaundryProtocol::stateCode(), held since sinceMs. Replaying a machine's later changes in order also
+  feeds its CycleModel the cycles they complete. Restored machines aren't marked dirty.
+*/
+void MachineStateTable::restore(size_t slot, const uint8_t mac[6], uint16_t machineId, const char *name, uint8_t state, uint32_t sinceMs) {
+  MachineState &entry = machines[slot];
+  bool machineOn = (state & LaundryProtocol::STATE_ON_BIT) != 0;
+  if (has(slot)) {
+    cycles[slot].observe(machineOn, sinceMs);
+  } else {
+    memset(&entry, 0, sizeof(entry));
+    cycles[slot].resume(machineOn, sinceMs);
+  }
+  heardMask |= (uint32_t) 1 << slot;
+  restoredMask |= (uint32_t) 1 << slot;
+
+  entry.machineId = machineId;
+  memcpy(entry.mac, mac, sizeof(entry.mac));
+  snprintf(entry.name, sizeof(entry.name), "%s", name);
+  entry.machineOn = machineOn;
+  entry.phase = state & LaundryProtocol::STATE_PHASE_MASK;
+  entry.lastTransitionMs = sinceMs;
+  entry.lastSeenMs = sinceMs;
+}
+
+/*
+  Counts the sequence numbers skipped since the machine's last frame and measures how late this one arrived.
+  The sender's clock isn't synchronized with ours, so the delay is measured from the arrival of its fastest recent
+  frame: the smallest difference between our time and its uptime is taken as a frame sent straight through. That
+  baseline creeps up 1 ms per frame so drift between the two crystals can't build up, and restarts with the sender.
+*/
+void MachineStateTable::trackDelivery(MachineState &state, const DecodedFrame &frame, uint32_t nowMs, bool first) {
+  uint32_t offsetMs = nowMs - frame.uptimeMs;
+  if (first || frame.uptimeMs < state.lastUptimeMs) {
+    state.clockOffsetMs = offsetMs;
+  } else {
+    uint16_t skipped = (uint16_t) (frame.sequence - state.lastSequence - 1);
+    if (skipped < 0x8000) {
+      state.lostFrames += skipped;
+      linkStats.sequenceGaps += skipped;
+    }
+  }
+
+  int32_t delayMs = (int32_t) (offsetMs - state.clockOffsetMs);
+  if (delayMs <= 0) {
+    state.clockOffsetMs = offsetMs;
+    delayMs = 0;
+  } else {
+    state.clockOffsetMs++;
+  }
+
+  linkStats.frames++;
+  linkStats.delaySumMs += delayMs;
+  if ((uint32_t) delayMs > linkStats.delayMaxMs) { linkStats.delayMaxMs = delayMs; }
+  if ((uint32_t) delayMs >= LATE_FRAME_MS) { linkStats.lateFrames++; }
+  state.lastUptimeMs = frame.uptimeMs;
+}
+
+// Returns the number of slots that have been heard from
+size_t MachineStateTable::count() const {
+  size_t total = 0;
+  for (uint32_t mask = heardMask; mask != 0; mask &= mask - 1) { total++; }
+  return total;
+}
+
+// Returns the mask of machines that changed since the last call and clears it
+uint32_t MachineStateTable::takeDirty() {
+  uint32_t mask = dirtyMask;
+  dirtyMask = 0;
+  return mask;
+}
+
+/*
+  Writes every machine as a JSON array into out, e.g.
+    [{"slot":0,"id":"FARRIS_WASHER_1","status":true,"phase":3,"lastSeen":1200,"since":64000,"remaining":1500000}, ...]
+  where lastSeen and since are ages in milliseconds, and remaining is the estimated time left in milliseconds
+  (only present while a machine runs and enough of its cycles have been seen). Machines that don't fit in capacity are left out.
+  Returns the length written (excluding the terminator).
+*/
+size_t MachineStateTable::writeJson(char *out, size_t capacity, uint32_t nowMs) const {
+  JsonWriter writer(out, capacity);
+  writeJson(writer, nowMs);
+  return writer.length();
+}
+
+/*
+  Appends the heard machines whose slot's bit is set in mask to writer as a JSON array (same format as above).
+  An entry that doesn't fit is rolled back, so the array stays valid; returns false if anything was left out.
+*/
+bool MachineStateTable::writeJson(JsonWriter &writer, uint32_t nowMs, uint32_t mask) const {
+  bool complete = true;
+  writer.beginArray();
+
+  mask &= heardMask;
+  for (size_t i = 0; i < MAX_MACHINES; i++) {
+    if ((mask & ((uint32_t) 1 << i)) == 0) { continue; }
+
+    const MachineState &state = machines[i];
+    size_t mark = writer.mark();
+    bool wasFirst = writer.isFirstInContainer();
+
+    writer.beginObject()
+          .field("slot", (uint32_t) i)
+          .field("id", state.name)
+          .field("status", state.machineOn)
+          .field("phase", (uint32_t) state.phase)
+          .field("lastSeen", (uint32_t) (nowMs - state.lastSeenMs))
+          .field("since", (uint32_t) (nowMs - state.lastTransitionMs));
+    uint32_t remainingMs;
+    if (cycles[i].estimateRemaining(nowMs, remainingMs)) {
+      writer.field("remaining", remainingMs);
+    }
+    writer.endObject();
+
+    // Keep one byte free for the closing bracket
+    if (writer.overflowed() || writer.length() + 2 > writer.getCapacity()) {
+      writer.rollback(mark, wasFirst);
+      complete = false;
+      break;
+    }
+  }
+
+  writer.endArray();
+  return complete && !writer.overflowed();
+}
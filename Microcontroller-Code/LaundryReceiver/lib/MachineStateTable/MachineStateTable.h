@@ -0,0 +1,103 @@
+/*
+  WasherWatcher LaundryReceiver library
+  "MachineStateTable.h"
+
+  Fixed-size table of the last known state of every sender, so the website can be given a
+  full snapshot at any time instead of waiting for each machine's next transmission.
+*/
+
+#ifndef MACHINE_STATE_TABLE_H
+#define MACHINE_STATE_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <LaundryProtocol.h>
+#include <JsonWriter.h>
+#include <CycleModel.h>
+
+// Everything the receiver knows about one machine
+typedef struct {
+  uint16_t machineId;
+  uint8_t mac[6];
+  char name[32];
+  bool machineOn;
+  uint8_t phase;
+  uint16_t lastSequence;
+  uint32_t lastUptimeMs;      // Sender uptime in its last v2 frame
+  uint32_t clockOffsetMs;     // Arrival time minus sender uptime of its fastest recent frame (see trackDelivery())
+  uint32_t lastSeenMs;        // When any frame from this machine last arrived
+  uint32_t lastTransitionMs;  // When its on/off status or phase last changed
+  uint32_t frames;            // Frames received from it, duplicates included
+  uint32_t duplicates;        // Of those, resent copies that were ignored
+  uint32_t lostFrames;        // Sequence numbers it skipped (never received, or superseded at the sender)
+  uint32_t outOfOrder;        // Of those, frames older than one already applied, which were ignored
+} MachineState;
+
+// How the senders' v2 frames arrived, over every machine
+typedef struct {
+  uint32_t frames;            // Frames applied (duplicates excluded)
+  uint32_t duplicates;        // Resent copies of a frame already applied (an ack was lost), ignored
+  uint32_t sequenceGaps;      // Sequence numbers never received: lost on every try, or superseded at the sender
+  uint32_t lateFrames;        // Frames that arrived LATE_FRAME_MS or more after their sender's fastest (so were resent)
+  uint32_t delaySumMs;        // Arrival delay beyond the sender's fastest frame, summed over frames
+  uint32_t delayMaxMs;
+} LinkStats;
+
+// Outcome of applying a frame to the table
+enum StateUpdate : uint8_t {
+  STATE_NEW,        // First frame from this machine
+  STATE_CHANGED,    // Status or phase differs from the last frame
+  STATE_REPEAT,     // Same state as before (only the last-seen time moved)
+  STATE_DUPLICATE   // Another copy of the last frame, or an older one, ignored (only the last-seen time moved)
+};
+
+
+/**************** MachineStateTable Class Definition *********************
+ * Indexed by the slot the MachineRegistry gives each sender, so a frame goes
+ * straight to its entry; a bit per slot records which have been heard from.
+ * New and changed machines are marked dirty (one bit per slot) until
+ * takeDirty() collects them, so several
+ * changes to one machine between flushes are sent once with its latest state.
+ * Not thread safe: callers that share it between tasks must hold a lock
+ * around every call. Each machine also has a CycleModel, fed with every
+ * status received, for estimating the time left in its cycle.
+ * Senders resend frames whose ack was lost, so a v2 frame repeating the
+ * last one's sequence number and uptime is a duplicate and isn't applied,
+ * and neither is one that arrives behind a newer frame from the same boot.
+ * Every machine's entry counts its own frames, duplicates, losses and
+ * reorderings, which the receiver reports per sender at /metrics.
+ * After a restart, restore() puts back each machine's state from the
+ * receiver's journal; its sender kept counting meanwhile, so the next
+ * frame starts duplicate and delivery tracking over, as a first frame does.
+ *************************************************************************/
+class MachineStateTable {
+  public:
+    static const size_t MAX_MACHINES = 32;             // One bit per slot in the dirty and heard masks
+    static const uint32_t ALL_MACHINES = 0xFFFFFFFF;
+    static const size_t JSON_BYTES_PER_MACHINE = 172;  // Longest possible entry written by writeJson(), with its comma
+    static const uint32_t LATE_FRAME_MS = 100;         // Senders wait at least this long before resending a frame
+    static const uint32_t REORDER_WINDOW_MS = 10000;   // A v2 frame up to this much older than the last is late, not from a restart
+
+    StateUpdate update(size_t slot, const DecodedFrame &frame, const uint8_t mac[6], uint32_t nowMs);
+    void restore(size_t slot, const uint8_t mac[6], uint16_t machineId, const char *name, uint8_t state, uint32_t sinceMs);
+    bool has(size_t slot) const { return slot < MAX_MACHINES && (heardMask & ((uint32_t) 1 << slot)) != 0; }
+    size_t count() const;
+    const MachineState &at(size_t slot) const { return machines[slot]; }
+    uint32_t takeDirty();
+    bool hasDirty() const { return dirtyMask != 0; }
+    size_t writeJson(char *out, size_t capacity, uint32_t nowMs) const;
+    bool writeJson(JsonWriter &writer, uint32_t nowMs, uint32_t mask = ALL_MACHINES) const;
+    const LinkStats &getLinkStats() const { return linkStats; }
+
+  private:
+    MachineState machines[MAX_MACHINES];
+    CycleModel cycles[MAX_MACHINES];   // Learned cycle lengths, indexed like machines
+    uint32_t heardMask = 0;     // Bit i set once machines[i] has had a frame (or was restored)
+    uint32_t dirtyMask = 0;     // Bit i set when machines[i] changed since the last takeDirty()
+    uint32_t restoredMask = 0;  // Bit i set while machines[i] holds a state restored from before a restart, and no frame since
+    LinkStats linkStats = {};
+
+    void trackDelivery(MachineState &state, const DecodedFrame &frame, uint32_t nowMs, bool first);
+};
+
+#endif
@@ -0,0 +1,80 @@
+/*
+  WasherWatcher LaundryReceiver library
+  "Metrics.cpp"
+*/
+
+#include "Metrics.h"
+#include <stdio.h>
+
+// Adds one duration. Only the owning task may call this (the counts are stored, not atomically incremented).
+void LatencyHistogram::record(uint32_t micros) {
+  std::atomic<uint32_t> &count = counts[bucketFor(micros)];
+  count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  sumMicros = sumMicros + micros;
+}
+
+// Returns the number of durations recorded (the sum of every bucket, so it always matches them)
+uint32_t LatencyHistogram::getTotal() const {
+  uint32_t total = 0;
+  for (size_t i = 0; i < BUCKETS; i++) { total += getCount(i); }
+  return total;
+}
+
+// Returns the sum of every duration recorded. It's read until two reads agree, so a read that caught
+// record() between writing the two halves isn't returned.
+uint64_t LatencyHistogram::getSumMicros() const {
+  uint64_t sum = sumMicros;
+  uint64_t again;
+  while ((again = sumMicros) != sum) { sum = again; }
+  return sum;
+}
+
+// Returns the bucket a duration falls in: the first whose upper bound is at least micros
+size_t LatencyHistogram::bucketFor(uint32_t micros) {
+  if (micros <= 1) { return 0; }
+  size_t bits = 32 - __builtin_clz(micros - 1);    // 4^i >= micros when 2i >= bits
+  size_t bucket = (bits + 1) / 2;
+  return (bucket < BUCKETS) ? bucket : BUCKETS - 1;
+}
+
+// Returns a bucket's upper bound in microseconds, or 0 for the last one (which has none)
+uint32_t LatencyHistogram::upperBound(size_t bucket) {
+  return (bucket < BUCKETS - 1) ? (uint32_t) 1 << (2 * bucket) : 0;
+}
+
+// "# HELP" and "# TYPE" lines introducing a metric
+int Prometheus::header(char *out, size_t capacity, const char *name, const char *type, const char *help) {
+  return snprintf(out, capacity, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+// A sample without labels, e.g. "washerwatcher_frames_received_total 1234"
+int Prometheus::sample(char *out, size_t capacity, const char *name, uint32_t value) {
+  return snprintf(out, capacity, "%s %lu\n", name, (unsigned long) value);
+}
+
+// A sample with one label. The label value must not contain quotes or backslashes (machine names don't).
+int Prometheus::sample(char *out, size_t capacity, const char *name, const char *label, const char *labelValue,
+                       uint32_t value) {
+  return snprintf(out, capacity, "%s{%s=\"%s\"} %lu\n", name, label, labelValue, (unsigned long) value);
+}
+
+// A sample of a duration given in microseconds, written in seconds. label may be NULL for none.
+int Prometheus::seconds(char *out, size_t capacity, const char *name, const char *label, const char *labelValue,
+                        uint64_t micros) {
+  unsigned long whole = (unsigned long) (micros / 1000000);
+  unsigned long fraction = (unsigned long) (micros % 1000000);
+  if (label == NULL) {
+    return snprintf(out, capacity, "%s %lu.%06lu\n", name, whole, fraction);
+  }
+  return snprintf(out, capacity, "%s{%s=\"%s\"} %lu.%06lu\n", name, label, labelValue, whole, fraction);
+}
+
+// One cumulative histogram bucket, e.g. "washerwatcher_sse_send_seconds_bucket{le="0.000256"} 17"
+int Prometheus::bucket(char *out, size_t capacity, const char *name, size_t bucket, uint32_t cumulativeCount) {
+  uint32_t bound = LatencyHistogram::upperBound(bucket);
+  if (bound == 0) {
+    return snprintf(out, capacity, "%s_bucket{le=\"+Inf\"} %lu\n", name, (unsigned long) cumulativeCount);
+  }
+  return snprintf(out, capacity, "%s_bucket{le=\"%lu.%06lu\"} %lu\n", name, (unsigned long) (bound / 1000000),
+                  (unsigned long) (bound % 1000000), (unsigned long) cumulativeCount);
+}
@@ -0,0 +1,48 @@
+/*
+  WasherWatcher LaundryReceiver library
+  "Metrics.h"
+
+  Latency histograms cheap enough to update on every received frame, and the Prometheus text format
+  the receiver reports them (and its counters) in at /metrics.
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+/****************** LatencyHistogram Class Definition *********************
+ * Counts durations in microseconds into fixed buckets whose upper bounds
+ * grow by a factor of 4, from 1 us to 4^11 us (about 4.2 s), plus one for
+ * anything longer. Recording is a count-leading-zeros and two additions,
+ * with no lock: exactly one task may call record(), while any other may
+ * read. Only std::atomic is needed, so it also runs on a PC with std::thread.
+ *************************************************************************/
+class LatencyHistogram {
+  public:
+    static const size_t BUCKETS = 13;
+
+    void record(uint32_t micros);
+    uint32_t getCount(size_t bucket) const { return counts[bucket].load(std::memory_order_relaxed); }
+    uint32_t getTotal() const;
+    uint64_t getSumMicros() const;
+    static size_t bucketFor(uint32_t micros);
+    static uint32_t upperBound(size_t bucket);
+
+  private:
+    std::atomic<uint32_t> counts[BUCKETS] = {};
+    volatile uint64_t sumMicros = 0;    // Written in two halves on a 32 bit core, see getSumMicros()
+};
+
+// Writes one piece of a /metrics response into out with snprintf(), returning its length (which may exceed capacity)
+namespace Prometheus {
+  int header(char *out, size_t capacity, const char *name, const char *type, const char *help);
+  int sample(char *out, size_t capacity, const char *name, uint32_t value);
+  int sample(char *out, size_t capacity, const char *name, const char *label, const char *labelValue, uint32_t value);
+  int seconds(char *out, size_t capacity, const char *name, const char *label, const char *labelValue, uint64_t micros);
+  int bucket(char *out, size_t capacity, const char *name, size_t bucket, uint32_t cumulativeCount);
+}
+
+#endif
@@ -0,0 +1,121 @@
+/*
+  WasherWatcher LaundryReceiver library
+  "SpscQueue.h"
+
+  Fixed-size, lock-free single-producer/single-consumer ring buffer.
+  Used to hand received ESP-NOW frames from the WiFi task's callback to the receiver's worker task
+  without blocking the radio stack. Only std::atomic is needed, so it also runs on a PC with std::thread.
+*/
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+/******************** SpscQueue Class Definition **************************
+ * CAPACITY must be a power of two. Exactly one thread may call the producer
+ * methods (tryPush/acquire/publish) and exactly one the consumer methods
+ * (tryPop/front/pop). head and tail only ever increase; the difference is the fill level.
+ *************************************************************************/
+template <typename T, size_t CAPACITY>
+class SpscQueue {
+  static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+  public:
+    // Producer side
+    bool tryPush(const T &item);
+    T *acquire();
+    void publish();
+
+    // Consumer side
+    bool tryPop(T &item);
+    T *front();
+    void pop();
+
+    size_t size() const;
+    size_t capacity() const { return CAPACITY; }
+    uint32_t getPushedCount() const { return pushedCount.load(std::memory_order_relaxed); }
+    uint32_t getDroppedCount() const { return droppedCount.load(std::memory_order_relaxed); }
+    uint32_t getHighWater() const { return highWater.load(std::memory_order_relaxed); }
+
+  private:
+    T slots[CAPACITY];
+
+    // Written by the consumer only (kept on its own cache line so the two sides don't false-share on a PC)
+    alignas(64) std::atomic<uint32_t> head{0};
+    // Written by the producer only
+    alignas(64) std::atomic<uint32_t> tail{0};
+
+    std::atomic<uint32_t> pushedCount{0};
+    std::atomic<uint32_t> droppedCount{0};
+    std::atomic<uint32_t> highWater{0};
+};
+
+// Copies item into the queue. Returns false (and counts a drop) if the queue is full.
+template <typename T, size_t CAPACITY>
+bool SpscQueue<T, CAPACITY>::tryPush(const T &item) {
+  T *slot = acquire();
+  if (slot == nullptr) { return false; }
+  *slot = item;
+  publish();
+  return true;
+}
+
+// Returns the next free slot to fill in place, or nullptr (counting a drop) if the queue is full.
+// The slot only becomes visible to the consumer once publish() is called.
+template <typename T, size_t CAPACITY>
+T *SpscQueue<T, CAPACITY>::acquire() {
+  uint32_t currentTail = tail.load(std::memory_order_relaxed);
+  if (currentTail - head.load(std::memory_order_acquire) >= CAPACITY) {
+    droppedCount.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  return &slots[currentTail & (CAPACITY - 1)];
+}
+
+// Makes the slot returned by the last acquire() visible to the consumer
+template <typename T, size_t CAPACITY>
+void SpscQueue<T, CAPACITY>::publish() {
+  uint32_t newTail = tail.load(std::memory_order_relaxed) + 1;
+  tail.store(newTail, std::memory_order_release);
+  pushedCount.fetch_add(1, std::memory_order_relaxed);
+
+  uint32_t fill = newTail - head.load(std::memory_order_relaxed);
+  if (fill > highWater.load(std::memory_order_relaxed)) {
+    highWater.store(fill, std::memory_order_relaxed);
+  }
+}
+
+// Moves the oldest item out of the queue. Returns false if the queue is empty.
+template <typename T, size_t CAPACITY>
+bool SpscQueue<T, CAPACITY>::tryPop(T &item) {
+  T *slot = front();
+  if (slot == nullptr) { return false; }
+  item = *slot;
+  pop();
+  return true;
+}
+
+// Returns the oldest item without removing it, or nullptr if the queue is empty
+template <typename T, size_t CAPACITY>
+T *SpscQueue<T, CAPACITY>::front() {
+  uint32_t currentHead = head.load(std::memory_order_relaxed);
+  if (currentHead == tail.load(std::memory_order_acquire)) { return nullptr; }
+  return &slots[currentHead & (CAPACITY - 1)];
+}
+
+// Releases the item returned by front() back to the producer
+template <typename T, size_t CAPACITY>
+void SpscQueue<T, CAPACITY>::pop() {
+  head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// Approximate number of queued items (exact when called from either side)
+template <typename T, size_t CAPACITY>
+size_t SpscQueue<T, CAPACITY>::size() const {
+  return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+}
+
+#endif
@@ -0,0 +1,61 @@
+/*
+  WasherWatcher LaundryReceiver library
+  "FsJournalStorage.h"
+
+  JournalStorage implementation on top of an Arduino file system (SPIFFS or LittleFS). Only used by the firmware.
+*/
+
+#ifndef FS_JOURNAL_STORAGE_H
+#define FS_JOURNAL_STORAGE_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include "JournalStorage.h"
+
+/*********************** FsJournalStorage Class ***************************
+ * Opens the file for every call; the journal reads in large chunks and
+ * appends whole batches, so that only costs a few opens per flush.
+ *************************************************************************/
+class FsJournalStorage : public JournalStorage {
+  private:
+    fs::FS &fs;
+
+  public:
+    explicit FsJournalStorage(fs::FS &fs) : fs(fs) {}
+    size_t size(const char *path) override;
+    size_t read(const char *path, size_t offset, uint8_t *buffer, size_t length) override;
+    bool append(const char *path, const uint8_t *data, size_t length) override;
+    bool remove(const char *path) override;
+};
+
+inline size_t FsJournalStorage::size(const char *path) {
+  if (!fs.exists(path)) { return 0; }
+  File file = fs.open(path, "r");
+  if (!file) { return 0; }
+  size_t length = file.size();
+  file.close();
+  return length;
+}
+
+inline size_t FsJournalStorage::read(const char *path, size_t offset, uint8_t *buffer, size_t length) {
+  if (!fs.exists(path)) { return 0; }
+  File file = fs.open(path, "r");
+  if (!file) { return 0; }
+  size_t count = file.seek(offset) ? file.read(buffer, length) : 0;
+  file.close();
+  return count;
+}
+
+inline bool FsJournalStorage::append(const char *path, const uint8_t *data, size_t length) {
+  File file = fs.open(path, "a");
+  if (!file) { return false; }
+  size_t written = file.write(data, length);
+  file.close();
+  return written == length;
+}
+
+inline bool FsJournalStorage::remove(const char *path) {
+  return !fs.exists(path) || fs.remove(path);
+}
+
+#endif
@@ -0,0 +1,34 @@
+/*
+  WasherWatcher LaundryReceiver library
+  "JournalStorage.h"
+
+  Minimal file interface the state journal keeps its files on. The firmware implements it with
+  SPIFFS (see FsJournalStorage.h); a file-backed flash emulator implements it on a PC.
+*/
+
+#ifndef JOURNAL_STORAGE_H
+#define JOURNAL_STORAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/************************ JournalStorage Interface ************************
+ * Files are only ever appended to, read, or removed whole, which every
+ * flash file system supports without rewriting blocks in place. A power
+ * cut during append() may leave any prefix of the data in the file.
+ *************************************************************************/
+class JournalStorage {
+  public:
+    virtual ~JournalStorage() {}
+
+    // Length of a file, 0 if it doesn't exist
+    virtual size_t size(const char *path) = 0;
+    // Reads up to length bytes from offset. Returns how many were read (fewer at the end of the file).
+    virtual size_t read(const char *path, size_t offset, uint8_t *buffer, size_t length) = 0;
+    // Adds data to the end of a file, creating it if needed. Returns false if not all of it was written.
+    virtual bool append(const char *path, const uint8_t *data, size_t length) = 0;
+    // Deletes a file. Returns true if it is gone (including if it never existed).
+    virtual bool remove(const char *path) = 0;
+};
+
+#endif
@@ -0,0 +1,345 @@
+/*
+  WasherWatcher LaundryReceiver library
+  "StateJournal.cpp"
+
+  Every file is a run of records, little endian:
+    offset  size  field
+         0     1  payload length n
+         1     1  record type (JournalRecord)
+         2     n  payload
+       2+n     2  CRC-16/CCITT of bytes 0 .. 1+n
+  Payloads:
+    JOURNAL_START       4  generation of the checkpoint this log follows (always the log's first record)
+    JOURNAL_CLOCK       4  receiver time of the flush
+    JOURNAL_STATE   13+k  MAC address (6), machine id (2), state code (1), time (4), then k bytes of name
+    JOURNAL_CHECKPOINT  9  generation (4), receiver time (4), machine count (1) (a checkpoint's first record)
+    JOURNAL_END         5  generation (4), machine count (1) (a checkpoint's last record; without it the checkpoint is ignored)
+*/
+
+#include "StateJournal.h"
+#include <string.h>
+#include <Crc16.h>
+#include <LaundryProtocol.h>
+
+namespace {
+  enum JournalRecord : uint8_t {
+    JOURNAL_START = 1,
+    JOURNAL_CLOCK = 2,
+    JOURNAL_STATE = 3,
+    JOURNAL_CHECKPOINT = 4,
+    JOURNAL_END = 5
+  };
+
+  const char *CHECKPOINT_PATHS[2] = {"/journal0.ckp", "/journal1.ckp"};   // Generation n goes in CHECKPOINT_PATHS[n & 1]
+  const char *LOG_PATH = "/journal.log";
+
+  const size_t RECORD_OVERHEAD = 4;                   // Length, type and CRC
+  const size_t STATE_FIXED_BYTES = 13;
+  const size_t MAX_PAYLOAD = STATE_FIXED_BYTES + sizeof(((JournalEntry *) 0)->name) - 1;
+  const size_t CLOCK_RECORD_BYTES = RECORD_OVERHEAD + 4;
+
+  using LaundryProtocol::readU16;
+  using LaundryProtocol::readU32;
+  using LaundryProtocol::writeU16;
+  using LaundryProtocol::writeU32;
+
+  // The later of two receiver times (they may have wrapped)
+  uint32_t later(uint32_t a, uint32_t b) {
+    return ((int32_t) (a - b) > 0) ? a : b;
+  }
+
+  // Encodes a record into out (room for RECORD_OVERHEAD + length). Returns its length.
+  size_t encodeRecord(uint8_t *out, uint8_t type, const uint8_t *payload, size_t length) {
+    out[0] = (uint8_t) length;
+    out[1] = type;
+    memcpy(out + 2, payload, length);
+    writeU16(out + 2 + length, crc16(out, 2 + length));
+    return length + RECORD_OVERHEAD;
+  }
+
+  size_t encodeState(uint8_t *payload, const JournalEntry &entry) {
+    memcpy(payload, entry.mac, 6);
+    writeU16(payload + 6, entry.machineId);
+    payload[8] = entry.state;
+    writeU32(payload + 9, entry.timeMs);
+    size_t nameLength = strnlen(entry.name, sizeof(entry.name) - 1);
+    memcpy(payload + STATE_FIXED_BYTES, entry.name, nameLength);
+    return STATE_FIXED_BYTES + nameLength;
+  }
+
+  bool decodeState(const uint8_t *payload, size_t length, JournalEntry &entry) {
+    if (length < STATE_FIXED_BYTES || length > MAX_PAYLOAD) { return false; }
+    memcpy(entry.mac, payload, 6);
+    entry.machineId = readU16(payload + 6);
+    entry.state = payload[8];
+    entry.timeMs = readU32(payload + 9);
+    memcpy(entry.name, payload + STATE_FIXED_BYTES, length - STATE_FIXED_BYTES);
+    entry.name[length - STATE_FIXED_BYTES] = '\0';
+    return true;
+  }
+
+  /*
+    Reads a file's records in order through a caller-owned window, so a whole file costs a few large reads.
+    Stops for good at the end of the file or at the first record that is cut short or fails its CRC.
+  */
+  class RecordReader {
+    public:
+      RecordReader(JournalStorage &storage, const char *path, uint8_t *window, size_t capacity)
+        : storage(storage), path(path), window(window), capacity(capacity) {}
+
+      // Returns the next good record's type and payload (valid until the next call), or false if there is none
+      bool next(uint8_t &type, const uint8_t *&payload, size_t &length) {
+        if (!fill(2)) { return false; }
+        length = window[start];
+        size_t total = length + RECORD_OVERHEAD;
+        if (length > MAX_PAYLOAD || !fill(total)) { return false; }
+        const uint8_t *record = window + start;
+        if (crc16(record, length + 2) != readU16(record + 2 + length)) { return false; }
+
+        type = record[1];
+        payload = record + 2;
+        start += total;
+        consumed += total;
+        return true;
+      }
+
+      // Bytes of good records read so far
+      size_t getConsumed() const { return consumed; }
+
+    private:
+      JournalStorage &storage;
+      const char *path;
+      uint8_t *window;
+      size_t capacity;
+      size_t start = 0;         // Window offset of the next record
+      size_t end = 0;           // Bytes in the window
+      size_t fileOffset = 0;    // File offset just past the window's end
+      size_t consumed = 0;
+
+      // Makes sure the window holds at least needed bytes from start, reading more of the file if it must
+      bool fill(size_t needed) {
+        if (end - start >= needed) { return true; }
+        memmove(window, window + start, end - start);
+        end -= start;
+        start = 0;
+        size_t count = storage.read(path, fileOffset, window + end, capacity - end);
+        fileOffset += count;
+        end += count;
+        return end >= needed;
+      }
+  };
+}
+
+/*
+  Rebuilds the journal from flash: the newest complete checkpoint, then the log after it. replay (if not NULL) is
+  called with every machine in the checkpoint and then every state change in the log, in the order they happened.
+  Ends with a new checkpoint, which also drops any torn record at the end of the log.
+  Returns true if any machine was restored.
+*/
+bool StateJournal::restore(ReplayCallback replay) {
+  uint32_t generations[2];
+  uint32_t times[2];
+  bool valid[2];
+  for (size_t i = 0; i < 2; i++) {
+    valid[i] = readCheckpoint(CHECKPOINT_PATHS[i], false, NULL, generations[i], times[i]);
+  }
+  int newest = -1;
+  for (int i = 0; i < 2; i++) {
+    if (valid[i] && (newest < 0 || (int32_t) (generations[i] - generations[newest]) > 0)) { newest = i; }
+  }
+
+  this->machineCount = 0;
+  this->clockMs = 0;
+  this->stats.generation = 0;   // No log follows generation 0, so without a checkpoint the log is ignored too
+  if (newest >= 0) {
+    readCheckpoint(CHECKPOINT_PATHS[newest], true, replay, this->stats.generation, this->clockMs);
+    this->stats.checkpointEntries = this->machineCount;
+  }
+  replayLog(replay);
+
+  checkpoint(this->clockMs);
+  return this->machineCount > 0;
+}
+
+/*
+  Adds a machine's new state to the journal (flushing first if the buffer is full). Returns false if the journal
+  already holds MAX_MACHINES other machines, in which case the change isn't journaled.
+*/
+bool StateJournal::record(const JournalEntry &entry) {
+  if (!apply(entry)) {
+    this->stats.droppedRecords++;
+    return false;
+  }
+  this->stats.records++;
+
+  uint8_t payload[MAX_PAYLOAD];
+  size_t length = encodeState(payload, entry);
+  if (this->pendingLength + length + RECORD_OVERHEAD + CLOCK_RECORD_BYTES > BUFFER_BYTES) {
+    flush(entry.timeMs);
+  }
+  if (this->pendingLength == 0) { this->pendingSinceMs = entry.timeMs; }
+  return appendPending(JOURNAL_STATE, payload, length);
+}
+
+// Milliseconds until flush() should be called: FLUSH_INTERVAL_MS after the oldest unflushed change, or CLOCK_INTERVAL_MS after the last write
+uint32_t StateJournal::msUntilFlush(uint32_t nowMs) const {
+  uint32_t dueMs = (this->pendingLength > 0) ? this->pendingSinceMs + FLUSH_INTERVAL_MS : this->lastWriteMs + CLOCK_INTERVAL_MS;
+  int32_t leftMs = (int32_t) (dueMs - nowMs);
+  return (leftMs > 0) ? (uint32_t) leftMs : 0;
+}
+
+/*
+  Appends the buffered changes and a clock mark to the log in one write, then checkpoints if the log has grown
+  past CHECKPOINT_LOG_BYTES. A failed write may have left part of a record behind, which restore() would stop at,
+  so it checkpoints too. Returns false if anything failed to write.
+*/
+bool StateJournal::flush(uint32_t nowMs) {
+  uint8_t payload[4];
+  writeU32(payload, nowMs);
+  appendPending(JOURNAL_CLOCK, payload, sizeof(payload));
+
+  bool written = this->storage.append(LOG_PATH, this->pending, this->pendingLength);
+  if (written) {
+    this->stats.flushes++;
+    this->stats.bytesWritten += this->pendingLength;
+    this->logBytes += this->pendingLength;
+  } else {
+    this->stats.writeFailures++;
+  }
+  this->pendingLength = 0;
+  this->lastWriteMs = nowMs;
+  this->clockMs = later(this->clockMs, nowMs);
+
+  if (!written || this->logBytes >= CHECKPOINT_LOG_BYTES) {
+    return checkpoint(nowMs) && written;
+  }
+  return true;
+}
+
+/*
+  Writes every machine's state into the checkpoint file the older generation is in, then starts the log over.
+  Unflushed changes are already in that state, so they are dropped rather than written twice.
+  Returns false (keeping the previous checkpoint and its log) if the checkpoint couldn't be written.
+*/
+bool StateJournal::checkpoint(uint32_t nowMs) {
+  uint32_t generation = this->stats.generation + 1;
+  const char *path = CHECKPOINT_PATHS[generation & 1];
+  this->clockMs = later(this->clockMs, nowMs);
+  this->pendingLength = 0;
+  this->lastWriteMs = nowMs;
+
+  // The pending buffer is free now, so the checkpoint is built in it and written a buffer at a time
+  bool written = this->storage.remove(path);
+  uint8_t payload[MAX_PAYLOAD];
+  writeU32(payload, generation);
+  writeU32(payload + 4, this->clockMs);
+  payload[8] = (uint8_t) this->machineCount;
+  appendPending(JOURNAL_CHECKPOINT, payload, 9);
+
+  for (size_t i = 0; i < this->machineCount; i++) {
+    size_t length = encodeState(payload, this->machines[i]);
+    if (this->pendingLength + length + RECORD_OVERHEAD > BUFFER_BYTES) {
+      written = written && this->storage.append(path, this->pending, this->pendingLength);
+      this->stats.bytesWritten += this->pendingLength;
+      this->pendingLength = 0;
+    }
+    appendPending(JOURNAL_STATE, payload, length);
+  }
+  writeU32(payload, generation);
+  payload[4] = (uint8_t) this->machineCount;
+  appendPending(JOURNAL_END, payload, 5);
+  written = written && this->storage.append(path, this->pending, this->pendingLength);
+  this->stats.bytesWritten += this->pendingLength;
+  this->pendingLength = 0;
+
+  if (!written) {
+    this->stats.writeFailures++;
+    this->logBytes = CHECKPOINT_LOG_BYTES;   // Try again at the next flush
+    return false;
+  }
+
+  // Only now is the old log covered by a checkpoint, so it can go
+  this->stats.generation = generation;
+  this->stats.checkpoints++;
+  writeU32(payload, generation);
+  appendPending(JOURNAL_START, payload, 4);
+  written = this->storage.remove(LOG_PATH) && this->storage.append(LOG_PATH, this->pending, this->pendingLength);
+  this->stats.bytesWritten += this->pendingLength;
+  this->logBytes = this->pendingLength;
+  this->pendingLength = 0;
+  if (!written) { this->stats.writeFailures++; }
+  return written;
+}
+
+// Makes entry its machine's latest state, adding the machine if it's new. Returns false if there is no room for it.
+bool StateJournal::apply(const JournalEntry &entry) {
+  size_t index = 0;
+  while (index < this->machineCount && memcmp(this->machines[index].mac, entry.mac, 6) != 0) { index++; }
+  if (index == MAX_MACHINES) { return false; }
+  if (index == this->machineCount) { this->machineCount++; }
+
+  this->machines[index] = entry;
+  this->machines[index].name[sizeof(entry.name) - 1] = '\0';
+  this->clockMs = later(this->clockMs, entry.timeMs);
+  return true;
+}
+
+/*
+  Checks a checkpoint file and reads its generation and time. Its machines are only taken in (and passed to replay,
+  if it isn't NULL) if load is set. Returns false if the file is missing, torn or corrupt; a file that is only
+  checked, not loaded, can't leave anything half taken in.
+*/
+bool StateJournal::readCheckpoint(const char *path, bool load, ReplayCallback replay, uint32_t &generation, uint32_t &checkpointMs) {
+  RecordReader reader(this->storage, path, this->pending, BUFFER_BYTES);
+  uint8_t type;
+  const uint8_t *payload;
+  size_t length;
+  if (!reader.next(type, payload, length) || type != JOURNAL_CHECKPOINT || length != 9) { return false; }
+  generation = readU32(payload);
+  checkpointMs = readU32(payload + 4);
+  size_t expected = payload[8];
+
+  size_t entries = 0;
+  while (reader.next(type, payload, length)) {
+    if (type == JOURNAL_END) {
+      return length == 5 && readU32(payload) == generation && payload[4] == expected && entries == expected;
+    }
+    JournalEntry entry;
+    if (type != JOURNAL_STATE || !decodeState(payload, length, entry)) { return false; }
+    entries++;
+    if (load && apply(entry) && replay != NULL) { replay(entry); }
+  }
+  return false;
+}
+
+/*
+  Replays the log after the loaded checkpoint, up to the first record that doesn't check out. A log that follows
+  another generation was already covered by a checkpoint (the crash came before it was started over), so it is skipped.
+*/
+void StateJournal::replayLog(ReplayCallback replay) {
+  RecordReader reader(this->storage, LOG_PATH, this->pending, BUFFER_BYTES);
+  uint8_t type;
+  const uint8_t *payload;
+  size_t length;
+  if (!reader.next(type, payload, length) || type != JOURNAL_START || length != 4 || readU32(payload) != this->stats.generation) {
+    return;
+  }
+
+  while (reader.next(type, payload, length)) {
+    JournalEntry entry;
+    if (type == JOURNAL_CLOCK && length == 4) {
+      this->clockMs = later(this->clockMs, readU32(payload));
+    } else if (type == JOURNAL_STATE && decodeState(payload, length, entry)) {
+      this->stats.logRecords++;
+      if (apply(entry) && replay != NULL) { replay(entry); }
+    }
+  }
+  this->stats.discardedBytes = this->storage.size(LOG_PATH) - reader.getConsumed();
+}
+
+// Encodes a record onto the end of the pending buffer. Returns false (adding nothing) if it doesn't fit.
+bool StateJournal::appendPending(uint8_t type, const uint8_t *payload, size_t length) {
+  if (this->pendingLength + length + RECORD_OVERHEAD > BUFFER_BYTES) { return false; }
+  this->pendingLength += encodeRecord(this->pending + this->pendingLength, type, payload, length);
+  return true;
+}
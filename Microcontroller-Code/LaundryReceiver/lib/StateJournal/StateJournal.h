@@ -0,0 +1,107 @@
+/*
+  WasherWatcher LaundryReceiver library
+  "StateJournal.h"
+
+  Append-only journal of machine state changes on flash, so a receiver that restarts (a brownout,
+  a watchdog reset) knows every machine's state again straight away instead of showing "Unknown"
+  until each sender's next frame.
+*/
+
+#ifndef STATE_JOURNAL_H
+#define STATE_JOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "JournalStorage.h"
+
+// One machine's state as journaled, keyed by its sender's MAC address
+typedef struct {
+  uint8_t mac[6];
+  uint16_t machineId;
+  uint8_t state;            // LaundryProtocol::stateCode()
+  uint32_t timeMs;          // Receiver time the state began
+  char name[32];            // Name the receiver gave the machine
+} JournalEntry;
+
+// What the journal has done since the receiver started
+typedef struct {
+  uint32_t generation;          // Checkpoint the journal is appending after
+  uint32_t checkpointEntries;   // Machines read from the checkpoint at restore
+  uint32_t logRecords;          // Records replayed from the log after it
+  uint32_t discardedBytes;      // Torn or corrupt bytes at the end of the log, ignored at restore
+  uint32_t records;             // State changes journaled since
+  uint32_t droppedRecords;      // Of those, ones for a machine the journal had no room for
+  uint32_t flushes;
+  uint32_t bytesWritten;
+  uint32_t checkpoints;
+  uint32_t writeFailures;
+} JournalStats;
+
+
+/******************** StateJournal Class Definition ***********************
+ * Files (all records CRC-checked, see StateJournal.cpp for the layout):
+ *   two checkpoint files, used in turn: every machine's state at one moment,
+ *     between a header and a trailer that both carry its generation number
+ *   a log: the generation it follows, then state changes and clock marks
+ * State changes are kept in RAM and appended as one write every
+ * FLUSH_INTERVAL_MS (or when the buffer fills), so a burst of changes costs
+ * one flash write; with nothing to write, a clock mark still goes out every
+ * CLOCK_INTERVAL_MS. Once the log passes CHECKPOINT_LOG_BYTES, the state
+ * is written into the older checkpoint file and the log starts over,
+ * which bounds both the flash used and how much restore() has to read.
+ *
+ * restore() takes the newest complete checkpoint and replays the log after
+ * it up to the first record that doesn't check out (a write torn by the
+ * power cut), then checkpoints straight away so the next append starts
+ * clean. A crash at any point leaves either the old checkpoint plus its
+ * log, or the new checkpoint, so no change written before the last
+ * completed flush is lost.
+ *
+ * Times are on the receiver's clock, which the firmware carries on from
+ * getClockMs() after a restart, so they stay comparable across restarts
+ * (the time the receiver was off doesn't count).
+ * Not thread safe: only one task may use a journal.
+ *************************************************************************/
+class StateJournal {
+  public:
+    static const size_t MAX_MACHINES = 32;
+    static const size_t BUFFER_BYTES = 1024;             // Records waiting for the next flush
+    static const uint32_t FLUSH_INTERVAL_MS = 10000;     // Longest a state change waits in RAM
+    static const uint32_t CLOCK_INTERVAL_MS = 600000;    // Longest between writes while nothing changes
+    static const size_t CHECKPOINT_LOG_BYTES = 16384;    // Log size that triggers a checkpoint
+
+    typedef void (*ReplayCallback)(const JournalEntry &entry);
+
+    explicit StateJournal(JournalStorage &storage) : storage(storage) {}
+
+    bool restore(ReplayCallback replay);
+    bool record(const JournalEntry &entry);
+    uint32_t msUntilFlush(uint32_t nowMs) const;
+    bool flush(uint32_t nowMs);
+    bool checkpoint(uint32_t nowMs);
+
+    uint32_t getClockMs() const { return clockMs; }
+    size_t count() const { return machineCount; }
+    const JournalEntry &at(size_t index) const { return machines[index]; }
+    size_t getLogBytes() const { return logBytes; }
+    const JournalStats &getStats() const { return stats; }
+
+  private:
+    JournalStorage &storage;
+    JournalEntry machines[MAX_MACHINES];   // Latest state of every machine journaled, what a checkpoint holds
+    size_t machineCount = 0;
+    uint8_t pending[BUFFER_BYTES];         // Encoded records not flushed yet
+    size_t pendingLength = 0;
+    uint32_t pendingSinceMs = 0;           // When the oldest pending record was added
+    uint32_t lastWriteMs = 0;
+    uint32_t clockMs = 0;                  // Latest receiver time written or read back
+    size_t logBytes = 0;
+    JournalStats stats = {};
+
+    bool apply(const JournalEntry &entry);
+    bool readCheckpoint(const char *path, bool load, ReplayCallback replay, uint32_t &generation, uint32_t &checkpointMs);
+    void replayLog(ReplayCallback replay);
+    bool appendPending(uint8_t type, const uint8_t *payload, size_t length);
+};
+
+#endif
@@ -0,0 +1,107 @@
+/*
+  WasherWatcher LaundryReceiver library
+  "UplinkQueue.cpp"
+*/
+
+#include "UplinkQueue.h"
+#include <string.h>
+
+namespace {
+  // Writes an unsigned LEB128 varint (7 bits per byte), returning its length
+  size_t writeVarint(uint8_t *out, uint32_t value) {
+    size_t length = 0;
+    while (value >= 0x80) {
+      out[length++] = (uint8_t) (value | 0x80);
+      value >>= 7;
+    }
+    out[length++] = (uint8_t) value;
+    return length;
+  }
+}
+
+// Sets the receiver identity written into every batch, and starts the sequence numbers over
+void UplinkQueue::begin(const uint8_t mac[6], uint32_t bootId) {
+  memcpy(this->mac, mac, sizeof(this->mac));
+  this->bootId = bootId;
+  this->sequence = 0;
+}
+
+// Adds a record to the backlog. Returns false if it (or, for a state change, the oldest record) had to be dropped.
+bool UplinkQueue::push(const UplinkRecord &record) {
+  bool kept = true;
+  if (this->filled == CAPACITY) {
+    this->droppedCount++;
+    if (record.kind != UPLINK_STATE) { return false; }
+    this->head = (this->head + 1) % CAPACITY;
+    this->filled--;
+    kept = false;
+  }
+
+  this->records[(this->head + this->filled) % CAPACITY] = record;
+  this->filled++;
+  this->queuedCount++;
+  return kept;
+}
+
+/*
+  Packs as many of the oldest records as fit into a batch in out, and removes them from the backlog.
+  Returns the batch length, or 0 if the backlog is empty (or capacity can't hold a header and one record).
+*/
+size_t UplinkQueue::takeBatch(uint32_t nowMs, uint8_t *out, size_t capacity) {
+  if (this->filled == 0 || capacity < HEADER_BYTES + MAX_RECORD_BYTES) { return 0; }
+
+  uint32_t firstMs = this->records[this->head].timeMs;
+  uint32_t previousMs = firstMs;
+  size_t length = HEADER_BYTES;
+  size_t count = 0;
+  while (count < this->filled && count < MAX_BATCH_RECORDS && length + MAX_RECORD_BYTES <= capacity) {
+    const UplinkRecord &record = this->records[(this->head + count) % CAPACITY];
+    length += encodeRecord(record, previousMs, out + length);
+    previousMs = record.timeMs;
+    count++;
+  }
+
+  out[0] = 'W';
+  out[1] = 'B';
+  out[2] = VERSION;
+  out[3] = (uint8_t) count;
+  memcpy(out + 4, this->mac, sizeof(this->mac));
+  LaundryProtocol::writeU32(out + 10, this->bootId);
+  LaundryProtocol::writeU32(out + 14, this->sequence);
+  LaundryProtocol::writeU32(out + 22, firstMs);
+  LaundryProtocol::writeU32(out + 26, this->droppedCount);
+  stampBatch(out, nowMs);
+
+  this->head = (this->head + count) % CAPACITY;
+  this->filled -= count;
+  this->sequence++;
+  return length;
+}
+
+// Updates a batch's send time before it is (re)sent, so the server can place its records in wall clock time
+void UplinkQueue::stampBatch(uint8_t *batch, uint32_t nowMs) {
+  LaundryProtocol::writeU32(batch + 18, nowMs);
+}
+
+// Number of records packed into a batch made by takeBatch()
+size_t UplinkQueue::batchRecordCount(const uint8_t *batch) {
+  return batch[3];
+}
+
+// Encodes one record after the one recorded at previousMs. Returns its length (at most MAX_RECORD_BYTES).
+size_t UplinkQueue::encodeRecord(const UplinkRecord &record, uint32_t previousMs, uint8_t *out) const {
+  size_t length = 0;
+  out[length++] = record.kind;
+  length += writeVarint(out + length, record.timeMs - previousMs);
+  LaundryProtocol::writeU16(out + length, record.machineId);
+  length += 2;
+  out[length++] = record.state;
+
+  if (record.kind == UPLINK_SUMMARY) {
+    out[length++] = record.summary.phase;
+    out[length++] = record.summary.peakFreqDeciHz;
+    length += writeVarint(out + length, record.summary.meanCms2);
+    length += writeVarint(out + length, record.summary.stdDevMms2);
+  }
+  return length;
+}
@@ -0,0 +1,89 @@
+/*
+  WasherWatcher LaundryReceiver library
+  "UplinkQueue.h"
+
+  Bounded backlog of state changes and feature summaries waiting to be sent upstream to the back-end server,
+  packed into compact binary batches so one server can collect from every laundry room's receiver.
+*/
+
+#ifndef UPLINK_QUEUE_H
+#define UPLINK_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <LaundryProtocol.h>
+#include <RetryBackoff.h>
+
+// Kinds of uplink record (the same numbering as HistoryKind)
+enum UplinkKind : uint8_t {
+  UPLINK_STATE = 0,     // A machine's on/off status or phase changed
+  UPLINK_SUMMARY = 1    // Periodic vibration features while a machine runs
+};
+
+// One record waiting to be sent
+typedef struct {
+  uint32_t timeMs;          // Receiver uptime when it was recorded
+  uint16_t machineId;
+  uint8_t kind;             // UplinkKind
+  uint8_t state;            // State code (LaundryProtocol::stateCode()) as of this record
+  FeatureSummary summary;   // Only meaningful for UPLINK_SUMMARY
+} UplinkRecord;
+
+
+/******************* UplinkQueue Class Definition *************************
+ * Batch layout (little endian, decoded by back-end/ingest.ts):
+ *   offset  size  field
+ *        0     2  magic "WB"
+ *        2     1  version (always 1)
+ *        3     1  number of records
+ *        4     6  receiver MAC address
+ *       10     4  boot id (random each boot, so the server can tell a rebooted receiver's sequences apart)
+ *       14     4  batch sequence number, counting up from 0 each boot
+ *       18     4  receiver uptime when the batch was sent (rewritten on every retry, see stampBatch())
+ *       22     4  receiver uptime of the first record
+ *       26     4  records dropped from the backlog since boot
+ *       30        records, oldest first: kind byte, varint ms since the previous record, machine id (2), then
+ *                   UPLINK_STATE:   state code byte
+ *                   UPLINK_SUMMARY: state code, phase, peakFreqDeciHz, varint meanCms2, varint stdDevMms2
+ * A state record usually costs 5-7 bytes and a summary 10-13, against about 70 as JSON.
+ *
+ * When the backlog is full a new summary is dropped, and a new state change
+ * evicts the oldest record instead, since missing a change is worse than
+ * missing a summary. takeBatch() removes the records it packs: the caller
+ * keeps the batch and resends the same bytes (same sequence number) until the
+ * server accepts it, so a retry can never be stored twice.
+ * Not thread safe: share a queue between tasks only under a lock.
+ *************************************************************************/
+class UplinkQueue {
+  public:
+    static const size_t CAPACITY = 512;         // Records the backlog holds (about 8 KB)
+    static const size_t HEADER_BYTES = 30;
+    static const size_t MAX_RECORD_BYTES = 17;
+    static const size_t MAX_BATCH_RECORDS = 255;
+    static const uint8_t VERSION = 1;
+
+    void begin(const uint8_t mac[6], uint32_t bootId);
+    bool push(const UplinkRecord &record);
+    size_t takeBatch(uint32_t nowMs, uint8_t *out, size_t capacity);
+    static void stampBatch(uint8_t *batch, uint32_t nowMs);
+    static size_t batchRecordCount(const uint8_t *batch);
+
+    size_t count() const { return filled; }
+    uint32_t getQueuedCount() const { return queuedCount; }
+    uint32_t getDroppedCount() const { return droppedCount; }
+    uint32_t getBatchCount() const { return sequence; }
+
+  private:
+    UplinkRecord records[CAPACITY];
+    size_t head = 0;                  // Index of the oldest record
+    size_t filled = 0;
+    uint8_t mac[6] = {0, 0, 0, 0, 0, 0};
+    uint32_t bootId = 0;
+    uint32_t sequence = 0;            // Sequence number of the next batch
+    uint32_t queuedCount = 0;
+    uint32_t droppedCount = 0;
+
+    size_t encodeRecord(const UplinkRecord &record, uint32_t previousMs, uint8_t *out) const;
+};
+
+#endif
@@ -12,58 +12,975 @@
 
 #include <esp_now.h>
 #include <WiFi.h>
-#include <ArduinoJson.h>
+#include <HTTPClient.h>
 #include "AsyncTCP.h"
 #include "ESPAsyncWebServer.h"
 #include "SPIFFS.h"
+#include "WebAssets.h"
+#include <LaundryProtocol.h>
+#include <SpscQueue.h>
+#include <MachineStateTable.h>
+#include <MachineRegistry.h>
+#include <JsonWriter.h>
+#include <HistoryRing.h>
+#include <UplinkQueue.h>
+#include <Metrics.h>
+#include <EventFanout.h>
+#include <StateJournal.h>
+#include <FsJournalStorage.h>
+#include <Log.h>
 
 const char* SSID = "UCAWIRELESS"; // String name of the WiFi network to connect to
 const char* PASSWORD = "";        // String password of the WiFi network (null for UCAWireless)
 
+/*
+  Back-end server every receiver sends its machines' state changes and summaries to (see back-end/server.ts),
+  so one server can follow every laundry room. Set to "" for a receiver that only hosts its own website.
+*/
+const char* UPLINK_URL = "http://10.0.0.2:3000/api/ingest";
+
 AsyncWebServer server(80);
-AsyncEventSource events("/events");
 
-// Structure to receive data. Must match the sender structure
+/*
+  Machines shown on the website, read from this file on SPIFFS (see data/machines.csv for the format) when the
+  receiver starts. Without one, the machines below are used. The website lays itself out from this list.
+*/
+const char* MACHINE_CONFIG_PATH = "/machines.csv";
+const size_t MACHINE_CONFIG_BYTES = 4096;    // Longest config file read
+const char* DEFAULT_MACHINES =
+  "Farris Hall Laundry Room,Washer 1,FARRIS_WASHER_1\n"
+  "Farris Hall Laundry Room,Washer 2,FARRIS_WASHER_2\n"
+  "Farris Hall Laundry Room,Washer 3,FARRIS_WASHER_3\n"
+  "Farris Hall Laundry Room,Washer 4,FARRIS_WASHER_4\n"
+  "Farris Hall Laundry Room,Washer 5,FARRIS_WASHER_5\n"
+  "Farris Hall Laundry Room,Washer 6,FARRIS_WASHER_6\n"
+  "Farris Hall Laundry Room,Dryer 1,FARRIS_DRYER_1\n"
+  "Farris Hall Laundry Room,Dryer 2,FARRIS_DRYER_2\n"
+  "Farris Hall Laundry Room,Dryer 3,FARRIS_DRYER_3\n"
+  "Farris Hall Laundry Room,Dryer 4,FARRIS_DRYER_4\n"
+  "Farris Hall Laundry Room,Dryer 5,FARRIS_DRYER_5\n"
+  "Farris Hall Laundry Room,Dryer 6,FARRIS_DRYER_6\n";
+
+// A raw ESP-NOW frame exactly as received, waiting in the queue for the worker task
 typedef struct {
-  char id[32];
-  bool machineOn;
-} sensor_message;
+  uint8_t mac[6];
+  uint8_t length;
+  uint8_t data[ESP_NOW_MAX_DATA_LEN];
+  uint32_t receivedMs;
+  uint32_t receivedUs;    // micros() when OnDataRecv was called, for the queueing time
+} ReceivedFrame;
+
+const size_t FRAME_QUEUE_SIZE = 32;                       // Frames that can wait for the worker (must be a power of two)
+SpscQueue<ReceivedFrame, FRAME_QUEUE_SIZE> frameQueue;    // Filled by OnDataRecv (WiFi task), drained by frameWorker
+TaskHandle_t frameWorkerHandle = NULL;
+uint32_t malformedFrames = 0;
+
+// Most recently received frame, decoded from either protocol version
+DecodedFrame receivedFrame;
+
+// Last known state of every machine, written by the frame worker and read by the web server
+MachineStateTable stateTable;
+SemaphoreHandle_t stateTableMutex = NULL;
+char snapshotJson[MachineStateTable::MAX_MACHINES * MachineStateTable::JSON_BYTES_PER_MACHINE + 3];   // Only used from the web server's task
 
-// Create a sensor_message called receivedMessage
-sensor_message receivedMessage;
+// Slot of every sender by MAC address, indexing stateTable and machineHistory. Guarded by stateTableMutex too.
+typedef MachineRegistry<MachineStateTable::MAX_MACHINES> Registry;
+Registry registry;
+char layoutJson[Registry::LAYOUT_BYTES];    // Only used from the web server's task
 
-// Callback function that will be executed when data is received
+// Status changes are coalesced and sent to the website at most this often, one machine_status event per machine
+const uint32_t STATUS_FLUSH_INTERVAL = 250;   // Milliseconds between flushes
+char statusJson[MachineStateTable::JSON_BYTES_PER_MACHINE + 3];     // Only used from the frame worker task
+uint32_t lastStatusFlushMs = 0;
+
+// Browsers on /events, fed from shared event buffers. fanoutMutex is always taken before stateTableMutex.
+const size_t MAX_EVENT_CLIENTS = 16;          // Browsers beyond this are asked to come back later
+EventFanout<MAX_EVENT_CLIENTS> fanout;
+SemaphoreHandle_t fanoutMutex = NULL;
+
+// Recent history of every machine, indexed like stateTable and guarded by stateTableMutex too
+const uint32_t HISTORY_SUMMARY_INTERVAL = 600000;   // Milliseconds between feature summaries kept while a machine runs
+HistoryRing machineHistory[MachineStateTable::MAX_MACHINES];
+
+// Everything recorded in the history is also queued for the server, and sent in batches by the uplink task
+const uint32_t UPLINK_INTERVAL = 5000;          // Milliseconds between batches while there is anything to send
+const size_t UPLINK_EAGER_RECORDS = 128;        // Records queued that wake the uplink task before the interval is up
+const uint32_t UPLINK_RETRY_MIN_MS = 1000;      // Backoff between failed sends, doubling up to UPLINK_RETRY_MAX_MS
+const uint32_t UPLINK_RETRY_MAX_MS = 60000;
+const uint16_t UPLINK_TIMEOUT_MS = 5000;        // Longest a send may wait for the server
+UplinkQueue uplinkQueue;                         // Guarded by stateTableMutex
+uint8_t uplinkBatch[1400];                       // Only used from the uplink task
+TaskHandle_t uplinkWorkerHandle = NULL;
+uint32_t uplinkBatchesSent = 0;
+uint32_t uplinkRecordsSent = 0;
+uint32_t uplinkFailures = 0;
+uint32_t uplinkRejected = 0;
+
+/*
+  Every machine's state changes are journaled to SPIFFS, so a receiver that restarts shows each machine's last
+  known state (and its history since the last checkpoint) straight away. The frame worker only queues the
+  changes: the journal itself is only used from the journal task, which does the slow flash writes and
+  checkpoints, and from setup() before that starts. Everyone else reads journalStats, the copy of its counters
+  the journal task keeps.
+*/
+FsJournalStorage journalStorage(SPIFFS);
+StateJournal journal(journalStorage);
+const size_t JOURNAL_QUEUE_SIZE = 64;                       // Changes that can wait for the journal task (a power of two)
+SpscQueue<JournalEntry, JOURNAL_QUEUE_SIZE> journalQueue;   // Filled by frameWorker, drained by journalWorker
+TaskHandle_t journalWorkerHandle = NULL;
+uint32_t clockBaseMs = 0;         // Added to millis(), so the receiver's clock carries on from before a restart
+uint32_t journalRestoreUs = 0;    // Time restoreState() took
+uint32_t journalRestored = 0;     // Machines restoreState() found in the journal
+JournalStats journalStats = {};   // journal.getStats() as of its last change, guarded by stateTableMutex
+
+// Receiver time in milliseconds: uptime, carried on across restarts from the journal's clock (see restoreState())
+uint32_t receiverMs() {
+  return clockBaseMs + millis();
+}
+
+// Latency histograms reported at /metrics, each recorded by a single task
+LatencyHistogram callbackTime;    // Time spent in OnDataRecv (WiFi task)
+LatencyHistogram queueTime;       // Arrival to the frame worker taking the frame off the queue (frame worker)
+LatencyHistogram sseSendTime;     // Time spent publishing one flush's machine_status events to every browser (frame worker)
+LatencyHistogram statusDelay;     // Arrival of a status change to its machine_status event going out (frame worker)
+
+/*
+  Callback function that will be executed when data is received.
+  It runs in the WiFi task, so it only copies the frame into the queue and wakes the worker task;
+  anything slower here (printing, JSON, web events) stalls the radio and loses packets.
+*/
 void OnDataRecv(const uint8_t * mac, const uint8_t *incomingData, int len) {
+  uint32_t startUs = micros();
+  if (len <= 0 || len > ESP_NOW_MAX_DATA_LEN) { return; }
+
+  ReceivedFrame *slot = frameQueue.acquire();
+  if (slot != NULL) {   // Otherwise the queue is full, counted as a drop by the queue
+    memcpy(slot->mac, mac, sizeof(slot->mac));
+    memcpy(slot->data, incomingData, len);
+    slot->length = len;
+    slot->receivedMs = receiverMs();
+    slot->receivedUs = startUs;
+    frameQueue.publish();
+
+    if (frameWorkerHandle != NULL) {
+      xTaskNotifyGive(frameWorkerHandle);
+    }
+  }
+  callbackTime.record(micros() - startUs);
+}
+
+// Adds receivedFrame to the history of the machine in slot and the uplink backlog: every state change, and a
+// feature summary now and then while it runs. Must be called with stateTableMutex held.
+void recordHistory(size_t slot, StateUpdate update, uint32_t nowMs) {
+  HistoryRing &history = machineHistory[slot];
+
+  UplinkRecord record;
+  record.timeMs = nowMs;
+  record.machineId = receivedFrame.machineId;
+  record.state = LaundryProtocol::stateCode(receivedFrame.machineOn, receivedFrame.phase);
+
+  if (update == STATE_NEW || update == STATE_CHANGED) {
+    history.addState(nowMs, record.state);
+    record.kind = UPLINK_STATE;
+    uplinkQueue.push(record);
+  }
+  if (receivedFrame.machineOn && receivedFrame.featureCount > 0 && history.isSummaryDue(nowMs, HISTORY_SUMMARY_INTERVAL)) {
+    record.kind = UPLINK_SUMMARY;
+    record.summary = receivedFrame.features[receivedFrame.featureCount - 1];
+    history.addSummary(nowMs, record.summary);
+    uplinkQueue.push(record);
+  }
+
+  if (uplinkQueue.count() >= UPLINK_EAGER_RECORDS && uplinkWorkerHandle != NULL) {
+    xTaskNotifyGive(uplinkWorkerHandle);
+  }
+}
+
+// Decodes one queued frame into the state table. Returns true if the machine's status needs to reach the website.
+bool handleFrame(const ReceivedFrame &raw) {
+
+  // Decode the frame (v1 or v2), rejecting anything whose length doesn't match its contents
+  if (!LaundryProtocol::decode(raw.data, raw.length, receivedFrame)) {
+    malformedFrames++;
+    LOG_PRINT("Dropped malformed frame of length ");
+    LOG_PRINTLN(raw.length);
+    return false;
+  }
+
+  // Find the machine by the sender's MAC address, and name it as the registry does (v2 frames only carry an id hash)
+  xSemaphoreTake(stateTableMutex, portMAX_DELAY);
+  bool hasName = (receivedFrame.version != LaundryProtocol::VERSION_2);
+  int slot = registry.resolve(raw.mac, receivedFrame.machineId, hasName ? receivedFrame.name : NULL);
+  if (slot < 0) {
+    xSemaphoreGive(stateTableMutex);
+    LOG_PRINTLN("Machine registry is full, not tracking this machine");
+    return false;
+  }
+  const RegistrySlot &machine = registry.at(slot);
+  receivedFrame.machineId = machine.machineId;
+  strncpy(receivedFrame.name, machine.id, sizeof(receivedFrame.name) - 1);
+  receivedFrame.name[sizeof(receivedFrame.name) - 1] = '\0';
+
+  StateUpdate update = stateTable.update(slot, receivedFrame, raw.mac, raw.receivedMs);
+  if (update != STATE_DUPLICATE) { recordHistory(slot, update, raw.receivedMs); }
+  xSemaphoreGive(stateTableMutex);
+
+  // Repeats of an unchanged state (heartbeats) and resent copies only refresh the table, they never reach the website
+  if (update == STATE_REPEAT || update == STATE_DUPLICATE) { return false; }
+
+  // Changes are kept for the next boot too, written to flash in batches by the journal task
+  JournalEntry *entry = journalQueue.acquire();
+  if (entry != NULL) {   // Otherwise the queue is full, counted as a drop by the queue
+    memcpy(entry->mac, raw.mac, sizeof(entry->mac));
+    entry->machineId = receivedFrame.machineId;
+    entry->state = LaundryProtocol::stateCode(receivedFrame.machineOn, receivedFrame.phase);
+    entry->timeMs = raw.receivedMs;
+    strncpy(entry->name, receivedFrame.name, sizeof(entry->name));
+    journalQueue.publish();
+    if (journalWorkerHandle != NULL) { xTaskNotifyGive(journalWorkerHandle); }
+  }
+
+  LOG_PRINT("Sensor Name: ");
+  LOG_PRINTLN(receivedFrame.name);
+  LOG_PRINT("Machine On? : ");
+  LOG_PRINTLN(receivedFrame.machineOn);
+  LOG_PRINT("Protocol Version: ");
+  LOG_PRINTLN(receivedFrame.version);
+  LOG_PRINTLN();
+  return true;
+}
+
+/*
+  Publishes every machine that changed since the last flush as its own "machine_status" event (handled by
+  JavaScript), a JSON array of one machine in the same format as the snapshot. Each is serialized once into
+  the fan-out, then written to every browser with room for it. Returns false if nothing had changed.
+*/
+bool flushStatusBatch() {
+  uint32_t startUs = micros();
+
+  xSemaphoreTake(fanoutMutex, portMAX_DELAY);
+  xSemaphoreTake(stateTableMutex, portMAX_DELAY);
+  uint32_t dirty = stateTable.takeDirty();
+  lastStatusFlushMs = receiverMs();
+  for (size_t i = 0; i < MachineStateTable::MAX_MACHINES; i++) {
+    if ((dirty & (1UL << i)) == 0) { continue; }
+    JsonWriter writer(statusJson, sizeof(statusJson));
+    if (stateTable.writeJson(writer, lastStatusFlushMs, 1UL << i)) {
+      fanout.publish(i, writer.c_str(), lastStatusFlushMs);
+    }
+  }
+  xSemaphoreGive(stateTableMutex);
+  if (dirty != 0) { fanout.pumpAll(); }
+  xSemaphoreGive(fanoutMutex);
+
+  if (dirty == 0) { return false; }
+  sseSendTime.record(micros() - startUs);
+  return true;
+}
+
+// Serializes the machines shown on the website, by room, into layoutJson and returns it
+const char *buildLayout() {
+  JsonWriter writer(layoutJson, sizeof(layoutJson));
+  xSemaphoreTake(stateTableMutex, portMAX_DELAY);
+  registry.writeLayout(writer);
+  xSemaphoreGive(stateTableMutex);
+  return layoutJson;
+}
+
+// Serializes every machine's last known state into snapshotJson and returns it
+const char *buildSnapshot() {
+  xSemaphoreTake(stateTableMutex, portMAX_DELAY);
+  stateTable.writeJson(snapshotJson, sizeof(snapshotJson), receiverMs());
+  xSemaphoreGive(stateTableMutex);
+  return snapshotJson;
+}
+
+/*
+  FreeRTOS task that sleeps until OnDataRecv queues frames, then handles every frame waiting.
+  The first change after a quiet period is flushed right away; further changes within
+  STATUS_FLUSH_INTERVAL wait (with a timeout instead of a notification) and go out together.
+  statusDelay measures from the arrival of the oldest change in a batch to the batch going out.
+*/
+void frameWorker(void *parameter) {
+  bool batchPending = false;
+  uint32_t batchStartUs = 0;    // Arrival of the oldest change in the pending batch
+  TickType_t wait = portMAX_DELAY;
+
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, wait);
+
+    ReceivedFrame *frame;
+    while ((frame = frameQueue.front()) != NULL) {
+      queueTime.record(micros() - frame->receivedUs);
+      if (handleFrame(*frame) && !batchPending) {
+        batchPending = true;
+        batchStartUs = frame->receivedUs;
+      }
+      frameQueue.pop();
+    }
+
+    wait = portMAX_DELAY;
+    if (batchPending) {
+      uint32_t sinceFlush = receiverMs() - lastStatusFlushMs;
+      if (sinceFlush >= STATUS_FLUSH_INTERVAL) {
+        if (flushStatusBatch()) { statusDelay.record(micros() - batchStartUs); }
+        batchPending = false;
+      } else {
+        wait = pdMS_TO_TICKS(STATUS_FLUSH_INTERVAL - sinceFlush);
+      }
+    }
+  }
+}
+
+/*
+  FreeRTOS task that owns the journal: takes the state changes the frame worker queued, and writes them to
+  flash whenever the journal asks for a flush. A flush, or a checkpoint of every machine, can keep flash busy
+  for tens of milliseconds, so it runs here rather than holding up frames and the website.
+*/
+void journalWorker(void *parameter) {
+  for (;;) {
+    bool changed = false;
+    JournalEntry *entry;
+    while ((entry = journalQueue.front()) != NULL) {
+      journal.record(*entry);
+      journalQueue.pop();
+      changed = true;
+    }
+
+    uint32_t dueMs = journal.msUntilFlush(receiverMs());
+    if (dueMs == 0) {
+      journal.flush(receiverMs());
+      dueMs = journal.msUntilFlush(receiverMs());
+      changed = true;
+    }
+
+    // Publish the counters for /metrics, which reads them from another task
+    if (changed) {
+      xSemaphoreTake(stateTableMutex, portMAX_DELAY);
+      journalStats = journal.getStats();
+      xSemaphoreGive(stateTableMutex);
+    }
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(dueMs));
+  }
+}
+
+// Sends one batch to the server. Returns the HTTP status code, or a negative HTTPClient error if it never got one.
+int postBatch(const uint8_t *batch, size_t length) {
+  HTTPClient http;
+  http.setTimeout(UPLINK_TIMEOUT_MS);
+  if (!http.begin(UPLINK_URL)) { return -1; }
+
+  http.addHeader("Content-Type", "application/octet-stream");
+  int code = http.POST((uint8_t *) batch, length);
+  http.end();
+  return code;
+}
+
+/*
+  FreeRTOS task that sends the uplink backlog to the server, one batch at a time, every UPLINK_INTERVAL
+  (or as soon as UPLINK_EAGER_RECORDS are waiting, and back to back while a backlog drains).
+  A batch that fails is resent unchanged after a backoff, while new records keep queueing behind it;
+  if the server stays away long enough the backlog fills and UplinkQueue decides what to drop.
+  A batch the server rejects outright (4xx) would never be accepted, so it is dropped instead.
+*/
+void uplinkWorker(void *parameter) {
+  RetryBackoff backoff(UPLINK_RETRY_MIN_MS, UPLINK_RETRY_MAX_MS);
+  size_t batchLength = 0;       // Batch in uplinkBatch that the server hasn't accepted yet
+  size_t remaining = 0;         // Records still in the backlog behind it
+  TickType_t wait = pdMS_TO_TICKS(UPLINK_INTERVAL);
+
+  for (;;) {
+    if (batchLength == 0) {
+      ulTaskNotifyTake(pdTRUE, wait);
+      xSemaphoreTake(stateTableMutex, portMAX_DELAY);
+      batchLength = uplinkQueue.takeBatch(receiverMs(), uplinkBatch, sizeof(uplinkBatch));
+      remaining = uplinkQueue.count();
+      xSemaphoreGive(stateTableMutex);
+      if (batchLength == 0) {
+        wait = pdMS_TO_TICKS(UPLINK_INTERVAL);
+        continue;
+      }
+    }
+
+    UplinkQueue::stampBatch(uplinkBatch, receiverMs());
+    int code = postBatch(uplinkBatch, batchLength);
+    if (code >= 200 && code < 500) {
+      if (code < 300) {
+        uplinkBatchesSent++;
+        uplinkRecordsSent += UplinkQueue::batchRecordCount(uplinkBatch);
+      } else {
+        uplinkRejected++;
+        LOG_PRINT("Server rejected uplink batch with status ");
+        LOG_PRINTLN(code);
+      }
+      batchLength = 0;
+      backoff.reset();
+      wait = (remaining >= UPLINK_EAGER_RECORDS) ? 0 : pdMS_TO_TICKS(UPLINK_INTERVAL);
+    } else {
+      uplinkFailures++;
+      vTaskDelay(pdMS_TO_TICKS(backoff.next(esp_random())));
+    }
+  }
+}
+
+/******************* EventConnection Class Definition *********************
+ * One browser on /events. Once its response headers are acknowledged it
+ * takes over the TCP connection, as ESPAsyncWebServer's own event source
+ * clients do, and is fed by the fan-out from then on: events are only
+ * copied into the connection as its send buffer has room, on every ack,
+ * so a slow phone holds up nothing but its own place in the stream.
+ *************************************************************************/
+class EventConnection : public EventTransport {
+  public:
+    explicit EventConnection(AsyncWebServerRequest *request);
+    void start();
+    size_t write(const char *data, size_t length) override;
+    void flush() override;
+
+  private:
+    AsyncClient *client;
+    int slot = -1;
+
+    void onAck();
+    void onDisconnect();
+};
+
+// Constructor, taking the connection's callbacks over from the request, which is deleted
+EventConnection::EventConnection(AsyncWebServerRequest *request) : client(request->client()) {
+  this->client->setRxTimeout(0);
+  this->client->onError(NULL, NULL);
+  this->client->onData(NULL, NULL);
+  this->client->onAck([](void *self, AsyncClient *client, size_t length, uint32_t time) {
+    ((EventConnection *) self)->onAck();
+  }, this);
+  this->client->onPoll([](void *self, AsyncClient *client) {
+    ((EventConnection *) self)->onAck();
+  }, this);
+  this->client->onDisconnect([](void *self, AsyncClient *client) {
+    ((EventConnection *) self)->onDisconnect();
+    delete (EventConnection *) self;
+    delete client;
+  }, this);
+  delete request;
+}
+
+/*
+  Joins the fan-out, which starts with a snapshot of every machine (serialized here only if the last one
+  is over a second old), or sends the browser away to retry later if /events is full.
+  Closing runs onDisconnect(), deleting the connection, so nothing may follow it.
+*/
+void EventConnection::start() {
+  xSemaphoreTake(fanoutMutex, portMAX_DELAY);
+  uint32_t nowMs = receiverMs();
+  if (fanout.snapshotDue(nowMs)) {
+    fanout.publishSnapshot(buildSnapshot(), nowMs, nowMs);
+  }
+  this->slot = fanout.connect(this);
+  xSemaphoreGive(fanoutMutex);
+
+  if (this->slot < 0) {
+    LOG_PRINTLN("Too many browsers on /events, asking one to retry later");
+    this->client->write(EventFanout<MAX_EVENT_CLIENTS>::busyEvent());
+    this->client->close();
+  }
+}
+
+// Queues as much of data as the connection's send buffer has room for
+size_t EventConnection::write(const char *data, size_t length) {
+  if (!this->client->canSend()) { return 0; }
+  size_t room = this->client->space();
+  return this->client->add(data, (length < room) ? length : room);
+}
+
+void EventConnection::flush() {
+  this->client->send();
+}
+
+// Sent data was acknowledged (or the connection was polled), so there may be room for more
+void EventConnection::onAck() {
+  xSemaphoreTake(fanoutMutex, portMAX_DELAY);
+  fanout.pump(this->slot);
+  xSemaphoreGive(fanoutMutex);
+}
+
+void EventConnection::onDisconnect() {
+  xSemaphoreTake(fanoutMutex, portMAX_DELAY);
+  fanout.disconnect(this->slot);
+  xSemaphoreGive(fanoutMutex);
+}
+
+/******************* EventStreamResponse Class Definition *****************
+ * The text/event-stream response headers, after which the connection is
+ * handed to an EventConnection (as ESPAsyncWebServer's AsyncEventSourceResponse does).
+ *************************************************************************/
+class EventStreamResponse : public AsyncWebServerResponse {
+  public:
+    EventStreamResponse();
+    void _respond(AsyncWebServerRequest *request) override;
+    size_t _ack(AsyncWebServerRequest *request, size_t length, uint32_t time) override;
+    bool _sourceValid() const override { return true; }
+};
+
+// Constructor, for headers that keep the stream open and uncached
+EventStreamResponse::EventStreamResponse() {
+  this->_code = 200;
+  this->_contentType = "text/event-stream";
+  this->_sendContentLength = false;
+  addHeader("Cache-Control", "no-cache");
+  addHeader("Connection", "keep-alive");
+}
+
+// Sends the headers
+void EventStreamResponse::_respond(AsyncWebServerRequest *request) {
+  String head = this->_assembleHead(request->version());
+  request->client()->write(head.c_str(), this->_headLength);
+  this->_state = RESPONSE_WAIT_ACK;
+}
+
+// Once the headers are acknowledged, the connection becomes an EventConnection (which deletes the request)
+size_t EventStreamResponse::_ack(AsyncWebServerRequest *request, size_t length, uint32_t time) {
+  if (length) {
+    EventConnection *connection = new EventConnection(request);
+    connection->start();
+  }
+  return 0;
+}
+
+// Serves GET /events with an EventStreamResponse
+class EventStreamHandler : public AsyncWebHandler {
+  public:
+    bool canHandle(AsyncWebServerRequest *request) override {
+      return request->method() == HTTP_GET && request->url() == "/events";
+    }
+    void handleRequest(AsyncWebServerRequest *request) override {
+      request->send(new EventStreamResponse());
+    }
+};
+EventStreamHandler eventStream;
+
+/******************* HistoryStream Class Definition ***********************
+ * Writes one machine's history for /api/history a chunk at a time, e.g.
+ *   {"machine":"FARRIS_WASHER_1","now":7200000,"records":[
+ *     {"t":3600000,"type":"state","status":true,"phase":1},
+ *     {"t":3600500,"type":"summary","phase":1,"peakHz":1.2,"mean":9.84,"stdDev":0.412}]}
+ * where times are receiver time (receiverMs()). Only a cursor into the
+ * ring is kept between chunks, so the response is never held in memory.
+ *************************************************************************/
+class HistoryStream {
+  public:
+    HistoryStream(int index, uint32_t nowMs, bool hasSince, uint32_t sinceMs);
+    size_t fill(uint8_t *buffer, size_t maxLength);
+
+  private:
+    enum Stage : uint8_t { STAGE_HEADER, STAGE_RECORDS, STAGE_FOOTER, STAGE_DONE };
+
+    int index;
+    uint32_t nowMs;
+    bool hasSince;
+    uint32_t sinceMs;
+    HistoryCursor cursor;
+    Stage stage = STAGE_HEADER;
+    bool firstRecord = true;
+
+    bool writeNext(JsonWriter &writer, HistoryCursor &next);
+};
+
+// Constructor, for the machine in slot index of stateTable. Without a since time, every stored record is sent.
+HistoryStream::HistoryStream(int index, uint32_t nowMs, bool hasSince, uint32_t sinceMs)
+  : index(index), nowMs(nowMs), hasSince(hasSince), sinceMs(sinceMs) {
+  this->cursor.started = false;
+}
+
+/*
+  Fills buffer with as many whole pieces of the response as fit. Returns the bytes written, RESPONSE_TRY_AGAIN if
+  not even the next piece fit (the server calls again once the connection has more room), or 0 once finished.
+*/
+size_t HistoryStream::fill(uint8_t *buffer, size_t maxLength) {
+  char piece[192];
+  size_t length = 0;
+
+  xSemaphoreTake(stateTableMutex, portMAX_DELAY);
+  while (this->stage != STAGE_DONE) {
+    // Every record after the first is written behind a comma, which goes in piece[0]
+    bool comma = (this->stage == STAGE_RECORDS && !this->firstRecord);
+    piece[0] = ',';
+    JsonWriter writer(piece + 1, sizeof(piece) - 1);
+    HistoryCursor next = this->cursor;
+    if (!writeNext(writer, next)) { continue; }   // Record skipped (older than since) or stage finished
+
+    const char *text = comma ? piece : piece + 1;
+    size_t textLength = writer.length() + (comma ? 1 : 0);
+    if (length + textLength > maxLength) { break; }
+    memcpy(buffer + length, text, textLength);
+    length += textLength;
+
+    // Only move on once the piece is in the buffer, so a piece that didn't fit is written again next chunk
+    this->cursor = next;
+    if (this->stage == STAGE_HEADER) { this->stage = STAGE_RECORDS; }
+    else if (this->stage == STAGE_FOOTER) { this->stage = STAGE_DONE; }
+    else { this->firstRecord = false; }
+  }
+  xSemaphoreGive(stateTableMutex);
+
+  // 0 would end the response, so only return it once the footer is out
+  if (length == 0 && this->stage != STAGE_DONE) { return RESPONSE_TRY_AGAIN; }
+  return length;
+}
+
+// Writes the next piece of the response. Returns false (after advancing past it) if there was nothing to write.
+bool HistoryStream::writeNext(JsonWriter &writer, HistoryCursor &next) {
+  if (this->stage == STAGE_HEADER) {
+    writer.beginObject()
+          .field("machine", stateTable.at(this->index).name)
+          .field("now", this->nowMs)
+          .key("records").beginArray();
+    return true;
+  }
+  if (this->stage == STAGE_FOOTER) {
+    writer.endArray().endObject();
+    return true;
+  }
+
+  HistoryRecord record;
+  if (!machineHistory[this->index].next(next, record)) {
+    this->stage = STAGE_FOOTER;
+    return false;
+  }
+  if (this->hasSince && (int32_t) (record.timeMs - this->sinceMs) < 0) {
+    this->cursor = next;
+    return false;
+  }
+
+  writer.beginObject().field("t", record.timeMs);
+  if (record.kind == HISTORY_STATE) {
+    writer.field("type", "state")
+          .field("status", (record.state & LaundryProtocol::STATE_ON_BIT) != 0)
+          .field("phase", (uint32_t) (record.state & LaundryProtocol::STATE_PHASE_MASK));
+  } else {
+    writer.field("type", "summary")
+          .field("phase", (uint32_t) record.summary.phase)
+          .key("peakHz").value(record.summary.peakFreqDeciHz / 10.0f, 1)
+          .key("mean").value(record.summary.meanCms2 / 100.0f, 2)
+          .key("stdDev").value(record.summary.stdDevMms2 / 1000.0f, 3);
+  }
+  writer.endObject();
+  return true;
+}
+
+// A receiver-wide counter or gauge reported at /metrics, read with stateTableMutex held (journal counters come from
+// journalStats, never the journal itself, which the journal task may be writing)
+typedef struct {
+  const char *name;
+  const char *type;
+  const char *help;
+  uint32_t (*read)();
+} ReceiverMetric;
+
+const ReceiverMetric RECEIVER_METRICS[] = {
+  {"washerwatcher_frames_received_total", "counter", "Frames the ESP-NOW callback queued",
+   []() -> uint32_t { return frameQueue.getPushedCount(); }},
+  {"washerwatcher_frames_dropped_total", "counter", "Frames dropped because the queue was full",
+   []() -> uint32_t { return frameQueue.getDroppedCount(); }},
+  {"washerwatcher_frames_malformed_total", "counter", "Frames dropped because they didn't decode",
+   []() -> uint32_t { return malformedFrames; }},
+  {"washerwatcher_frame_queue_high_water", "gauge", "Most frames ever waiting in the queue at once",
+   []() -> uint32_t { return frameQueue.getHighWater(); }},
+  {"washerwatcher_sse_clients", "gauge", "Browsers connected to /events",
+   []() -> uint32_t { return fanout.count(); }},
+  {"washerwatcher_sse_clients_rejected_total", "counter", "Browsers asked to retry later because /events was full",
+   []() -> uint32_t { return fanout.getStats().rejected; }},
+  {"washerwatcher_sse_superseded_total", "counter", "Events a slow browser skipped for a newer one of the same machine",
+   []() -> uint32_t { return fanout.getStats().superseded; }},
+  {"washerwatcher_sse_snapshots_total", "counter", "Snapshots serialized for browsers connecting to /events",
+   []() -> uint32_t { return fanout.getStats().snapshots; }},
+  {"washerwatcher_machines_registered", "gauge", "Machines in the registry, listed in the config or heard since boot",
+   []() -> uint32_t { return registry.count(); }},
+  {"washerwatcher_journal_restored_machines", "gauge", "Machines whose state was restored from the journal at boot",
+   []() -> uint32_t { return journalRestored; }},
+  {"washerwatcher_journal_restore_microseconds", "gauge", "Time taken restoring the journal at boot",
+   []() -> uint32_t { return journalRestoreUs; }},
+  {"washerwatcher_journal_records_total", "counter", "State changes journaled",
+   []() -> uint32_t { return journalStats.records; }},
+  {"washerwatcher_journal_queue_dropped_total", "counter", "State changes not journaled because the journal task's queue was full",
+   []() -> uint32_t { return journalQueue.getDroppedCount(); }},
+  {"washerwatcher_journal_flushes_total", "counter", "Batches of state changes written to the journal's log",
+   []() -> uint32_t { return journalStats.flushes; }},
+  {"washerwatcher_journal_checkpoints_total", "counter", "Journal checkpoints written",
+   []() -> uint32_t { return journalStats.checkpoints; }},
+  {"washerwatcher_journal_written_bytes_total", "counter", "Bytes the journal wrote to flash",
+   []() -> uint32_t { return journalStats.bytesWritten; }},
+  {"washerwatcher_journal_write_failures_total", "counter", "Journal writes to flash that failed",
+   []() -> uint32_t { return journalStats.writeFailures; }},
+  {"washerwatcher_heap_free_bytes", "gauge", "Free heap",
+   []() -> uint32_t { return ESP.getFreeHeap(); }},
+  {"washerwatcher_heap_min_free_bytes", "gauge", "Lowest free heap since boot",
+   []() -> uint32_t { return ESP.getMinFreeHeap(); }},
+  {"washerwatcher_heap_largest_block_bytes", "gauge", "Largest block the heap could allocate",
+   []() -> uint32_t { return ESP.getMaxAllocHeap(); }},
+  {"washerwatcher_heap_fragmentation_percent", "gauge", "Share of the free heap outside its largest block",
+   []() -> uint32_t {
+     uint32_t freeBytes = ESP.getFreeHeap();
+     return (freeBytes == 0) ? 0 : 100 - (uint32_t) ((uint64_t) ESP.getMaxAllocHeap() * 100 / freeBytes);
+   }},
+  {"washerwatcher_uplink_records_sent_total", "counter", "Records the back-end server accepted",
+   []() -> uint32_t { return uplinkRecordsSent; }},
+  {"washerwatcher_uplink_failures_total", "counter", "Batch sends that failed and were retried",
+   []() -> uint32_t { return uplinkFailures; }},
+  {"washerwatcher_uplink_dropped_total", "counter", "Records dropped because the uplink backlog was full",
+   []() -> uint32_t { return uplinkQueue.getDroppedCount(); }},
+  {"washerwatcher_uplink_backlog", "gauge", "Records waiting to be sent to the back-end server",
+   []() -> uint32_t { return uplinkQueue.count(); }}
+};
+const size_t RECEIVER_METRIC_COUNT = sizeof(RECEIVER_METRICS) / sizeof(RECEIVER_METRICS[0]);
+
+// A latency histogram reported at /metrics
+typedef struct {
+  const char *name;
+  const char *help;
+  const LatencyHistogram *histogram;
+} LatencyMetric;
+
+const LatencyMetric LATENCY_METRICS[] = {
+  {"washerwatcher_recv_callback_seconds", "Time spent in the ESP-NOW receive callback", &callbackTime},
+  {"washerwatcher_frame_queue_seconds", "Time frames waited in the queue for the frame worker", &queueTime},
+  {"washerwatcher_sse_send_seconds", "Time spent publishing one flush's machine_status events", &sseSendTime},
+  {"washerwatcher_status_delay_seconds", "Arrival of a status change to its machine_status event", &statusDelay}
+};
+const size_t LATENCY_METRIC_COUNT = sizeof(LATENCY_METRICS) / sizeof(LATENCY_METRICS[0]);
+
+// A value reported for every machine at /metrics, read with stateTableMutex held
+typedef struct {
+  const char *name;
+  const char *type;
+  const char *help;
+  bool milliseconds;          // The value is a duration in milliseconds, reported in seconds
+  uint32_t (*read)(const MachineState &state, uint32_t nowMs);
+} MachineMetric;
+
+const MachineMetric MACHINE_METRICS[] = {
+  {"washerwatcher_machine_frames_total", "counter", "Frames received from the machine's sender", false,
+   [](const MachineState &state, uint32_t nowMs) -> uint32_t { return state.frames; }},
+  {"washerwatcher_machine_duplicates_total", "counter", "Resent copies of a frame already received", false,
+   [](const MachineState &state, uint32_t nowMs) -> uint32_t { return state.duplicates; }},
+  {"washerwatcher_machine_lost_frames_total", "counter", "Sequence numbers never received", false,
+   [](const MachineState &state, uint32_t nowMs) -> uint32_t { return state.lostFrames; }},
+  {"washerwatcher_machine_out_of_order_total", "counter", "Frames older than the one received before", false,
+   [](const MachineState &state, uint32_t nowMs) -> uint32_t { return state.outOfOrder; }},
+  {"washerwatcher_machine_last_seen_seconds", "gauge", "Time since the machine's last frame", true,
+   [](const MachineState &state, uint32_t nowMs) -> uint32_t { return nowMs - state.lastSeenMs; }}
+};
+const size_t MACHINE_METRIC_COUNT = sizeof(MACHINE_METRICS) / sizeof(MACHINE_METRICS[0]);
+
+/******************* MetricsStream Class Definition ***********************
+ * Writes /metrics in the Prometheus text format a piece at a time, e.g.
+ *   # HELP washerwatcher_frames_received_total Frames the ESP-NOW callback queued
+ *   # TYPE washerwatcher_frames_received_total counter
+ *   washerwatcher_frames_received_total 1234
+ *   washerwatcher_recv_callback_seconds_bucket{le="0.000016"} 1200
+ *   washerwatcher_machine_frames_total{machine="FARRIS_WASHER_1"} 310
+ * Receiver-wide metrics come first, then the latency histograms, then each
+ * metric for every machine. A histogram is copied when its header is
+ * written, so its buckets, sum and count agree with each other.
+ *************************************************************************/
+class MetricsStream {
+  public:
+    explicit MetricsStream(uint32_t nowMs) : nowMs(nowMs) {}
+    size_t fill(uint8_t *buffer, size_t maxLength);
+
+  private:
+    enum Stage : uint8_t { STAGE_RECEIVER, STAGE_LATENCY, STAGE_MACHINES, STAGE_DONE };
+
+    // Position in the response: a metric of the current stage, and the line of that metric
+    typedef struct {
+      Stage stage;
+      uint8_t metric;
+      uint8_t item;
+    } MetricsCursor;
+
+    uint32_t nowMs;
+    MetricsCursor cursor = {STAGE_RECEIVER, 0, 0};
+    uint32_t counts[LatencyHistogram::BUCKETS];   // Copy of the histogram being written
+    uint64_t sumMicros = 0;
+
+    int writeNext(char *piece, size_t capacity, MetricsCursor &next);
+};
 
-  // Copy received data to global struct
-  memcpy(&receivedMessage, incomingData, sizeof(receivedMessage));
+/*
+  Fills buffer with as many whole pieces of the response as fit. Returns the bytes written, RESPONSE_TRY_AGAIN
+  if not even the next piece fit (the server calls again once the connection has more room), or 0 once finished.
+*/
+size_t MetricsStream::fill(uint8_t *buffer, size_t maxLength) {
+  char piece[320];
+  size_t length = 0;
+
+  xSemaphoreTake(stateTableMutex, portMAX_DELAY);
+  while (this->cursor.stage != STAGE_DONE) {
+    MetricsCursor next = this->cursor;
+    int pieceLength = writeNext(piece, sizeof(piece), next);
+    if (pieceLength > 0 && (size_t) pieceLength < sizeof(piece)) {
+      if (length + pieceLength > maxLength) { break; }
+      memcpy(buffer + length, piece, pieceLength);
+      length += pieceLength;
+    }
+    // Only move on once the piece is in the buffer, so a piece that didn't fit is written again next chunk
+    this->cursor = next;
+  }
+  xSemaphoreGive(stateTableMutex);
+
+  // 0 would end the response, so only return it once the last piece is out
+  if (length == 0 && this->cursor.stage != STAGE_DONE) { return RESPONSE_TRY_AGAIN; }
+  return length;
+}
+
+// Writes the piece at next into piece and advances next past it. Returns the length written, 0 if there was nothing.
+int MetricsStream::writeNext(char *piece, size_t capacity, MetricsCursor &next) {
+  if (next.stage == STAGE_RECEIVER) {
+    if (next.metric == RECEIVER_METRIC_COUNT) {
+      next.stage = STAGE_LATENCY;
+      next.metric = 0;
+      return 0;
+    }
+    const ReceiverMetric &metric = RECEIVER_METRICS[next.metric++];
+    int length = Prometheus::header(piece, capacity, metric.name, metric.type, metric.help);
+    if (length < 0 || (size_t) length >= capacity) { return length; }
+    return length + Prometheus::sample(piece + length, capacity - length, metric.name, metric.read());
+  }
 
-  Serial.print("Sensor Name: ");
-  Serial.println(receivedMessage.id);
-  Serial.print("Machine On? : ");
-  Serial.println(receivedMessage.machineOn);
-  Serial.println();
+  if (next.stage == STAGE_LATENCY) {
+    if (next.metric == LATENCY_METRIC_COUNT) {
+      next.stage = STAGE_MACHINES;
+      next.metric = 0;
+      return 0;
+    }
+    const LatencyMetric &metric = LATENCY_METRICS[next.metric];
+    size_t item = next.item++;
+    if (item == 0) {
+      for (size_t i = 0; i < LatencyHistogram::BUCKETS; i++) { this->counts[i] = metric.histogram->getCount(i); }
+      this->sumMicros = metric.histogram->getSumMicros();
+      return Prometheus::header(piece, capacity, metric.name, "histogram", metric.help);
+    }
 
-  // Format the received data in JSON and send it as an AsyncEvent (handled by JavaScript)
-  DynamicJsonDocument board(1024);
-  board["id"] = receivedMessage.id;
-  board["status"] = receivedMessage.machineOn;
+    uint32_t cumulative = 0;
+    for (size_t i = 0; i < item && i < LatencyHistogram::BUCKETS; i++) { cumulative += this->counts[i]; }
+    if (item <= LatencyHistogram::BUCKETS) {
+      return Prometheus::bucket(piece, capacity, metric.name, item - 1, cumulative);
+    }
+
+    next.metric++;
+    next.item = 0;
+    char name[64];
+    snprintf(name, sizeof(name), "%s_sum", metric.name);
+    int length = Prometheus::seconds(piece, capacity, name, NULL, NULL, this->sumMicros);
+    if (length < 0 || (size_t) length >= capacity) { return length; }
+    snprintf(name, sizeof(name), "%s_count", metric.name);
+    return length + Prometheus::sample(piece + length, capacity - length, name, cumulative);
+  }
 
-  String jsonStr;
-  serializeJson(board, jsonStr);
-  events.send(jsonStr.c_str(), "machine_status", millis());
+  if (next.metric == MACHINE_METRIC_COUNT) {
+    next.stage = STAGE_DONE;
+    return 0;
+  }
+  const MachineMetric &metric = MACHINE_METRICS[next.metric];
+  size_t item = next.item++;
+  if (item == 0) {
+    return Prometheus::header(piece, capacity, metric.name, metric.type, metric.help);
+  }
+  if (item > MachineStateTable::MAX_MACHINES) {
+    next.metric++;
+    next.item = 0;
+    return 0;
+  }
+  if (!stateTable.has(item - 1)) { return 0; }
+
+  const MachineState &state = stateTable.at(item - 1);
+  uint32_t value = metric.read(state, this->nowMs);
+  if (metric.milliseconds) {
+    return Prometheus::seconds(piece, capacity, metric.name, "machine", state.name, (uint64_t) value * 1000);
+  }
+  return Prometheus::sample(piece, capacity, metric.name, "machine", state.name, value);
+}
+
+/*
+  Sends one of the website files embedded in flash by tools/embed_assets.py.
+  Browsers that already have this exact version (matching If-None-Match) just get a 304 with no body.
+*/
+void serveAsset(AsyncWebServerRequest *request, const WebAsset &asset) {
+  AsyncWebServerResponse *response;
+
+  if (request->hasHeader("If-None-Match") && request->getHeader("If-None-Match")->value() == asset.etag) {
+    response = request->beginResponse(304);
+  } else {
+    response = request->beginResponse_P(200, asset.contentType, asset.data, asset.length);
+    response->addHeader("Content-Encoding", "gzip");
+  }
+  response->addHeader("ETag", asset.etag);
+  response->addHeader("Cache-Control", asset.cacheControl);
+  request->send(response);
 }
 
 // Helper function to initialize SPIFFS (SPI Flash File System), a way of storing files on the controller.
 bool initSPIFFS() {
   if (!SPIFFS.begin()) {
-    Serial.println("An error has occurred while mounting SPIFFS");
+    LOG_PRINTLN("An error has occurred while mounting SPIFFS");
     return false;
   }
-  Serial.println("SPIFFS mounted successfully");
+  LOG_PRINTLN("SPIFFS mounted successfully");
   return true;
 }
 
+// Registers the machines listed in MACHINE_CONFIG_PATH, or DEFAULT_MACHINES if it is missing, too long or lists none
+void loadMachineConfig() {
+  static char text[MACHINE_CONFIG_BYTES];    // Static, to keep it off setup()'s stack
+  size_t length = 0;
+
+  File file = SPIFFS.open(MACHINE_CONFIG_PATH, "r");
+  if (file) {
+    if (file.size() < sizeof(text)) {
+      length = file.read((uint8_t *) text, sizeof(text) - 1);
+    } else {
+      LOG_PRINTLN("Machine config is too long, using the default machines");
+    }
+    file.close();
+  }
+  text[length] = '\0';
+
+  size_t loaded = (length > 0) ? registry.loadConfig(text) : 0;
+  if (loaded == 0) { loaded = registry.loadConfig(DEFAULT_MACHINES); }
+  LOG_PRINT("Machines registered: ");
+  LOG_PRINT(loaded);
+  LOG_PRINT(", config lines skipped: ");
+  LOG_PRINTLN(registry.getRejectedLines());
+}
+
+/*
+  Puts every machine back as the journal last saw it, with its history since the journal's last checkpoint,
+  and carries the receiver's clock on from the journal's, so those times stay in the past.
+  Must run before the frame worker starts.
+*/
+void restoreState() {
+  uint32_t startUs = micros();
+  journal.restore([](const JournalEntry &entry) {
+    int slot = registry.resolve(entry.mac, entry.machineId, entry.name);
+    if (slot < 0) { return; }
+    stateTable.restore(slot, entry.mac, registry.at(slot).machineId, registry.at(slot).id, entry.state, entry.timeMs);
+    machineHistory[slot].addState(entry.timeMs, entry.state);
+  });
+  clockBaseMs = journal.getClockMs() - millis();
+  journalRestoreUs = micros() - startUs;
+  journalRestored = journal.count();
+  journalStats = journal.getStats();
+
+  LOG_PRINT("Journal restored: ");
+  LOG_PRINT(journalRestored);
+  LOG_PRINT(" machines, ");
+  LOG_PRINT(journalStats.logRecords);
+  LOG_PRINT(" changes replayed, ");
+  LOG_PRINT(journalStats.discardedBytes);
+  LOG_PRINT(" bytes discarded, in ");
+  LOG_PRINT(journalRestoreUs);
+  LOG_PRINTLN(" us");
+}
+
 // Helper function to connect the microcontroller to the WiFi network. Will hang indefinitely until it connects.
 void initWiFi() {
   // Set device as a Wi-Fi access point (allows controllers to connect)
@@ -71,19 +988,19 @@ void initWiFi() {
   WiFi.begin(SSID, PASSWORD);
 
 
-  Serial.print("Connecting to WiFi...");
+  LOG_PRINT("Connecting to WiFi...");
   while (WiFi.status() != WL_CONNECTED) {
-    Serial.print(".");
+    LOG_PRINT(".");
     delay(1000);
   }
 
   // Print information about the controller's WiFi connection
-  Serial.print("\nStation IP Address: ");
-  Serial.println(WiFi.localIP());
-  Serial.print("Wi-Fi Channel: ");
-  Serial.println(WiFi.channel());
-  Serial.print("WiFi MAC Address: ");
-  Serial.println(WiFi.macAddress());
+  LOG_PRINT("\nStation IP Address: ");
+  LOG_PRINTLN(WiFi.localIP());
+  LOG_PRINT("Wi-Fi Channel: ");
+  LOG_PRINTLN(WiFi.channel());
+  LOG_PRINT("WiFi MAC Address: ");
+  LOG_PRINTLN(WiFi.macAddress());
 }
 
 /******************* Arduino Setup() Function ****************************
@@ -99,38 +1016,115 @@ void setup() {
 
   // Initialize ESP-NOW
   if (initSPIFFS() != true) {
-    Serial.println("Error initializing SPIFFS. Returning from setup");
+    LOG_PRINTLN("Error initializing SPIFFS. Returning from setup");
     return;
   }
+  loadMachineConfig();
+  restoreState();
   
   // Initialize ESP-NOW
   if (esp_now_init() != ESP_OK) {
-    Serial.println("Error initializing ESP-NOW. Returning from setup");
+    LOG_PRINTLN("Error initializing ESP-NOW. Returning from setup");
     return;
   }
   
+  // Start the worker that handles received frames outside of the WiFi task (on the other core from WiFi)
+  stateTableMutex = xSemaphoreCreateMutex();
+  fanoutMutex = xSemaphoreCreateMutex();
+  xTaskCreatePinnedToCore(frameWorker, "frameWorker", 4096, NULL, 1, &frameWorkerHandle, 1);
+
+  // Journal to flash from a task of its own at the lowest priority, so its writes only take time nothing else needs
+  xTaskCreatePinnedToCore(journalWorker, "journalWorker", 4096, NULL, 0, &journalWorkerHandle, 0);
+
+  // Start sending to the back-end server, identifying this receiver by its MAC and a random id for this boot
+  if (UPLINK_URL[0] != '\0') {
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    uplinkQueue.begin(mac, esp_random());
+    xTaskCreatePinnedToCore(uplinkWorker, "uplinkWorker", 6144, NULL, 1, &uplinkWorkerHandle, 0);
+  }
+
   // Once ESP-NOW is successfully initialized, we will register our receiver handler
   esp_now_register_recv_cb(OnDataRecv);
 
-  // Handle Web Server (direct users to the correct html when connecting)
-  server.on("/", HTTP_GET, [](AsyncWebServerRequest *request){
-    request->send(SPIFFS, "/index.html", "text/html");
+  // Handle Web Server (serve the gzipped website files built into the firmware, "/" being index.html)
+  for (size_t i = 0; i < WEB_ASSET_COUNT; i++) {
+    const WebAsset &asset = WEB_ASSETS[i];
+    server.on(asset.url, HTTP_GET, [&asset](AsyncWebServerRequest *request){
+      serveAsset(request, asset);
+    });
+  }
+
+  // Return the machines to show, by room, each with the slot its machine_status events carry
+  server.on("/api/layout", HTTP_GET, [](AsyncWebServerRequest *request){
+    request->send(200, "application/json", buildLayout());
   });
 
-  // Serve the website files stored in the "data" folder with SPIFFS
-  server.serveStatic("/", SPIFFS, "/");
-  
-  // Add AsyncEvent for when users connect
-  events.onConnect([](AsyncEventSourceClient *client){
-    if(client->lastId()){
-      Serial.printf("Client reconnected! Last message ID received is: %u\n", client->lastId());
+  // Return the last known state of every machine in one response
+  server.on("/api/state", HTTP_GET, [](AsyncWebServerRequest *request){
+    request->send(200, "application/json", buildSnapshot());
+  });
+
+  // Stream one machine's recorded history: /api/history?machine=FARRIS_WASHER_1&since=<receiver ms>
+  server.on("/api/history", HTTP_GET, [](AsyncWebServerRequest *request){
+    if (!request->hasParam("machine")) {
+      request->send(400, "application/json", "{\"error\":\"missing machine\"}");
+      return;
+    }
+    const char *name = request->getParam("machine")->value().c_str();
+
+    int index = -1;
+    xSemaphoreTake(stateTableMutex, portMAX_DELAY);
+    for (size_t i = 0; i < registry.count(); i++) {
+      if (stateTable.has(i) && strcmp(registry.at(i).id, name) == 0) { index = i; }
+    }
+    xSemaphoreGive(stateTableMutex);
+    if (index < 0) {
+      request->send(404, "application/json", "{\"error\":\"unknown machine\"}");
+      return;
     }
-    // Send event with message "hello!", whose id is current millis and set reconnect delay to 1 second
-    client->send("hello!", NULL, millis(), 10000);
+
+    bool hasSince = request->hasParam("since");
+    uint32_t since = hasSince ? strtoul(request->getParam("since")->value().c_str(), NULL, 10) : 0;
+    HistoryStream stream(index, receiverMs(), hasSince, since);
+    request->send(request->beginChunkedResponse("application/json", [stream](uint8_t *buffer, size_t maxLength, size_t index) mutable -> size_t {
+      return stream.fill(buffer, maxLength);
+    }));
+  });
+
+  // Report the health of the senders' link, the received frame queue and the uplink to the server
+  server.on("/api/stats", HTTP_GET, [](AsyncWebServerRequest *request){
+    xSemaphoreTake(stateTableMutex, portMAX_DELAY);
+    LinkStats link = stateTable.getLinkStats();
+    uint32_t uplinkQueued = uplinkQueue.getQueuedCount();
+    uint32_t uplinkBacklog = uplinkQueue.count();
+    uint32_t uplinkDropped = uplinkQueue.getDroppedCount();
+    xSemaphoreGive(stateTableMutex);
+
+    char json[512];
+    snprintf(json, sizeof(json), "{\"received\":%u,\"dropped\":%u,\"highWater\":%u,\"capacity\":%u,\"malformed\":%u,"
+             "\"duplicates\":%u,\"sequenceGaps\":%u,\"lateFrames\":%u,\"frameDelayAvgMs\":%u,\"frameDelayMaxMs\":%u,"
+             "\"uplinkQueued\":%u,\"uplinkBacklog\":%u,\"uplinkDropped\":%u,\"uplinkSent\":%u,\"uplinkBatches\":%u,"
+             "\"uplinkFailures\":%u,\"uplinkRejected\":%u}",
+             (unsigned) frameQueue.getPushedCount(), (unsigned) frameQueue.getDroppedCount(),
+             (unsigned) frameQueue.getHighWater(), (unsigned) frameQueue.capacity(), (unsigned) malformedFrames,
+             (unsigned) link.duplicates, (unsigned) link.sequenceGaps, (unsigned) link.lateFrames,
+             (unsigned) (link.frames ? link.delaySumMs / link.frames : 0), (unsigned) link.delayMaxMs,
+             (unsigned) uplinkQueued, (unsigned) uplinkBacklog, (unsigned) uplinkDropped, (unsigned) uplinkRecordsSent,
+             (unsigned) uplinkBatchesSent, (unsigned) uplinkFailures, (unsigned) uplinkRejected);
+    request->send(200, "application/json", json);
+  });
+  
+  // Report counters, latency histograms and per-machine link counts in the Prometheus text format
+  server.on("/metrics", HTTP_GET, [](AsyncWebServerRequest *request){
+    MetricsStream stream(receiverMs());
+    request->send(request->beginChunkedResponse("text/plain; version=0.0.4", [stream](uint8_t *buffer, size_t maxLength, size_t index) mutable -> size_t {
+      return stream.fill(buffer, maxLength);
+    }));
   });
 
-  // Add the AsyncEvents to the WebServer and begin hosting the website 
-  server.addHandler(&events);
+  // Add the Server-Sent Events stream to the WebServer and begin hosting the website
+  server.addHandler(&eventStream);
   server.begin();
 }
  
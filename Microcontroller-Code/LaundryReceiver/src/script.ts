@@ -1,5 +1,57 @@
+// The box of every machine on the page, indexed by the slot the receiver's events carry
+let machineBoxes:HTMLElement[] = [];
+
+// When each running machine is expected to finish (in Date.now() milliseconds), from the receiver's estimates, by slot
+let finishTimes = new Map<number, number>();
+
+// Set while the layout is being fetched again because an event named a machine the page doesn't have yet
+let layoutReloading = false;
+
+// Lay the page out from the receiver's machine list, then start listening for changes
+loadLayout()
+  .then(connectEvents)
+  .catch((error) => console.log("Couldn't load the machine layout: ", error));
+
+// Builds a section per room with a box per machine, replacing whatever was on the page
+function loadLayout():Promise<void> {
+  return fetch('/api/layout')
+    .then((response) => response.json())
+    .then((layout:Layout) => {
+      let content = document.getElementById("rooms") as HTMLElement;
+      content.replaceChildren();
+      machineBoxes = [];
+      finishTimes.clear();
+
+      layout.rooms.forEach((room) => {
+        if (room.machines.length == 0) {
+          return;
+        }
+        let heading = document.createElement("h2");
+        heading.textContent = room.name;
+        let machines = document.createElement("div");
+        machines.className = "machines";
+
+        room.machines.forEach((machine) => {
+          let name = document.createElement("span");
+          name.textContent = machine.label + ":";
+          let status = document.createElement("span");
+          status.textContent = "Unknown";
+          let box = document.createElement("div");
+          box.className = "machine_unknown";
+          box.append(name, " ", status);
+          machines.appendChild(box);
+          machineBoxes[machine.slot] = box;
+        });
+        content.append(heading, machines);
+      });
+    });
+}
+
 // Create events for the sensor readings
-if (!!window.EventSource) {
+function connectEvents() {
+  if (!window.EventSource) {
+    return;
+  }
   let source = new EventSource('/events');
 
   source.addEventListener('open', () => {
@@ -12,22 +64,96 @@ if (!!window.EventSource) {
     }
   }, false);
 
+  // Sent once when connecting, with the last known state of every machine
+  source.addEventListener('snapshot', (event) => {
+    console.log("Snapshot: ", (event as MessageEvent).data);
+    let machines:MachineStatus[] = JSON.parse((event as MessageEvent).data);
+    machines.forEach(applyMachineStatus);
+  }, false);
+
+  // Sent for each machine that changed, at most every 250ms (a slow connection skips straight to the newest)
   source.addEventListener('machine_status', (event) => {
     console.log("Machine Status: ", (event as MessageEvent).data);
-    let receivedJson:MachineStatus = JSON.parse((event as MessageEvent).data);
-    let machineHtmlElement = document.getElementById(receivedJson.id)
-    if (receivedJson.status) {
-      machineHtmlElement.className = "machine_on"
-      machineHtmlElement.children[1].innerHTML = "Occupied"
+    let machines:MachineStatus[] = JSON.parse((event as MessageEvent).data);
+    machines.forEach(applyMachineStatus);
+  }, false);
+
+  // Sent instead of a snapshot when the receiver already has as many browsers as it can keep updated.
+  // The browser reconnects by itself after the delay the event gives; until then the page is filled in once.
+  source.addEventListener('busy', () => {
+    console.log("Receiver busy, retrying later");
+    loadState();
+  }, false);
+}
+
+// Fills in every machine once from the receiver's last known state
+function loadState() {
+  fetch('/api/state')
+    .then((response) => response.json())
+    .then((machines:MachineStatus[]) => machines.forEach(applyMachineStatus));
+}
+
+// Updates a machine's box on the page. A machine the page doesn't have yet (a sender the receiver
+// heard for the first time) has the page laid out again and filled in from the receiver's state.
+function applyMachineStatus(machine:MachineStatus) {
+  let machineHtmlElement = machineBoxes[machine.slot];
+  if (machineHtmlElement === undefined) {
+    if (!layoutReloading) {
+      layoutReloading = true;
+      loadLayout()
+        .then(loadState)
+        .finally(() => { layoutReloading = false; });
+    }
+    return;
+  }
+
+  if (machine.status) {
+    if (machine.remaining !== undefined) {
+      finishTimes.set(machine.slot, Date.now() + machine.remaining);
     } else {
-      machineHtmlElement.className = "machine_off"
-      machineHtmlElement.children[1].innerHTML = "Available"
+      finishTimes.delete(machine.slot);
     }
-    
-  }, false);
+    machineHtmlElement.className = "machine_on"
+    machineHtmlElement.children[1].innerHTML = occupiedText(machine.slot)
+  } else {
+    finishTimes.delete(machine.slot);
+    machineHtmlElement.className = "machine_off"
+    machineHtmlElement.children[1].innerHTML = "Available"
+  }
+}
+
+// Status text for a running machine, with the estimated time left once the receiver has learned its cycles
+function occupiedText(slot:number):string {
+  let finish = finishTimes.get(slot);
+  if (finish === undefined) {
+    return "Occupied";
+  }
+  let minutes = Math.ceil((finish - Date.now()) / 60000);
+  return (minutes > 1) ? "Occupied, about " + minutes + " min left" : "Occupied, finishing soon";
 }
 
+// Count down the time left on every running machine between updates
+setInterval(() => {
+  finishTimes.forEach((finish, slot) => {
+    let machineHtmlElement = machineBoxes[slot];
+    if (machineHtmlElement !== undefined) {
+      machineHtmlElement.children[1].innerHTML = occupiedText(slot);
+    }
+  });
+}, 30000);
+
 type MachineStatus = {
+  slot: number;         // Index into the layout's machines, the same for as long as the receiver runs
   id: string;
   status: boolean;
-};
\ No newline at end of file
+  phase?: number;
+  remaining?: number;   // Estimated milliseconds left in the cycle, when known
+};
+
+// The machines to show, by room, from /api/layout
+type Layout = {
+  rooms: {
+    name: string;
+    machines: { slot: number; id: string; label: string }[];
+  }[];
+};
@@ -0,0 +1,321 @@
+/*
+  WasherWatcher receiver unit tests
+  "test_cycle_model/test_main.cpp"
+
+  CycleModel on hand-made cycles, then on replayed machine logs against the exact quantiles of the same cycles.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include <unity.h>
+#include <CycleModel.h>
+
+namespace {
+  const uint32_t MINUTE_MS = 60000;
+  const uint32_t LOG_CYCLES = 400;          // Cycles in each replayed log, about three months of a busy machine
+  const uint32_t MACHINES = 200;            // Logs replayed for the accuracy figures
+  const uint32_t HEARTBEAT_MS = 5 * MINUTE_MS;
+  const uint32_t TIMED_UPDATES = 2000000;
+
+  double nanosSince(std::chrono::steady_clock::time_point start, uint32_t count) {
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / count;
+  }
+
+  // One status frame as the receiver sees it
+  struct Transition {
+    uint32_t timeMs;
+    bool on;
+  };
+
+  // A machine's replayed log, and the lengths of the cycles in it that the model should learn from
+  struct TransitionLog {
+    std::vector<Transition> frames;
+    std::vector<float> cycles;
+  };
+
+  /*
+    A machine's status frames over LOG_CYCLES cycles: a mix of quick, normal and heavy programs, heartbeats
+    repeating the status every HEARTBEAT_MS, and the noise a real log has (someone opening the door of an idle
+    machine, an "off" frame that never arrived). Starts a day before millis() wraps, so cycles span the wrap.
+  */
+  TransitionLog makeLog(uint32_t seed, bool skewed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> uniform(0.0, 1.0);
+    std::normal_distribution<float> quick(32, 3), normal(48, 4), heavy(75, 6);
+    std::lognormal_distribution<float> drying(log(55.0), 0.35);
+    std::exponential_distribution<float> idle(1.0 / 180);
+
+    TransitionLog log;
+    uint32_t now = 0xFFFFFFFF - 24 * 60 * MINUTE_MS;
+    auto hold = [&](bool on, uint32_t lengthMs) {
+      for (uint32_t t = 0; t < lengthMs; t += HEARTBEAT_MS) { log.frames.push_back({now + t, on}); }
+      now += lengthMs;
+    };
+
+    for (uint32_t i = 0; i < LOG_CYCLES; i++) {
+      hold(false, (uint32_t) ((5 + idle(random)) * MINUTE_MS));
+      float pick = uniform(random);
+      float minutes;
+      if (pick < 0.05) {
+        minutes = 0.5 + uniform(random);            // Door opened, not a cycle
+      } else if (pick < 0.07) {
+        minutes = 300 + 200 * uniform(random);      // The "off" frame was lost and the next cycle's "on" too
+      } else if (skewed) {
+        minutes = drying(random);
+      } else {
+        minutes = (pick < 0.30) ? quick(random) : (pick < 0.85) ? normal(random) : heavy(random);
+      }
+      uint32_t length = (uint32_t) (minutes * MINUTE_MS);
+      hold(true, length);
+      if (length >= CycleModel::MIN_CYCLE_MS && length <= CycleModel::MAX_CYCLE_MS) { log.cycles.push_back(length); }
+    }
+    log.frames.push_back({now, false});
+    return log;
+  }
+
+  // The exact quantile of values, with the same rounding as P2Quantile gives its first five values
+  float exactQuantile(std::vector<float> values, float quantile) {
+    std::sort(values.begin(), values.end());
+    return values[(size_t) (quantile * (values.size() - 1) + 0.5)];
+  }
+
+  // How far the estimate's rank among values is from the quantile asked for, as a fraction of the values
+  float rankError(const std::vector<float> &values, float estimate, float quantile) {
+    size_t below = 0;
+    for (float value : values) { below += (value < estimate) ? 1 : 0; }
+    return fabsf((float) below / values.size() - quantile);
+  }
+
+  // CycleModel's rule for the time left, given a median and 90th percentile
+  float remainingFrom(float typical, float longest, float elapsed) {
+    if (elapsed < typical) { return typical - elapsed; }
+    if (elapsed < longest) { return longest - elapsed; }
+    return 0;
+  }
+
+  /*
+    Replays MACHINES logs of one shape, comparing the learned median and 90th percentile with the exact ones
+    over the same cycles, and the time left predicted at the start and 20 minutes into every cycle with the
+    actual time left and with what the exact quantiles of the cycles so far would have predicted.
+  */
+  void replay(bool skewed) {
+    const uint32_t MILESTONES[] = {10, 30, 100, 0};    // 0 stands for the whole log
+    double medianError[4] = {}, upperError[4] = {};
+    double modelAbsError = 0, exactAbsError = 0;
+    uint32_t predictions = 0;
+
+    for (uint32_t machine = 0; machine < MACHINES; machine++) {
+      TransitionLog log = makeLog(1000 * machine + (skewed ? 7 : 3), skewed);
+      CycleModel model;
+      std::vector<float> seen;
+      uint32_t startMs = 0;
+      bool on = false;
+
+      for (size_t i = 0; i < log.frames.size(); i++) {
+        const Transition &frame = log.frames[i];
+        if (frame.on && !on) {
+          startMs = frame.timeMs;
+          size_t end = i;
+          while (log.frames[end].on) { end++; }
+          uint32_t actual = log.frames[end].timeMs - startMs;
+          bool plausible = actual >= CycleModel::MIN_CYCLE_MS && actual <= CycleModel::MAX_CYCLE_MS;
+          if (plausible && seen.size() >= CycleModel::MIN_CYCLES) {
+            float typical = exactQuantile(seen, 0.5), longest = exactQuantile(seen, 0.9);
+            model.observe(true, frame.timeMs);
+            for (uint32_t elapsed : {0U, 20 * MINUTE_MS}) {
+              uint32_t remaining;
+              if (actual <= elapsed || !model.estimateRemaining(startMs + elapsed, remaining)) { continue; }
+              modelAbsError += fabs((double) remaining - (actual - elapsed));
+              exactAbsError += fabs((double) remainingFrom(typical, longest, elapsed) - (actual - elapsed));
+              predictions++;
+            }
+          }
+        }
+        model.observe(frame.on, frame.timeMs);
+        if (!frame.on && on) {
+          uint32_t length = frame.timeMs - startMs;
+          if (length >= CycleModel::MIN_CYCLE_MS && length <= CycleModel::MAX_CYCLE_MS) { seen.push_back(length); }
+          for (size_t m = 0; m < 4; m++) {
+            if (seen.size() == (MILESTONES[m] ? MILESTONES[m] : log.cycles.size()) && model.getCycleCount() == seen.size()) {
+              medianError[m] += rankError(seen, model.getMedianMs(), 0.5) / MACHINES;
+              upperError[m] += rankError(seen, model.getUpperMs(), 0.9) / MACHINES;
+            }
+          }
+        }
+        on = frame.on;
+      }
+      // Every plausible cycle is learned, even across the millis() wrap
+      TEST_ASSERT_EQUAL_UINT32(log.cycles.size(), model.getCycleCount());
+      TEST_ASSERT_EQUAL_UINT32(log.cycles.size(), seen.size());
+    }
+
+    char message[200];
+    snprintf(message, sizeof(message), "median rank error %.3f, %.3f, %.3f after 10, 30, 100 cycles, %.3f after all; p90 %.3f, %.3f, %.3f, %.3f",
+             medianError[0], medianError[1], medianError[2], medianError[3], upperError[0], upperError[1], upperError[2], upperError[3]);
+    TEST_MESSAGE(message);
+    snprintf(message, sizeof(message), "time left off by %.1f min on average (exact quantiles: %.1f min) over %u predictions",
+             modelAbsError / predictions / MINUTE_MS, exactAbsError / predictions / MINUTE_MS, predictions);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_TRUE(medianError[3] < 0.03);
+    TEST_ASSERT_TRUE(upperError[3] < 0.03);
+    TEST_ASSERT_TRUE(modelAbsError <= exactAbsError * 1.1 + predictions * 0.5 * MINUTE_MS);
+  }
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+// A machine already running when the receiver booted isn't timed from the wrong start
+void test_running_at_boot_is_not_timed(void) {
+  CycleModel model;
+  model.observe(true, 0);
+  model.observe(false, 40 * MINUTE_MS);
+  TEST_ASSERT_EQUAL_UINT32(0, model.getCycleCount());
+}
+
+// Heartbeats don't restart a cycle, and door openings and missed "off" frames aren't learned
+void test_noise_is_not_learned(void) {
+  CycleModel model;
+  uint32_t remaining;
+  model.observe(false, 0);
+  uint32_t now = 60 * MINUTE_MS;
+  const uint32_t lengths[] = {40, 50, 60, 1, 600, 45};    // Minutes; the door opening and the 10 h run don't count
+  for (uint32_t length : lengths) {
+    model.observe(true, now);
+    model.observe(true, now + 5 * MINUTE_MS);
+    now += length * MINUTE_MS;
+    model.observe(false, now);
+    now += 30 * MINUTE_MS;
+  }
+  TEST_ASSERT_EQUAL_UINT32(4, model.getCycleCount());
+  TEST_ASSERT_FALSE(model.estimateRemaining(now, remaining));     // No estimate while the machine is off
+}
+
+// No estimate before MIN_CYCLES cycles were seen
+void test_no_estimate_before_min_cycles(void) {
+  CycleModel model;
+  uint32_t remaining;
+  model.observe(false, 0);
+  for (uint32_t i = 0; i < CycleModel::MIN_CYCLES - 1; i++) {
+    model.observe(true, i * 100 * MINUTE_MS);
+    model.observe(false, i * 100 * MINUTE_MS + 45 * MINUTE_MS);
+  }
+  model.observe(true, 1000 * MINUTE_MS);
+  TEST_ASSERT_FALSE(model.estimateRemaining(1010 * MINUTE_MS, remaining));
+}
+
+// The time left counts down to the median, then to the 90th percentile, then stays at 0
+void test_time_left_regimes(void) {
+  CycleModel model;
+  uint32_t remaining, now = 0;
+  model.observe(false, now);
+  const uint32_t lengths[] = {40, 50, 60, 45, 70};
+  for (uint32_t length : lengths) {
+    model.observe(true, now);
+    now += length * MINUTE_MS;
+    model.observe(false, now);
+    now += 30 * MINUTE_MS;
+  }
+
+  model.observe(true, now);
+  float typical = model.getMedianMs(), longest = model.getUpperMs();
+  TEST_ASSERT_TRUE(typical < longest);
+  for (uint32_t elapsed = 0; elapsed < 90 * MINUTE_MS; elapsed += 7000) {
+    TEST_ASSERT_TRUE(model.estimateRemaining(now + elapsed, remaining));
+    TEST_ASSERT_FLOAT_WITHIN(1, remainingFrom(typical, longest, elapsed), remaining);
+  }
+}
+
+// A machine restored as running after a receiver restart is timed from when it started, and one restored as off isn't timed
+void test_resume_after_restart(void) {
+  CycleModel model;
+  uint32_t remaining, now = 0;
+  model.observe(false, now);
+  for (uint32_t i = 0; i < CycleModel::MIN_CYCLES; i++) {
+    model.observe(true, now);
+    now += 50 * MINUTE_MS;
+    model.observe(false, now);
+    now += 30 * MINUTE_MS;
+  }
+
+  model.resume(true, 1000 * MINUTE_MS);
+  TEST_ASSERT_TRUE(model.estimateRemaining(1020 * MINUTE_MS, remaining));
+  TEST_ASSERT_UINT32_WITHIN(1, 30 * MINUTE_MS, remaining);
+  model.observe(false, 1050 * MINUTE_MS);
+  TEST_ASSERT_EQUAL_UINT32(CycleModel::MIN_CYCLES + 1, model.getCycleCount());
+
+  model.resume(false, 1100 * MINUTE_MS);
+  TEST_ASSERT_FALSE(model.estimateRemaining(1110 * MINUTE_MS, remaining));
+}
+
+// Three programs (quick, normal, heavy) in one machine's log
+void test_replay_three_programs(void) {
+  replay(false);
+}
+
+// One long-tailed program, like a dryer's
+void test_replay_skewed_program(void) {
+  replay(true);
+}
+
+// What an update costs: one P-squared add, a whole on/off cycle through the model (two adds), an estimate
+void test_update_cost(void) {
+  std::mt19937 random(5);
+  std::normal_distribution<float> lengths(48 * MINUTE_MS, 6 * MINUTE_MS);
+  std::vector<float> values(4096);
+  for (float &value : values) { value = lengths(random); }
+
+  P2Quantile quantile(0.5);
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < TIMED_UPDATES; i++) { quantile.add(values[i & 4095]); }
+  double addNs = nanosSince(start, TIMED_UPDATES);
+
+  CycleModel model;
+  uint32_t now = 0;
+  model.observe(false, now);
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < TIMED_UPDATES / 2; i++) {
+    model.observe(true, now);
+    now += (uint32_t) values[i & 4095];
+    model.observe(false, now);
+    now += 30 * MINUTE_MS;
+  }
+  double cycleNs = nanosSince(start, TIMED_UPDATES / 2);
+
+  uint32_t remaining, total = 0;
+  model.observe(true, now);
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < TIMED_UPDATES; i++) {
+    model.estimateRemaining(now + (i & 0xFFFF) * 100, remaining);
+    total += remaining;
+  }
+  double estimateNs = nanosSince(start, TIMED_UPDATES);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, total);
+  TEST_ASSERT_EQUAL_UINT32(TIMED_UPDATES / 2, model.getCycleCount());
+
+  char message[160];
+  snprintf(message, sizeof(message), "%.1f ns a quantile update, %.1f ns a whole cycle, %.1f ns an estimate, %u bytes a machine",
+           addNs, cycleNs, estimateNs, (unsigned) sizeof(CycleModel));
+  TEST_MESSAGE(message);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_running_at_boot_is_not_timed);
+  RUN_TEST(test_noise_is_not_learned);
+  RUN_TEST(test_no_estimate_before_min_cycles);
+  RUN_TEST(test_time_left_regimes);
+  RUN_TEST(test_resume_after_restart);
+  RUN_TEST(test_replay_three_programs);
+  RUN_TEST(test_replay_skewed_program);
+  RUN_TEST(test_update_cost);
+  return UNITY_END();
+}
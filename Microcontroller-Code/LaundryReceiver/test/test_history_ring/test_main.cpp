@@ -0,0 +1,200 @@
+/*
+  WasherWatcher receiver unit tests
+  "test_history_ring/test_main.cpp"
+
+  HistoryRing against the records written to it, its cursors, and a synthetic week of a busy washer.
+*/
+
+#include <stdio.h>
+#include <chrono>
+#include <deque>
+
+#include <unity.h>
+#include <HistoryRing.h>
+
+namespace {
+  const uint32_t RANDOM_RECORDS = 50000;    // Records written by the round-trip test, many times what the ring holds
+  const uint32_t DAY_MS = 24UL * 3600 * 1000;
+  const uint32_t WEEK_DAYS = 7;
+  const uint32_t SUMMARY_INTERVAL_MS = 600000;    // The receiver's HISTORY_SUMMARY_INTERVAL
+  const uint32_t QUERIES = 20000;
+
+  uint32_t nextRandom(uint32_t &state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  bool sameRecord(const HistoryRecord &a, const HistoryRecord &b) {
+    if (a.kind != b.kind || a.timeMs != b.timeMs || a.state != b.state) { return false; }
+    return a.kind != HISTORY_SUMMARY || (a.summary.phase == b.summary.phase && a.summary.peakFreqDeciHz == b.summary.peakFreqDeciHz
+                                         && a.summary.meanCms2 == b.summary.meanCms2 && a.summary.stdDevMms2 == b.summary.stdDevMms2);
+  }
+
+  // Reads the whole ring and compares it with the newest records written, oldest first
+  bool matches(const HistoryRing &ring, const std::deque<HistoryRecord> &written) {
+    if (ring.getRecordCount() > written.size()) { return false; }
+    HistoryCursor cursor;
+    ring.beginRead(cursor);
+    HistoryRecord record;
+    size_t index = written.size() - ring.getRecordCount(), read = 0;
+    while (ring.next(cursor, record)) {
+      if (index >= written.size() || !sameRecord(record, written[index])) { return false; }
+      index++;
+      read++;
+    }
+    return read == ring.getRecordCount();
+  }
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+/*
+  Random states and summaries, with gaps from a tick to weeks and feature jumps across their whole range,
+  written far past the ring's capacity. After every record the ring must hold exactly the newest ones.
+*/
+void test_round_trip_past_capacity(void) {
+  static HistoryRing ring;
+  std::deque<HistoryRecord> written;
+  uint32_t random = 21, now = 123456, base = 0;
+  uint8_t state = 0;
+  FeatureSummary summary = {};
+
+  for (uint32_t i = 0; i < RANDOM_RECORDS; i++) {
+    uint32_t gap = nextRandom(random) % 8;
+    now += (gap == 0) ? 14UL * DAY_MS : (gap < 3) ? nextRandom(random) % 99 : nextRandom(random) % 3600000;
+    HistoryRecord expected = {};
+    if (i == 0) { base = now; }
+    base += (now - base) / HistoryRing::TICK_MS * HistoryRing::TICK_MS;    // Times are kept to whole ticks from the first
+    uint32_t before = ring.getWrittenBytes();
+
+    if (nextRandom(random) % 3 == 0) {
+      state = (uint8_t) nextRandom(random);
+      ring.addState(now, state);
+      expected.kind = HISTORY_STATE;
+      TEST_ASSERT_UINT32_WITHIN(2, 5, ring.getWrittenBytes() - before);     // 3-7 bytes
+    } else {
+      uint32_t bits = nextRandom(random);
+      bool jump = (bits & 7) == 0;
+      summary.phase = (uint8_t) (bits >> 3);
+      summary.peakFreqDeciHz = jump ? (uint8_t) (bits >> 8) : (uint8_t) (summary.peakFreqDeciHz + (bits >> 8) % 5 - 2);
+      summary.meanCms2 = jump ? (uint16_t) (bits >> 16) : (uint16_t) (summary.meanCms2 + (bits >> 16) % 9 - 4);
+      summary.stdDevMms2 = jump ? (uint16_t) nextRandom(random) : (uint16_t) (summary.stdDevMms2 + (bits >> 20) % 41 - 20);
+      ring.addSummary(now, summary);
+      expected.kind = HISTORY_SUMMARY;
+      expected.summary = summary;
+      TEST_ASSERT_LESS_OR_EQUAL_UINT32(HistoryRing::MAX_RECORD_BYTES, ring.getWrittenBytes() - before);
+    }
+    expected.timeMs = base;
+    expected.state = state;
+    written.push_back(expected);
+    if (written.size() > ring.getRecordCount() + 16) { written.pop_front(); }
+    TEST_ASSERT_TRUE(matches(ring, written));
+  }
+
+  // Old records are evicted to stay within the capacity, and counted
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(HistoryRing::CAPACITY, ring.getUsedBytes());
+  TEST_ASSERT_GREATER_THAN_UINT32(0, ring.getEvictedCount());
+  TEST_ASSERT_EQUAL_UINT32(RANDOM_RECORDS, ring.getRecordCount() + ring.getEvictedCount());
+}
+
+// A reader whose next records are overwritten skips to the oldest record still there; clear() empties the ring
+void test_cursor_overtaken_by_eviction(void) {
+  static HistoryRing ring;
+  for (uint32_t i = 0; i < 10; i++) { ring.addState(1000 + i * 1000, (uint8_t) i); }
+  HistoryCursor cursor;
+  HistoryRecord record;
+  ring.beginRead(cursor);
+  ring.next(cursor, record);
+  ring.next(cursor, record);
+  TEST_ASSERT_EQUAL_UINT8(1, record.state);
+  TEST_ASSERT_EQUAL_UINT32(2000, record.timeMs);
+
+  for (uint32_t i = 0; i < HistoryRing::CAPACITY; i++) { ring.addState(20000 + i * 1000, (uint8_t) (100 + i)); }
+  HistoryCursor oldest;
+  HistoryRecord first;
+  ring.beginRead(oldest);
+  ring.next(oldest, first);
+  TEST_ASSERT_TRUE(ring.next(cursor, record));
+  TEST_ASSERT_TRUE(sameRecord(record, first));
+
+  while (ring.next(cursor, record)) {}
+  TEST_ASSERT_FALSE(ring.next(cursor, record));
+  TEST_ASSERT_EQUAL_UINT8((uint8_t) (100 + HistoryRing::CAPACITY - 1), record.state);
+
+  ring.clear();
+  HistoryCursor empty;
+  ring.beginRead(empty);
+  TEST_ASSERT_FALSE(ring.next(empty, record));
+  TEST_ASSERT_EQUAL_UINT32(0, ring.getUsedBytes());
+  TEST_ASSERT_EQUAL_UINT32(0, ring.getRecordCount());
+}
+
+/*
+  A week of a busy washer, recorded the way the receiver does: a state record for every status or phase change
+  and a feature summary every SUMMARY_INTERVAL_MS while it runs. A day has to fit in under a kilobyte, and
+  reading back the full ring is timed.
+*/
+void test_busy_week(void) {
+  static HistoryRing ring;
+  uint32_t random = 77;
+  const uint32_t phaseMinutes[] = {15, 4, 12, 14};
+  FeatureSummary summary = {1, 12, 984, 412};
+  uint32_t cycles = 0;
+
+  for (uint32_t day = 0; day < WEEK_DAYS; day++) {
+    uint32_t dayCycles = 6 + nextRandom(random) % 5;
+    uint32_t slot = 15UL * 3600 * 1000 / dayCycles;
+    for (uint32_t c = 0; c < dayCycles; c++) {
+      uint32_t now = day * DAY_MS + 7UL * 3600 * 1000 + c * slot + nextRandom(random) % (slot - 50UL * 60 * 1000);
+      for (uint8_t phase = 0; phase < 4; phase++) {
+        uint32_t phaseEnd = now + phaseMinutes[phase] * 60000;
+        ring.addState(now, LaundryProtocol::stateCode(true, phase + 1));
+        for (uint32_t t = now; t < phaseEnd; t += 2000) {
+          if (!ring.isSummaryDue(t, SUMMARY_INTERVAL_MS)) { continue; }
+          summary.phase = phase + 1;
+          summary.peakFreqDeciHz = (uint8_t) (10 + phase * 40 + nextRandom(random) % 8);
+          summary.meanCms2 = (uint16_t) (981 + nextRandom(random) % 30);
+          summary.stdDevMms2 = (uint16_t) (200 + phase * 300 + nextRandom(random) % 150);
+          ring.addSummary(t, summary);
+        }
+        now = phaseEnd;
+      }
+      ring.addState(now, LaundryProtocol::stateCode(false, 0));
+      cycles++;
+    }
+  }
+
+  double bytesPerDay = (double) ring.getWrittenBytes() / WEEK_DAYS;
+  uint32_t records = ring.getRecordCount() + ring.getEvictedCount();
+  TEST_ASSERT_TRUE(bytesPerDay < 1024);
+
+  HistoryRecord record;
+  uint32_t read = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < QUERIES; i++) {
+    HistoryCursor cursor;
+    ring.beginRead(cursor);
+    while (ring.next(cursor, record)) { read++; }
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  double queryNs = elapsed.count() / QUERIES;
+  TEST_ASSERT_EQUAL_UINT32(QUERIES * ring.getRecordCount(), read);
+
+  char message[200];
+  snprintf(message, sizeof(message), "%u cycles, %u records, %.0f bytes a day, %.1f days in %u bytes; %.1f us to read %u records",
+           cycles, records, bytesPerDay, HistoryRing::CAPACITY / bytesPerDay, (unsigned) HistoryRing::CAPACITY,
+           queryNs / 1000, ring.getRecordCount());
+  TEST_MESSAGE(message);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_round_trip_past_capacity);
+  RUN_TEST(test_cursor_overtaken_by_eviction);
+  RUN_TEST(test_busy_week);
+  return UNITY_END();
+}
@@ -0,0 +1,259 @@
+/*
+  WasherWatcher receiver unit tests
+  "test_json_writer/test_main.cpp"
+
+  JsonWriter output, overflow and rollback, the state table's JSON, and an hour of status events against
+  the old per-packet path that built a JSON document and a string for every frame.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <string>
+
+#include <unity.h>
+#include <JsonWriter.h>
+#include <MachineStateTable.h>
+
+// Counts every operator new while countingHeap is set, so the two paths' allocations can be compared.
+// Kept out of line, so the compiler doesn't pair an inlined free() with a new expression and warn.
+namespace {
+  bool countingHeap = false;
+  uint64_t heapAllocations = 0;
+}
+
+__attribute__((noinline)) void *operator new(size_t size) {
+  if (countingHeap) { heapAllocations++; }
+  void *memory = malloc(size ? size : 1);
+  if (memory == NULL) { throw std::bad_alloc(); }
+  return memory;
+}
+
+__attribute__((noinline)) void operator delete(void *memory) noexcept {
+  free(memory);
+}
+
+namespace {
+  const size_t MACHINES = 24;
+  const size_t BROWSERS = 5;
+  const uint32_t HOUR_MS = 3600UL * 1000;
+  const uint32_t PACKET_MS = 2000;          // The old senders sent every evaluation
+  const uint32_t FLUSH_MS = 250;            // The receiver's STATUS_FLUSH_INTERVAL
+  const uint32_t PHASE_MS = 9UL * 60 * 1000;
+  const size_t JSON_BYTES_PER_MACHINE = 128;
+
+  // A document using every kind of value, and what it must come out as
+  void writeReference(JsonWriter &writer) {
+    writer.beginObject()
+          .field("name", "a\"b\\c\n\x01")
+          .field("max", (uint32_t) 4294967295UL)
+          .field("min", (int32_t) (-2147483647L - 1))
+          .field("on", true)
+          .key("floats").beginArray()
+            .value((float) 3.14159, 2).value((float) -0.5, 1).value((float) 2.0, 0).value((float) 1.5, 9)
+          .endArray()
+          .key("nested").beginArray().beginObject().endObject().beginArray().endArray().endArray()
+          .endObject();
+  }
+
+  const char *REFERENCE = "{\"name\":\"a\\\"b\\\\c\\u000a\\u0001\",\"max\":4294967295,\"min\":-2147483648,\"on\":true,"
+                          "\"floats\":[3.14,-0.5,2,1.500000],\"nested\":[{},[]]}";
+
+  DecodedFrame frameFor(size_t machine, uint16_t sequence, uint32_t uptimeMs, bool on, uint8_t phase) {
+    DecodedFrame frame = {};
+    frame.version = LaundryProtocol::VERSION_2;
+    frame.machineId = 0x100 + machine;
+    snprintf(frame.name, sizeof(frame.name), "FARRIS_WASHER_%u", (unsigned) machine);
+    frame.sequence = sequence;
+    frame.uptimeMs = uptimeMs;
+    frame.machineOn = on;
+    frame.phase = phase;
+    return frame;
+  }
+
+  /*
+    The old OnDataRecv on the host: ArduinoJson's DynamicJsonDocument allocated its 1024 byte pool, serializeJson()
+    built a String, and AsyncEventSource formatted the message and queued a copy of it for every browser.
+    Returns the bytes written to the browsers.
+  */
+  size_t sendLegacy(const char *name, bool machineOn, uint32_t id) {
+    char *pool = new char[1024];
+    std::string json;
+    json += "{\"id\":\"";
+    json += name;
+    json += "\",\"status\":";
+    json += machineOn ? "true" : "false";
+    json += "}";
+
+    std::string message("id: ");
+    message += std::to_string((unsigned long) id);
+    message += "\r\nevent: machine_status\r\ndata: ";
+    message += json;
+    message += "\r\n\r\n";
+    for (size_t i = 0; i < BROWSERS; i++) {
+      std::string *queued = new std::string(message);
+      delete queued;
+    }
+    delete[] pool;
+    return message.length() * BROWSERS;
+  }
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+// Escaping, numbers, decimals and commas
+void test_every_kind_of_value(void) {
+  char buffer[256];
+  JsonWriter writer(buffer, sizeof(buffer));
+  writeReference(writer);
+  TEST_ASSERT_EQUAL_STRING(REFERENCE, writer.c_str());
+  TEST_ASSERT_FALSE(writer.overflowed());
+  TEST_ASSERT_EQUAL_UINT32(strlen(REFERENCE), writer.length());
+
+  writer.reset();
+  TEST_ASSERT_EQUAL_STRING("", writer.c_str());
+  writer.beginArray().value((int32_t) -7).value((uint32_t) 0).value((float) -1.25, 2).endArray();
+  TEST_ASSERT_EQUAL_STRING("[-7,0,-1.25]", writer.c_str());
+}
+
+// A buffer of any size stops cleanly at a terminated prefix and reports the overflow
+void test_any_buffer_size_stops_cleanly(void) {
+  size_t length = strlen(REFERENCE);
+  for (size_t capacity = 1; capacity <= length + 1; capacity++) {
+    char small[256];
+    JsonWriter truncated(small, capacity);
+    writeReference(truncated);
+    TEST_ASSERT_EQUAL(capacity <= length, truncated.overflowed());
+    TEST_ASSERT_LESS_THAN_UINT32(capacity, truncated.length());
+    TEST_ASSERT_EQUAL_UINT32(truncated.length(), strlen(small));
+    TEST_ASSERT_EQUAL_MEMORY(REFERENCE, small, truncated.length());
+  }
+
+  char buffer[64];
+  JsonWriter deep(buffer, sizeof(buffer));
+  for (size_t i = 0; i <= JsonWriter::MAX_DEPTH; i++) { deep.beginArray(); }
+  TEST_ASSERT_TRUE(deep.overflowed());
+}
+
+// rollback() drops an element and its comma, and clears an overflow it caused
+void test_rollback(void) {
+  char buffer[16];
+  JsonWriter writer(buffer, sizeof(buffer));
+  writer.beginArray().value((uint32_t) 1);
+  size_t mark = writer.mark();
+  bool wasFirst = writer.isFirstInContainer();
+  writer.value("does not fit in here");
+  TEST_ASSERT_TRUE(writer.overflowed());
+  writer.rollback(mark, wasFirst);
+  TEST_ASSERT_FALSE(writer.overflowed());
+  writer.value((uint32_t) 2).endArray();
+  TEST_ASSERT_EQUAL_STRING("[1,2]", writer.c_str());
+
+  writer.reset();
+  writer.beginArray();
+  mark = writer.mark();
+  wasFirst = writer.isFirstInContainer();
+  writer.value("dropped");
+  writer.rollback(mark, wasFirst);
+  writer.value((uint32_t) 3).endArray();
+  TEST_ASSERT_EQUAL_STRING("[3]", writer.c_str());
+}
+
+// Whatever the buffer, the table writes a valid array of whole machines, each in full or not at all
+void test_table_cuts_at_an_entry(void) {
+  static MachineStateTable table;
+  const uint8_t mac[6] = {2, 0, 0, 0, 0, 1};
+  for (size_t i = 0; i < MACHINES; i++) { table.update(i, frameFor(i, 1, 1000, i % 2, i % 4), mac, 5000); }
+
+  static char full[MachineStateTable::MAX_MACHINES * JSON_BYTES_PER_MACHINE + 3];
+  size_t fullLength = table.writeJson(full, sizeof(full), 9000);
+  TEST_ASSERT_TRUE(fullLength > 2 && full[fullLength - 1] == ']');
+  TEST_ASSERT_TRUE(strstr(full, "{\"slot\":1,\"id\":\"FARRIS_WASHER_1\",\"status\":true,\"phase\":1,\"lastSeen\":4000,\"since\":4000}") != NULL);
+
+  for (size_t capacity = 3; capacity <= fullLength + 1; capacity++) {
+    static char out[sizeof(full)];
+    size_t length = table.writeJson(out, capacity, 9000);
+    // Everything before the closing bracket must be the full output up to the end of an entry
+    TEST_ASSERT_LESS_THAN_UINT32(capacity, length);
+    TEST_ASSERT_TRUE(out[0] == '[' && out[length - 1] == ']');
+    TEST_ASSERT_EQUAL_MEMORY(full, out, length - 1);
+    TEST_ASSERT_TRUE(length == 2 || full[length - 1] == ',' || full[length - 1] == ']');
+  }
+}
+
+/*
+  An hour of every machine's frames, through the old path and through the state table and writer. The receiver
+  flushes the machines that changed as one machine_status event at most every FLUSH_MS.
+*/
+void test_hour_of_events_against_old_path(void) {
+  static MachineStateTable table;
+  static char statusJson[MachineStateTable::MAX_MACHINES * JSON_BYTES_PER_MACHINE + 3];
+  static char event[sizeof(statusJson) + 64];
+  const uint8_t mac[6] = {2, 0, 0, 0, 0, 2};
+
+  uint64_t legacyAllocations = 0, legacyBytes = 0, legacyEvents = 0;
+  uint64_t writerAllocations = 0, writerBytes = 0, writerEvents = 0;
+  uint32_t changes = 0, sentMachines = 0;
+  for (uint32_t now = 0; now < HOUR_MS; now += FLUSH_MS) {
+    for (size_t machine = 0; machine < MACHINES; machine++) {
+      uint32_t offset = machine * (PACKET_MS / MACHINES) + machine * 97000;
+      if ((now + offset) % PACKET_MS >= FLUSH_MS) { continue; }     // Each machine sends once every PACKET_MS
+
+      // Machines run one cycle of four phases, then sit idle, at staggered times
+      uint32_t cycleMs = (now + offset) % (6 * PHASE_MS);
+      bool on = cycleMs < 4 * PHASE_MS;
+      uint8_t phase = on ? 1 + cycleMs / PHASE_MS : 0;
+      DecodedFrame frame = frameFor(machine, (now + offset) / PACKET_MS, now + offset, on, phase);
+
+      countingHeap = true;
+      heapAllocations = 0;
+      legacyBytes += sendLegacy(frame.name, on, now);
+      legacyAllocations += heapAllocations;
+      legacyEvents++;
+
+      heapAllocations = 0;
+      StateUpdate update = table.update(machine, frame, mac, now);
+      writerAllocations += heapAllocations;
+      countingHeap = false;
+      if (update != STATE_REPEAT) { changes++; }
+    }
+
+    countingHeap = true;
+    heapAllocations = 0;
+    uint32_t dirty = table.takeDirty();
+    if (dirty != 0) {
+      JsonWriter writer(statusJson, sizeof(statusJson));
+      table.writeJson(writer, now, dirty);
+      int length = snprintf(event, sizeof(event), "event: machine_status\nid: %u\ndata: %s\n\n", (unsigned) now, writer.c_str());
+      writerBytes += (uint64_t) length * BROWSERS;
+      writerEvents++;
+      for (uint32_t bits = dirty; bits; bits &= bits - 1) { sentMachines++; }
+    }
+    writerAllocations += heapAllocations;
+    countingHeap = false;
+  }
+
+  char message[200];
+  snprintf(message, sizeof(message), "old path: %llu events, %.1f KB, %.1f allocations per packet; writer: %llu events, %.1f KB, %llu allocations",
+           (unsigned long long) legacyEvents, legacyBytes / 1024.0, (double) legacyAllocations / legacyEvents,
+           (unsigned long long) writerEvents, writerBytes / 1024.0, (unsigned long long) writerAllocations);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, legacyAllocations);
+  TEST_ASSERT_EQUAL_UINT32(0, writerAllocations);
+  TEST_ASSERT_EQUAL_UINT32(changes, sentMachines);       // Every new machine and change is sent once
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(changes, writerEvents);
+  TEST_ASSERT_TRUE(writerBytes * 10 < legacyBytes);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_every_kind_of_value);
+  RUN_TEST(test_any_buffer_size_stops_cleanly);
+  RUN_TEST(test_rollback);
+  RUN_TEST(test_table_cuts_at_an_entry);
+  RUN_TEST(test_hour_of_events_against_old_path);
+  return UNITY_END();
+}
@@ -0,0 +1,175 @@
+/*
+  WasherWatcher receiver unit tests
+  "test_machine_state_table/test_main.cpp"
+
+  MachineStateTable's outcomes for each frame, its slots, the dirty mask, the link statistics it keeps from v2 frames, and
+  restoring a machine after a restart.
+*/
+
+#include <stdio.h>
+
+#include <unity.h>
+#include <MachineStateTable.h>
+
+namespace {
+  const uint8_t MAC[6] = {2, 0, 0, 0, 0, 7};
+
+  DecodedFrame v2Frame(uint16_t machineId, uint16_t sequence, uint32_t uptimeMs, bool on, uint8_t phase) {
+    DecodedFrame frame = {};
+    frame.version = LaundryProtocol::VERSION_2;
+    frame.machineId = machineId;
+    snprintf(frame.name, sizeof(frame.name), "MACHINE_%04X", (unsigned) machineId);
+    frame.sequence = sequence;
+    frame.uptimeMs = uptimeMs;
+    frame.machineOn = on;
+    frame.phase = phase;
+    return frame;
+  }
+
+  // The tests give each machine the slot of its id's high nibble
+  size_t slotOf(uint16_t machineId) { return machineId >> 4; }
+
+  StateUpdate apply(MachineStateTable &table, const DecodedFrame &frame, uint32_t nowMs) {
+    return table.update(slotOf(frame.machineId), frame, MAC, nowMs);
+  }
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+// New, changed and repeated states, and which of them mark the machine dirty
+void test_outcomes_and_dirty_mask(void) {
+  static MachineStateTable table;
+  TEST_ASSERT_EQUAL(STATE_NEW, apply(table, v2Frame(0x10, 1, 1000, false, 0), 5000));
+  TEST_ASSERT_EQUAL(STATE_NEW, apply(table, v2Frame(0x20, 1, 1000, false, 0), 5000));
+  TEST_ASSERT_EQUAL_HEX32(0x6, table.takeDirty());
+  TEST_ASSERT_FALSE(table.hasDirty());
+
+  TEST_ASSERT_EQUAL(STATE_REPEAT, apply(table, v2Frame(0x10, 2, 61000, false, 0), 65000));
+  TEST_ASSERT_FALSE(table.hasDirty());
+  TEST_ASSERT_EQUAL(STATE_CHANGED, apply(table, v2Frame(0x20, 2, 3000, true, 1), 7000));
+  TEST_ASSERT_EQUAL(STATE_CHANGED, apply(table, v2Frame(0x20, 3, 5000, true, 3), 9000));
+  TEST_ASSERT_EQUAL_HEX32(0x4, table.takeDirty());
+
+  const MachineState &washer = table.at(slotOf(0x20));
+  TEST_ASSERT_EQUAL_UINT8(3, washer.phase);
+  TEST_ASSERT_EQUAL_UINT32(9000, washer.lastTransitionMs);
+  TEST_ASSERT_EQUAL_UINT32(65000, table.at(slotOf(0x10)).lastSeenMs);
+  TEST_ASSERT_EQUAL_UINT32(5000, table.at(slotOf(0x10)).lastTransitionMs);
+}
+
+// A resent copy of the last v2 frame is ignored but still counts as hearing from the machine; v1 frames never are
+void test_duplicates_are_ignored(void) {
+  static MachineStateTable table;
+  apply(table, v2Frame(0x10, 7, 1000, false, 0), 5000);
+  table.takeDirty();
+  TEST_ASSERT_EQUAL(STATE_DUPLICATE, apply(table, v2Frame(0x10, 7, 1000, false, 0), 5300));
+  TEST_ASSERT_EQUAL(STATE_DUPLICATE, apply(table, v2Frame(0x10, 7, 1000, true, 1), 5600));    // Applied as it was first
+  TEST_ASSERT_FALSE(table.hasDirty());
+  TEST_ASSERT_FALSE(table.at(slotOf(0x10)).machineOn);
+  TEST_ASSERT_EQUAL_UINT32(5600, table.at(slotOf(0x10)).lastSeenMs);
+  TEST_ASSERT_EQUAL_UINT32(2, table.getLinkStats().duplicates);
+  TEST_ASSERT_EQUAL_UINT32(1, table.getLinkStats().frames);
+
+  // A rebooted sender starts its sequence over, so the same number with another uptime is a new frame
+  TEST_ASSERT_EQUAL(STATE_CHANGED, apply(table, v2Frame(0x10, 7, 400, true, 1), 9000));
+
+  DecodedFrame v1 = v2Frame(0x30, 0, 0, true, 0);
+  v1.version = 1;
+  TEST_ASSERT_EQUAL(STATE_NEW, apply(table, v1, 9000));
+  TEST_ASSERT_EQUAL(STATE_REPEAT, apply(table, v1, 9100));
+}
+
+// Entries live at their slot, in any order, and only the slots heard from count or are written
+void test_slots(void) {
+  static MachineStateTable table;
+  const size_t last = MachineStateTable::MAX_MACHINES - 1;
+  TEST_ASSERT_EQUAL(STATE_NEW, table.update(last, v2Frame(0x900, 1, 1000, false, 0), MAC, 2000));
+  TEST_ASSERT_EQUAL(STATE_NEW, table.update(3, v2Frame(0x100, 1, 1000, true, 1), MAC, 2000));
+  TEST_ASSERT_TRUE(table.has(last) && table.has(3));
+  TEST_ASSERT_FALSE(table.has(0) || table.has(MachineStateTable::MAX_MACHINES));
+  TEST_ASSERT_EQUAL_UINT32(2, table.count());
+  TEST_ASSERT_EQUAL_HEX32(((uint32_t) 1 << last) | (1 << 3), table.takeDirty());
+  TEST_ASSERT_EQUAL_UINT16(0x100, table.at(3).machineId);
+
+  char json[2 * MachineStateTable::JSON_BYTES_PER_MACHINE + 3];
+  table.writeJson(json, sizeof(json), 3000);
+  TEST_ASSERT_EQUAL_STRING("[{\"slot\":3,\"id\":\"MACHINE_0100\",\"status\":true,\"phase\":1,\"lastSeen\":1000,\"since\":1000},"
+                           "{\"slot\":31,\"id\":\"MACHINE_0900\",\"status\":false,\"phase\":0,\"lastSeen\":1000,\"since\":1000}]", json);
+}
+
+/*
+  Sequence gaps and arrival delays: delays are measured from the sender's fastest frame, a resent frame shows up
+  as late, and a sender restart (its uptime going backwards) starts the baseline over without counting a gap.
+*/
+void test_link_statistics(void) {
+  static MachineStateTable table;
+  const uint32_t offsetMs = 70000;      // Our clock minus the sender's
+  apply(table, v2Frame(0x10, 1, 1000, false, 0), 1000 + offsetMs + 3);
+  apply(table, v2Frame(0x10, 2, 61000, false, 0), 61000 + offsetMs + 1);    // Faster: the new baseline
+  apply(table, v2Frame(0x10, 5, 121000, false, 0), 121000 + offsetMs + 1);  // Two lost
+  apply(table, v2Frame(0x10, 6, 181000, true, 1), 181000 + offsetMs + 401); // Resent after 400 ms
+
+  const LinkStats &stats = table.getLinkStats();
+  TEST_ASSERT_EQUAL_UINT32(4, stats.frames);
+  TEST_ASSERT_EQUAL_UINT32(2, stats.sequenceGaps);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.lateFrames);
+  TEST_ASSERT_UINT32_WITHIN(2, 400, stats.delayMaxMs);
+
+  // The sender reboots: sequence and uptime start over
+  apply(table, v2Frame(0x10, 0, 2500, false, 0), 400000);
+  apply(table, v2Frame(0x10, 1, 62500, false, 0), 460000);
+  TEST_ASSERT_EQUAL_UINT32(2, stats.sequenceGaps);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.lateFrames);
+  TEST_ASSERT_EQUAL_UINT32(6, stats.frames);
+}
+
+// Every machine counts its own frames, duplicates and losses; a frame arriving behind a newer one is ignored
+void test_per_machine_counters(void) {
+  static MachineStateTable table;
+  apply(table, v2Frame(0x10, 1, 1000, false, 0), 5000);
+  apply(table, v2Frame(0x10, 1, 1000, false, 0), 5300);
+  apply(table, v2Frame(0x10, 4, 4000, true, 1), 8000);      // Two lost
+  TEST_ASSERT_EQUAL(STATE_DUPLICATE, apply(table, v2Frame(0x10, 3, 3000, false, 0), 8100));
+  apply(table, v2Frame(0x20, 1, 1000, false, 0), 9000);
+
+  const MachineState &washer = table.at(slotOf(0x10));
+  TEST_ASSERT_TRUE(washer.machineOn);
+  TEST_ASSERT_EQUAL_UINT32(4, washer.frames);
+  TEST_ASSERT_EQUAL_UINT32(1, washer.duplicates);
+  TEST_ASSERT_EQUAL_UINT32(2, washer.lostFrames);
+  TEST_ASSERT_EQUAL_UINT32(1, washer.outOfOrder);
+  TEST_ASSERT_EQUAL_UINT32(8100, washer.lastSeenMs);
+  TEST_ASSERT_EQUAL_UINT32(1, table.at(slotOf(0x20)).frames);
+  TEST_ASSERT_EQUAL_UINT32(0, table.at(slotOf(0x20)).lostFrames);
+}
+
+// A restored machine is back in its slot without being marked dirty, and its sender's next frame is never a duplicate
+void test_restore(void) {
+  static MachineStateTable table;
+  table.restore(slotOf(0x10), MAC, 0x10, "MACHINE_0010", LaundryProtocol::STATE_ON_BIT | 2, 1000);
+  TEST_ASSERT_TRUE(table.has(slotOf(0x10)));
+  TEST_ASSERT_FALSE(table.hasDirty());
+  const MachineState &washer = table.at(slotOf(0x10));
+  TEST_ASSERT_TRUE(washer.machineOn);
+  TEST_ASSERT_EQUAL_UINT8(2, washer.phase);
+  TEST_ASSERT_EQUAL_UINT32(1000, washer.lastTransitionMs);
+
+  TEST_ASSERT_EQUAL(STATE_REPEAT, apply(table, v2Frame(0x10, 0, 0, true, 2), 9000));
+  TEST_ASSERT_EQUAL_UINT32(0, table.getLinkStats().duplicates);
+  TEST_ASSERT_EQUAL(STATE_DUPLICATE, apply(table, v2Frame(0x10, 0, 0, true, 2), 9300));
+  TEST_ASSERT_EQUAL(STATE_CHANGED, apply(table, v2Frame(0x10, 1, 60000, false, 0), 69000));
+  TEST_ASSERT_EQUAL_UINT32(0, table.getLinkStats().sequenceGaps);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_outcomes_and_dirty_mask);
+  RUN_TEST(test_duplicates_are_ignored);
+  RUN_TEST(test_slots);
+  RUN_TEST(test_link_statistics);
+  RUN_TEST(test_per_machine_counters);
+  RUN_TEST(test_restore);
+  return UNITY_END();
+}
@@ -0,0 +1,224 @@
+/*
+  WasherWatcher receiver unit tests
+  "test_spsc_queue/test_main.cpp"
+
+  SpscQueue on one thread, then with a real producer and consumer thread, lossless and overloaded.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <unity.h>
+#include <SpscQueue.h>
+
+namespace {
+  const size_t CAPACITY = 32;               // The receiver's FRAME_QUEUE_SIZE
+  const uint32_t LOSSLESS_FRAMES = 500000;  // Frames handed over by a producer that waits for room
+  const uint32_t LOSSY_FRAMES = 500000;     // Frames pushed by a producer that never waits, like the WiFi callback
+
+  // The same shape as the receiver's ReceivedFrame, with the sequence number in receivedMs
+  typedef struct {
+    uint8_t mac[6];
+    uint8_t length;
+    uint8_t data[250];
+    uint32_t receivedMs;
+    uint32_t receivedUs;
+  } Frame;
+
+  typedef SpscQueue<Frame, CAPACITY> Queue;
+
+  // Fills a frame from its sequence number, so the consumer can tell a torn or stale frame apart
+  void fill(Frame &frame, uint32_t sequence) {
+    frame.length = (uint8_t) (11 + sequence % 97);
+    memset(frame.mac, (uint8_t) sequence, sizeof(frame.mac));
+    memset(frame.data, (uint8_t) (sequence * 7), frame.length);
+    frame.receivedMs = sequence;
+    frame.receivedUs = ~sequence;
+  }
+
+  bool isWhole(const Frame &frame) {
+    uint32_t sequence = frame.receivedMs;
+    if (frame.receivedUs != ~sequence || frame.length != (uint8_t) (11 + sequence % 97) || frame.mac[5] != (uint8_t) sequence) { return false; }
+    for (size_t i = 0; i < frame.length; i++) {
+      if (frame.data[i] != (uint8_t) (sequence * 7)) { return false; }
+    }
+    return true;
+  }
+
+  // Waits for the other thread: yielding briefly, then sleeping, so the test also finishes on a single core
+  void backOff(uint32_t &waits) {
+    if (++waits < 64) { std::this_thread::yield(); }
+    else { std::this_thread::sleep_for(std::chrono::microseconds(20)); }
+  }
+
+  double secondsSince(std::chrono::steady_clock::time_point start) {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+  }
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+// FIFO order, a full queue refusing and counting pushes, and the high-water mark
+void test_fifo_and_full_queue(void) {
+  static Queue queue;
+  static Frame frame;
+  for (uint32_t i = 0; i < CAPACITY; i++) {
+    fill(frame, i);
+    TEST_ASSERT_TRUE(queue.tryPush(frame));
+  }
+  fill(frame, CAPACITY);
+  TEST_ASSERT_FALSE(queue.tryPush(frame));
+  TEST_ASSERT_NULL(queue.acquire());
+  TEST_ASSERT_EQUAL_UINT32(2, queue.getDroppedCount());
+  TEST_ASSERT_EQUAL_UINT32(CAPACITY, queue.getPushedCount());
+  TEST_ASSERT_EQUAL_UINT32(CAPACITY, queue.getHighWater());
+  TEST_ASSERT_EQUAL_UINT32(CAPACITY, queue.size());
+
+  for (uint32_t i = 0; i < CAPACITY; i++) {
+    TEST_ASSERT_TRUE(queue.tryPop(frame));
+    TEST_ASSERT_EQUAL_UINT32(i, frame.receivedMs);
+    TEST_ASSERT_TRUE(isWhole(frame));
+  }
+  TEST_ASSERT_FALSE(queue.tryPop(frame));
+  TEST_ASSERT_NULL(queue.front());
+}
+
+// acquire/publish and front/pop pass frames in place, many times around the ring
+void test_in_place_around_the_ring(void) {
+  static Queue queue;
+  for (uint32_t i = 0; i < CAPACITY * 100 + 3; i++) {
+    Frame *slot = queue.acquire();
+    TEST_ASSERT_NOT_NULL(slot);
+    fill(*slot, i);
+    TEST_ASSERT_EQUAL_UINT32(0, queue.size());       // Not visible until published
+    queue.publish();
+    Frame *oldest = queue.front();
+    TEST_ASSERT_TRUE(oldest == slot);
+    TEST_ASSERT_TRUE(isWhole(*oldest));
+    queue.pop();
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, queue.size());
+  TEST_ASSERT_EQUAL_UINT32(1, queue.getHighWater());
+  TEST_ASSERT_EQUAL_UINT32(0, queue.getDroppedCount());
+}
+
+/*
+  A producer that waits for room and a consumer on another thread: every frame arrives, whole and in order,
+  and the only drops counted are the producer's own refused attempts.
+*/
+void test_two_threads_lossless(void) {
+  static Queue queue;
+  std::atomic<bool> ordered{true};
+  std::atomic<uint32_t> received{0};
+  uint32_t refused = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  std::thread consumer([&]() {
+    uint32_t expected = 0, waits = 0;
+    bool inOrder = true;
+    while (expected < LOSSLESS_FRAMES) {
+      Frame *frame = queue.front();
+      if (frame == nullptr) {
+        backOff(waits);
+        continue;
+      }
+      waits = 0;
+      if (frame->receivedMs != expected || !isWhole(*frame)) { inOrder = false; }
+      queue.pop();
+      expected++;
+    }
+    ordered = inOrder;
+    received = expected;
+  });
+  uint32_t waits = 0;
+  for (uint32_t i = 0; i < LOSSLESS_FRAMES; i++) {
+    Frame *slot;
+    while ((slot = queue.acquire()) == nullptr) {
+      refused++;
+      backOff(waits);
+    }
+    waits = 0;
+    fill(*slot, i);
+    queue.publish();
+  }
+  consumer.join();
+  double seconds = secondsSince(start);
+
+  char message[128];
+  snprintf(message, sizeof(message), "%.1f M frames/s between two threads (%u byte frames, high water %u of %u)",
+           LOSSLESS_FRAMES / seconds / 1e6, (unsigned) sizeof(Frame), queue.getHighWater(), (unsigned) CAPACITY);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_EQUAL_UINT32(LOSSLESS_FRAMES, received.load());
+  TEST_ASSERT_TRUE(ordered);
+  TEST_ASSERT_EQUAL_UINT32(LOSSLESS_FRAMES, queue.getPushedCount());
+  TEST_ASSERT_EQUAL_UINT32(refused, queue.getDroppedCount());
+  TEST_ASSERT_EQUAL_UINT32(0, queue.size());
+  TEST_ASSERT_TRUE(queue.getHighWater() >= 1 && queue.getHighWater() <= CAPACITY);
+}
+
+/*
+  A producer that never waits, as the WiFi callback can't, against a slower consumer: frames that got in arrive
+  in order, and every frame is either received or counted as dropped.
+*/
+void test_two_threads_overloaded(void) {
+  static Queue queue;
+  std::atomic<bool> done{false};
+  std::atomic<bool> ordered{true};
+  std::atomic<uint32_t> received{0};
+  uint32_t refused = 0;
+
+  std::thread consumer([&]() {
+    uint32_t count = 0, last = 0, waits = 0;
+    bool inOrder = true;
+    Frame frame;
+    while (true) {
+      bool finished = done.load(std::memory_order_acquire);
+      if (!queue.tryPop(frame)) {
+        if (finished) { break; }
+        backOff(waits);
+        continue;
+      }
+      waits = 0;
+      if ((count > 0 && frame.receivedMs <= last) || !isWhole(frame)) { inOrder = false; }
+      last = frame.receivedMs;
+      count++;
+      for (volatile int spin = 0; spin < 200; spin = spin + 1) {}   // Handling the frame takes a while
+    }
+    ordered = inOrder;
+    received = count;
+  });
+  static Frame frame;
+  for (uint32_t i = 0; i < LOSSY_FRAMES; i++) {
+    fill(frame, i);
+    if (!queue.tryPush(frame)) { refused++; }
+    if ((i & 63) == 0) { std::this_thread::yield(); }    // Frames arrive in bursts, giving the worker a turn in between
+  }
+  done.store(true, std::memory_order_release);
+  consumer.join();
+
+  char message[96];
+  snprintf(message, sizeof(message), "%u of %u frames dropped, %u received", refused, (unsigned) LOSSY_FRAMES, received.load());
+  TEST_MESSAGE(message);
+  TEST_ASSERT_TRUE(ordered);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, received.load());
+  TEST_ASSERT_EQUAL_UINT32(LOSSY_FRAMES, received + refused);
+  TEST_ASSERT_EQUAL_UINT32(refused, queue.getDroppedCount());
+  TEST_ASSERT_EQUAL_UINT32(received.load(), queue.getPushedCount());
+  TEST_ASSERT_GREATER_THAN_UINT32(0, refused);
+  TEST_ASSERT_EQUAL_UINT32(CAPACITY, queue.getHighWater());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_fifo_and_full_queue);
+  RUN_TEST(test_in_place_around_the_ring);
+  RUN_TEST(test_two_threads_lossless);
+  RUN_TEST(test_two_threads_overloaded);
+  return UNITY_END();
+}
@@ -0,0 +1,202 @@
+"""
+  WasherWatcher LaundryReceiver build step
+  "embed_assets.py"
+
+  Minifies and gzips the website in data/ and writes it into include/WebAssets.h as PROGMEM
+  byte arrays with precomputed ETags, so the receiver can serve the site straight from flash.
+  External CDN links (nothing on the page uses them) are dropped so the site works without internet.
+
+  PlatformIO runs this automatically before every build (extra_scripts in platformio.ini).
+  It also runs on its own with any Python 3:
+    python3 tools/embed_assets.py           regenerate include/WebAssets.h
+    python3 tools/embed_assets.py --check   fail if include/WebAssets.h is out of date or doesn't round trip
+"""
+
+import gzip
+import hashlib
+import os
+import re
+import sys
+
+# PlatformIO runs extra scripts without __file__, so the project directory comes from its environment there
+try:
+    PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+except NameError:
+    Import("env")  # noqa: F821
+    PROJECT_DIR = env.subst("$PROJECT_DIR")  # noqa: F821
+DATA_DIR = os.path.join(PROJECT_DIR, "data")
+HEADER_PATH = os.path.join(PROJECT_DIR, "include", "WebAssets.h")
+
+# (file in data/, URL it is served at, content type, Cache-Control header)
+# index.html is always revalidated (cheap 304s); the files it links to get a version query and are cached for a year.
+ASSETS = [
+    ("index.html", "/", "text/html", "no-cache"),
+    ("style.css", "/style.css", "text/css", "public, max-age=31536000, immutable"),
+    ("script.js", "/script.js", "application/javascript", "public, max-age=31536000, immutable"),
+]
+
+
+# Removes <link> and <script> tags that load anything from another host
+def drop_external(html):
+    html = re.sub(r'\s*<link[^>]+href="(https?:)?//[^"]*"[^>]*>', "", html)
+    html = re.sub(r'\s*<script[^>]+src="(https?:)?//[^"]*"[^>]*>\s*</script>', "", html)
+    return html
+
+
+# Collapses whitespace runs to one space (spaces between inline tags are visible, so they can't be removed outright)
+def minify_html(html):
+    html = re.sub(r"<!--.*?-->", "", html, flags=re.S)
+    html = re.sub(r"\s+", " ", html)
+    return html.strip()
+
+
+def minify_css(css):
+    css = re.sub(r"/\*.*?\*/", "", css, flags=re.S)
+    css = re.sub(r"\s+", " ", css)
+    css = re.sub(r"\s*([{}:;,>])\s*", r"\1", css)
+    return css.replace(";}", "}").strip()
+
+
+# Only strips indentation, blank lines and whole-line comments; newlines are kept so automatic semicolons still work
+def minify_js(js):
+    lines = []
+    for line in js.splitlines():
+        line = line.strip()
+        if line and not line.startswith("//"):
+            lines.append(line)
+    return "\n".join(lines)
+
+
+# Points index.html at versioned style.css/script.js URLs, so their year-long cache is dropped when they change
+def version_links(html, etags):
+    for name, url, _, _ in ASSETS:
+        if name in etags and url != "/":
+            html = re.sub(r'(href|src)="%s"' % re.escape(name), r'\1="%s?v=%s"' % (name, etags[name]), html)
+    return html
+
+
+def read_text(name):
+    with open(os.path.join(DATA_DIR, name), encoding="utf-8") as f:
+        return f.read().replace("\r\n", "\n")
+
+
+# gzip with no file name and a fixed timestamp, so the same input always gives the same bytes
+def compress(text):
+    return gzip.compress(text.encode("utf-8"), 9, mtime=0)
+
+
+def etag_of(data):
+    return hashlib.sha256(data).hexdigest()[:16]
+
+
+# Returns [(name, url, content type, cache control, minified text, gzipped bytes, etag)], index.html last
+def build_assets():
+    built = {}
+    etags = {}
+    for name, url, content_type, cache in ASSETS:
+        if name == "index.html":
+            continue
+        text = minify_css(read_text(name)) if name.endswith(".css") else minify_js(read_text(name))
+        data = compress(text)
+        etags[name] = etag_of(data)
+        built[name] = (name, url, content_type, cache, text, data, etags[name])
+
+    html = minify_html(version_links(drop_external(read_text("index.html")), etags))
+    data = compress(html)
+    built["index.html"] = ("index.html", "/", "text/html", "no-cache", html, data, etag_of(data))
+    return [built[name] for name, _, _, _ in ASSETS]
+
+
+def c_identifier(name):
+    return re.sub(r"[^A-Za-z0-9]", "_", name).upper() + "_GZ"
+
+
+def render_header(assets):
+    out = []
+    out.append("/*")
+    out.append("  WasherWatcher LaundryReceiver code")
+    out.append('  "WebAssets.h"')
+    out.append("")
+    out.append("  GENERATED by tools/embed_assets.py from the files in data/. Do not edit by hand.")
+    out.append("  Each asset is stored gzipped in flash and served with Content-Encoding: gzip.")
+    out.append("*/")
+    out.append("")
+    out.append("#ifndef WEB_ASSETS_H")
+    out.append("#define WEB_ASSETS_H")
+    out.append("")
+    out.append("#include <Arduino.h>")
+    out.append("")
+    out.append("// One gzipped website file kept in flash")
+    out.append("typedef struct {")
+    out.append("  const char *url;")
+    out.append("  const char *contentType;")
+    out.append("  const char *cacheControl;")
+    out.append("  const char *etag;              // Quoted, ready to compare with If-None-Match")
+    out.append("  const uint8_t *data;")
+    out.append("  size_t length;")
+    out.append("} WebAsset;")
+    out.append("")
+
+    for name, url, content_type, cache, text, data, etag in assets:
+        out.append("// %s: %d bytes minified, %d bytes gzipped" % (name, len(text.encode("utf-8")), len(data)))
+        out.append("const uint8_t %s[] PROGMEM = {" % c_identifier(name))
+        for i in range(0, len(data), 16):
+            out.append("  " + ", ".join("0x%02x" % b for b in data[i:i + 16]) + ",")
+        out.append("};")
+        out.append("")
+
+    out.append("const WebAsset WEB_ASSETS[] = {")
+    for name, url, content_type, cache, text, data, etag in assets:
+        out.append('  { "%s", "%s", "%s", "\\"%s\\"", %s, sizeof(%s) },' % (url, content_type, cache, etag, c_identifier(name), c_identifier(name)))
+    out.append("};")
+    out.append("const size_t WEB_ASSET_COUNT = sizeof(WEB_ASSETS) / sizeof(WEB_ASSETS[0]);")
+    out.append("")
+    out.append("#endif")
+    out.append("")
+    return "\n".join(out)
+
+
+def read_header():
+    if not os.path.exists(HEADER_PATH):
+        return None
+    with open(HEADER_PATH, encoding="utf-8") as f:
+        return f.read().replace("\r\n", "\n")
+
+
+# Writes the header, leaving it untouched (and so not triggering a rebuild) when nothing changed
+def generate():
+    header = render_header(build_assets())
+    if read_header() == header:
+        return False
+    with open(HEADER_PATH, "w", encoding="utf-8", newline="\n") as f:
+        f.write(header)
+    return True
+
+
+# Verifies the committed header matches data/ and that every asset decompresses back to its minified text
+def check():
+    assets = build_assets()
+    ok = True
+    for name, url, content_type, cache, text, data, etag in assets:
+        if gzip.decompress(data).decode("utf-8") != text:
+            print("%s: gzip round trip failed" % name)
+            ok = False
+        if re.search(r'(href|src)="(https?:)?//', text):
+            print("%s: still references an external host" % name)
+            ok = False
+        raw = len(read_text(name).encode("utf-8"))
+        print("%-10s %5d -> %5d bytes (minified %d), ETag %s" % (name, raw, len(data), len(text.encode("utf-8")), etag))
+    if read_header() != render_header(assets):
+        print("include/WebAssets.h is out of date, run python3 tools/embed_assets.py")
+        ok = False
+    return ok
+
+
+if __name__ == "__main__":
+    if "--check" in sys.argv[1:]:
+        sys.exit(0 if check() else 1)
+    print("Updated include/WebAssets.h" if generate() else "include/WebAssets.h is up to date")
+else:
+    # Run by PlatformIO as a pre: extra script
+    if generate():
+        print("embed_assets: regenerated include/WebAssets.h")
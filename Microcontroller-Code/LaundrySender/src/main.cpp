@@ -8,45 +8,127 @@
   Code to be flashed onto each machine sensor microcontroller (ESP32).
   Each microcontroller is connected to an MPU-6050 accelerometer, which it uses to determine the status of the machine.
   Data is sent to LaundryReceiver microcontrollers (given in receiverMacAddress variable).
+  The board's name, receiver and channel can be changed over serial without reflashing (see SenderConfig.h),
+  and are kept in NVS along with the channel the receiver was last reached on, so a reboot doesn't need a WiFi scan.
 */
 
 #include <Arduino.h>
 #include <esp_now.h>
 #include <WiFi.h>
 #include <esp_wifi.h>
-#include <Adafruit_MPU6050.h>
+#include <Preferences.h>
 #include <Arduino_JSON.h>
-
-constexpr char WIFI_SSID[] = "UCAWIRELESS"; // String name of the WiFi network to connect to
-char BOARD_ID[] = "FARRIS_WASHER_2";        // String name of this board (aka the machine it is attached to)
-
-const unsigned long MEASUREDELAY = 400;     // Time between each sensor reading
+#include <MPU6050Fifo.h>
+#include <WireBus.h>
+#include <VibrationKernel.h>
+#include <SampleWindow.h>
+#include <SpectralDetector.h>
+#include <MachineDetector.h>
+#include <TransmitPolicy.h>
+#include <LaundryProtocol.h>
+#include <TraceFormat.h>
+#include <SenderConfig.h>
+#include <ChannelSearch.h>
+#include <DeliveryQueue.h>
+#include <PeriodicTimer.h>
+
+// Build with -D TRACE_MODE=1 to also stream every raw sample over serial for the trace recorder (see TraceFormat.h)
+#ifndef TRACE_MODE
+#define TRACE_MODE 0
+#endif
+
+constexpr char WIFI_SSID[] = "UCAWIRELESS"; // String name of the WiFi network the receiver is connected to
+char BOARD_ID[] = "FARRIS_WASHER_2";        // Default name of this board (aka the machine it is attached to), until one is provisioned
+const MachineType MACHINE_TYPE = MACHINE_WASHER; // Kind of machine this board is attached to
+
+const unsigned long MEASUREDELAY = 100;     // Time between each burst read of the sensor's sample FIFO
 const unsigned long EVALDELAY = 2000;       // Time between each determination of whether the machine is on or off
+const unsigned long STATSDELAY = 60000;     // Time between prints of how punctually the loop ran and how long it was awake
+const unsigned long HEARTBEATDELAY = 60000; // Time between repeats of an unchanged machine state
+const unsigned long MINSENDDELAY = 1000;    // Minimum time between two transmissions (limits flapping states)
+const unsigned long SENDJITTER = 5000;      // Max random delay added to each heartbeat so senders don't collide
+const unsigned long RETRYDELAY = 200;       // Backoff before resending an unacknowledged frame, doubling on each failure...
+const unsigned long MAXRETRYDELAY = 4000;   // ...up to this
+const uint8_t SEND_ATTEMPTS = 5;            // Sends of one frame before it is given up on (a newer frame replaces it sooner)
+const unsigned long ACKTIMEOUT = 500;       // A send whose outcome hasn't been reported by then counts as failed
+const uint16_t SAMPLE_RATE_HZ = 100;        // Rate the MPU6050 samples into its FIFO (holds 73 samples, so drain well within 730 ms)
+const uint8_t CHANNEL_TRIES = 2;            // Failed sends before an unconfirmed channel is given up on
+const uint8_t CHANNEL_LOST_FAILURES = 5;    // Failed sends in a row before a working channel is searched for again
+const uint32_t SCAN_MS_PER_CHANNEL = 120;   // Time the scan for the receiver's network spends on each channel
+constexpr char PREFERENCES_NAMESPACE[] = "washerwatcher";   // NVS namespace holding the SenderConfig record
+
+const size_t WINDOW_LENGTH = EVALDELAY * SAMPLE_RATE_HZ / 1000;   // Number of readings the sliding statistics window covers
+const unsigned long SERIAL_BAUD = TRACE_MODE ? 921600 : 115200;   // Traces need the faster port (about 1.3 KB/s at 100 Hz)
 
 /*
   Receiver microcontroller MAC Address. Notice that for ESP32 units, it can simply be the WiFi.macAddress() value 
   but for ESP8266 units, it needs to be the WiFi.softAPmacAddress() value. ESP32s can use either.
   This is probably due to the receiver being both an STA and soft AP unit, but I'm not sure.
+  This is the default; a provisioned board uses the address stored in its SenderConfig.
 */
 uint8_t receiverMacAddress[] = {0x94, 0xB9, 0x7E, 0xFA, 0x5A, 0x3D};
 
+SenderConfig senderConfig = {};             // Settings in use: from NVS, or the defaults above
+ChannelSearch channelSearch(CHANNEL_TRIES, CHANNEL_LOST_FAILURES);
+ProvisioningConsole console;
+volatile int8_t lastDelivery = -1;          // Outcome of the last send, set by onDataSent: 1 delivered, 0 failed, -1 handled
+volatile unsigned long lastDeliveryTime = 0; // millis() when that outcome was reported
+unsigned long firstDeliveryTime = 0;        // millis() when the receiver first acknowledged a frame (time to first packet)
+TaskHandle_t loopTask = NULL;               // Task running loop(), woken by onDataSent while it sleeps
+
 
-// Callback when data is sent over ESP-NOW
+// Callback when data is sent over ESP-NOW (runs in the WiFi task, so loop() acts on the outcome)
 void onDataSent(const uint8_t *mac_addr, esp_now_send_status_t status) {
   Serial.print("\r\nLast Packet Send Status:\t");
   Serial.println(status == ESP_NOW_SEND_SUCCESS ? "Delivery Success" : "Delivery Fail");
+  lastDeliveryTime = millis();
+  lastDelivery = (status == ESP_NOW_SEND_SUCCESS) ? 1 : 0;
+  if (loopTask != NULL) { xTaskNotifyGive(loopTask); }
 }
 
-// Used to ensure the sender and receiver are on the same WiFi channel
-int32_t getWiFiChannel(const char *ssid) {
-  if (int32_t n = WiFi.scanNetworks()) {
-    for (uint8_t i=0; i<n; i++) {
-      if (!strcmp(ssid, WiFi.SSID(i).c_str())) {
-        return WiFi.channel(i);
-      }
-    }
+// Loads the board's settings from NVS, keeping the built-in defaults if none were stored
+void loadConfig() {
+  strncpy(senderConfig.boardId, BOARD_ID, sizeof(senderConfig.boardId) - 1);
+  memcpy(senderConfig.receiverMac, receiverMacAddress, 6);
+  senderConfig.channel = 0;
+
+  uint8_t record[SenderConfigRecord::RECORD_BYTES];
+  size_t length = 0;
+  Preferences preferences;
+  if (preferences.begin(PREFERENCES_NAMESPACE, true)) {
+    length = preferences.getBytes("config", record, sizeof(record));
+    preferences.end();
   }
-  return 0;
+  bool stored = SenderConfigRecord::decode(record, length, senderConfig);
+  Serial.println(stored ? "Loaded the stored settings" : "No stored settings, using the defaults");
+}
+
+// Stores settings in NVS. Returns false if they couldn't be written.
+bool saveConfig(const SenderConfig &config) {
+  uint8_t record[SenderConfigRecord::RECORD_BYTES];
+  size_t length = SenderConfigRecord::encode(config, record, sizeof(record));
+
+  Preferences preferences;
+  if (!preferences.begin(PREFERENCES_NAMESPACE, false)) { return false; }
+  bool saved = preferences.putBytes("config", record, length) == length;
+  preferences.end();
+  return saved;
+}
+
+// Scans for the receiver's network alone and returns its channel, or 0 if it wasn't found.
+// Blocks for about 13 * SCAN_MS_PER_CHANNEL, which is why a stored channel is tried first.
+uint8_t scanForReceiver() {
+  int16_t found = WiFi.scanNetworks(false, false, false, SCAN_MS_PER_CHANNEL, 0, WIFI_SSID);
+  uint8_t channel = (found > 0) ? (uint8_t) WiFi.channel(0) : 0;
+  WiFi.scanDelete();
+  return channel;
+}
+
+// Moves the radio (and so ESP-NOW, whose peer follows the current channel) to a WiFi channel
+void tuneChannel(uint8_t channel) {
+  esp_wifi_set_promiscuous(true);
+  esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE);
+  esp_wifi_set_promiscuous(false);
 }
 
 // Helper function used to establish an ESP-NOW connection with the receiver safely
@@ -55,13 +137,14 @@ bool prepareEspNow() {
   // Set ESP32 as a Wi-Fi Station
   WiFi.mode(WIFI_STA);
 
-  // The following code ensures that the ESP-NOW connection doesn't have issues caused by channel conflicts
-  int32_t channel = getWiFiChannel(WIFI_SSID);
+  // ESP-NOW only reaches the receiver on its access point's channel: start on the stored one, or scan for it
+  channelSearch.begin(senderConfig.channel);
+  if (channelSearch.isScanDue()) {
+    channelSearch.setScanResult(scanForReceiver());
+  }
 
   WiFi.printDiag(Serial); // Print to verify channel number before
-  esp_wifi_set_promiscuous(true);
-  esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE);
-  esp_wifi_set_promiscuous(false);
+  tuneChannel(channelSearch.getChannel());
   WiFi.printDiag(Serial); // Print to verify channel change after
 
 
@@ -76,7 +159,7 @@ bool prepareEspNow() {
   
   // Register peer (the receiver microcontroller) to communicate with
   esp_now_peer_info_t peerInfo;
-  memcpy(peerInfo.peer_addr, receiverMacAddress, 6);
+  memcpy(peerInfo.peer_addr, senderConfig.receiverMac, 6);
   peerInfo.channel = 0;  
   peerInfo.encrypt = false;
   
@@ -89,70 +172,56 @@ bool prepareEspNow() {
   return true;
 }
 
-// Structure to send data. Must match the receiver structure
-typedef struct {
-  char id[32];
-  bool machineOn;
-} sensor_message;
-
-
-/************************** AccReadings Class ****************************
- * A class used to group the readings from the MPU 6050 together
- * Also allows us to average the 3-axes into a single reading
- *************************************************************************/
-class AccReadings {
-  private:
-    float accX;
-    float accY;
-    float accZ;
-
-  public:
-    AccReadings(float, float, float);
-    float getTotalAcc();
+/*
+  How the machine's state is decided. The detection code itself lives in the shared MachineDetector library,
+  so the TraceTools replay runs exactly what the board runs.
+*/
+const DetectorConfig DETECTOR_CONFIG = {
+  DETECT_SPECTRAL,    // Statistic used to decide whether the machine is on
+  MACHINE_TYPE,
+  SAMPLE_RATE_HZ,
+  WINDOW_LENGTH,
+  0.01,               // Mean mode: percent difference from the calibrated average
+  0.05,               // Variance mode: m/s^2 of standard deviation above the calibrated noise floor
+  6000,               // Vibration must last 6 s (3 evaluations) before the machine is reported on
+  90000,              // A washer pauses up to a minute between phases, so only 90 s of quiet means the cycle is over
+  0.5,                // Once on, a window only counts as quiet below half the threshold
+  0.02                // Each idle window moves the idle baseline 2% of the way (about a minute to settle)
 };
 
-// Constructor, given the 3-axes as floats
-AccReadings::AccReadings(float accX, float accY, float accZ) {
-  this->accX = accX;
-  this->accY = accY;
-  this->accZ = accZ;
-}
-
-// A method that returns a single average reading given the three axes data points
-float AccReadings::getTotalAcc() {
-  return sqrt(sq(accX) + sq(accY) + sq(accZ));
-}
-
-
 /***************** SensorUnit Class Definition *************************
  * This class defines all helpful methods and variables for the accelerometer,
- * keeping track of the running reading totals to calculate whatever average is needed
+ * feeding its readings to a MachineDetector that keeps the sliding window
  ************************************************************************/
 class SensorUnit {
   private:
-    const float STATUS_THRESHOLD_PERCENT = 0.01;
-    Adafruit_MPU6050 mpu;
-    sensors_event_t a, g, temp;
-    AccReadings getAccReadings();
-    float runningTotal = 0.0;
-    int totalReadings = 0;
-    float calibrationAccAvg = 0.0;
-    sensor_message currentMessageToSend;
+    WireBus bus;
+    MPU6050Fifo mpu{bus, []() -> uint32_t { return micros(); }};
+    RawSample burst[MPU6050Fifo::MAX_SAMPLES];  // Samples drained from the FIFO in the current burst
+    RawSample lastSample = {};
+    MachineDetector detector{DETECTOR_CONFIG};
+    FrameBuilder frameBuilder;                   // Batches each evaluation's feature summary into the next v2 frame
+    FeatureSummary summarizeWindow();
+    void traceBurst(size_t count);
 
   public:
-    bool isCalibrated = false;
+    bool isCalibrated() { return detector.isCalibrated(); }
     bool initMPU();
-    void addReading();
+    void addReadings();
     void calibrate();
     bool determineStatus();
+    MachinePhase getPhase();
     float getTemperature();
-    void setMessage(char[32]);
-    sensor_message getMsg();
+    float getBusMicrosPerSample();
+    void setBoardId(const char*);
+    uint8_t getStateCode();
+    size_t buildFrame(uint8_t*, size_t);
 };
 
-// Initialize the MPU6050 accelerometer. If unable to find it return false.
+// Initialize the MPU6050 accelerometer in FIFO mode on a fast I2C bus. If unable to find it return false.
 bool SensorUnit::initMPU() {
-  if (!mpu.begin()) {
+  bus.begin();
+  if (!mpu.begin(SAMPLE_RATE_HZ)) {
     Serial.println("Failed to find MPU6050 chip");
     return false;
   }
@@ -160,72 +229,91 @@ bool SensorUnit::initMPU() {
   return true;
 }
 
-// Helper method to add an accelerometer reading to the running total
-void SensorUnit::addReading() {
-  this->runningTotal += this->getAccReadings().getTotalAcc();
-  this->totalReadings++;
+// Helper method to drain every sample waiting in the MPU6050's FIFO into the detector's sliding window
+void SensorUnit::addReadings() {
+  size_t count = this->mpu.drain(this->burst, MPU6050Fifo::MAX_SAMPLES);
+  if (count == 0) { return; }
+
+  this->detector.addSamples(this->burst, count);
+  if (TRACE_MODE) { this->traceBurst(count); }
+
+  this->lastSample = this->burst[count - 1];
+}
+
+// Trace mode: writes the burst just drained to serial as a binary frame for the capture tool
+void SensorUnit::traceBurst(size_t count) {
+  TraceRecord records[MPU6050Fifo::MAX_SAMPLES];
+  for (size_t i = 0; i < count; i++) {
+    records[i] = {{this->burst[i].accX, this->burst[i].accY, this->burst[i].accZ},
+                  {this->burst[i].gyroX, this->burst[i].gyroY, this->burst[i].gyroZ}};
+  }
+
+  uint8_t frame[TraceFormat::MAX_SERIAL_FRAME_BYTES];
+  uint32_t firstIndex = this->mpu.getSampleCount() - count;
+  size_t length = TraceFormat::encodeSerialFrame(records, count, SAMPLE_RATE_HZ, firstIndex, micros(), frame, sizeof(frame));
+  Serial.write(frame, length);
 }
 
-// "Calibrates" the accelerometer, assuming it isn't moving. Results used to evaluate machine state.
+// "Calibrates" the accelerometer, assuming it isn't moving. Only the starting point: idle windows keep refining it.
 void SensorUnit::calibrate() {
-  if (totalReadings != 0)  { this->calibrationAccAvg = runningTotal / totalReadings; }
-  else { this->calibrationAccAvg = 0; }
+  this->detector.calibrate();
 
   Serial.print("Calibrated to ");
-  Serial.println(this->calibrationAccAvg);
-
-  this->runningTotal = 0.0;
-  this->totalReadings = 0;
-  this->isCalibrated = true;
+  Serial.print(this->detector.getCalibrationMean());
+  Serial.print(" +/- ");
+  Serial.println(this->detector.getCalibrationStdDev());
 }
 
-// Determines the state of the machine (on/off) by comparing it to the calibration baseline
+// Determines the state of the machine (on/off) by comparing the current window to the idle baseline
 bool SensorUnit::determineStatus() {
-  // Safely determine the current average
-  float currentAvg = 0;
-  if (this->totalReadings != 0) { 
-    currentAvg = this->runningTotal / this->totalReadings; 
-  }
-  
-  // Reset for next cycle
-  this->runningTotal = 0;
-  this->totalReadings = 0;
-
-  // Determine the percent difference between currentAvg and calibrationAvg
-  // Uses the equation %diff = |a - b| / ((a+b)/2) , where a and b are 2 numbers
-  double calcDifference = abs(currentAvg - this->calibrationAccAvg);
-  double calcAverage = (currentAvg + this->calibrationAccAvg) / 2.0;
-
-  if ((calcDifference / calcAverage) >= this->STATUS_THRESHOLD_PERCENT) {
-    this->currentMessageToSend.machineOn = true;
-    return true;
-  } else {
-    this->currentMessageToSend.machineOn = false;
-    return false;
-  }
+  bool machineOn = this->detector.evaluate(millis());
+  this->frameBuilder.addFeature(this->summarizeWindow());
+  return machineOn;
+}
+
+// Returns the cycle phase found by the last spectral evaluation (PHASE_IDLE in the other detection modes)
+MachinePhase SensorUnit::getPhase() {
+  return this->detector.getPhase();
+}
+
+// Compresses the current window's statistics into the fixed-point summary sent to the receiver
+FeatureSummary SensorUnit::summarizeWindow() {
+  SpectralBand band = (this->getPhase() == PHASE_SPIN) ? BAND_SPIN : BAND_LOW;
+  float peakDeciHz = this->detector.getSpectral().getPeakFrequency(band) * 10.0;
+  float meanCms2 = this->detector.windowMean() * 100.0;
+  float stdDevMms2 = this->detector.windowStdDev() * 1000.0;
+
+  FeatureSummary summary;
+  summary.phase = this->getPhase();
+  summary.peakFreqDeciHz = (peakDeciHz < 255.0) ? (uint8_t) (peakDeciHz + 0.5) : 255;
+  summary.meanCms2 = (meanCms2 < 65535.0) ? (uint16_t) (meanCms2 + 0.5) : 65535;
+  summary.stdDevMms2 = (stdDevMms2 < 65535.0) ? (uint16_t) (stdDevMms2 + 0.5) : 65535;
+  return summary;
 }
 
-// Sets the string message to send over ESP-NOW. Likely the machine's name.
-void SensorUnit::setMessage(char msg[]) {
-  strcpy(currentMessageToSend.id, msg);
+// Sets the board's name, which the receiver knows it by as a 16 bit machine id
+void SensorUnit::setBoardId(const char *boardId) {
+  this->frameBuilder.setMachineId(LaundryProtocol::machineIdFromName(boardId));
 }
 
-// Returns the message to send over ESP-NOW. Likely the machine's name.
-sensor_message SensorUnit::getMsg() {
-  return this->currentMessageToSend;
+// Returns the on/off status and cycle phase packed into the v2 frame's state byte
+uint8_t SensorUnit::getStateCode() {
+  return LaundryProtocol::stateCode(this->detector.isOn(), this->getPhase());
 }
 
-// Returns the current accelerometer readings in the form of the custom AccReadings object
-AccReadings SensorUnit::getAccReadings() {
-  mpu.getEvent(&a, &g, &temp);
-  // Save current acceleration values
-  return AccReadings(a.acceleration.x, a.acceleration.y, a.acceleration.z);
+// Encodes a v2 frame with the current state and every summary since the last one. Returns its length.
+size_t SensorUnit::buildFrame(uint8_t *frame, size_t capacity) {
+  return this->frameBuilder.build(millis(), this->getStateCode(), frame, capacity);
 }
 
-// Returns the current temperature provided by the sensor. Currently unused.
+// Returns the temperature from the most recent FIFO sample, so no extra bus transaction is needed. Currently unused.
 float SensorUnit::getTemperature() {
-  mpu.getEvent(&a, &g, &temp);
-  return temp.temperature;
+  return MPU6050Fifo::temperatureToC(this->lastSample.temperature);
+}
+
+// Returns the average I2C bus time spent per drained sample, in microseconds
+float SensorUnit::getBusMicrosPerSample() {
+  return this->mpu.getBusMicrosPerSample();
 }
 
 
@@ -235,9 +323,20 @@ float SensorUnit::getTemperature() {
  **************************************************************************/
 
 SensorUnit machineUnit = SensorUnit();
+TransmitPolicy transmitPolicy(HEARTBEATDELAY, MINSENDDELAY, SENDJITTER);
+DeliveryQueue deliveryQueue(RETRYDELAY, MAXRETRYDELAY, SEND_ATTEMPTS, ACKTIMEOUT);
+
+// Deadlines for the loop's periodic work (drain the sensor, evaluate the state, print the schedule's statistics)
+PeriodicTimer drainTimer(MEASUREDELAY * 1000);
+PeriodicTimer evaluationTimer(EVALDELAY * 1000);
+PeriodicTimer statsTimer(STATSDELAY * 1000);
+DutyCycleMeter dutyCycle;
 
 void setup() {
-  Serial.begin(115200);
+  Serial.begin(SERIAL_BAUD);
+
+  loadConfig();
+  console.begin(senderConfig);
 
   if (prepareEspNow() == false) { 
     Serial.println("ESP-Now failed to initialize, exiting setup now.");
@@ -249,55 +348,170 @@ void setup() {
     return;
   }
 
-  machineUnit.setMessage(BOARD_ID);
+  machineUnit.setBoardId(senderConfig.boardId);
+
+  // Seed the heartbeat jitter and the retry backoff from the chip's unique ID so every sender picks different delays
+  transmitPolicy.begin(millis(), (uint32_t) ESP.getEfuseMac());
+  deliveryQueue.begin((uint32_t) ESP.getEfuseMac() ^ 0x5DEECE66);
+
+  // Start the loop's schedule, which it sleeps between (setup() runs in the loop task)
+  loopTask = xTaskGetCurrentTaskHandle();
+  uint32_t nowMicros = micros();
+  drainTimer.start(nowMicros);
+  evaluationTimer.start(nowMicros);
+  statsTimer.start(nowMicros);
+  dutyCycle.begin(nowMicros);
 }
 
 /******************* Arduino Loop() Function ****************************
  * Runs Arduino's built-in loop() function, which repeats indefinitely while the microcontroller is powered.
- * Here, loop() takes measurement every MEASUREDELAY milliseconds and evaluates the state
- * of the machine based off these measurements every EVALDELAY milliseconds.
- * After determining the machine's status, it sends these results through ESP-NOW and resets.
+ * Here, loop() drains the sensor's sample FIFO every MEASUREDELAY milliseconds and evaluates the state
+ * of the machine based off these measurements every EVALDELAY milliseconds, sleeping in between (the FIFO
+ * keeps sampling at SAMPLE_RATE_HZ meanwhile). Deadlines are kept on a fixed grid, so they don't drift.
+ * The status is sent through ESP-NOW as soon as it changes, and otherwise repeated every HEARTBEATDELAY milliseconds.
+ * A frame that isn't acknowledged is resent with backoff until a newer one replaces it.
+ * Every send's acknowledgement steers the channel search, and serial input goes to the provisioning console.
  *************************************************************************/
 
-// Timer variables for use in the loop (determine when to read from the sensor and evaluate state)
-unsigned long lastMeasurementTime = 0;  
-unsigned long lastEvaluationTime = 0;
+// Acts on whether the last frame reached the receiver (as reported at reportedTime): schedules a retransmission if
+// it didn't, moves to another channel while the receiver hasn't been found, and stores the channel once it has
+void handleDelivery(bool delivered, unsigned long reportedTime) {
+  deliveryQueue.recordResult(delivered, reportedTime);
+  if (delivered && deliveryQueue.getLastAttempts() > 1) {
+    Serial.printf("Delivered after %u sends, %lu ms after it was queued\n", deliveryQueue.getLastAttempts(),
+                  (unsigned long) deliveryQueue.getLastLatencyMs());
+  }
+
+  bool retune = channelSearch.recordDelivery(delivered);
+  if (channelSearch.isScanDue()) {
+    channelSearch.setScanResult(scanForReceiver());
+    retune = true;
+  }
+  if (retune) {
+    tuneChannel(channelSearch.getChannel());
+    Serial.print("Looking for the receiver on channel ");
+    Serial.println(channelSearch.getChannel());
+  }
+
+  if (!delivered) {
+    // Once the queue gives up on the frame, send a new one soon rather than at the next heartbeat until the
+    // receiver is found (or every channel has been tried)
+    if (channelSearch.shouldRetrySoon() && !deliveryQueue.hasPending()) { transmitPolicy.retrySoon(); }
+    return;
+  }
+
+  if (firstDeliveryTime == 0) {
+    firstDeliveryTime = millis();
+    Serial.printf("Time to first packet: %lu ms, on channel %u (%s)\n", firstDeliveryTime, channelSearch.getChannel(),
+                  (channelSearch.wasCached() && channelSearch.getScans() == 0) ? "stored" : "searched");
+  }
+  if (senderConfig.channel != channelSearch.getChannel()) {
+    senderConfig.channel = channelSearch.getChannel();
+    Serial.println(saveConfig(senderConfig) ? "Stored the receiver's channel" : "Couldn't store the receiver's channel");
+  }
+}
+
+// Blocks the loop task until waitMicros have passed or onDataSent wakes it, so FreeRTOS can idle the CPU
+void idleFor(uint32_t waitMicros) {
+  TickType_t ticks = pdMS_TO_TICKS((waitMicros + 999) / 1000);
+  if (ticks > 0) { ulTaskNotifyTake(pdTRUE, ticks); }
+}
+
+// Prints how punctually the sensor was drained and how much of the time the loop was awake
+void printScheduleStats(uint32_t nowMicros) {
+  const TimerStats &drains = drainTimer.getStats();
+  uint32_t awakePermille = (uint32_t) (dutyCycle.getPercent(nowMicros) * 10 + 0.5);
+  Serial.printf("Drains: %lu, late by avg %lu us, max %lu us, %lu skipped; awake %lu.%lu%% of the time\n",
+                (unsigned long) drains.runs, (unsigned long) (drains.runs ? drains.lateSumMicros / drains.runs : 0),
+                (unsigned long) drains.lateMaxMicros, (unsigned long) drains.skipped,
+                (unsigned long) (awakePermille / 10), (unsigned long) (awakePermille % 10));
+}
+
+// Runs the provisioning commands typed on the serial console (see ProvisioningConsole)
+void readConsole() {
+  while (Serial.available() > 0) {
+    ProvisioningConsole::Action action = console.feed((char) Serial.read());
+    if (action == ProvisioningConsole::ACTION_NONE) { continue; }
+
+    Serial.println(console.getReply());
+    if (action == ProvisioningConsole::ACTION_SAVE) {
+      if (saveConfig(console.getConfig())) {
+        Serial.println("Saved, restarting");
+        Serial.flush();
+        ESP.restart();
+      }
+      Serial.println("Couldn't save the settings");
+    }
+  }
+}
 
 
 void loop() {
+  dutyCycle.wake(micros());
   unsigned long startingTime = millis();
 
-  // Take simple measurements and add to running average
-  if ((startingTime - lastMeasurementTime) > MEASUREDELAY) {
-    machineUnit.addReading();
-    lastMeasurementTime = millis();
+  readConsole();
+  if (lastDelivery >= 0) {
+    bool delivered = (lastDelivery == 1);
+    lastDelivery = -1;
+    handleDelivery(delivered, lastDeliveryTime);
+  }
+
+  // Drain the sensor's FIFO and add the samples to the sliding window
+  if (drainTimer.poll(micros())) {
+    machineUnit.addReadings();
   }
 
-  // Determine the machine's status and send the results via ESP-NOW
-  if ((startingTime - lastEvaluationTime) > EVALDELAY) {
+  // Determine the machine's status (due together with a drain, so the window is up to date)
+  if (evaluationTimer.poll(micros())) {
 
     // Ensure machine is calibrated before performing the first evaluation
-    if (machineUnit.isCalibrated) {
+    if (machineUnit.isCalibrated()) {
 
       machineUnit.determineStatus();
-
-      // Send message via ESP-NOW
-      sensor_message currentMsg = machineUnit.getMsg();
-      Serial.println(currentMsg.machineOn);
-      esp_err_t result = esp_now_send(receiverMacAddress, (uint8_t *) &currentMsg, sizeof(currentMsg));
-
-      if (result == ESP_OK) {
-        Serial.println("Sent with success");
-      }
-      else {
-        Serial.println("Error sending the data");
-      }
+      Serial.print("Bus time per sample (us): ");
+      Serial.println(machineUnit.getBusMicrosPerSample());
 
     } else {
       machineUnit.calibrate();
     }
-    
-    // Reset timer for next evaluation
-    lastEvaluationTime = millis();
+  }
+
+  // Queue the status when it changes, or when a heartbeat is due
+  uint8_t currentState = machineUnit.getStateCode();
+  if (machineUnit.isCalibrated() && transmitPolicy.isSendDue(startingTime, currentState)) {
+    uint8_t frame[LaundryProtocol::MAX_FRAME_BYTES];
+    size_t frameLength = machineUnit.buildFrame(frame, sizeof(frame));
+    deliveryQueue.push(frame, frameLength, startingTime);
+    transmitPolicy.recordSend(startingTime, currentState);
+  }
+
+  // Send the queued frame via ESP-NOW, or resend it if the last try wasn't acknowledged and its backoff is over
+  const uint8_t *dueFrame;
+  size_t dueLength = deliveryQueue.nextDue(millis(), dueFrame);
+  if (dueLength > 0) {
+    deliveryQueue.recordTransmit(millis());
+    esp_err_t result = esp_now_send(senderConfig.receiverMac, dueFrame, dueLength);
+
+    if (result == ESP_OK) {
+      Serial.println("Sent with success");
+    }
+    else {
+      Serial.println("Error sending the data");
+      deliveryQueue.recordResult(false, millis());
+    }
+  }
+
+  if (statsTimer.poll(micros())) { printScheduleStats(micros()); }
+
+  // Sleep until the next drain, evaluation or send (or resend) is due (heartbeats are checked on every wake-up)
+  uint32_t nowMicros = micros();
+  uint32_t waitMicros = drainTimer.untilDue(nowMicros);
+  if (evaluationTimer.untilDue(nowMicros) < waitMicros) { waitMicros = evaluationTimer.untilDue(nowMicros); }
+  uint32_t deliveryMs = deliveryQueue.untilDue(millis());
+  if (deliveryMs < waitMicros / 1000) { waitMicros = deliveryMs * 1000; }
+  if (lastDelivery < 0 && waitMicros > 0) {
+    dutyCycle.sleep(nowMicros);
+    idleFor(waitMicros);
   }
 }
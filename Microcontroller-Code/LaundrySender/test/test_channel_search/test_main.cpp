@@ -0,0 +1,163 @@
+/*
+  WasherWatcher sender unit tests
+  "test_channel_search/test_main.cpp"
+
+  ChannelSearch driven the way the sender's handleDelivery() drives it, against a receiver on a known channel.
+*/
+
+#include <stdio.h>
+
+#include <unity.h>
+#include <ChannelSearch.h>
+
+namespace {
+  // The ESP32 sender's settings
+  const uint8_t CHANNEL_TRIES = 2;
+  const uint8_t CHANNEL_LOST_FAILURES = 5;
+  const uint32_t MAX_SENDS = 200;
+
+  // How a search went
+  typedef struct {
+    uint32_t sends;       // Sends until the first acknowledged one, or MAX_SENDS if none was
+    uint32_t scans;
+    uint8_t channel;
+  } SearchResult;
+
+  /*
+    Sends until one is acknowledged, as handleDelivery() does: a send is delivered only on the receiver's channel,
+    a scan that is due is run at once and finds the receiver's network only if scanFinds is set.
+  */
+  SearchResult search(ChannelSearch &channels, uint8_t receiverChannel, bool scanFinds) {
+    SearchResult result = {0, 0, 0};
+    while (result.sends < MAX_SENDS) {
+      result.sends++;
+      bool delivered = channels.getChannel() == receiverChannel && !channels.isScanDue();
+      channels.recordDelivery(delivered);
+      if (delivered) { break; }
+      if (channels.isScanDue()) { channels.setScanResult(scanFinds ? receiverChannel : 0); }
+    }
+    result.scans = channels.getScans();
+    result.channel = channels.getChannel();
+    return result;
+  }
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+// A stored channel that still works is used straight away, without a scan
+void test_stored_channel_needs_no_scan(void) {
+  ChannelSearch channels(CHANNEL_TRIES, CHANNEL_LOST_FAILURES);
+  channels.begin(6);
+  SearchResult result = search(channels, 6, true);
+  TEST_ASSERT_EQUAL_UINT32(1, result.sends);
+  TEST_ASSERT_EQUAL_UINT32(0, result.scans);
+  TEST_ASSERT_TRUE(channels.isConfirmed());
+  TEST_ASSERT_TRUE(channels.wasCached());
+  TEST_ASSERT_FALSE(channels.shouldRetrySoon());
+}
+
+// Without a stored channel the first failed send scans, and the scan's channel is confirmed by the next send
+void test_no_stored_channel_scans(void) {
+  const uint8_t stored[] = {0, 14, 255};        // Never set, and out of range
+  for (uint8_t channel : stored) {
+    ChannelSearch channels(CHANNEL_TRIES, CHANNEL_LOST_FAILURES);
+    channels.begin(channel);
+    TEST_ASSERT_FALSE(channels.wasCached());
+    TEST_ASSERT_TRUE(channels.shouldRetrySoon());
+    SearchResult result = search(channels, 11, true);
+    TEST_ASSERT_EQUAL_UINT32(2, result.sends);
+    TEST_ASSERT_EQUAL_UINT32(1, result.scans);
+    TEST_ASSERT_EQUAL_UINT8(11, result.channel);
+  }
+}
+
+// A stale stored channel gets CHANNEL_TRIES sends before the scan
+void test_stale_channel_falls_back_to_scan(void) {
+  ChannelSearch channels(CHANNEL_TRIES, CHANNEL_LOST_FAILURES);
+  channels.begin(1);
+  SearchResult result = search(channels, 9, true);
+  TEST_ASSERT_EQUAL_UINT32(CHANNEL_TRIES + 1, result.sends);
+  TEST_ASSERT_EQUAL_UINT32(1, result.scans);
+  TEST_ASSERT_EQUAL_UINT8(9, result.channel);
+}
+
+// A channel the scan saw the network on gets CHANNEL_LOST_FAILURES sends, not CHANNEL_TRIES, so loss doesn't sweep it away
+void test_scanned_channel_survives_loss(void) {
+  ChannelSearch channels(CHANNEL_TRIES, CHANNEL_LOST_FAILURES);
+  channels.begin(0);
+  channels.recordDelivery(false);
+  TEST_ASSERT_TRUE(channels.isScanDue());
+  channels.setScanResult(6);
+
+  for (uint8_t i = 0; i < CHANNEL_LOST_FAILURES - 1; i++) { TEST_ASSERT_FALSE(channels.recordDelivery(false)); }
+  TEST_ASSERT_EQUAL_UINT8(6, channels.getChannel());
+  TEST_ASSERT_TRUE(channels.recordDelivery(false));
+  TEST_ASSERT_EQUAL_UINT8(7, channels.getChannel());
+}
+
+// A scan that can't see the network (a hidden SSID, a weak AP) steps through the channels until one is acknowledged
+void test_failed_scan_sweeps_every_channel(void) {
+  for (uint8_t receiver = 1; receiver <= ChannelSearch::MAX_CHANNEL; receiver++) {
+    for (uint8_t start = 0; start <= ChannelSearch::MAX_CHANNEL; start++) {
+      ChannelSearch channels(CHANNEL_TRIES, CHANNEL_LOST_FAILURES);
+      channels.begin(start);
+      SearchResult result = search(channels, receiver, false);
+      TEST_ASSERT_EQUAL_UINT8(receiver, result.channel);
+      TEST_ASSERT_TRUE(channels.isConfirmed());
+      TEST_ASSERT_EQUAL_UINT32((start == receiver) ? 0 : 1, result.scans);
+      TEST_ASSERT_LESS_OR_EQUAL_UINT32(CHANNEL_TRIES * (ChannelSearch::MAX_CHANNEL + 1) + 1, result.sends);
+    }
+  }
+}
+
+// Fast retries stop once a whole sweep found nothing, so a receiver that is off doesn't keep the sender on the air
+void test_retry_soon_stops_after_a_sweep(void) {
+  ChannelSearch channels(CHANNEL_TRIES, CHANNEL_LOST_FAILURES);
+  channels.begin(0);
+  uint32_t fastSends = 0;
+  for (uint32_t i = 0; i < MAX_SENDS && channels.shouldRetrySoon(); i++) {
+    channels.recordDelivery(false);
+    if (channels.isScanDue()) { channels.setScanResult(0); }
+    fastSends++;
+  }
+  TEST_ASSERT_FALSE(channels.shouldRetrySoon());
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(CHANNEL_TRIES * (ChannelSearch::MAX_CHANNEL + 1), fastSends);
+
+  TEST_ASSERT_FALSE(channels.recordDelivery(true));
+  TEST_ASSERT_TRUE(channels.isConfirmed());
+}
+
+// A confirmed channel survives a few lost frames, and is searched again after CHANNEL_LOST_FAILURES in a row
+void test_lost_channel_is_searched_again(void) {
+  ChannelSearch channels(CHANNEL_TRIES, CHANNEL_LOST_FAILURES);
+  channels.begin(3);
+  channels.recordDelivery(true);
+
+  for (uint8_t i = 0; i < CHANNEL_LOST_FAILURES - 1; i++) { TEST_ASSERT_FALSE(channels.recordDelivery(false)); }
+  TEST_ASSERT_TRUE(channels.isConfirmed());
+  channels.recordDelivery(true);
+  for (uint8_t i = 0; i < CHANNEL_LOST_FAILURES - 1; i++) { channels.recordDelivery(false); }
+  TEST_ASSERT_TRUE(channels.isConfirmed());         // A delivery in between starts the count again
+
+  channels.recordDelivery(false);
+  TEST_ASSERT_TRUE(channels.isScanDue());
+  TEST_ASSERT_TRUE(channels.shouldRetrySoon());
+  channels.setScanResult(7);
+  SearchResult result = search(channels, 7, true);
+  TEST_ASSERT_EQUAL_UINT32(1, result.sends);
+  TEST_ASSERT_EQUAL_UINT8(7, result.channel);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_stored_channel_needs_no_scan);
+  RUN_TEST(test_no_stored_channel_scans);
+  RUN_TEST(test_stale_channel_falls_back_to_scan);
+  RUN_TEST(test_scanned_channel_survives_loss);
+  RUN_TEST(test_failed_scan_sweeps_every_channel);
+  RUN_TEST(test_retry_soon_stops_after_a_sweep);
+  RUN_TEST(test_lost_channel_is_searched_again);
+  return UNITY_END();
+}
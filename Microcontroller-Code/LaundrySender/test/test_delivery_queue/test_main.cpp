@@ -0,0 +1,234 @@
+/*
+  WasherWatcher sender unit tests
+  "test_delivery_queue/test_main.cpp"
+
+  RetryBackoff's delays, and DeliveryQueue's retries, wake-up times, superseding and counters, alone and over a lossy link.
+*/
+
+#include <math.h>
+#include <stdio.h>
+
+#include <unity.h>
+#include <DeliveryQueue.h>
+
+namespace {
+  // The ESP32 sender's settings
+  const uint32_t RETRYDELAY = 200;
+  const uint32_t MAXRETRYDELAY = 4000;
+  const uint8_t SEND_ATTEMPTS = 5;
+  const uint32_t ACKTIMEOUT = 500;
+
+  const uint32_t HOUR_MS = 3600UL * 1000;
+  const uint32_t TICK_MS = 10;
+  const uint32_t FRAME_EVERY_MS = 1500;     // Far more often than a sender builds frames, so retries get superseded
+
+  uint32_t nextRandom(uint32_t &state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  // A one-byte stand-in for a frame, numbered so the receiving end can tell which it got
+  void pushNumbered(DeliveryQueue &queue, uint8_t number, uint32_t nowMs) {
+    queue.push(&number, 1, nowMs);
+  }
+
+  uint8_t dueNumber(DeliveryQueue &queue, uint32_t nowMs) {
+    const uint8_t *frame = NULL;
+    TEST_ASSERT_EQUAL_UINT32(1, queue.nextDue(nowMs, frame));
+    return frame[0];
+  }
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+// Each failure doubles the ceiling up to the maximum, the delay falls in its upper half, and reset() starts over
+void test_backoff_doubles_with_jitter(void) {
+  RetryBackoff backoff(RETRYDELAY, MAXRETRYDELAY);
+  const uint32_t ceilings[] = {200, 400, 800, 1600, 3200, 4000, 4000};
+  for (uint32_t ceiling : ceilings) {
+    RetryBackoff low = backoff, high = backoff;
+    TEST_ASSERT_EQUAL_UINT32(ceiling / 2, low.next(0));
+    TEST_ASSERT_EQUAL_UINT32(ceiling, high.next(ceiling / 2));
+    uint32_t random = ceiling;
+    uint32_t delay = backoff.next(nextRandom(random));
+    TEST_ASSERT_TRUE(delay >= ceiling / 2 && delay <= ceiling);
+  }
+  TEST_ASSERT_EQUAL_UINT32(7, backoff.getFailures());
+  backoff.reset();
+  TEST_ASSERT_EQUAL_UINT32(0, backoff.getFailures());
+  TEST_ASSERT_EQUAL_UINT32(RETRYDELAY, backoff.next(RETRYDELAY / 2));
+}
+
+// A frame acknowledged on its first send leaves the queue, with its latency counted
+void test_delivered_first_time(void) {
+  DeliveryQueue queue(RETRYDELAY, MAXRETRYDELAY, SEND_ATTEMPTS, ACKTIMEOUT);
+  queue.begin(1);
+  const uint8_t *frame = NULL;
+  TEST_ASSERT_EQUAL_UINT32(0, queue.nextDue(0, frame));
+
+  pushNumbered(queue, 1, 100);
+  TEST_ASSERT_EQUAL_UINT8(1, dueNumber(queue, 100));
+  queue.recordTransmit(100);
+  TEST_ASSERT_EQUAL_UINT32(0, queue.nextDue(110, frame));      // Nothing more is sent while one is on the air
+  TEST_ASSERT_TRUE(queue.recordResult(true, 112));
+  TEST_ASSERT_FALSE(queue.hasPending());
+  TEST_ASSERT_EQUAL_UINT32(12, queue.getLastLatencyMs());
+  TEST_ASSERT_EQUAL_UINT8(1, queue.getLastAttempts());
+  TEST_ASSERT_EQUAL_UINT32(1, queue.getStats().delivered);
+  TEST_ASSERT_EQUAL_UINT32(0, queue.getStats().retries);
+}
+
+// A frame that keeps failing is resent after the backoff, SEND_ATTEMPTS times in all, then given up on
+void test_retries_then_abandons(void) {
+  DeliveryQueue queue(RETRYDELAY, MAXRETRYDELAY, SEND_ATTEMPTS, ACKTIMEOUT);
+  queue.begin(7);
+  pushNumbered(queue, 1, 0);
+  uint32_t now = 0, lastSend = 0, sends = 0;
+  const uint8_t *frame = NULL;
+  for (; now < 60000 && queue.hasPending(); now++) {
+    if (queue.nextDue(now, frame) == 0) { continue; }
+    if (sends > 0) {
+      uint32_t ceiling = RETRYDELAY << (sends - 1);
+      TEST_ASSERT_TRUE(now - lastSend >= ceiling / 2 && now - lastSend <= ceiling);
+    }
+    queue.recordTransmit(now);
+    queue.recordResult(false, now);
+    lastSend = now;
+    sends++;
+  }
+  TEST_ASSERT_EQUAL_UINT32(SEND_ATTEMPTS, sends);
+  TEST_ASSERT_EQUAL_UINT32(SEND_ATTEMPTS, queue.getStats().transmissions);
+  TEST_ASSERT_EQUAL_UINT32(SEND_ATTEMPTS - 1, queue.getStats().retries);
+  TEST_ASSERT_EQUAL_UINT32(1, queue.getStats().abandoned);
+}
+
+// A send whose outcome never arrives counts as failed after ACKTIMEOUT
+void test_missing_outcome_times_out(void) {
+  DeliveryQueue queue(RETRYDELAY, MAXRETRYDELAY, SEND_ATTEMPTS, ACKTIMEOUT);
+  queue.begin(3);
+  pushNumbered(queue, 1, 0);
+  dueNumber(queue, 0);
+  queue.recordTransmit(0);
+  const uint8_t *frame = NULL;
+  TEST_ASSERT_EQUAL_UINT32(0, queue.nextDue(ACKTIMEOUT - 1, frame));
+  queue.nextDue(ACKTIMEOUT, frame);
+  TEST_ASSERT_EQUAL_UINT8(1, dueNumber(queue, ACKTIMEOUT + RETRYDELAY));
+  TEST_ASSERT_FALSE(queue.recordResult(true, ACKTIMEOUT + RETRYDELAY));    // A late outcome for a send already given up on
+}
+
+// untilDue() counts down to the frame's next send or resend, or to giving up on the outcome of the one on the air
+void test_until_due(void) {
+  DeliveryQueue queue(RETRYDELAY, MAXRETRYDELAY, SEND_ATTEMPTS, ACKTIMEOUT);
+  queue.begin(9);
+  const uint8_t *frame = NULL;
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, queue.untilDue(0));
+  pushNumbered(queue, 1, 100);
+  TEST_ASSERT_EQUAL_UINT32(0, queue.untilDue(100));
+  dueNumber(queue, 100);
+  queue.recordTransmit(100);
+  TEST_ASSERT_EQUAL_UINT32(ACKTIMEOUT - 50, queue.untilDue(150));
+  TEST_ASSERT_EQUAL_UINT32(0, queue.untilDue(100 + ACKTIMEOUT + 20));   // Overdue
+
+  queue.recordResult(false, 200);
+  uint32_t waitMs = queue.untilDue(200);
+  TEST_ASSERT_TRUE(waitMs >= RETRYDELAY / 2 && waitMs <= RETRYDELAY);
+  TEST_ASSERT_EQUAL_UINT32(0, queue.nextDue(200 + waitMs - 1, frame));
+  TEST_ASSERT_EQUAL_UINT8(1, dueNumber(queue, 200 + waitMs));
+  queue.recordTransmit(200 + waitMs);
+  queue.recordResult(true, 210 + waitMs);
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, queue.untilDue(210 + waitMs));
+}
+
+// A newer frame replaces one not yet sent, waits behind one on the air, and replaces that one too if it fails
+void test_newer_frame_supersedes(void) {
+  DeliveryQueue queue(RETRYDELAY, MAXRETRYDELAY, SEND_ATTEMPTS, ACKTIMEOUT);
+  queue.begin(5);
+  pushNumbered(queue, 1, 0);
+  pushNumbered(queue, 2, 0);
+  TEST_ASSERT_EQUAL_UINT8(2, dueNumber(queue, 0));
+  queue.recordTransmit(0);
+
+  pushNumbered(queue, 3, 5);
+  pushNumbered(queue, 4, 6);
+  queue.recordResult(false, 10);
+  TEST_ASSERT_EQUAL_UINT8(4, dueNumber(queue, 10));             // Sent at once, not after the backoff
+  queue.recordTransmit(10);
+  pushNumbered(queue, 5, 12);
+  TEST_ASSERT_TRUE(queue.recordResult(true, 15));
+  TEST_ASSERT_EQUAL_UINT8(5, dueNumber(queue, 15));             // A delivered frame's successor goes straight out
+  queue.recordTransmit(15);
+  queue.recordResult(true, 16);
+
+  const DeliveryStats &stats = queue.getStats();
+  TEST_ASSERT_EQUAL_UINT32(5, stats.queued);
+  TEST_ASSERT_EQUAL_UINT32(2, stats.delivered);
+  TEST_ASSERT_EQUAL_UINT32(3, stats.superseded);
+  TEST_ASSERT_FALSE(queue.hasPending());
+}
+
+/*
+  An hour of frames over a link that loses frames and acks alike. Every frame is accounted for, the receiving end
+  never sees an older frame after a newer one, the last frame always gets through, and a lost ack shows up there
+  as a duplicate.
+*/
+void test_lossy_link(void) {
+  const uint32_t lossPercents[] = {0, 10, 30};
+  for (uint32_t lossPercent : lossPercents) {
+    DeliveryQueue queue(RETRYDELAY, MAXRETRYDELAY, SEND_ATTEMPTS, ACKTIMEOUT);
+    queue.begin(11);
+    uint32_t random = 99, duplicates = 0, received = 0;
+    int32_t lastReceived = -1;
+    bool ordered = true;
+    uint8_t pushed = 0;
+    const uint8_t *frame = NULL;
+
+    for (uint32_t now = 0; now < HOUR_MS || queue.hasPending(); now += TICK_MS) {
+      if (now < HOUR_MS && now % FRAME_EVERY_MS == 0) { pushNumbered(queue, ++pushed, now); }
+      if (queue.nextDue(now, frame) == 0) { continue; }
+      queue.recordTransmit(now);
+      bool arrived = nextRandom(random) % 100 >= lossPercent;
+      bool acked = arrived && nextRandom(random) % 100 >= lossPercent;
+      if (arrived) {
+        int32_t number = frame[0];
+        if (number == lastReceived) { duplicates++; }
+        else if (lastReceived >= 0 && (uint8_t) (number - lastReceived) > 128) { ordered = false; }
+        else { received++; }
+        lastReceived = number;
+      }
+      queue.recordResult(acked, now + TICK_MS / 2);
+    }
+
+    const DeliveryStats &stats = queue.getStats();
+    char message[160];
+    snprintf(message, sizeof(message), "%u%% loss: %u frames, %u delivered, %u superseded, %u abandoned, %u retries, %u duplicates, worst %u ms",
+             lossPercent, stats.queued, stats.delivered, stats.superseded, stats.abandoned, stats.retries, duplicates, stats.latencyMaxMs);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_EQUAL_UINT32(stats.queued, stats.delivered + stats.superseded + stats.abandoned);
+    TEST_ASSERT_TRUE(ordered);
+    TEST_ASSERT_EQUAL_UINT8(pushed, lastReceived);
+    TEST_ASSERT_TRUE(received >= stats.delivered);
+    if (lossPercent == 0) { TEST_ASSERT_EQUAL_UINT32(0, stats.retries + duplicates + stats.abandoned); }
+    else {
+      // A send fails if either the frame or its ack is lost; a frame is only given up on after SEND_ATTEMPTS of those
+      double failure = 1 - (1 - lossPercent / 100.0) * (1 - lossPercent / 100.0);
+      TEST_ASSERT_TRUE(duplicates > 0 && stats.superseded > 0);
+      TEST_ASSERT_TRUE(stats.abandoned <= 2 * stats.queued * pow(failure, SEND_ATTEMPTS));
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_backoff_doubles_with_jitter);
+  RUN_TEST(test_delivered_first_time);
+  RUN_TEST(test_retries_then_abandons);
+  RUN_TEST(test_missing_outcome_times_out);
+  RUN_TEST(test_until_due);
+  RUN_TEST(test_newer_frame_supersedes);
+  RUN_TEST(test_lossy_link);
+  return UNITY_END();
+}
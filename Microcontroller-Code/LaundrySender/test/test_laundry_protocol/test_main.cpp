@@ -0,0 +1,257 @@
+/*
+  WasherWatcher sender unit tests
+  "test_laundry_protocol/test_main.cpp"
+
+  Round trips and malformed input for the v1 and v2 frame codec, plus the cost of a decode.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#include <unity.h>
+#include <LaundryProtocol.h>
+
+namespace {
+  const uint32_t RANDOM_FRAMES = 200000;    // Random v2 frames round tripped, and random byte strings decoded
+  const uint32_t DECODES = 2000000;         // Decodes timed per kind of frame
+
+  volatile uint32_t sink;   // Keeps the timed decodes from being optimized away
+
+  uint32_t nextRandom(uint32_t &state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  FeatureSummary randomFeature(uint32_t &random) {
+    uint32_t bits = nextRandom(random);
+    FeatureSummary feature = {(uint8_t) bits, (uint8_t) (bits >> 8), (uint16_t) (bits >> 16), (uint16_t) nextRandom(random)};
+    return feature;
+  }
+
+  void assertSameFeature(const FeatureSummary &expected, const FeatureSummary &actual) {
+    TEST_ASSERT_EQUAL_UINT8(expected.phase, actual.phase);
+    TEST_ASSERT_EQUAL_UINT8(expected.peakFreqDeciHz, actual.peakFreqDeciHz);
+    TEST_ASSERT_EQUAL_UINT16(expected.meanCms2, actual.meanCms2);
+    TEST_ASSERT_EQUAL_UINT16(expected.stdDevMms2, actual.stdDevMms2);
+  }
+
+  // A v1 frame the way old senders send it: the struct's bytes
+  size_t encodeV1(const char *name, bool machineOn, uint8_t *out) {
+    sensor_message message;
+    memset(&message, 0, sizeof(message));
+    snprintf(message.id, sizeof(message.id), "%s", name);
+    message.machineOn = machineOn;
+    memcpy(out, &message, sizeof(message));
+    return sizeof(message);
+  }
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+// Old senders' frames still decode, with the machine id derived from the name
+void test_v1_round_trip(void) {
+  uint8_t frame[LaundryProtocol::V1_FRAME_BYTES];
+  DecodedFrame decoded;
+  encodeV1("FARRIS_WASHER_2", true, frame);
+  TEST_ASSERT_TRUE(LaundryProtocol::decode(frame, sizeof(frame), decoded));
+  TEST_ASSERT_EQUAL_UINT8(1, decoded.version);
+  TEST_ASSERT_EQUAL_STRING("FARRIS_WASHER_2", decoded.name);
+  TEST_ASSERT_TRUE(decoded.machineOn);
+  TEST_ASSERT_EQUAL_UINT16(LaundryProtocol::machineIdFromName("FARRIS_WASHER_2"), decoded.machineId);
+  TEST_ASSERT_EQUAL_UINT8(0, decoded.featureCount);
+
+  encodeV1("0123456789012345678901234567890", false, frame);
+  TEST_ASSERT_TRUE(LaundryProtocol::decode(frame, sizeof(frame), decoded));
+  TEST_ASSERT_EQUAL_UINT32(31, strlen(decoded.name));
+  TEST_ASSERT_FALSE(decoded.machineOn);
+}
+
+// Random v2 frames of every feature count are 11 bytes plus 6 per summary, and come back field for field
+void test_v2_round_trip(void) {
+  uint32_t random = 3;
+  for (uint32_t i = 0; i < RANDOM_FRAMES; i++) {
+    FeatureSummary features[LaundryProtocol::MAX_FEATURES];
+    size_t count = i % (LaundryProtocol::MAX_FEATURES + 1);
+    for (size_t j = 0; j < count; j++) { features[j] = randomFeature(random); }
+    uint16_t machineId = nextRandom(random), sequence = nextRandom(random);
+    uint32_t uptimeMs = nextRandom(random);
+    uint8_t state = nextRandom(random);
+
+    uint8_t frame[LaundryProtocol::MAX_FRAME_BYTES];
+    size_t length = LaundryProtocol::encodeV2(machineId, sequence, uptimeMs, state, features, count, frame, sizeof(frame));
+    TEST_ASSERT_EQUAL_UINT32(LaundryProtocol::V2_HEADER_BYTES + count * LaundryProtocol::FEATURE_BYTES, length);
+
+    DecodedFrame decoded;
+    TEST_ASSERT_TRUE(LaundryProtocol::decode(frame, length, decoded));
+    TEST_ASSERT_EQUAL_UINT8(LaundryProtocol::VERSION_2, decoded.version);
+    TEST_ASSERT_EQUAL_UINT16(machineId, decoded.machineId);
+    TEST_ASSERT_EQUAL_UINT16(sequence, decoded.sequence);
+    TEST_ASSERT_EQUAL_UINT32(uptimeMs, decoded.uptimeMs);
+    TEST_ASSERT_EQUAL_UINT8(state, LaundryProtocol::stateCode(decoded.machineOn, decoded.phase));
+    TEST_ASSERT_EQUAL_UINT8(count, decoded.featureCount);
+    TEST_ASSERT_EQUAL_UINT8('\0', decoded.name[0]);
+    for (size_t j = 0; j < count; j++) { assertSameFeature(features[j], decoded.features[j]); }
+  }
+}
+
+// encodeV2() refuses a buffer that is too small and caps the batch at MAX_FEATURES, which fits one ESP-NOW packet
+void test_v2_encode_limits(void) {
+  uint8_t frame[LaundryProtocol::MAX_FRAME_BYTES];
+  FeatureSummary features[LaundryProtocol::MAX_FEATURES + 4] = {};
+  TEST_ASSERT_EQUAL_UINT32(0, LaundryProtocol::encodeV2(1, 2, 3, 4, features, 3, frame, LaundryProtocol::V2_HEADER_BYTES + 2 * LaundryProtocol::FEATURE_BYTES));
+  TEST_ASSERT_EQUAL_UINT32(LaundryProtocol::MAX_FRAME_BYTES, LaundryProtocol::encodeV2(1, 2, 3, 4, features, LaundryProtocol::MAX_FEATURES + 4, frame, sizeof(frame)));
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(250, LaundryProtocol::MAX_FRAME_BYTES);
+}
+
+// The builder batches the latest summaries, numbers its frames and empties the batch
+void test_frame_builder(void) {
+  FrameBuilder builder;
+  builder.setMachineId(0x1234);
+  uint32_t random = 8;
+  FeatureSummary added[LaundryProtocol::MAX_FEATURES + 4];
+  for (size_t i = 0; i < LaundryProtocol::MAX_FEATURES + 4; i++) {
+    added[i] = randomFeature(random);
+    builder.addFeature(added[i]);
+  }
+
+  uint8_t frame[LaundryProtocol::MAX_FRAME_BYTES];
+  DecodedFrame decoded;
+  size_t length = builder.build(1000, LaundryProtocol::stateCode(true, 2), frame, sizeof(frame));
+  TEST_ASSERT_TRUE(LaundryProtocol::decode(frame, length, decoded));
+  TEST_ASSERT_EQUAL_UINT8(LaundryProtocol::MAX_FEATURES, decoded.featureCount);
+  for (size_t i = 0; i < LaundryProtocol::MAX_FEATURES; i++) { assertSameFeature(added[i + 4], decoded.features[i]); }
+  TEST_ASSERT_EQUAL_UINT16(0x1234, decoded.machineId);
+  TEST_ASSERT_EQUAL_UINT16(0, decoded.sequence);
+  TEST_ASSERT_TRUE(decoded.machineOn);
+  TEST_ASSERT_EQUAL_UINT8(2, decoded.phase);
+
+  length = builder.build(3000, 0, frame, sizeof(frame));
+  TEST_ASSERT_TRUE(LaundryProtocol::decode(frame, length, decoded));
+  TEST_ASSERT_EQUAL_UINT8(0, decoded.featureCount);
+  TEST_ASSERT_EQUAL_UINT16(1, decoded.sequence);
+  TEST_ASSERT_EQUAL_UINT16(1, builder.getLastSequence());
+
+  FrameBuilder unbatched(0);
+  unbatched.addFeature(added[0]);
+  TEST_ASSERT_EQUAL_UINT32(LaundryProtocol::V2_HEADER_BYTES, unbatched.build(0, 0, frame, sizeof(frame)));
+}
+
+// Empty, truncated and padded frames, and feature counts that disagree with the length, are refused
+void test_malformed_v2_is_refused(void) {
+  uint32_t random = 13;
+  FeatureSummary features[LaundryProtocol::MAX_FEATURES];
+  for (size_t i = 0; i < LaundryProtocol::MAX_FEATURES; i++) { features[i] = randomFeature(random); }
+  uint8_t frame[LaundryProtocol::MAX_FRAME_BYTES + 8] = {};
+  DecodedFrame decoded;
+
+  TEST_ASSERT_FALSE(LaundryProtocol::decode(frame, 0, decoded));
+  for (size_t count = 0; count <= LaundryProtocol::MAX_FEATURES; count++) {
+    size_t length = LaundryProtocol::encodeV2(7, 8, 9, 0x81, features, count, frame, sizeof(frame));
+    for (size_t cut = 1; cut < length; cut++) { TEST_ASSERT_FALSE(LaundryProtocol::decode(frame, cut, decoded)); }
+    TEST_ASSERT_FALSE(LaundryProtocol::decode(frame, length + 1, decoded));
+  }
+
+  size_t length = LaundryProtocol::encodeV2(7, 8, 9, 0x81, features, 2, frame, sizeof(frame));
+  frame[10] = 3;
+  TEST_ASSERT_FALSE(LaundryProtocol::decode(frame, length, decoded));
+  frame[10] = LaundryProtocol::MAX_FEATURES + 1;
+  TEST_ASSERT_FALSE(LaundryProtocol::decode(frame, LaundryProtocol::V2_HEADER_BYTES + (LaundryProtocol::MAX_FEATURES + 1) * LaundryProtocol::FEATURE_BYTES, decoded));
+}
+
+// v1 frames of the wrong length or without a terminated id are refused
+void test_malformed_v1_is_refused(void) {
+  uint8_t v1[LaundryProtocol::V1_FRAME_BYTES + 1];
+  DecodedFrame decoded;
+  encodeV1("DRYER_1", true, v1);
+  TEST_ASSERT_FALSE(LaundryProtocol::decode(v1, sizeof(v1) - 2, decoded));
+  TEST_ASSERT_FALSE(LaundryProtocol::decode(v1, sizeof(v1), decoded));
+  memset(v1, 'A', sizeof(v1));
+  TEST_ASSERT_FALSE(LaundryProtocol::decode(v1, LaundryProtocol::V1_FRAME_BYTES, decoded));
+}
+
+// A 33 byte frame whose first byte no sender uses is an unknown version, not a v1 frame, even with a terminated id
+void test_unknown_version_is_refused(void) {
+  uint8_t frame[LaundryProtocol::V1_FRAME_BYTES];
+  DecodedFrame decoded;
+  for (uint32_t first = 0; first < 256; first++) {
+    if (first == LaundryProtocol::VERSION_2) { continue; }
+    encodeV1("WASHER_1", false, frame);
+    frame[0] = (uint8_t) first;
+    bool printable = first >= ' ' && first <= '~';
+    TEST_ASSERT_EQUAL(printable, LaundryProtocol::decode(frame, sizeof(frame), decoded));
+  }
+}
+
+// Whatever random bytes decode to, a v2 frame that decodes encodes back to the same bytes
+void test_random_bytes_decode_canonically(void) {
+  uint32_t random = 21;
+  uint8_t frame[LaundryProtocol::MAX_FRAME_BYTES + 8];
+  DecodedFrame decoded;
+  uint32_t accepted = 0;
+  for (uint32_t i = 0; i < RANDOM_FRAMES; i++) {
+    size_t randomLength = nextRandom(random) % sizeof(frame);
+    for (size_t j = 0; j < randomLength; j++) { frame[j] = nextRandom(random); }
+    if (i % 2) {
+      frame[0] = LaundryProtocol::VERSION_2;
+      if (randomLength > 10) { frame[10] = (randomLength - LaundryProtocol::V2_HEADER_BYTES) / LaundryProtocol::FEATURE_BYTES; }
+    }
+    if (!LaundryProtocol::decode(frame, randomLength, decoded) || decoded.version != LaundryProtocol::VERSION_2) { continue; }
+    accepted++;
+    uint8_t again[LaundryProtocol::MAX_FRAME_BYTES];
+    size_t againLength = LaundryProtocol::encodeV2(decoded.machineId, decoded.sequence, decoded.uptimeMs,
+                                                   LaundryProtocol::stateCode(decoded.machineOn, decoded.phase),
+                                                   decoded.features, decoded.featureCount, again, sizeof(again));
+    TEST_ASSERT_EQUAL_UINT32(randomLength, againLength);
+    TEST_ASSERT_EQUAL_MEMORY(frame, again, randomLength);
+  }
+  TEST_ASSERT_GREATER_THAN_UINT32(0, accepted);
+}
+
+// Time to decode one frame of each kind
+void test_decode_cost(void) {
+  FeatureSummary features[LaundryProtocol::MAX_FEATURES] = {};
+  uint8_t bare[LaundryProtocol::MAX_FRAME_BYTES], full[LaundryProtocol::MAX_FRAME_BYTES], v1[LaundryProtocol::V1_FRAME_BYTES];
+  size_t bareLength = LaundryProtocol::encodeV2(1, 2, 3, 4, features, 0, bare, sizeof(bare));
+  size_t fullLength = LaundryProtocol::encodeV2(1, 2, 3, 4, features, LaundryProtocol::MAX_FEATURES, full, sizeof(full));
+  encodeV1("FARRIS_WASHER_2", true, v1);
+
+  const uint8_t *frames[] = {bare, full, v1};
+  const size_t lengths[] = {bareLength, fullLength, sizeof(v1)};
+  double nanos[3];
+  DecodedFrame decoded;
+  for (int kind = 0; kind < 3; kind++) {
+    uint32_t total = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < DECODES; i++) {
+      total += LaundryProtocol::decode(frames[kind], lengths[kind], decoded);
+      total += decoded.sequence;
+      sink = total;
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    nanos[kind] = elapsed.count() / DECODES;
+  }
+
+  char message[128];
+  snprintf(message, sizeof(message), "decode() %.1f ns for a bare v2 header, %.1f ns with 16 summaries, %.1f ns for v1",
+           nanos[0], nanos[1], nanos[2]);
+  TEST_MESSAGE(message);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_v1_round_trip);
+  RUN_TEST(test_v2_round_trip);
+  RUN_TEST(test_v2_encode_limits);
+  RUN_TEST(test_frame_builder);
+  RUN_TEST(test_malformed_v2_is_refused);
+  RUN_TEST(test_malformed_v1_is_refused);
+  RUN_TEST(test_unknown_version_is_refused);
+  RUN_TEST(test_random_bytes_decode_canonically);
+  RUN_TEST(test_decode_cost);
+  return UNITY_END();
+}
@@ -0,0 +1,224 @@
+/*
+  WasherWatcher sender unit tests
+  "test_machine_detector/test_main.cpp"
+
+  MachineDetector's debouncing state machine and idle baseline, fed raw accelerometer windows on a simulated clock.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <random>
+
+#include <unity.h>
+#include <MachineDetector.h>
+
+namespace {
+  // The ESP32 sender's timings
+  const uint16_t SAMPLE_RATE_HZ = 100;
+  const uint32_t EVALDELAY = 2000;
+  const size_t WINDOW_LENGTH = EVALDELAY * SAMPLE_RATE_HZ / 1000;
+  const uint32_t START_DWELL_MS = 6000;
+  const uint32_t STOP_DWELL_MS = 90000;
+  const float THRESHOLD_STDDEV = 0.05;
+
+  const float NOISE = 0.02;                     // m/s^2 of sensor noise on an idle machine
+
+  // The sender's config, in the given mode
+  DetectorConfig makeConfig(DetectionMode mode, float baselineAlpha) {
+    return {mode, MACHINE_WASHER, SAMPLE_RATE_HZ, WINDOW_LENGTH, 0.01, THRESHOLD_STDDEV,
+            START_DWELL_MS, STOP_DWELL_MS, 0.5, baselineAlpha};
+  }
+
+  /*
+    A detector on a simulated clock. Every evaluate() first feeds it one EVALDELAY of raw samples from a sensor
+    lying flat on a machine whose drum shakes it at frequencyHz (amplitude 0 for an idle machine).
+  */
+  class Bench {
+    public:
+      explicit Bench(const DetectorConfig &config) : detector(config), random(3) {}
+
+      void calibrate(float frequencyHz, float amplitude) {
+        feed(frequencyHz, amplitude);
+        detector.calibrate();
+      }
+
+      bool evaluate(float frequencyHz, float amplitude) {
+        feed(frequencyHz, amplitude);
+        nowMs += EVALDELAY;
+        return detector.evaluate(nowMs);
+      }
+
+      // Evaluates for at least durationMs, returning whether the machine was reported on at any point
+      bool run(uint32_t durationMs, float frequencyHz, float amplitude) {
+        bool everOn = false;
+        for (uint32_t elapsed = 0; elapsed < durationMs; elapsed += EVALDELAY) { everOn |= evaluate(frequencyHz, amplitude); }
+        return everOn;
+      }
+
+      MachineDetector detector;
+      uint32_t nowMs = 0;
+
+    private:
+      std::mt19937 random;
+      uint32_t sampleIndex = 0;       // Keeps the drum's phase continuous from window to window
+
+      void feed(float frequencyHz, float amplitude) {
+        const float LSB_PER_MS2 = 1 / MPU6050Fifo::accelToMs2(1);
+        std::normal_distribution<float> noise(0.0, NOISE);
+        int16_t x[WINDOW_LENGTH], y[WINDOW_LENGTH], z[WINDOW_LENGTH];
+        for (size_t n = 0; n < WINDOW_LENGTH; n++, sampleIndex++) {
+          float vertical = 9.80665 + noise(random) + amplitude * sinf(2 * M_PI * frequencyHz * sampleIndex / SAMPLE_RATE_HZ);
+          x[n] = (int16_t) lroundf(noise(random) * LSB_PER_MS2);
+          y[n] = (int16_t) lroundf(noise(random) * LSB_PER_MS2);
+          z[n] = (int16_t) lroundf(vertical * LSB_PER_MS2);
+        }
+        detector.addSamples(x, y, z, WINDOW_LENGTH);
+      }
+  };
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+// A drum has to keep going for the start dwell before the machine is reported on, in either mode
+void test_start_needs_dwell(void) {
+  const DetectionMode modes[] = {DETECT_VARIANCE, DETECT_SPECTRAL};
+  for (DetectionMode mode : modes) {
+    Bench bench(makeConfig(mode, 0.02));
+    bench.calibrate(0, 0);
+    TEST_ASSERT_FALSE(bench.run(60000, 0, 0));
+
+    TEST_ASSERT_FALSE(bench.evaluate(1.0, 0.4));
+    TEST_ASSERT_EQUAL_UINT8(DETECTOR_STARTING, bench.detector.getState());
+    TEST_ASSERT_FALSE(bench.run(START_DWELL_MS - EVALDELAY, 1.0, 0.4));
+    TEST_ASSERT_TRUE(bench.evaluate(1.0, 0.4));
+    TEST_ASSERT_EQUAL_UINT8(DETECTOR_RUNNING, bench.detector.getState());
+  }
+}
+
+// A single shaking window (a bump, a door slammed) goes back to idle without ever being reported
+void test_bump_is_not_a_start(void) {
+  Bench bench(makeConfig(DETECT_VARIANCE, 0.02));
+  bench.calibrate(0, 0);
+  TEST_ASSERT_FALSE(bench.evaluate(3.0, 1.0));
+  TEST_ASSERT_EQUAL_UINT8(DETECTOR_STARTING, bench.detector.getState());
+  TEST_ASSERT_FALSE(bench.evaluate(0, 0));
+  TEST_ASSERT_EQUAL_UINT8(DETECTOR_IDLE, bench.detector.getState());
+}
+
+// A pause between phases shorter than the stop dwell keeps the machine on; only a longer quiet turns it off
+void test_pause_within_stop_dwell(void) {
+  Bench bench(makeConfig(DETECT_SPECTRAL, 0.02));
+  bench.calibrate(0, 0);
+  bench.run(60000, 1.0, 0.4);
+  TEST_ASSERT_TRUE(bench.detector.isOn());
+  TEST_ASSERT_EQUAL_UINT8(PHASE_WASH, bench.detector.getPhase());
+
+  bench.run(60000, 0, 0);
+  TEST_ASSERT_TRUE(bench.detector.isOn());
+  TEST_ASSERT_EQUAL_UINT8(DETECTOR_STOPPING, bench.detector.getState());
+  TEST_ASSERT_TRUE(bench.evaluate(1.0, 0.4));
+  TEST_ASSERT_EQUAL_UINT8(DETECTOR_RUNNING, bench.detector.getState());
+
+  TEST_ASSERT_TRUE(bench.run(STOP_DWELL_MS, 0, 0));
+  TEST_ASSERT_TRUE(bench.detector.isOn());
+  TEST_ASSERT_FALSE(bench.evaluate(0, 0));
+  TEST_ASSERT_EQUAL_UINT8(DETECTOR_IDLE, bench.detector.getState());
+  TEST_ASSERT_EQUAL_UINT8(PHASE_IDLE, bench.detector.getPhase());
+}
+
+// Once on, a window under the threshold but above exitFraction of it still counts as running
+void test_hysteresis_once_on(void) {
+  const float amplitude = 0.075;            // About 0.7 of the threshold above the noise floor
+  Bench idle(makeConfig(DETECT_VARIANCE, 0.02));
+  idle.calibrate(0, 0);
+  TEST_ASSERT_FALSE(idle.evaluate(2.0, amplitude));
+  TEST_ASSERT_FALSE(idle.detector.wasWindowActive());
+
+  Bench running(makeConfig(DETECT_VARIANCE, 0.02));
+  running.calibrate(0, 0);
+  running.run(30000, 2.0, 0.5);
+  TEST_ASSERT_TRUE(running.detector.isOn());
+  running.run(STOP_DWELL_MS * 2, 2.0, amplitude);
+  TEST_ASSERT_EQUAL_UINT8(DETECTOR_RUNNING, running.detector.getState());
+  TEST_ASSERT_TRUE(running.detector.wasWindowActive());
+}
+
+/*
+  A sender that booted mid-cycle calibrates on a running machine. With the baseline frozen (alpha 0, the old
+  one-shot calibration) it never sees a cycle again; with it adapting, quiet windows pull the baseline down to
+  the real floor and the next cycle is reported.
+*/
+void test_boot_mid_cycle_recovers(void) {
+  const DetectionMode modes[] = {DETECT_VARIANCE, DETECT_SPECTRAL};
+  for (DetectionMode mode : modes) {
+    for (float alpha : {0.0f, 0.02f}) {
+      Bench bench(makeConfig(mode, alpha));
+      bench.calibrate(1.0, 0.8);
+      bench.run(5UL * 60 * 1000, 1.0, 0.8);
+      TEST_ASSERT_FALSE(bench.detector.isOn());
+      bench.run(10UL * 60 * 1000, 0, 0);
+
+      bool detected = bench.run(10UL * 60 * 1000, 1.0, 0.4);
+      TEST_ASSERT_EQUAL(alpha > 0, detected);
+      if (alpha > 0) { TEST_ASSERT_FLOAT_WITHIN(NOISE, NOISE, bench.detector.getCalibrationStdDev()); }
+    }
+  }
+}
+
+// The baseline follows a noise floor that creeps up while idle, without reporting the machine on
+void test_baseline_follows_rising_floor(void) {
+  Bench bench(makeConfig(DETECT_VARIANCE, 0.02));
+  bench.calibrate(0, 0);
+  float before = bench.detector.getCalibrationStdDev();
+  bool everOn = false;
+  for (uint32_t minute = 0; minute < 60; minute++) {
+    everOn |= bench.run(60000, 7.0, 0.002 * minute);      // Someone's dryer next door, slowly getting louder
+  }
+  TEST_ASSERT_FALSE(everOn);
+  TEST_ASSERT_TRUE(bench.detector.getCalibrationStdDev() > before + THRESHOLD_STDDEV);
+}
+
+/*
+  The window is kept in integer LSB and only scaled when read. Its mean, std dev and peak-to-peak stay within one
+  LSB of the float path it replaced: sqrtf of each reading, converted to m/s^2, then averaged.
+*/
+void test_window_matches_float_path(void) {
+  const float LSB_MS2 = MPU6050Fifo::accelMs2PerLsb();
+  std::mt19937 random(11);
+  std::normal_distribution<float> shake(0.0, 1500);
+  for (int run = 0; run < 50; run++) {
+    MachineDetector detector(makeConfig(DETECT_VARIANCE, 0.02));
+    int16_t x[WINDOW_LENGTH], y[WINDOW_LENGTH], z[WINDOW_LENGTH];
+    double sum = 0, squares = 0, low = 1e9, high = 0;
+    for (size_t n = 0; n < WINDOW_LENGTH; n++) {
+      x[n] = (int16_t) lroundf(shake(random) * run / 50);
+      y[n] = (int16_t) lroundf(shake(random) * run / 50);
+      z[n] = (int16_t) lroundf(8192 + shake(random) * run / 50);
+      float magnitude = MPU6050Fifo::accelToMs2(1) * sqrtf((float) x[n] * x[n] + (float) y[n] * y[n] + (float) z[n] * z[n]);
+      sum += magnitude;
+      squares += (double) magnitude * magnitude;
+      low = fmin(low, magnitude);
+      high = fmax(high, magnitude);
+    }
+    detector.addSamples(x, y, z, WINDOW_LENGTH);
+
+    double mean = sum / WINDOW_LENGTH;
+    TEST_ASSERT_FLOAT_WITHIN(LSB_MS2, mean, detector.windowMean());
+    TEST_ASSERT_FLOAT_WITHIN(LSB_MS2, sqrt(fmax(0, squares / WINDOW_LENGTH - mean * mean)), detector.windowStdDev());
+    TEST_ASSERT_FLOAT_WITHIN(LSB_MS2, high - low, detector.getWindow().peakToPeak() * LSB_MS2);
+  }
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_start_needs_dwell);
+  RUN_TEST(test_bump_is_not_a_start);
+  RUN_TEST(test_pause_within_stop_dwell);
+  RUN_TEST(test_hysteresis_once_on);
+  RUN_TEST(test_boot_mid_cycle_recovers);
+  RUN_TEST(test_baseline_follows_rising_floor);
+  RUN_TEST(test_window_matches_float_path);
+  return UNITY_END();
+}
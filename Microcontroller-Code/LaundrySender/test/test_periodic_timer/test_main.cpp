@@ -0,0 +1,89 @@
+/*
+  WasherWatcher sender unit tests
+  "test_periodic_timer/test_main.cpp"
+
+  PeriodicTimer's deadlines against late and missed runs and micros() wrapping, and DutyCycleMeter's awake share.
+*/
+
+#include <stdio.h>
+
+#include <unity.h>
+#include <PeriodicTimer.h>
+
+namespace {
+  const uint32_t PERIOD_MICROS = 100000;    // The sender's FIFO drain
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+// A run that starts late doesn't push the next deadline back, and lateness and intervals are recorded
+void test_late_runs_do_not_drift(void) {
+  PeriodicTimer timer(PERIOD_MICROS);
+  timer.start(0);
+  TEST_ASSERT_FALSE(timer.poll(PERIOD_MICROS - 1));
+  TEST_ASSERT_EQUAL_UINT32(1, timer.untilDue(PERIOD_MICROS - 1));
+  TEST_ASSERT_TRUE(timer.poll(PERIOD_MICROS + 30000));
+  TEST_ASSERT_FALSE(timer.poll(PERIOD_MICROS + 30001));
+  TEST_ASSERT_EQUAL_UINT32(70000, timer.untilDue(PERIOD_MICROS + 30000));
+  TEST_ASSERT_TRUE(timer.poll(2 * PERIOD_MICROS));
+
+  for (uint32_t n = 3; n <= 1000; n++) { TEST_ASSERT_TRUE(timer.poll(n * PERIOD_MICROS + (n % 7) * 1000)); }
+  const TimerStats &stats = timer.getStats();
+  TEST_ASSERT_EQUAL_UINT32(1000, stats.runs);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.skipped);
+  TEST_ASSERT_EQUAL_UINT32(30000, stats.lateMaxMicros);
+  TEST_ASSERT_EQUAL_UINT32(70000, stats.intervalMinMicros);
+  TEST_ASSERT_EQUAL_UINT32(1000 * PERIOD_MICROS + 6000 - (PERIOD_MICROS + 30000), (uint32_t) stats.intervalSumMicros);
+}
+
+// A run more than a period late skips the periods it missed instead of running back to back to catch up
+void test_missed_periods_are_skipped(void) {
+  PeriodicTimer timer(PERIOD_MICROS);
+  timer.start(0);
+  TEST_ASSERT_TRUE(timer.poll(3 * PERIOD_MICROS + 500));
+  TEST_ASSERT_EQUAL_UINT32(2, timer.getStats().skipped);
+  TEST_ASSERT_EQUAL_UINT32(500, timer.getStats().lateMaxMicros);
+  TEST_ASSERT_FALSE(timer.poll(3 * PERIOD_MICROS + 600));
+  TEST_ASSERT_EQUAL_UINT32(PERIOD_MICROS - 500, timer.untilDue(3 * PERIOD_MICROS + 500));
+  TEST_ASSERT_TRUE(timer.poll(4 * PERIOD_MICROS));
+}
+
+// Deadlines keep their spacing across micros() wrapping, about every 71.6 minutes
+void test_micros_wrap(void) {
+  PeriodicTimer timer(PERIOD_MICROS);
+  uint32_t start = 0xFFFFFFFF - 250000;
+  timer.start(start);
+  for (uint32_t n = 1; n <= 5; n++) {
+    TEST_ASSERT_FALSE(timer.poll(start + n * PERIOD_MICROS - 1));
+    TEST_ASSERT_TRUE(timer.poll(start + n * PERIOD_MICROS));
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, timer.getStats().skipped);
+  TEST_ASSERT_EQUAL_UINT32(PERIOD_MICROS, timer.getStats().intervalMaxMicros);
+}
+
+// The awake share counts from each wake() to the next sleep(), and a wake() without a sleep() in between changes nothing
+void test_duty_cycle(void) {
+  DutyCycleMeter meter;
+  meter.begin(0);
+  for (uint32_t n = 0; n < 100; n++) {
+    uint32_t wakeMicros = n * PERIOD_MICROS;
+    meter.wake(wakeMicros);
+    meter.wake(wakeMicros + 1000);
+    meter.sleep(wakeMicros + 5000);
+  }
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 5.0, meter.getPercent(100 * PERIOD_MICROS));
+
+  meter.wake(100 * PERIOD_MICROS);                        // Still awake a period later
+  TEST_ASSERT_FLOAT_WITHIN(0.01, (100 * 5.0 + 100) / 101, meter.getPercent(101 * PERIOD_MICROS));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_late_runs_do_not_drift);
+  RUN_TEST(test_missed_periods_are_skipped);
+  RUN_TEST(test_micros_wrap);
+  RUN_TEST(test_duty_cycle);
+  return UNITY_END();
+}
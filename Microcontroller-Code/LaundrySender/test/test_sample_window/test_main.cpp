@@ -0,0 +1,208 @@
+/*
+  WasherWatcher sender unit tests
+  "test_sample_window/test_main.cpp"
+
+  SampleWindow against a brute-force recompute of the same samples, plus the cost of keeping it current.
+  Samples are raw sensor LSB, as the sender's magnitudes are.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <chrono>
+#include <deque>
+#include <random>
+#include <vector>
+
+#include <unity.h>
+#include <SampleWindow.h>
+
+namespace {
+  const size_t CAPACITY = 256;
+  const size_t STREAM_SAMPLES = 20000;    // Samples checked per window length
+  const uint32_t TIMED_SAMPLES = 2000000;
+  const size_t TIMED_LENGTH = 200;        // A 2 s window at 100 Hz
+  const double MAX_ERROR_LSB = 0.01;      // The sums are exact, so only the final float conversion may round
+
+  typedef SampleWindow<CAPACITY> Window;
+
+  double nanosSince(std::chrono::steady_clock::time_point start, uint32_t count) {
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / count;
+  }
+
+  // Magnitudes in LSB the way a sender sees them (8192 is 1 g): an idle machine's noise, then a drum shaking, and back
+  std::vector<int32_t> makeStream(size_t count, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::normal_distribution<float> noise(0.0, 25);
+    std::vector<int32_t> stream;
+    for (size_t i = 0; i < count; i++) {
+      bool running = (i / 3000) % 2 == 1;
+      float sample = 8192 + noise(random);
+      if (running) { sample += 1250 * sinf(i * 0.16) + 5 * noise(random); }
+      stream.push_back((int32_t) lroundf(sample));
+    }
+    return stream;
+  }
+
+  // Statistics of a window recomputed from scratch in double precision
+  typedef struct {
+    double mean, variance, rms, min, max;
+  } Exact;
+
+  Exact recompute(const std::deque<int32_t> &samples) {
+    Exact exact = {0, 0, 0, (double) samples.front(), (double) samples.front()};
+    for (int32_t sample : samples) {
+      exact.mean += sample;
+      exact.rms += (double) sample * sample;
+      if (sample < exact.min) { exact.min = sample; }
+      if (sample > exact.max) { exact.max = sample; }
+    }
+    exact.mean /= samples.size();
+    exact.rms = sqrt(exact.rms / samples.size());
+    for (int32_t sample : samples) { exact.variance += (sample - exact.mean) * (sample - exact.mean); }
+    exact.variance /= samples.size();
+    return exact;
+  }
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+/*
+  Feeds a stream through windows of several lengths, comparing every statistic with a recompute of the
+  same samples after every add. The extremes must be exact, and the rest may only differ by float rounding.
+*/
+void test_statistics_match_recompute(void) {
+  std::vector<int32_t> stream = makeStream(STREAM_SAMPLES, 1);
+  const size_t lengths[] = {1, 2, 7, 64, 200, CAPACITY};
+  double worstMean = 0, worstStdDev = 0, worstRms = 0;
+
+  for (size_t length : lengths) {
+    static Window window;
+    TEST_ASSERT_TRUE(window.setLength(length));
+    std::deque<int32_t> samples;
+    for (int32_t sample : stream) {
+      window.add(sample);
+      samples.push_back(sample);
+      if (samples.size() > length) { samples.pop_front(); }
+
+      Exact exact = recompute(samples);
+      worstMean = fmax(worstMean, fabs(window.mean() - exact.mean));
+      worstStdDev = fmax(worstStdDev, fabs(window.stdDev() - sqrt(exact.variance)));
+      worstRms = fmax(worstRms, fabs(window.rms() - exact.rms));
+      size_t n = samples.size();
+      if (n > 1) { TEST_ASSERT_FLOAT_WITHIN(1e-6 * window.sampleVariance(), window.variance() * n / (n - 1), window.sampleVariance()); }
+      TEST_ASSERT_EQUAL_INT(exact.min, window.min());
+      TEST_ASSERT_EQUAL_INT(exact.max, window.max());
+      TEST_ASSERT_EQUAL_INT(exact.max - exact.min, window.peakToPeak());
+      TEST_ASSERT_EQUAL_UINT32(n, window.count());
+      TEST_ASSERT_EQUAL_INT(sample, window.latest());
+    }
+  }
+
+  char message[128];
+  snprintf(message, sizeof(message), "worst error in sensor LSB: mean %.4f, std dev %.4f, RMS %.4f", worstMean, worstStdDev, worstRms);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_TRUE(worstMean < MAX_ERROR_LSB);
+  TEST_ASSERT_TRUE(worstStdDev < MAX_ERROR_LSB);
+  TEST_ASSERT_TRUE(worstRms < MAX_ERROR_LSB);
+}
+
+// A full window holds only the last `length` samples
+void test_full_window_slides(void) {
+  static Window window(10);
+  for (int i = 0; i < 25; i++) { window.add(i); }
+  TEST_ASSERT_TRUE(window.isFull());
+  TEST_ASSERT_EQUAL_UINT32(10, window.count());
+  TEST_ASSERT_EQUAL_INT(15, window.min());
+  TEST_ASSERT_EQUAL_INT(24, window.max());
+  TEST_ASSERT_FLOAT_WITHIN(1e-5, 19.5, window.mean());
+}
+
+// setLength() and clear() start the statistics over, and bad lengths are refused
+void test_length_changes_clear(void) {
+  static Window window(10);
+  for (int i = 0; i < 25; i++) { window.add(i); }
+  TEST_ASSERT_FALSE(window.setLength(0));
+  TEST_ASSERT_FALSE(window.setLength(CAPACITY + 1));
+  TEST_ASSERT_EQUAL_UINT32(10, window.getLength());
+
+  TEST_ASSERT_TRUE(window.setLength(4));
+  TEST_ASSERT_EQUAL_UINT32(0, window.count());
+  TEST_ASSERT_TRUE(window.mean() == 0 && window.stdDev() == 0 && window.latest() == 0);
+
+  window.add(3);
+  TEST_ASSERT_TRUE(window.mean() == 3 && window.variance() == 0 && window.sampleVariance() == 0);
+  window.clear();
+  TEST_ASSERT_EQUAL_UINT32(0, window.count());
+  TEST_ASSERT_EQUAL_UINT32(4, window.getLength());
+}
+
+// copyTo() hands out the window oldest first and scaled, before and after it wraps
+void test_copy_to_is_chronological(void) {
+  static Window window(7);
+  float copy[CAPACITY];
+  for (int i = 0; i < 20; i++) {
+    window.add(i);
+    size_t copied = window.copyTo(copy, 0.5);
+    TEST_ASSERT_EQUAL_UINT32(window.count(), copied);
+    for (size_t j = 0; j < copied; j++) { TEST_ASSERT_FLOAT_WITHIN(0, 0.5 * (i + 1 - (int) copied + (int) j), copy[j]); }
+  }
+}
+
+// The exact sums hold the largest magnitudes the sensor can produce without overflowing
+void test_full_scale_samples(void) {
+  static Window window(CAPACITY);
+  for (size_t i = 0; i < 3 * CAPACITY; i++) { window.add((i % 2) ? 65535 : 0); }
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 32767.5, window.mean());
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 32767.5, window.stdDev());
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 65535 / sqrtf(2), window.rms());
+  TEST_ASSERT_EQUAL_INT(65535, window.peakToPeak());
+}
+
+// Cost of add() with the statistics kept current, against recomputing the window's mean and spread for every sample
+void test_add_is_cheaper_than_recompute(void) {
+  std::vector<int32_t> stream = makeStream(1 << 16, 2);
+  static Window window(TIMED_LENGTH);
+  volatile float sink = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < TIMED_SAMPLES; i++) {
+    window.add(stream[i & 0xFFFF]);
+  }
+  sink = window.stdDev() + window.max();
+  double addNs = nanosSince(start, TIMED_SAMPLES);
+
+  std::deque<int32_t> samples;
+  const uint32_t recomputed = TIMED_SAMPLES / 20;
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < recomputed; i++) {
+    samples.push_back(stream[i & 0xFFFF]);
+    if (samples.size() > TIMED_LENGTH) { samples.pop_front(); }
+    float sum = 0, squares = 0;
+    for (int32_t sample : samples) { sum += sample; }
+    float mean = sum / samples.size();
+    for (int32_t sample : samples) { squares += (sample - mean) * (sample - mean); }
+    sink = sink + squares;
+  }
+  double recomputeNs = nanosSince(start, recomputed);
+  (void) sink;
+
+  char message[128];
+  snprintf(message, sizeof(message), "add() %.1f ns per sample, recomputing mean and variance %.1f ns (length %u)",
+           addNs, recomputeNs, (unsigned) TIMED_LENGTH);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_TRUE(addNs < recomputeNs);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_statistics_match_recompute);
+  RUN_TEST(test_full_window_slides);
+  RUN_TEST(test_length_changes_clear);
+  RUN_TEST(test_copy_to_is_chronological);
+  RUN_TEST(test_full_scale_samples);
+  RUN_TEST(test_add_is_cheaper_than_recompute);
+  return UNITY_END();
+}
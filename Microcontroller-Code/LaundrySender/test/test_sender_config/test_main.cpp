@@ -0,0 +1,142 @@
+/*
+  WasherWatcher sender unit tests
+  "test_sender_config/test_main.cpp"
+
+  The stored settings record against corruption, and the serial provisioning console's commands.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include <unity.h>
+#include <SenderConfig.h>
+
+namespace {
+  const SenderConfig SAMPLE = {"FARRIS_WASHER_3", {0xA4, 0xCF, 0x12, 0x0B, 0x7E, 0x01}, 11};
+
+  void assertSameConfig(const SenderConfig &expected, const SenderConfig &actual) {
+    TEST_ASSERT_EQUAL_STRING(expected.boardId, actual.boardId);
+    TEST_ASSERT_EQUAL_MEMORY(expected.receiverMac, actual.receiverMac, 6);
+    TEST_ASSERT_EQUAL_UINT8(expected.channel, actual.channel);
+  }
+
+  // Feeds a whole line to the console, returning what it asked the firmware to do
+  ProvisioningConsole::Action type(ProvisioningConsole &console, const char *line) {
+    for (const char *c = line; *c; c++) { TEST_ASSERT_EQUAL(ProvisioningConsole::ACTION_NONE, console.feed(*c)); }
+    ProvisioningConsole::Action action = console.feed('\r');
+    TEST_ASSERT_EQUAL(ProvisioningConsole::ACTION_NONE, console.feed('\n'));
+    return action;
+  }
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+// A record decodes to what was encoded, including a name of the full 31 characters
+void test_record_round_trip(void) {
+  uint8_t record[SenderConfigRecord::RECORD_BYTES + 8];
+  SenderConfig decoded = {};
+  TEST_ASSERT_EQUAL_UINT32(SenderConfigRecord::RECORD_BYTES, SenderConfigRecord::encode(SAMPLE, record, sizeof(record)));
+  TEST_ASSERT_TRUE(SenderConfigRecord::decode(record, sizeof(record), decoded));
+  assertSameConfig(SAMPLE, decoded);
+
+  SenderConfig longName = SAMPLE;
+  memset(longName.boardId, 'N', sizeof(longName.boardId));     // Not terminated: only the first 31 are kept
+  SenderConfigRecord::encode(longName, record, sizeof(record));
+  TEST_ASSERT_TRUE(SenderConfigRecord::decode(record, SenderConfigRecord::RECORD_BYTES, decoded));
+  TEST_ASSERT_EQUAL_UINT32(sizeof(decoded.boardId) - 1, strlen(decoded.boardId));
+
+  TEST_ASSERT_EQUAL_UINT32(0, SenderConfigRecord::encode(SAMPLE, record, SenderConfigRecord::RECORD_BYTES - 1));
+}
+
+// Every single-bit flip, a short read, another version and erased flash are refused, leaving the defaults alone
+void test_corrupt_records_are_refused(void) {
+  uint8_t record[SenderConfigRecord::RECORD_BYTES];
+  SenderConfigRecord::encode(SAMPLE, record, sizeof(record));
+  SenderConfig untouched = {"DEFAULT", {1, 2, 3, 4, 5, 6}, 0};
+
+  for (size_t bit = 0; bit < sizeof(record) * 8; bit++) {
+    uint8_t flipped[sizeof(record)];
+    memcpy(flipped, record, sizeof(record));
+    flipped[bit / 8] ^= (uint8_t) (1 << (bit % 8));
+    SenderConfig decoded = untouched;
+    TEST_ASSERT_FALSE(SenderConfigRecord::decode(flipped, sizeof(flipped), decoded));
+    assertSameConfig(untouched, decoded);
+  }
+
+  SenderConfig decoded = untouched;
+  TEST_ASSERT_FALSE(SenderConfigRecord::decode(record, sizeof(record) - 1, decoded));
+  uint8_t erased[sizeof(record)];
+  memset(erased, 0xFF, sizeof(erased));
+  TEST_ASSERT_FALSE(SenderConfigRecord::decode(erased, sizeof(erased), decoded));
+  memset(erased, 0, sizeof(erased));
+  TEST_ASSERT_FALSE(SenderConfigRecord::decode(erased, sizeof(erased), decoded));
+  assertSameConfig(untouched, decoded);
+}
+
+// MAC addresses in either case are parsed; anything else is refused without touching the output
+void test_parse_mac(void) {
+  uint8_t mac[6] = {9, 9, 9, 9, 9, 9};
+  const uint8_t expected[6] = {0xA4, 0xCF, 0x12, 0x0B, 0x7E, 0x01};
+  TEST_ASSERT_TRUE(SenderConfigRecord::parseMac("a4:CF:12:0b:7e:1", mac));
+  TEST_ASSERT_EQUAL_MEMORY(expected, mac, 6);
+
+  const char *bad[] = {"", "A4:CF:12:0B:7E", "A4:CF:12:0B:7E:01:", "A4:CF:12:0B:7E:01:02", "A4-CF-12-0B-7E-01",
+                       "A4:CF:12:0B:7E:100", "G4:CF:12:0B:7E:01", "A4::12:0B:7E:01"};
+  for (const char *text : bad) {
+    TEST_ASSERT_FALSE_MESSAGE(SenderConfigRecord::parseMac(text, mac), text);
+    TEST_ASSERT_EQUAL_MEMORY(expected, mac, 6);
+  }
+}
+
+// Each command edits the copy and echoes it, bad arguments are explained, and save asks for a restart
+void test_console_commands(void) {
+  ProvisioningConsole console;
+  console.begin(SAMPLE);
+
+  TEST_ASSERT_EQUAL(ProvisioningConsole::ACTION_REPLY, type(console, "id   FARRIS_DRYER_1"));
+  TEST_ASSERT_EQUAL(ProvisioningConsole::ACTION_REPLY, type(console, "receiver 24:0A:C4:00:00:2F"));
+  TEST_ASSERT_EQUAL(ProvisioningConsole::ACTION_REPLY, type(console, "channel 0"));
+  TEST_ASSERT_EQUAL_STRING("id=FARRIS_DRYER_1 receiver=24:0A:C4:00:00:2F channel=0", console.getReply());
+
+  type(console, "channel 14");
+  TEST_ASSERT_EQUAL_STRING("channel must be 0-13", console.getReply());
+  type(console, "receiver nonsense");
+  TEST_ASSERT_EQUAL_STRING("receiver must look like AA:BB:CC:DD:EE:FF", console.getReply());
+  type(console, "id ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456");
+  TEST_ASSERT_EQUAL_STRING("id is limited to 31 characters", console.getReply());
+  type(console, "reboot now");
+  TEST_ASSERT_EQUAL_STRING("unknown command \"reboot\"", console.getReply());
+  type(console, "id");
+  TEST_ASSERT_EQUAL_STRING("commands: id NAME, receiver MAC, channel N, show, save", console.getReply());
+  TEST_ASSERT_EQUAL_STRING("FARRIS_DRYER_1", console.getConfig().boardId);
+  TEST_ASSERT_EQUAL_UINT8(0, console.getConfig().channel);
+
+  TEST_ASSERT_EQUAL(ProvisioningConsole::ACTION_SAVE, type(console, "save"));
+  TEST_ASSERT_EQUAL_STRING("id=FARRIS_DRYER_1 receiver=24:0A:C4:00:00:2F channel=0", console.getReply());
+}
+
+// A line longer than the console keeps is refused as a whole, and the next line works again
+void test_console_overlong_line(void) {
+  ProvisioningConsole console;
+  console.begin(SAMPLE);
+  char line[200];
+  snprintf(line, sizeof(line), "id %0150d", 7);
+  TEST_ASSERT_EQUAL(ProvisioningConsole::ACTION_REPLY, type(console, line));
+  TEST_ASSERT_EQUAL_STRING("line too long", console.getReply());
+  TEST_ASSERT_EQUAL_STRING(SAMPLE.boardId, console.getConfig().boardId);
+
+  TEST_ASSERT_EQUAL(ProvisioningConsole::ACTION_REPLY, type(console, "show"));
+  TEST_ASSERT_EQUAL_STRING("id=FARRIS_WASHER_3 receiver=A4:CF:12:0B:7E:01 channel=11", console.getReply());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_record_round_trip);
+  RUN_TEST(test_corrupt_records_are_refused);
+  RUN_TEST(test_parse_mac);
+  RUN_TEST(test_console_commands);
+  RUN_TEST(test_console_overlong_line);
+  return UNITY_END();
+}
@@ -0,0 +1,196 @@
+/*
+  WasherWatcher sender unit tests
+  "test_spectral_detector/test_main.cpp"
+
+  The Goertzel bank against a direct DFT, and the phases it classifies from synthetic drum vibration.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include <unity.h>
+#include <SpectralDetector.h>
+
+namespace {
+  const float SAMPLE_RATE_HZ = 100;
+  const size_t WINDOW_LENGTH = 200;       // A 2 s window, so bins are 0.5 Hz apart
+  const float GRAVITY = 9.81;
+  const float NOISE = 0.02;               // m/s^2 of sensor noise on an idle machine
+  const uint32_t TIMED_WINDOWS = 2000;
+
+  std::mt19937 random(1);
+
+  // One window of magnitudes in m/s^2: gravity, sensor noise and a drum turning at frequencyHz (none at 0)
+  std::vector<float> makeWindow(float frequencyHz, float amplitude) {
+    std::normal_distribution<float> noise(0.0, NOISE);
+    std::vector<float> window;
+    for (size_t n = 0; n < WINDOW_LENGTH; n++) {
+      window.push_back(GRAVITY + noise(random) + amplitude * sinf(2 * M_PI * frequencyHz * n / SAMPLE_RATE_HZ));
+    }
+    return window;
+  }
+
+  // Energy of the bins in [firstBin, lastBin] by a direct DFT of the mean-removed window, normalized like the detector's
+  double dftEnergy(const std::vector<float> &window, size_t firstBin, size_t lastBin) {
+    double mean = 0;
+    for (float sample : window) { mean += sample; }
+    mean /= window.size();
+
+    double energy = 0;
+    for (size_t k = firstBin; k <= lastBin; k++) {
+      double re = 0, im = 0;
+      for (size_t n = 0; n < window.size(); n++) {
+        re += (window[n] - mean) * cos(2 * M_PI * k * n / window.size());
+        im -= (window[n] - mean) * sin(2 * M_PI * k * n / window.size());
+      }
+      energy += (re * re + im * im) / ((double) window.size() * window.size());
+    }
+    return energy;
+  }
+
+  SpectralDetector calibrated(MachineType type) {
+    SpectralDetector detector(SAMPLE_RATE_HZ, WINDOW_LENGTH, type);
+    std::vector<float> idle = makeWindow(0, 0);
+    detector.calibrate(idle.data(), idle.size());
+    return detector;
+  }
+
+  MachinePhase classify(SpectralDetector &detector, float frequencyHz, float amplitude) {
+    std::vector<float> window = makeWindow(frequencyHz, amplitude);
+    return detector.classify(window.data(), window.size());
+  }
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+// 0.5 Hz bins up to 20 Hz, split at 4 Hz into the low band (bins 1-8) and the spin band (bins 9-40)
+void test_bins_cover_the_drum_range(void) {
+  SpectralDetector detector(SAMPLE_RATE_HZ, WINDOW_LENGTH, MACHINE_WASHER);
+  TEST_ASSERT_EQUAL_UINT32(40, detector.getBinCount());
+
+  SpectralDetector slow(25, 16, MACHINE_WASHER);
+  TEST_ASSERT_EQUAL_UINT32(8, slow.getBinCount());                                   // Never past the Nyquist bin
+  SpectralDetector fine(SAMPLE_RATE_HZ, 1000, MACHINE_WASHER);
+  TEST_ASSERT_EQUAL_UINT32(SpectralDetector::MAX_BINS, fine.getBinCount());          // Nor past the coefficient table
+}
+
+// Every band energy equals the same bins of a direct DFT, for a drum on a bin, between two bins and for noise alone
+void test_band_energy_matches_dft(void) {
+  const float frequencies[] = {0, 1.5, 2.25, 9.0, 13.7};
+  SpectralDetector detector(SAMPLE_RATE_HZ, WINDOW_LENGTH, MACHINE_WASHER);
+
+  for (float frequencyHz : frequencies) {
+    std::vector<float> window = makeWindow(frequencyHz, 0.5);
+    detector.classify(window.data(), window.size());
+    double low = dftEnergy(window, 1, 8), spin = dftEnergy(window, 9, 40);
+    double total = low + spin;
+    TEST_ASSERT_FLOAT_WITHIN(1e-4 * total, low, detector.getBandEnergy(BAND_LOW));
+    TEST_ASSERT_FLOAT_WITHIN(1e-4 * total, spin, detector.getBandEnergy(BAND_SPIN));
+  }
+}
+
+// Every filter sits on a bin, so feeding the window from any point of a ring buffer gives the same energies
+void test_energy_independent_of_window_start(void) {
+  std::vector<float> window = makeWindow(2.25, 0.5);
+  SpectralDetector detector(SAMPLE_RATE_HZ, WINDOW_LENGTH, MACHINE_WASHER);
+  detector.classify(window.data(), window.size());
+  float low = detector.getBandEnergy(BAND_LOW), spin = detector.getBandEnergy(BAND_SPIN);
+
+  const size_t starts[] = {1, 37, 100, 199};
+  for (size_t start : starts) {
+    std::vector<float> rotated(window.begin() + start, window.end());
+    rotated.insert(rotated.end(), window.begin(), window.begin() + start);
+    detector.classify(rotated.data(), rotated.size());
+    TEST_ASSERT_FLOAT_WITHIN(1e-4 * low, low, detector.getBandEnergy(BAND_LOW));
+    TEST_ASSERT_FLOAT_WITHIN(1e-3 * spin, spin, detector.getBandEnergy(BAND_SPIN));
+  }
+}
+
+// The strongest bin of each band is the drum's frequency
+void test_peak_frequency(void) {
+  SpectralDetector detector(SAMPLE_RATE_HZ, WINDOW_LENGTH, MACHINE_WASHER);
+  std::vector<float> agitating = makeWindow(1.5, 0.5);
+  detector.classify(agitating.data(), agitating.size());
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 1.5, detector.getPeakFrequency(BAND_LOW));
+
+  std::vector<float> spinning = makeWindow(12.0, 0.5);
+  detector.classify(spinning.data(), spinning.size());
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 12.0, detector.getPeakFrequency(BAND_SPIN));
+}
+
+// A washer goes WASH -> SPIN -> RINSE, agitation in pauses stays RINSE, and a long idle stretch starts a new cycle
+void test_washer_phases(void) {
+  SpectralDetector washer = calibrated(MACHINE_WASHER);
+  TEST_ASSERT_EQUAL_UINT8(PHASE_IDLE, classify(washer, 0, 0));
+  TEST_ASSERT_EQUAL_UINT8(PHASE_WASH, classify(washer, 1.0, 0.4));
+  TEST_ASSERT_EQUAL_UINT8(PHASE_WASH, classify(washer, 0.75, 0.2));
+  TEST_ASSERT_EQUAL_UINT8(PHASE_SPIN, classify(washer, 11.0, 1.0));
+  TEST_ASSERT_EQUAL_UINT8(PHASE_IDLE, classify(washer, 0, 0));
+  TEST_ASSERT_EQUAL_UINT8(PHASE_RINSE, classify(washer, 1.0, 0.4));
+  TEST_ASSERT_EQUAL_UINT8(PHASE_RINSE, washer.getPhase());
+
+  for (uint16_t i = 0; i <= SpectralDetector::RINSE_RESET_WINDOWS; i++) { classify(washer, 0, 0); }
+  TEST_ASSERT_EQUAL_UINT8(PHASE_WASH, classify(washer, 1.0, 0.4));
+}
+
+// A dryer has no spin: its drum is TUMBLE in either band
+void test_dryer_tumbles(void) {
+  SpectralDetector dryer = calibrated(MACHINE_DRYER);
+  TEST_ASSERT_EQUAL_UINT8(PHASE_IDLE, classify(dryer, 0, 0));
+  TEST_ASSERT_EQUAL_UINT8(PHASE_TUMBLE, classify(dryer, 0.8, 0.3));
+  TEST_ASSERT_EQUAL_UINT8(PHASE_TUMBLE, classify(dryer, 6.0, 0.3));
+  TEST_ASSERT_EQUAL_UINT8(PHASE_IDLE, classify(dryer, 0, 0));
+}
+
+// A knock on the cabinet carries plenty of energy but spreads it over every bin, so it is not a running machine
+void test_knock_is_not_a_drum(void) {
+  SpectralDetector washer = calibrated(MACHINE_WASHER);
+  std::vector<float> knocked = makeWindow(0, 0);
+  for (size_t n = 0; n < 6; n++) { knocked[90 + n] += 20 * expf(-(float) n) * ((n & 1) ? -1 : 1); }
+
+  TEST_ASSERT_EQUAL_UINT8(PHASE_IDLE, washer.classify(knocked.data(), knocked.size()));
+  TEST_ASSERT_TRUE(washer.getBandEnergy(BAND_LOW) > 10 * SpectralDetector::ENERGY_FLOOR);
+  TEST_ASSERT_TRUE(washer.getBandEnergy(BAND_SPIN) > 10 * SpectralDetector::ENERGY_FLOOR);
+
+  // A drum too weak to stand out from the calibrated noise stays idle as well
+  TEST_ASSERT_EQUAL_UINT8(PHASE_IDLE, classify(washer, 1.0, 0.02));
+}
+
+// Cost of one classify() over a full window, the work a sender does every evaluation
+void test_classify_cost(void) {
+  SpectralDetector washer = calibrated(MACHINE_WASHER);
+  std::vector<float> window = makeWindow(11.0, 1.0);
+  volatile float sink = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < TIMED_WINDOWS; i++) {
+    window[i % WINDOW_LENGTH] += 0.001;
+    washer.classify(window.data(), window.size());
+    sink = sink + washer.getBandEnergy(BAND_SPIN);
+  }
+  std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+  (void) sink;
+
+  char message[96];
+  snprintf(message, sizeof(message), "classify() %.1f us per %u sample window, %u bins",
+           elapsed.count() / TIMED_WINDOWS, (unsigned) WINDOW_LENGTH, (unsigned) washer.getBinCount());
+  TEST_MESSAGE(message);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_bins_cover_the_drum_range);
+  RUN_TEST(test_band_energy_matches_dft);
+  RUN_TEST(test_energy_independent_of_window_start);
+  RUN_TEST(test_peak_frequency);
+  RUN_TEST(test_washer_phases);
+  RUN_TEST(test_dryer_tumbles);
+  RUN_TEST(test_knock_is_not_a_drum);
+  RUN_TEST(test_classify_cost);
+  return UNITY_END();
+}
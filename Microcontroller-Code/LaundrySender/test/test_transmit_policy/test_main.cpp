@@ -0,0 +1,246 @@
+/*
+  WasherWatcher sender unit tests
+  "test_transmit_policy/test_main.cpp"
+
+  TransmitPolicy on a simulated clock: a room of senders through a day of laundry, and a flapping state.
+*/
+
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+#include <unity.h>
+#include <TransmitPolicy.h>
+
+namespace {
+  // The ESP32 sender's timings
+  const uint32_t MEASUREDELAY = 100;        // The sender wakes (and asks the policy) this often
+  const uint32_t EVALDELAY = 2000;          // Before the policy, one frame went out per evaluation
+  const uint32_t HEARTBEATDELAY = 60000;
+  const uint32_t MINSENDDELAY = 1000;
+  const uint32_t SENDJITTER = 5000;
+
+  const uint32_t DAY_MS = 24UL * 3600 * 1000;
+  const size_t SENDERS = 60;                // A big laundry room
+  const uint32_t CYCLE_MS = 45UL * 60 * 1000;
+  const uint32_t FIRST_CYCLE_MS = 7UL * 3600 * 1000;   // Cycles start between 7:00 and 23:00
+  const uint32_t LAST_CYCLE_MS = 23UL * 3600 * 1000;
+  const uint32_t COLLISION_MS = 2;          // Two frames starting this close together are taken to collide
+
+  uint32_t nextRandom(uint32_t &state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  // A machine state change at atMs
+  typedef struct {
+    uint32_t atMs;
+    uint8_t state;
+  } Change;
+
+  // A washer's day: a handful of 45 minute cycles
+  std::vector<Change> makeDay(uint32_t &random) {
+    std::vector<Change> changes;
+    uint32_t cycles = 3 + nextRandom(random) % 6;
+    uint32_t slot = (LAST_CYCLE_MS - FIRST_CYCLE_MS) / cycles;
+    for (uint32_t i = 0; i < cycles; i++) {
+      uint32_t start = FIRST_CYCLE_MS + i * slot + nextRandom(random) % (slot - CYCLE_MS);
+      changes.push_back({start, 1});
+      changes.push_back({start + CYCLE_MS, 0});
+    }
+    return changes;
+  }
+
+  // What a day of one sender looked like on the air
+  typedef struct {
+    std::vector<uint32_t> sendMs;
+    uint32_t transitions;
+    uint32_t worstTransitionMs;     // Longest a state change waited for its frame
+    uint32_t shortestGapMs;
+    uint32_t shortestHeartbeatMs;   // Gaps between sends with no state change in between
+    uint32_t longestHeartbeatMs;
+    std::vector<uint32_t> heartbeatJitterMs;
+  } SenderDay;
+
+  // Steps one sender through the day on its own clock (booting at bootMs), the way its loop asks the policy
+  SenderDay runSender(const std::vector<Change> &changes, uint32_t bootMs, uint32_t seed, uint32_t jitterMs) {
+    TransmitPolicy policy(HEARTBEATDELAY, MINSENDDELAY, jitterMs);
+    policy.begin(bootMs, seed);
+    SenderDay day = {{}, 0, 0, UINT32_MAX, UINT32_MAX, 0, {}};
+
+    size_t next = 0;
+    uint8_t state = 0;
+    uint32_t changedMs = 0, lastSendMs = 0;
+    bool pending = false, changedSinceSend = false;
+    for (uint32_t now = bootMs; now < bootMs + DAY_MS; now += MEASUREDELAY) {
+      while (next < changes.size() && changes[next].atMs <= now - bootMs) {
+        state = changes[next++].state;
+        changedMs = now;
+        pending = true;
+        changedSinceSend = true;
+      }
+      if (!policy.isSendDue(now, state)) { continue; }
+
+      if (!day.sendMs.empty()) {
+        uint32_t gap = now - lastSendMs;
+        day.shortestGapMs = std::min(day.shortestGapMs, gap);
+        if (!changedSinceSend) {
+          day.shortestHeartbeatMs = std::min(day.shortestHeartbeatMs, gap);
+          day.longestHeartbeatMs = std::max(day.longestHeartbeatMs, gap);
+          day.heartbeatJitterMs.push_back(gap - HEARTBEATDELAY);
+        }
+      }
+      if (pending) {
+        day.transitions++;
+        day.worstTransitionMs = std::max(day.worstTransitionMs, now - changedMs);
+        pending = false;
+      }
+      changedSinceSend = false;
+      policy.recordSend(now, state);
+      lastSendMs = now;
+      day.sendMs.push_back(now);
+    }
+    return day;
+  }
+
+  // Frames of different senders starting within COLLISION_MS of each other
+  uint32_t countCollisions(const std::vector<SenderDay> &days) {
+    std::vector<uint32_t> all;
+    for (const SenderDay &day : days) { all.insert(all.end(), day.sendMs.begin(), day.sendMs.end()); }
+    std::sort(all.begin(), all.end());
+    uint32_t collisions = 0;
+    for (size_t i = 1; i < all.size(); i++) {
+      if (all[i] - all[i - 1] < COLLISION_MS) { collisions++; }
+    }
+    return collisions;
+  }
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+/*
+  A room of senders powered up together (the breaker coming back on) through a day of usage. Every state change
+  has to go out within the minimum spacing, unchanged states have to repeat on the heartbeat, and the jitter has
+  to keep the room from transmitting in lockstep.
+*/
+void test_room_through_a_day(void) {
+  uint32_t random = 5;
+  std::vector<SenderDay> days, lockstep;
+  uint32_t changes = 0;
+  for (size_t i = 0; i < SENDERS; i++) {
+    std::vector<Change> usage = makeDay(random);
+    changes += usage.size();
+    uint32_t bootMs = nextRandom(random) % 10;
+    uint32_t seed = nextRandom(random);
+    days.push_back(runSender(usage, bootMs, seed, SENDJITTER));
+    lockstep.push_back(runSender(usage, bootMs, seed, 0));
+  }
+
+  uint32_t sends = 0, transitions = 0, worstTransition = 0, shortestGap = UINT32_MAX;
+  uint32_t shortestHeartbeat = UINT32_MAX, longestHeartbeat = 0;
+  uint32_t jitterBuckets[10] = {0};
+  uint32_t jitterSamples = 0;
+  for (const SenderDay &day : days) {
+    sends += day.sendMs.size();
+    transitions += day.transitions;
+    worstTransition = std::max(worstTransition, day.worstTransitionMs);
+    shortestGap = std::min(shortestGap, day.shortestGapMs);
+    shortestHeartbeat = std::min(shortestHeartbeat, day.shortestHeartbeatMs);
+    longestHeartbeat = std::max(longestHeartbeat, day.longestHeartbeatMs);
+    for (uint32_t jitter : day.heartbeatJitterMs) {
+      jitterBuckets[std::min<uint32_t>(jitter * 10 / SENDJITTER, 9)]++;
+      jitterSamples++;
+    }
+  }
+  uint32_t emptiestBucket = *std::min_element(jitterBuckets, jitterBuckets + 10);
+  uint32_t collisions = countCollisions(days), lockstepCollisions = countCollisions(lockstep);
+  uint32_t everyEvaluation = SENDERS * (DAY_MS / EVALDELAY);
+
+  char message[160];
+  snprintf(message, sizeof(message), "%u senders: %u frames a day against %u sending every evaluation (%.1f%% fewer), %u collisions with jitter, %u without",
+           (unsigned) SENDERS, sends, everyEvaluation, 100.0 - 100.0 * sends / everyEvaluation, collisions, lockstepCollisions);
+  TEST_MESSAGE(message);
+
+  TEST_ASSERT_EQUAL_UINT32(changes, transitions);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(MINSENDDELAY + MEASUREDELAY, worstTransition);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(MINSENDDELAY, shortestGap);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(HEARTBEATDELAY, shortestHeartbeat);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(HEARTBEATDELAY + SENDJITTER + MEASUREDELAY, longestHeartbeat);
+  TEST_ASSERT_TRUE(emptiestBucket * 10 * 2 >= jitterSamples);      // The jitter covers its whole range evenly
+  TEST_ASSERT_TRUE(collisions * 10 < lockstepCollisions);
+  TEST_ASSERT_TRUE(sends * 10 < everyEvaluation);
+}
+
+// A flapping state is sent at most once per minimum spacing, and the counters add up
+void test_flapping_is_rate_limited(void) {
+  TransmitPolicy policy(HEARTBEATDELAY, MINSENDDELAY, SENDJITTER);
+  policy.begin(0, 9);
+  uint32_t sends = 0;
+  for (uint32_t now = 0; now < 10000; now += MEASUREDELAY) {
+    uint8_t state = (now / 300) % 2;
+    if (policy.isSendDue(now, state)) {
+      policy.recordSend(now, state);
+      sends++;
+    }
+  }
+  TEST_ASSERT_TRUE(sends >= 2);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(10000 / MINSENDDELAY + 1, sends);
+  TEST_ASSERT_EQUAL_UINT32(sends, policy.getTransitionSends() + policy.getHeartbeatSends());
+}
+
+// A change that reverts before the minimum spacing is up is never sent
+void test_reverted_change_is_not_sent(void) {
+  TransmitPolicy policy(HEARTBEATDELAY, MINSENDDELAY, 0);
+  policy.begin(0, 1);
+  TEST_ASSERT_TRUE(policy.isSendDue(0, 0));
+  policy.recordSend(0, 0);
+
+  TEST_ASSERT_FALSE(policy.isSendDue(MINSENDDELAY / 2, 1));
+  TEST_ASSERT_FALSE(policy.isSendDue(MINSENDDELAY, 0));
+  TEST_ASSERT_TRUE(policy.isSendDue(MINSENDDELAY, 1));
+  TEST_ASSERT_EQUAL_UINT32(0, policy.getTransitionSends());
+}
+
+// The first send is due within the jitter, even across a millis() wrap
+void test_first_send_across_wrap(void) {
+  TransmitPolicy policy(HEARTBEATDELAY, MINSENDDELAY, SENDJITTER);
+  policy.begin(UINT32_MAX - 1000, 0);
+  TEST_ASSERT_TRUE(policy.isSendDue(UINT32_MAX - 1000 + SENDJITTER, 0));
+  policy.recordSend(UINT32_MAX - 1000 + SENDJITTER, 0);
+  TEST_ASSERT_FALSE(policy.isSendDue(UINT32_MAX - 1000 + SENDJITTER + HEARTBEATDELAY - 1, 0));
+  TEST_ASSERT_TRUE(policy.isSendDue(UINT32_MAX - 1000 + 2 * SENDJITTER + HEARTBEATDELAY, 0));
+}
+
+// retrySoon() brings the next send forward to the minimum spacing after the last one, and does nothing before any send
+void test_retry_soon(void) {
+  TransmitPolicy policy(HEARTBEATDELAY, MINSENDDELAY, SENDJITTER);
+  policy.begin(0, 4);
+  policy.retrySoon();
+  TEST_ASSERT_FALSE(policy.isSendDue(0, 0));
+
+  TEST_ASSERT_TRUE(policy.isSendDue(SENDJITTER, 0));
+  policy.recordSend(SENDJITTER, 0);
+  TEST_ASSERT_FALSE(policy.isSendDue(SENDJITTER + MINSENDDELAY, 0));
+  policy.retrySoon();
+  TEST_ASSERT_FALSE(policy.isSendDue(SENDJITTER + MINSENDDELAY - 1, 0));
+  TEST_ASSERT_TRUE(policy.isSendDue(SENDJITTER + MINSENDDELAY, 0));
+
+  // Once a retry goes out, the heartbeat is back to its usual spacing
+  policy.recordSend(SENDJITTER + MINSENDDELAY, 0);
+  TEST_ASSERT_FALSE(policy.isSendDue(SENDJITTER + 2 * MINSENDDELAY, 0));
+  TEST_ASSERT_TRUE(policy.isSendDue(SENDJITTER + MINSENDDELAY + HEARTBEATDELAY + SENDJITTER, 0));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_room_through_a_day);
+  RUN_TEST(test_flapping_is_rate_limited);
+  RUN_TEST(test_reverted_change_is_not_sent);
+  RUN_TEST(test_first_send_across_wrap);
+  RUN_TEST(test_retry_soon);
+  return UNITY_END();
+}
@@ -0,0 +1,174 @@
+/*
+  WasherWatcher sender unit tests
+  "test_vibration_kernel/test_main.cpp"
+
+  The integer magnitude kernel against a double-precision reference, plus its cost next to a float sqrt, and the
+  host builds' hardware square root against the digit loop.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <chrono>
+
+#include <unity.h>
+#include <VibrationKernel.h>
+
+namespace {
+  const size_t BATCH = 64;
+  const uint32_t RANDOM_MAGNITUDES = 1000000;
+  const uint32_t TIMED_SAMPLES = 2000000;
+  const uint32_t SQRT_STRIDE = 251;         // Every this many values across the whole 32 bit range are compared
+
+  uint32_t nextRandom(uint32_t &state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  double nanosSince(std::chrono::steady_clock::time_point start, uint32_t count) {
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / count;
+  }
+
+  // The exact square root rounded to the nearest integer, saturated like isqrt32()
+  uint16_t roundedRoot(uint32_t value) {
+    uint32_t root = (uint32_t) llround(sqrt((double) value));
+    return (uint16_t) ((root > 0xFFFF) ? 0xFFFF : root);
+  }
+
+  // Random readings, with the corners of the sensor's range in the first eight
+  void fillBatch(AccBatch<BATCH> &batch, uint32_t &state) {
+    for (size_t i = 0; i < BATCH; i++) {
+      batch.x[i] = (int16_t) nextRandom(state);
+      batch.y[i] = (int16_t) nextRandom(state);
+      batch.z[i] = (int16_t) nextRandom(state);
+      if (i < 8) {
+        batch.x[i] = (i & 1) ? -32768 : 32767;
+        batch.y[i] = (i & 2) ? -32768 : 32767;
+        batch.z[i] = (i & 4) ? -32768 : 32767;
+      }
+    }
+    batch.count = BATCH;
+  }
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+// isqrt32() rounds to the nearest integer, checked on every value up to 2^22 and around every rounding edge
+void test_isqrt32_rounds_to_nearest(void) {
+  for (uint32_t value = 0; value < (1UL << 22); value++) {
+    TEST_ASSERT_EQUAL_UINT16(roundedRoot(value), VibrationKernel::isqrt32(value));
+  }
+  for (uint32_t root = 1; root <= 0xFFFF; root++) {
+    uint32_t square = root * root;
+    TEST_ASSERT_EQUAL_UINT16(roundedRoot(square - 1), VibrationKernel::isqrt32(square - 1));
+    TEST_ASSERT_EQUAL_UINT16(root, VibrationKernel::isqrt32(square));
+    TEST_ASSERT_EQUAL_UINT16(root, VibrationKernel::isqrt32(square + root));           // Last value that rounds down to root
+    TEST_ASSERT_EQUAL_UINT16(roundedRoot(square + root + 1), VibrationKernel::isqrt32(square + root + 1));
+  }
+  TEST_ASSERT_EQUAL_UINT16(0xFFFF, VibrationKernel::isqrt32(0xFFFFFFFFUL));
+}
+
+// Every magnitude is within half an LSB of the exact one, including the corners of the sensor's range
+void test_magnitude_within_half_lsb(void) {
+  static AccBatch<BATCH> batch;
+  static uint16_t out[BATCH];
+  static uint32_t scratch[BATCH];
+  uint32_t state = 7;
+  double worst = 0;
+
+  for (uint32_t done = 0; done < RANDOM_MAGNITUDES; done += BATCH) {
+    fillBatch(batch, state);
+    VibrationKernel::magnitude(batch, out, scratch);
+    for (size_t i = 0; i < BATCH; i++) {
+      double exact = sqrt((double) batch.x[i] * batch.x[i] + (double) batch.y[i] * batch.y[i] + (double) batch.z[i] * batch.z[i]);
+      TEST_ASSERT_EQUAL_UINT32((uint32_t) batch.x[i] * batch.x[i] + (uint32_t) batch.y[i] * batch.y[i] + (uint32_t) batch.z[i] * batch.z[i], scratch[i]);
+      worst = fmax(worst, fabs(out[i] - exact));
+    }
+  }
+
+  char message[96];
+  snprintf(message, sizeof(message), "worst error %.3f LSB over %u random readings", worst, (unsigned) RANDOM_MAGNITUDES);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_TRUE(worst <= 0.5);
+}
+
+/*
+  isqrt32Hardware() gives the same result as the digit loop: on every value up to 2^24, around every rounding edge
+  and every SQRT_STRIDE values across the rest of the range. Also times the two.
+*/
+void test_hardware_sqrt_matches_digit_loop(void) {
+  for (uint32_t value = 0; value < (1UL << 24); value++) {
+    TEST_ASSERT_EQUAL_UINT16(VibrationKernel::isqrt32(value), VibrationKernel::isqrt32Hardware(value));
+  }
+  for (uint32_t root = 1; root <= 0xFFFF; root++) {
+    uint32_t square = root * root;
+    TEST_ASSERT_EQUAL_UINT16(VibrationKernel::isqrt32(square - 1), VibrationKernel::isqrt32Hardware(square - 1));
+    TEST_ASSERT_EQUAL_UINT16(VibrationKernel::isqrt32(square), VibrationKernel::isqrt32Hardware(square));
+    TEST_ASSERT_EQUAL_UINT16(VibrationKernel::isqrt32(square + root), VibrationKernel::isqrt32Hardware(square + root));
+    TEST_ASSERT_EQUAL_UINT16(VibrationKernel::isqrt32(square + root + 1), VibrationKernel::isqrt32Hardware(square + root + 1));
+  }
+  for (uint32_t value = 1UL << 24; value >= (1UL << 24); value += SQRT_STRIDE) {
+    TEST_ASSERT_EQUAL_UINT16(VibrationKernel::isqrt32(value), VibrationKernel::isqrt32Hardware(value));
+  }
+  TEST_ASSERT_EQUAL_UINT16(0xFFFF, VibrationKernel::isqrt32Hardware(0xFFFFFFFFUL));
+
+  uint32_t state = 13;
+  volatile uint32_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < TIMED_SAMPLES; i++) { sink = sink + VibrationKernel::isqrt32(nextRandom(state)); }
+  double loopNs = nanosSince(start, TIMED_SAMPLES);
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < TIMED_SAMPLES; i++) { sink = sink + VibrationKernel::isqrt32Hardware(nextRandom(state)); }
+  double hardwareNs = nanosSince(start, TIMED_SAMPLES);
+  (void) sink;
+
+  char message[96];
+  snprintf(message, sizeof(message), "digit loop %.1f ns, hardware sqrt %.1f ns per root", loopNs, hardwareNs);
+  TEST_MESSAGE(message);
+}
+
+// Cost of one magnitude through the kernel, and through the float sqrt the senders used to take
+void test_kernel_cost(void) {
+  static AccBatch<BATCH> batch;
+  static uint16_t out[BATCH];
+  static uint32_t scratch[BATCH];
+  uint32_t state = 11;
+  fillBatch(batch, state);
+  volatile float sink = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t done = 0; done < TIMED_SAMPLES; done += BATCH) {
+    batch.x[done & (BATCH - 1)] ^= 1;
+    VibrationKernel::magnitude(batch, out, scratch);
+    sink = sink + out[0];
+  }
+  double kernelNs = nanosSince(start, TIMED_SAMPLES);
+
+  start = std::chrono::steady_clock::now();
+  for (uint32_t done = 0; done < TIMED_SAMPLES; done += BATCH) {
+    batch.x[done & (BATCH - 1)] ^= 1;
+    for (size_t i = 0; i < BATCH; i++) {
+      sink = sink + sqrtf((float) batch.x[i] * batch.x[i] + (float) batch.y[i] * batch.y[i] + (float) batch.z[i] * batch.z[i]);
+    }
+  }
+  double floatNs = nanosSince(start, TIMED_SAMPLES);
+  (void) sink;
+
+  char message[128];
+  snprintf(message, sizeof(message), "kernel %.1f ns per sample, float sqrt %.1f ns (host FPU; the ESP8266 emulates floats)",
+           kernelNs, floatNs);
+  TEST_MESSAGE(message);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_isqrt32_rounds_to_nearest);
+  RUN_TEST(test_magnitude_within_half_lsb);
+  RUN_TEST(test_hardware_sqrt_matches_digit_loop);
+  RUN_TEST(test_kernel_cost);
+  return UNITY_END();
+}
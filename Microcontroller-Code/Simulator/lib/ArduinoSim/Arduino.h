@@ -0,0 +1,154 @@
+/*
+  WasherWatcher Simulator
+  "Arduino.h"
+
+  The parts of the ESP32 Arduino core (and the FreeRTOS calls it exposes) that the
+  WasherWatcher firmware uses, running on a PC against the simulator's virtual clock.
+*/
+
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <algorithm>
+
+using std::abs;
+
+#define PROGMEM
+#define IRAM_ATTR
+#define F(text) text
+#define DEC 10
+#define HEX 16
+
+// Time since the current board booted, on the virtual clock
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+inline void yield() {}
+
+
+/********************** String Class Definition ***************************
+ * Arduino String, backed by std::string.
+ *************************************************************************/
+class String {
+  public:
+    String() {}
+    String(const char *text) : text(text ? text : "") {}
+    String(const std::string &text) : text(text) {}
+    explicit String(int value) : text(std::to_string(value)) {}
+    explicit String(unsigned long value) : text(std::to_string(value)) {}
+
+    const char *c_str() const { return text.c_str(); }
+    size_t length() const { return text.size(); }
+    int toInt() const { return atoi(text.c_str()); }
+    bool operator==(const char *other) const { return text == other; }
+    bool operator==(const String &other) const { return text == other.text; }
+    bool operator!=(const char *other) const { return text != other; }
+    String &operator+=(const String &other) { text += other.text; return *this; }
+    String &operator+=(const char *other) { text += other; return *this; }
+    String operator+(const String &other) const { return String(text + other.text); }
+
+  private:
+    std::string text;
+};
+
+
+/*********************** Print Class Definition ***************************
+ * Arduino's Print, formatting numbers the same way (base, float digits).
+ *************************************************************************/
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *text) { return write((const uint8_t *) text, strlen(text)); }
+
+    size_t print(const char *text) { return write(text); }
+    size_t print(const String &text) { return write(text.c_str()); }
+    size_t print(char c) { return write((uint8_t) c); }
+    size_t print(unsigned char value, int base = DEC) { return print((unsigned long) value, base); }
+    size_t print(int value, int base = DEC) { return print((long) value, base); }
+    size_t print(unsigned int value, int base = DEC) { return print((unsigned long) value, base); }
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(double value, int digits = 2);
+
+    template <typename T>
+    size_t println(const T &value) { return print(value) + println(); }
+    template <typename T>
+    size_t println(const T &value, int format) { return print(value, format) + println(); }
+    size_t println() { return write("\r\n"); }
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+
+/****************** HardwareSerial Class Definition ***********************
+ * Serial output goes to stdout when the simulator runs with --verbose,
+ * and is thrown away otherwise. There is never any input.
+ *************************************************************************/
+class HardwareSerial : public Print {
+  public:
+    void begin(unsigned long baud) {}
+    int available() { return 0; }
+    int read() { return -1; }
+    void flush() {}
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+};
+extern HardwareSerial Serial;
+
+
+/************************ EspClass Definition *****************************
+ * Chip information for the current board.
+ *************************************************************************/
+class EspClass {
+  public:
+    uint64_t getEfuseMac();
+    uint32_t getChipId() { return (uint32_t) getEfuseMac(); }
+    uint32_t getFreeHeap() { return 200000; }
+    uint32_t getMinFreeHeap() { return 180000; }
+    uint32_t getMaxAllocHeap() { return 110000; }
+    void restart() {}
+};
+extern EspClass ESP;
+
+uint32_t esp_random();
+
+
+// FreeRTOS, with tasks as threads and tick counts in virtual milliseconds
+struct SimTask;
+struct SimSemaphore;
+typedef SimTask *TaskHandle_t;
+typedef SimSemaphore *SemaphoreHandle_t;
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY ((TickType_t) 0xFFFFFFFF)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t) (ms))
+
+BaseType_t xTaskCreatePinnedToCore(void (*task)(void *), const char *name, uint32_t stackDepth, void *parameter,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core);
+void xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait);
+void vTaskDelay(TickType_t ticks);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+TickType_t xTaskGetTickCount();
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+
+#endif
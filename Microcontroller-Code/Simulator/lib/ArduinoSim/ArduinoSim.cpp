@@ -0,0 +1,556 @@
+/*
+  WasherWatcher Simulator
+  "ArduinoSim.cpp"
+
+  Implementation of the simulated Arduino core: virtual clock, boards, Serial, FreeRTOS, I2C, WiFi, ESP-NOW, file systems and NVS.
+*/
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "WiFi.h"
+#include "SPIFFS.h"
+#include "Preferences.h"
+#include "esp_now.h"
+#include "esp_wifi.h"
+#include "SimBoard.h"
+#include "SimMpu6050.h"
+#include <stdarg.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+HardwareSerial Serial;
+EspClass ESP;
+TwoWire Wire;
+WiFiClass WiFi;
+SPIFFSFS SPIFFS;
+
+// Every task waits on this, and advancing the clock wakes them to check their timeouts
+struct SimTask {
+  std::mutex lock;
+  std::condition_variable wake;
+  uint32_t notifications = 0;
+};
+
+struct SimSemaphore {
+  std::mutex lock;
+};
+
+namespace {
+  std::atomic<uint64_t> clockMicros(0);
+  std::vector<Sim::Board *> boards;
+  thread_local Sim::Board *current = NULL;
+  thread_local SimTask *currentTask = NULL;
+
+  std::mutex tasksLock;
+  std::vector<SimTask *> tasks;
+
+  std::mutex radioLock;
+  Sim::RadioStats radioStats;
+  float radioLoss = 0.0;
+  std::mt19937 radioRandom(1);
+  std::atomic<uint8_t> accessPointChannel(1);
+  const uint8_t CHANNELS = 13;                  // Channels a scan visits
+
+  std::atomic<Sim::EventTap> eventTap(NULL);
+  std::atomic<bool> verbose(false);
+  std::mutex serialLock;
+
+  std::mutex uplinkLock;
+  std::string uplinkHost;
+  uint16_t uplinkPort = 0;
+
+  // Virtual microseconds since the current board booted
+  uint64_t boardMicros() {
+    uint64_t now = clockMicros.load();
+    uint64_t boot = (current != NULL) ? current->bootMicros : 0;
+    return (now > boot) ? now - boot : 0;
+  }
+
+  Sim::Board *findBoard(const uint8_t *mac) {
+    for (Sim::Board *board : boards) {
+      if (memcmp(board->mac, mac, 6) == 0) { return board; }
+    }
+    return NULL;
+  }
+}
+
+
+/***** Virtual clock and boards *****/
+
+uint64_t Sim::now() {
+  return clockMicros.load();
+}
+
+void Sim::advanceTo(uint64_t micros) {
+  if (micros <= clockMicros.load()) { return; }
+  clockMicros.store(micros);
+
+  std::lock_guard<std::mutex> guard(tasksLock);
+  for (SimTask *task : tasks) {
+    std::lock_guard<std::mutex> taskGuard(task->lock);
+    task->wake.notify_all();
+  }
+}
+
+void Sim::addBoard(Board &board) {
+  boards.push_back(&board);
+}
+
+void Sim::setCurrentBoard(Board *board) {
+  current = board;
+}
+
+Sim::Board *Sim::currentBoard() {
+  return current;
+}
+
+void Sim::setRadioLoss(float probability, uint32_t seed) {
+  std::lock_guard<std::mutex> guard(radioLock);
+  radioLoss = probability;
+  radioRandom.seed(seed);
+}
+
+void Sim::setAccessPointChannel(uint8_t channel) {
+  accessPointChannel.store(channel);
+}
+
+uint8_t Sim::getAccessPointChannel() {
+  return accessPointChannel.load();
+}
+
+Sim::RadioStats Sim::getRadioStats() {
+  std::lock_guard<std::mutex> guard(radioLock);
+  return radioStats;
+}
+
+void Sim::setEventTap(EventTap tap) {
+  eventTap.store(tap);
+}
+
+Sim::EventTap Sim::getEventTap() {
+  return eventTap.load();
+}
+
+void Sim::setVerbose(bool enabled) {
+  verbose.store(enabled);
+}
+
+bool Sim::isVerbose() {
+  return verbose.load();
+}
+
+void Sim::setUplinkTarget(const std::string &host, uint16_t port) {
+  std::lock_guard<std::mutex> guard(uplinkLock);
+  uplinkHost = host;
+  uplinkPort = port;
+}
+
+bool Sim::getUplinkTarget(std::string &host, uint16_t &port) {
+  std::lock_guard<std::mutex> guard(uplinkLock);
+  host = uplinkHost;
+  port = uplinkPort;
+  return port != 0;
+}
+
+
+/***** Arduino core *****/
+
+unsigned long millis() {
+  return (unsigned long) (uint32_t) (boardMicros() / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long) (uint32_t) boardMicros();
+}
+
+// The firmware only delays while waiting for WiFi, which is connected from the start here
+void delay(unsigned long ms) {}
+
+uint32_t esp_random() {
+  thread_local std::mt19937 generator(12345);
+  return generator();
+}
+
+uint64_t EspClass::getEfuseMac() {
+  return (current != NULL) ? current->chipId : 0;
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t written = 0;
+  for (size_t i = 0; i < size; i++) { written += write(buffer[i]); }
+  return written;
+}
+
+size_t Print::print(long value, int base) {
+  if (base == DEC) {
+    char text[24];
+    snprintf(text, sizeof(text), "%ld", value);
+    return write(text);
+  }
+  return print((unsigned long) value, base);
+}
+
+size_t Print::print(unsigned long value, int base) {
+  char text[72];
+  char *cursor = text + sizeof(text) - 1;
+  *cursor = '\0';
+  if (base < 2) { base = DEC; }
+  do {
+    unsigned digit = value % base;
+    *--cursor = (char) (digit < 10 ? '0' + digit : 'A' + digit - 10);
+    value /= base;
+  } while (value > 0);
+  return write(cursor);
+}
+
+size_t Print::print(double value, int digits) {
+  char text[48];
+  snprintf(text, sizeof(text), "%.*f", digits, value);
+  return write(text);
+}
+
+size_t Print::printf(const char *format, ...) {
+  char text[256];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  return write(text);
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+  if (verbose.load()) {
+    std::lock_guard<std::mutex> guard(serialLock);
+    fwrite(buffer, 1, size, stdout);
+  }
+  return size;
+}
+
+
+/***** FreeRTOS *****/
+
+// Starts the task on its own thread, running as the board that created it
+BaseType_t xTaskCreatePinnedToCore(void (*function)(void *), const char *name, uint32_t stackDepth, void *parameter,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core) {
+  SimTask *task = new SimTask();
+  {
+    std::lock_guard<std::mutex> guard(tasksLock);
+    tasks.push_back(task);
+  }
+  if (handle != NULL) { *handle = task; }
+
+  Sim::Board *board = current;
+  std::thread([function, parameter, board, task]() {
+    current = board;
+    currentTask = task;
+    function(parameter);
+  }).detach();
+  return pdPASS;
+}
+
+void xTaskNotifyGive(TaskHandle_t task) {
+  std::lock_guard<std::mutex> guard(task->lock);
+  task->notifications++;
+  task->wake.notify_all();
+}
+
+/*
+  Waits for a notification or until ticksToWait virtual milliseconds pass. A board's loop() runs on the
+  simulator's own thread, which can't block while it moves the clock, so there the wait marks the board busy
+  until then instead (its loop() isn't run again before that) and returns straight away.
+*/
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait) {
+  SimTask *task = currentTask;
+  if (task == NULL) {
+    if (current != NULL && ticksToWait != portMAX_DELAY) {
+      current->busyUntilMicros = std::max(current->busyUntilMicros, clockMicros.load() + (uint64_t) ticksToWait * 1000);
+    }
+    return 0;
+  }
+
+  uint64_t deadline = Sim::now() + (uint64_t) ticksToWait * 1000;
+  std::unique_lock<std::mutex> guard(task->lock);
+  while (task->notifications == 0 && (ticksToWait == portMAX_DELAY || Sim::now() < deadline)) {
+    // Also wake up now and then in real time, in case a clock advance was missed
+    task->wake.wait_for(guard, std::chrono::milliseconds(5));
+  }
+
+  uint32_t value = task->notifications;
+  if (value > 0) { task->notifications = clearOnExit ? 0 : value - 1; }
+  return value;
+}
+
+void vTaskDelay(TickType_t ticks) {
+  uint64_t deadline = Sim::now() + (uint64_t) ticks * 1000;
+  while (Sim::now() < deadline) { std::this_thread::sleep_for(std::chrono::microseconds(200)); }
+}
+
+// NULL for a board's loop(), which runs on the simulator's own thread rather than in a task
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return currentTask;
+}
+
+TickType_t xTaskGetTickCount() {
+  return (TickType_t) millis();
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+  return new SimSemaphore();
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait) {
+  if (ticksToWait == portMAX_DELAY) {
+    semaphore->lock.lock();
+    return pdTRUE;
+  }
+  uint64_t deadline = Sim::now() + (uint64_t) ticksToWait * 1000;
+  while (!semaphore->lock.try_lock()) {
+    if (Sim::now() >= deadline) { return pdFALSE; }
+    std::this_thread::yield();
+  }
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  semaphore->lock.unlock();
+  return pdTRUE;
+}
+
+
+/***** I2C *****/
+
+void TwoWire::beginTransmission(uint8_t address) {
+  this->address = address;
+  txLength = 0;
+}
+
+size_t TwoWire::write(uint8_t value) {
+  if (txLength >= sizeof(txBuffer)) { return 0; }
+  txBuffer[txLength++] = value;
+  return 1;
+}
+
+// A register number followed by a value is a write; a register number alone selects where the next read starts
+uint8_t TwoWire::endTransmission(bool sendStop) {
+  SimMpu6050 *mpu = (current != NULL) ? current->mpu : NULL;
+  if (mpu == NULL || address != SimMpu6050::ADDRESS) { return 2; }   // Address not acknowledged
+
+  if (txLength >= 1) { readRegister = txBuffer[0]; }
+  for (size_t i = 1; i < txLength; i++) {
+    mpu->writeRegister(readRegister + i - 1, txBuffer[i]);
+  }
+  return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t length) {
+  SimMpu6050 *mpu = (current != NULL) ? current->mpu : NULL;
+  rxIndex = 0;
+  rxLength = 0;
+  if (mpu == NULL || address != SimMpu6050::ADDRESS) { return 0; }
+
+  if (length > sizeof(rxBuffer)) { length = sizeof(rxBuffer); }
+  mpu->readRegisters(readRegister, rxBuffer, length);
+  rxLength = length;
+  return length;
+}
+
+int TwoWire::read() {
+  if (rxIndex >= rxLength) { return -1; }
+  return rxBuffer[rxIndex++];
+}
+
+
+/***** WiFi and ESP-NOW *****/
+
+uint8_t *WiFiClass::macAddress(uint8_t *mac) {
+  if (current != NULL) { memcpy(mac, current->mac, 6); }
+  else { memset(mac, 0, 6); }
+  return mac;
+}
+
+String WiFiClass::macAddress() {
+  char text[18] = "00:00:00:00:00:00";
+  if (current != NULL) {
+    snprintf(text, sizeof(text), "%02X:%02X:%02X:%02X:%02X:%02X",
+             current->mac[0], current->mac[1], current->mac[2], current->mac[3], current->mac[4], current->mac[5]);
+  }
+  return String(text);
+}
+
+// Joining the access point moves the board to its channel
+void WiFiClass::begin(const char *ssid, const char *password) {
+  if (current != NULL) { current->channel = accessPointChannel.load(); }
+}
+
+// A blocking scan: the board is kept busy for msPerChannel on every channel visited, then finds the access point
+// (named ssid, when one was asked for) unless only another channel was scanned
+int16_t WiFiClass::scanNetworks(bool async, bool showHidden, bool passive, uint32_t msPerChannel, uint8_t channel, const char *ssid) {
+  if (current == NULL) { return 0; }
+  uint64_t busyFrom = std::max(current->busyUntilMicros, clockMicros.load());
+  current->busyUntilMicros = busyFrom + (uint64_t) msPerChannel * 1000 * ((channel == 0) ? CHANNELS : 1);
+  current->scans++;
+
+  scannedSsid = (ssid != NULL) ? ssid : "WasherWatcherSim";
+  return (channel == 0 || channel == accessPointChannel.load()) ? 1 : 0;
+}
+
+int32_t WiFiClass::channel(uint8_t index) {
+  return accessPointChannel.load();
+}
+
+int32_t WiFiClass::channel() {
+  return (current != NULL) ? current->channel : accessPointChannel.load();
+}
+
+esp_err_t esp_wifi_set_channel(uint8_t primary, int second) {
+  if (current == NULL || primary < 1 || primary > CHANNELS) { return ESP_FAIL; }
+  current->channel = primary;
+  return ESP_OK;
+}
+
+esp_err_t esp_now_init() {
+  return ESP_OK;
+}
+
+esp_err_t esp_now_register_send_cb(esp_now_send_cb_t cb) {
+  if (current == NULL) { return ESP_FAIL; }
+  current->sendCallback = cb;
+  return ESP_OK;
+}
+
+esp_err_t esp_now_register_recv_cb(esp_now_recv_cb_t cb) {
+  if (current == NULL) { return ESP_FAIL; }
+  current->recvCallback = cb;
+  return ESP_OK;
+}
+
+esp_err_t esp_now_add_peer(const esp_now_peer_info_t *peer) {
+  return ESP_OK;
+}
+
+/*
+  Delivers a frame to the board with the peer's MAC if both radios are on the same channel, unless the simulated
+  radio loses it. The ack back is lost just as often, in which case the sender is told the send failed even though
+  the frame arrived (as happens on real hardware, so the receiver sees resent copies).
+  The receive callback runs right away on the calling thread (standing in for the receiver's WiFi task),
+  switched to the receiving board so its millis() is used, followed by the sender's send callback.
+*/
+esp_err_t esp_now_send(const uint8_t *peer_addr, const uint8_t *data, size_t len) {
+  Sim::Board *sender = current;
+  if (sender == NULL || len == 0 || len > ESP_NOW_MAX_DATA_LEN) { return ESP_FAIL; }
+
+  Sim::Board *target = findBoard(peer_addr);
+  bool delivered = false;
+  bool acked = false;
+  {
+    std::lock_guard<std::mutex> guard(radioLock);
+    radioStats.sent++;
+    radioStats.bytes += len;
+    if (target != NULL && target->recvCallback != NULL && target->channel == sender->channel) {
+      std::uniform_real_distribution<float> chance(0.0, 1.0);
+      delivered = chance(radioRandom) >= radioLoss;
+    }
+    if (delivered) {
+      radioStats.delivered++;
+      std::uniform_real_distribution<float> chance(0.0, 1.0);
+      acked = chance(radioRandom) >= radioLoss;
+      if (!acked) { radioStats.acksLost++; }
+    } else {
+      radioStats.lost++;
+    }
+  }
+
+  if (delivered) {
+    current = target;
+    target->recvCallback(sender->mac, data, (int) len);
+    current = sender;
+  }
+  if (sender->sendCallback != NULL) {
+    sender->sendCallback(peer_addr, acked ? ESP_NOW_SEND_SUCCESS : ESP_NOW_SEND_FAIL);
+  }
+  return ESP_OK;
+}
+
+
+/***** File systems *****/
+
+// Opens a file of the current board: "r" only if it exists, "w" emptied (or created), "a" created if it doesn't exist
+fs::File fs::FS::open(const char *path, const char *mode) {
+  if (current == NULL) { return File(); }
+  if (mode[0] == 'r') {
+    auto found = current->files.find(path);
+    return (found == current->files.end()) ? File() : File(&found->second, false);
+  }
+  std::vector<uint8_t> &data = current->files[path];
+  if (mode[0] == 'w') { data.clear(); }
+  return File(&data, true);
+}
+
+bool fs::FS::exists(const char *path) {
+  return current != NULL && current->files.count(path) > 0;
+}
+
+bool fs::FS::remove(const char *path) {
+  return current != NULL && current->files.erase(path) > 0;
+}
+
+bool fs::File::seek(uint32_t position) {
+  if (data == NULL || position > data->size()) { return false; }
+  this->position = position;
+  return true;
+}
+
+size_t fs::File::read(uint8_t *buffer, size_t length) {
+  if (data == NULL || position >= data->size()) { return 0; }
+  size_t count = std::min(length, data->size() - position);
+  memcpy(buffer, data->data() + position, count);
+  position += count;
+  return count;
+}
+
+size_t fs::File::write(const uint8_t *buffer, size_t length) {
+  if (data == NULL || !writable) { return 0; }
+  data->insert(data->end(), buffer, buffer + length);
+  return length;
+}
+
+
+/***** NVS *****/
+
+bool Preferences::begin(const char *name, bool readOnly) {
+  if (current == NULL) { return false; }
+  this->space = std::string(name) + "/";
+  this->readOnly = readOnly;
+  return true;
+}
+
+// Copies a stored value into buffer. Returns its length, or 0 if there is none or it doesn't fit.
+size_t Preferences::getBytes(const char *key, void *buffer, size_t maxLength) {
+  if (current == NULL || this->space.empty()) { return 0; }
+  auto found = current->flash.find(this->space + key);
+  if (found == current->flash.end() || found->second.size() > maxLength) { return 0; }
+  memcpy(buffer, found->second.data(), found->second.size());
+  return found->second.size();
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t length) {
+  if (current == NULL || this->space.empty() || this->readOnly) { return 0; }
+  const uint8_t *bytes = (const uint8_t *) value;
+  current->flash[this->space + key].assign(bytes, bytes + length);
+  return length;
+}
+
+bool Preferences::remove(const char *key) {
+  if (current == NULL || this->space.empty() || this->readOnly) { return false; }
+  return current->flash.erase(this->space + key) > 0;
+}
@@ -0,0 +1,11 @@
+/*
+  WasherWatcher Simulator
+  "Arduino_JSON.h"
+
+  The senders include Arduino_JSON but no longer use it, so nothing is simulated here.
+*/
+
+#ifndef SIM_ARDUINO_JSON_H
+#define SIM_ARDUINO_JSON_H
+
+#endif
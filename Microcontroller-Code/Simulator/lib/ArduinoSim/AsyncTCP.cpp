@@ -0,0 +1,55 @@
+/*
+  WasherWatcher Simulator
+  "AsyncTCP.cpp"
+*/
+
+#include "AsyncTCP.h"
+#include "SimBoard.h"
+
+// Takes everything written, parsing out any events it completes
+size_t AsyncClient::add(const char *data, size_t length) {
+  if (this->closed) { return 0; }
+  this->pending.append(data, length);
+  parseEvents();
+  return length;
+}
+
+void AsyncClient::close(bool now) {
+  if (this->closed) { return; }
+  this->closed = true;
+  if (this->disconnectHandler) { this->disconnectHandler(this->disconnectArg, this); }
+}
+
+void AsyncClient::onDisconnect(AcConnectHandler handler, void *arg) {
+  this->disconnectHandler = handler;
+  this->disconnectArg = arg;
+}
+
+// Skips the HTTP headers, then hands every complete event (ended by a blank line) to the event tap
+void AsyncClient::parseEvents() {
+  if (!this->headersDone) {
+    size_t end = this->pending.find("\r\n\r\n");
+    if (end == std::string::npos) { return; }
+    this->pending.erase(0, end + 4);
+    this->headersDone = true;
+  }
+
+  size_t end;
+  while ((end = this->pending.find("\n\n")) != std::string::npos) {
+    std::string event = "message", data;
+    uint32_t id = 0;
+    size_t start = 0;
+    while (start <= end) {
+      size_t lineEnd = this->pending.find('\n', start);
+      std::string line = this->pending.substr(start, lineEnd - start);
+      if (line.compare(0, 7, "event: ") == 0) { event = line.substr(7); }
+      else if (line.compare(0, 6, "data: ") == 0) { data = line.substr(6); }
+      else if (line.compare(0, 4, "id: ") == 0) { id = (uint32_t) strtoul(line.c_str() + 4, NULL, 10); }
+      start = lineEnd + 1;
+    }
+    this->pending.erase(0, end + 2);
+
+    Sim::EventTap tap = Sim::getEventTap();
+    if (tap != NULL) { tap(event.c_str(), data.c_str(), id); }
+  }
+}
@@ -0,0 +1,55 @@
+/*
+  WasherWatcher Simulator
+  "AsyncTCP.h"
+
+  The subset of AsyncClient the receiver's /events stream uses. There is no network: everything written
+  after the HTTP headers is parsed back into Server-Sent Events and handed to Sim::getEventTap().
+*/
+
+#ifndef SIM_ASYNC_TCP_H
+#define SIM_ASYNC_TCP_H
+
+#include "Arduino.h"
+#include <functional>
+#include <string>
+
+class AsyncClient;
+typedef std::function<void(void *arg, AsyncClient *client)> AcConnectHandler;
+typedef std::function<void(void *arg, AsyncClient *client, size_t length, uint32_t time)> AcAckHandler;
+typedef std::function<void(void *arg, AsyncClient *client, int8_t error)> AcErrorHandler;
+typedef std::function<void(void *arg, AsyncClient *client, void *data, size_t length)> AcDataHandler;
+
+/******************* AsyncClient Class Definition *************************
+ * A connection whose send buffer always has room. close() runs the
+ * disconnect handler straight away, as the real one does.
+ *************************************************************************/
+class AsyncClient {
+  public:
+    static const size_t SEND_BUFFER = 5744;     // TCP_SND_BUF in the ESP32's lwIP
+
+    size_t space() const { return SEND_BUFFER; }
+    bool canSend() const { return !closed; }
+    size_t add(const char *data, size_t length);
+    bool send() { return !closed; }
+    size_t write(const char *data) { return add(data, strlen(data)); }
+    size_t write(const char *data, size_t length) { return add(data, length); }
+    void close(bool now = false);
+
+    void setRxTimeout(uint32_t timeout) {}
+    void onError(AcErrorHandler handler, void *arg = NULL) {}
+    void onData(AcDataHandler handler, void *arg = NULL) {}
+    void onAck(AcAckHandler handler, void *arg = NULL) {}
+    void onPoll(AcConnectHandler handler, void *arg = NULL) {}
+    void onDisconnect(AcConnectHandler handler, void *arg = NULL);
+
+  private:
+    bool closed = false;
+    bool headersDone = false;
+    std::string pending;            // Received text not yet parsed
+    AcConnectHandler disconnectHandler;
+    void *disconnectArg = NULL;
+
+    void parseEvents();
+};
+
+#endif
@@ -0,0 +1,125 @@
+/*
+  WasherWatcher Simulator
+  "ESPAsyncWebServer.cpp"
+*/
+
+#include "ESPAsyncWebServer.h"
+#include "SimBoard.h"
+
+// Replaces any response already sent (a handler should only send once)
+void AsyncWebServerRequest::send(AsyncWebServerResponse *response) {
+  delete this->response;
+  this->response = response;
+}
+
+void AsyncWebServerRequest::send(int code, const String &contentType, const String &content) {
+  send(beginResponse(code, contentType, content));
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginResponse(int code, const String &contentType, const String &content) {
+  AsyncWebServerResponse *response = new AsyncWebServerResponse();
+  response->code = code;
+  response->contentType = contentType;
+  response->body = content.c_str();
+  return response;
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginResponse_P(int code, const String &contentType, const uint8_t *content, size_t length) {
+  AsyncWebServerResponse *response = beginResponse(code, contentType);
+  response->body.assign((const char *) content, length);
+  return response;
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginChunkedResponse(const String &contentType, AwsResponseFiller filler) {
+  AsyncWebServerResponse *response = beginResponse(200, contentType);
+  response->filler = filler;
+  return response;
+}
+
+AsyncWebParameter *AsyncWebServerRequest::getParam(const String &name, bool post) const {
+  for (const AsyncWebParameter &param : params) {
+    if (param.name() == name) { return const_cast<AsyncWebParameter *>(&param); }
+  }
+  return NULL;
+}
+
+AsyncWebHeader *AsyncWebServerRequest::getHeader(const String &name) const {
+  for (const AsyncWebHeader &header : requestHeaders) {
+    if (header.name() == name) { return const_cast<AsyncWebHeader *>(&header); }
+  }
+  return NULL;
+}
+
+// The status line and headers, enough for AsyncClient to find where the body starts
+String AsyncWebServerResponse::_assembleHead(uint8_t version) {
+  std::string head = "HTTP/1.1 " + std::to_string(this->_code) + " OK\r\nContent-Type: " + this->_contentType.c_str() + "\r\n\r\n";
+  this->_headLength = head.size();
+  return String(head.c_str());
+}
+
+void AsyncWebServer::on(const char *url, int method, ArRequestHandlerFunction handler) {
+  if (method == HTTP_GET) { routes.push_back(std::make_pair(std::string(url), handler)); }
+}
+
+/*
+  Opens a connection to the handler added for url, as a browser opening a Server-Sent Events stream:
+  its response sends the headers, which are acknowledged straight away. The handler then owns the
+  request and connection (deleting them when it's done). Returns false if no handler takes url.
+*/
+bool AsyncWebServer::simulateConnect(const char *url) {
+  AsyncWebServerRequest *request = new AsyncWebServerRequest();
+  request->path = url;
+  request->connection = new AsyncClient();
+
+  for (AsyncWebHandler *handler : handlers) {
+    if (!handler->canHandle(request)) { continue; }
+    handler->handleRequest(request);
+    AsyncWebServerResponse *response = request->response;
+    if (response == NULL) { break; }
+    response->_respond(request);
+    response->_ack(request, 1, 0);
+    return true;
+  }
+  delete request->connection;
+  delete request;
+  return false;
+}
+
+/*
+  Runs the handler for url and collects its whole body, calling a chunked response's filler until it
+  returns 0. Like the real server, it offers as much room as the TCP window has: usually 1 kB, but every
+  third call only a few dozen bytes, and after RESPONSE_TRY_AGAIN the full 1 kB again.
+  Returns the status code, 404 if no route matches, or 500 if a filler can't fill even 1 kB.
+*/
+int AsyncWebServer::simulateGet(const char *url, const std::vector<AsyncWebParameter> &params, std::string &body) {
+  body.clear();
+  for (auto &route : routes) {
+    if (route.first != url) { continue; }
+
+    AsyncWebServerRequest request;
+    request.params = params;
+    route.second(&request);
+    if (request.response == NULL) { return 500; }
+
+    body = request.response->body;
+    if (request.response->filler) {
+      uint8_t chunk[1024];
+      const size_t SMALL_WINDOW = 40;
+      bool retry = false;
+      for (unsigned call = 0; ; call++) {
+        size_t window = (call % 3 == 2 && !retry) ? SMALL_WINDOW : sizeof(chunk);
+        size_t written = request.response->filler(chunk, window, body.size());
+        if (written == RESPONSE_TRY_AGAIN) {
+          if (window == sizeof(chunk)) { return 500; }
+          retry = true;
+          continue;
+        }
+        if (written == 0) { break; }
+        body.append((const char *) chunk, written);
+        retry = false;
+      }
+    }
+    return request.response->code;
+  }
+  return 404;
+}
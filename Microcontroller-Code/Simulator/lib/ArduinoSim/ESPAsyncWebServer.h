@@ -0,0 +1,125 @@
+/*
+  WasherWatcher Simulator
+  "ESPAsyncWebServer.h"
+
+  The subset of ESPAsyncWebServer the receiver uses. There is no network: the simulator calls
+  AsyncWebServer::simulateGet() to run a route handler, and AsyncWebServer::simulateConnect() to open
+  a handler's stream (whose Server-Sent Events go to Sim::getEventTap(), see AsyncTCP.h).
+*/
+
+#ifndef SIM_ESP_ASYNC_WEB_SERVER_H
+#define SIM_ESP_ASYNC_WEB_SERVER_H
+
+#include "Arduino.h"
+#include "FS.h"
+#include "AsyncTCP.h"
+#include <functional>
+#include <string>
+#include <vector>
+#include <utility>
+
+#define HTTP_GET 1
+#define HTTP_POST 2
+
+class AsyncWebServerRequest;
+typedef std::function<void(AsyncWebServerRequest *request)> ArRequestHandlerFunction;
+typedef std::function<size_t(uint8_t *buffer, size_t maxLen, size_t index)> AwsResponseFiller;
+
+// A chunked response's filler returns this when it has nothing to send yet but isn't finished
+#define RESPONSE_TRY_AGAIN 0xFFFFFFFF
+
+enum WebResponseState { RESPONSE_SETUP, RESPONSE_HEADERS, RESPONSE_CONTENT, RESPONSE_WAIT_ACK, RESPONSE_END, RESPONSE_FAILED };
+
+// A query parameter or header
+class AsyncWebParameter {
+  public:
+    AsyncWebParameter(const String &name, const String &value) : paramName(name), paramValue(value) {}
+    const String &name() const { return paramName; }
+    const String &value() const { return paramValue; }
+
+  private:
+    String paramName;
+    String paramValue;
+};
+typedef AsyncWebParameter AsyncWebHeader;
+
+// Response built by a handler. Bodies are either held whole or produced by a filler; a stream's
+// response overrides the internal _respond()/_ack() hooks instead, as with the real server.
+class AsyncWebServerResponse {
+  public:
+    int code = 200;
+    String contentType;
+    std::string body;
+    AwsResponseFiller filler;
+    std::vector<std::pair<String, String> > headers;
+
+    virtual ~AsyncWebServerResponse() {}
+    void addHeader(const String &name, const String &value) { headers.push_back(std::make_pair(name, value)); }
+    void setCode(int code) { this->code = code; }
+
+    virtual String _assembleHead(uint8_t version);
+    virtual bool _sourceValid() const { return false; }
+    virtual void _respond(AsyncWebServerRequest *request) {}
+    virtual size_t _ack(AsyncWebServerRequest *request, size_t length, uint32_t time) { return 0; }
+
+  protected:
+    int _code = 200;
+    String _contentType;
+    bool _sendContentLength = true;
+    size_t _headLength = 0;
+    WebResponseState _state = RESPONSE_SETUP;
+};
+
+class AsyncWebServerRequest {
+  public:
+    std::vector<AsyncWebParameter> params;
+    std::vector<AsyncWebHeader> requestHeaders;
+    AsyncWebServerResponse *response = NULL;
+    String path;
+    AsyncClient *connection = NULL;
+
+    ~AsyncWebServerRequest() { delete response; }
+
+    void send(AsyncWebServerResponse *response);
+    void send(int code, const String &contentType = String(), const String &content = String());
+    AsyncWebServerResponse *beginResponse(int code, const String &contentType = String(), const String &content = String());
+    AsyncWebServerResponse *beginResponse_P(int code, const String &contentType, const uint8_t *content, size_t length);
+    AsyncWebServerResponse *beginChunkedResponse(const String &contentType, AwsResponseFiller filler);
+
+    bool hasParam(const String &name, bool post = false) const { return getParam(name, post) != NULL; }
+    AsyncWebParameter *getParam(const String &name, bool post = false) const;
+    bool hasHeader(const String &name) const { return getHeader(name) != NULL; }
+    AsyncWebHeader *getHeader(const String &name) const;
+
+    int method() const { return HTTP_GET; }
+    uint8_t version() const { return 1; }
+    const String &url() const { return path; }
+    AsyncClient *client() { return connection; }
+};
+
+class AsyncWebHandler {
+  public:
+    virtual ~AsyncWebHandler() {}
+    virtual bool canHandle(AsyncWebServerRequest *request) { return false; }
+    virtual void handleRequest(AsyncWebServerRequest *request) {}
+};
+
+/******************* AsyncWebServer Class Definition **********************
+ * Remembers every route so the simulator can issue requests to them.
+ *************************************************************************/
+class AsyncWebServer {
+  public:
+    explicit AsyncWebServer(uint16_t port) {}
+    void on(const char *url, int method, ArRequestHandlerFunction handler);
+    void addHandler(AsyncWebHandler *handler) { handlers.push_back(handler); }
+    void begin() {}
+
+    int simulateGet(const char *url, const std::vector<AsyncWebParameter> &params, std::string &body);
+    bool simulateConnect(const char *url);
+
+  private:
+    std::vector<std::pair<std::string, ArRequestHandlerFunction> > routes;
+    std::vector<AsyncWebHandler *> handlers;
+};
+
+#endif
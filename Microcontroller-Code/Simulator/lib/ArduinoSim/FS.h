@@ -0,0 +1,44 @@
+/*
+  WasherWatcher Simulator
+  "FS.h"
+
+  Arduino file system base class. Files are kept per board in Sim::Board::files, so they last across a board's reboots.
+*/
+
+#ifndef SIM_FS_H
+#define SIM_FS_H
+
+#include "Arduino.h"
+#include <vector>
+
+namespace fs {
+  // An open file, reading and writing the board's copy directly. A default constructed one was never opened.
+  class File {
+    public:
+      File() {}
+      File(std::vector<uint8_t> *data, bool writable) : data(data), writable(writable) {}
+      operator bool() const { return data != NULL; }
+      size_t size() const { return data ? data->size() : 0; }
+      bool seek(uint32_t position);
+      size_t read(uint8_t *buffer, size_t length);
+      size_t write(const uint8_t *buffer, size_t length);
+      void close() { data = NULL; }
+
+    private:
+      std::vector<uint8_t> *data = NULL;
+      bool writable = false;     // Opened "w" or "a", which both write at the end of the file
+      size_t position = 0;
+  };
+
+  class FS {
+    public:
+      virtual ~FS() {}
+      File open(const char *path, const char *mode = "r");
+      bool exists(const char *path);
+      bool remove(const char *path);
+  };
+}
+
+using fs::File;
+
+#endif
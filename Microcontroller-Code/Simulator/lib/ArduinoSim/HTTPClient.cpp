@@ -0,0 +1,91 @@
+/*
+  WasherWatcher Simulator
+  "HTTPClient.cpp"
+*/
+
+#include "HTTPClient.h"
+#include "SimBoard.h"
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace {
+  // Connects to host:port with send and receive timeouts. Returns the socket, or -1.
+  int connectTo(const std::string &host, uint16_t port, uint16_t timeoutMs) {
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *found = NULL;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &found) != 0) { return -1; }
+
+    int fd = -1;
+    for (addrinfo *address = found; address != NULL && fd < 0; address = address->ai_next) {
+      fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+      if (fd < 0) { continue; }
+      timeval timeout = {timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+      setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+      setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+      if (connect(fd, address->ai_addr, address->ai_addrlen) != 0) {
+        close(fd);
+        fd = -1;
+      }
+    }
+    freeaddrinfo(found);
+    return fd;
+  }
+
+  bool sendAll(int fd, const char *data, size_t length) {
+    while (length > 0) {
+      ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+      if (sent <= 0) { return false; }
+      data += sent;
+      length -= sent;
+    }
+    return true;
+  }
+}
+
+// Keeps the path of an http://host[:port]/path URL (the host is replaced by the uplink target)
+bool HTTPClient::begin(const char *url) {
+  const char *start = strstr(url, "://");
+  start = (start != NULL) ? start + 3 : url;
+  const char *slash = strchr(start, '/');
+  this->path = (slash != NULL) ? slash : "/";
+  this->headers.clear();
+  this->response.clear();
+  return true;
+}
+
+void HTTPClient::addHeader(const String &name, const String &value) {
+  this->headers += std::string(name.c_str()) + ": " + value.c_str() + "\r\n";
+}
+
+// Sends the request and reads the whole response (the server closes the connection). Returns the status code.
+int HTTPClient::POST(uint8_t *payload, size_t size) {
+  std::string host;
+  uint16_t port;
+  if (!Sim::getUplinkTarget(host, port)) { return HTTPC_ERROR_CONNECTION_REFUSED; }
+
+  int fd = connectTo(host, port, this->timeoutMs);
+  if (fd < 0) { return HTTPC_ERROR_CONNECTION_REFUSED; }
+
+  std::string request = "POST " + this->path + " HTTP/1.1\r\nHost: " + host + ":" + std::to_string(port) + "\r\n" +
+                        this->headers + "Content-Length: " + std::to_string(size) + "\r\nConnection: close\r\n\r\n";
+  if (!sendAll(fd, request.data(), request.size()) || !sendAll(fd, (const char *) payload, size)) {
+    close(fd);
+    return HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+  }
+
+  std::string reply;
+  char buffer[2048];
+  ssize_t received;
+  while ((received = recv(fd, buffer, sizeof(buffer), 0)) > 0) { reply.append(buffer, received); }
+  close(fd);
+
+  int code = 0;
+  if (sscanf(reply.c_str(), "HTTP/%*s %d", &code) != 1) { return HTTPC_ERROR_READ_TIMEOUT; }
+  size_t bodyStart = reply.find("\r\n\r\n");
+  this->response = (bodyStart != std::string::npos) ? reply.substr(bodyStart + 4) : "";
+  return code;
+}
@@ -0,0 +1,38 @@
+/*
+  WasherWatcher Simulator
+  "HTTPClient.h"
+
+  The ESP32 core's HTTPClient, for the receiver's uplink. Unlike the rest of the simulated network this
+  one is real: requests go over TCP to the server given by Sim::setUplinkTarget() (whatever host the
+  firmware's URL names), so the receiver can be tested against a server running on the same machine.
+*/
+
+#ifndef SIM_HTTP_CLIENT_H
+#define SIM_HTTP_CLIENT_H
+
+#include "Arduino.h"
+#include <string>
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+class HTTPClient {
+  public:
+    bool begin(const char *url);
+    bool begin(const String &url) { return begin(url.c_str()); }
+    void setTimeout(uint16_t timeoutMs) { this->timeoutMs = timeoutMs; }
+    void addHeader(const String &name, const String &value);
+    int POST(uint8_t *payload, size_t size);
+    int POST(const String &payload) { return POST((uint8_t *) payload.c_str(), payload.length()); }
+    String getString() { return String(response); }
+    void end() {}
+
+  private:
+    std::string path = "/";
+    std::string headers;
+    std::string response;
+    uint16_t timeoutMs = 5000;
+};
+
+#endif
@@ -0,0 +1,26 @@
+/*
+  WasherWatcher Simulator
+  "Preferences.h"
+
+  The ESP32 core's NVS key-value store, kept per board in Sim::Board::flash so it lasts across a board's reboots.
+*/
+
+#ifndef SIM_PREFERENCES_H
+#define SIM_PREFERENCES_H
+
+#include "Arduino.h"
+
+class Preferences {
+  public:
+    bool begin(const char *name, bool readOnly = false);
+    void end() { space.clear(); }
+    size_t getBytes(const char *key, void *buffer, size_t maxLength);
+    size_t putBytes(const char *key, const void *value, size_t length);
+    bool remove(const char *key);
+
+  private:
+    std::string space;
+    bool readOnly = false;
+};
+
+#endif
@@ -0,0 +1,17 @@
+/*
+  WasherWatcher Simulator
+  "SPIFFS.h"
+*/
+
+#ifndef SIM_SPIFFS_H
+#define SIM_SPIFFS_H
+
+#include "FS.h"
+
+class SPIFFSFS : public fs::FS {
+  public:
+    bool begin(bool formatOnFail = false) { return true; }
+};
+extern SPIFFSFS SPIFFS;
+
+#endif
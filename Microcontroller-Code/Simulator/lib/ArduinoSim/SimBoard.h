@@ -0,0 +1,76 @@
+/*
+  WasherWatcher Simulator
+  "SimBoard.h"
+
+  Shared state behind the simulated Arduino core: a virtual clock, the boards taking part,
+  and the ESP-NOW "air" that carries frames between them.
+*/
+
+#ifndef SIM_BOARD_H
+#define SIM_BOARD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "esp_now.h"
+
+class SimMpu6050;
+
+namespace Sim {
+
+  /*
+    One simulated microcontroller. millis()/micros() count from bootMicros, and ESP.getEfuseMac() returns chipId.
+    A blocking WiFi scan, or loop() sleeping until its next deadline, can't stop the virtual clock, so it sets
+    busyUntilMicros instead, and the board's loop() isn't run again until then.
+  */
+  struct Board {
+    uint8_t mac[6] = {0, 0, 0, 0, 0, 0};
+    uint64_t chipId = 0;
+    uint64_t bootMicros = 0;
+    SimMpu6050 *mpu = NULL;                       // The accelerometer on this board's I2C bus, if any
+    esp_now_recv_cb_t recvCallback = NULL;
+    esp_now_send_cb_t sendCallback = NULL;
+    uint8_t channel = 1;                          // WiFi channel the radio is on (ESP-NOW only reaches the same channel)
+    uint64_t busyUntilMicros = 0;
+    uint32_t scans = 0;
+    std::map<std::string, std::vector<uint8_t>> flash;   // Preferences (NVS), keyed "namespace/key"
+    std::map<std::string, std::vector<uint8_t>> files;   // SPIFFS, keyed by path
+  };
+
+  // Totals for the simulated radio
+  struct RadioStats {
+    uint64_t sent = 0;
+    uint64_t delivered = 0;
+    uint64_t lost = 0;
+    uint64_t acksLost = 0;                      // Delivered, but the sender was told the send failed
+    uint64_t bytes = 0;
+  };
+
+  // Called for every Server-Sent Event a board sends (from whichever thread sent it)
+  typedef void (*EventTap)(const char *event, const char *data, uint32_t id);
+
+  uint64_t now();                               // Virtual time in microseconds since the simulation began
+  void advanceTo(uint64_t micros);              // Moves the virtual clock forward (never back)
+
+  void addBoard(Board &board);
+  void setCurrentBoard(Board *board);           // Board whose firmware runs on the calling thread
+  Board *currentBoard();
+
+  void setRadioLoss(float probability, uint32_t seed);
+  void setAccessPointChannel(uint8_t channel);  // Channel of the WiFi network, which the receiver joins
+  uint8_t getAccessPointChannel();
+  RadioStats getRadioStats();
+
+  void setEventTap(EventTap tap);
+  EventTap getEventTap();
+
+  void setVerbose(bool verbose);                // Echo the firmware's Serial output
+  bool isVerbose();
+
+  void setUplinkTarget(const std::string &host, uint16_t port);   // Real server every HTTPClient request goes to
+  bool getUplinkTarget(std::string &host, uint16_t &port);        // False if none was set (requests are refused)
+}
+
+#endif
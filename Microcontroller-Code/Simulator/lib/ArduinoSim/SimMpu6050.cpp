@@ -0,0 +1,104 @@
+/*
+  WasherWatcher Simulator
+  "SimMpu6050.cpp"
+*/
+
+#include "SimMpu6050.h"
+#include "SimBoard.h"
+#include <math.h>
+
+namespace {
+  const uint8_t REG_SMPLRT_DIV = 0x19;
+  const uint8_t REG_INT_STATUS = 0x3A;
+  const uint8_t REG_USER_CTRL = 0x6A;
+  const uint8_t REG_FIFO_COUNT_H = 0x72;
+  const uint8_t REG_FIFO_R_W = 0x74;
+  const uint8_t REG_WHO_AM_I = 0x75;
+
+  const uint8_t INT_FIFO_OFLOW = 0x10;
+  const uint8_t USER_CTRL_FIFO_EN = 0x40;
+  const uint8_t USER_CTRL_FIFO_RESET = 0x04;
+
+  const float ACCEL_LSB_PER_MS2 = 8192.0 / 9.80665;
+  const int16_t ROOM_TEMPERATURE_RAW = (int16_t) ((25.0 - 36.53) * 340.0);
+  const size_t SAMPLE_BYTES = 14;
+}
+
+// Applies a register write from the driver
+void SimMpu6050::writeRegister(uint8_t reg, uint8_t value) {
+  if (reg == REG_SMPLRT_DIV) {
+    samplePeriodMicros = 1000 * (value + 1);   // 1 kHz gyro output rate with the DLPF on
+  } else if (reg == REG_USER_CTRL) {
+    catchUp();
+    if (value & USER_CTRL_FIFO_RESET) {
+      fifoHead = 0;
+      fifoCount = 0;
+    }
+    bool enable = (value & USER_CTRL_FIFO_EN) != 0;
+    if (enable && !fifoEnabled) { nextSampleMicros = Sim::now() + samplePeriodMicros; }
+    fifoEnabled = enable;
+  }
+}
+
+// Answers a register read from the driver (consecutive registers, except the FIFO which streams)
+void SimMpu6050::readRegisters(uint8_t reg, uint8_t *buffer, size_t length) {
+  catchUp();
+  for (size_t i = 0; i < length; i++) {
+    uint8_t current = (reg == REG_FIFO_R_W) ? reg : reg + i;
+    if (current == REG_WHO_AM_I) {
+      buffer[i] = ADDRESS;
+    } else if (current == REG_INT_STATUS) {
+      buffer[i] = overflow ? INT_FIFO_OFLOW : 0;
+      overflow = false;
+    } else if (current == REG_FIFO_COUNT_H) {
+      buffer[i] = (uint8_t) (fifoCount >> 8);
+    } else if (current == REG_FIFO_COUNT_H + 1) {
+      buffer[i] = (uint8_t) fifoCount;
+    } else if (current == REG_FIFO_R_W) {
+      buffer[i] = pop();
+    } else {
+      buffer[i] = 0;
+    }
+  }
+}
+
+// Adds every sample that fell due since the last bus access
+void SimMpu6050::catchUp() {
+  uint64_t now = Sim::now();
+  while (fifoEnabled && nextSampleMicros <= now) {
+    if (fifoCount + SAMPLE_BYTES > FIFO_BYTES) {
+      overflow = true;
+    } else {
+      float acceleration[3];
+      source.accelerationAt(nextSampleMicros, acceleration);
+      for (size_t axis = 0; axis < 3; axis++) {
+        float raw = acceleration[axis] * ACCEL_LSB_PER_MS2;
+        if (raw > 32767) { raw = 32767; }
+        if (raw < -32768) { raw = -32768; }
+        push((int16_t) lroundf(raw));
+      }
+      push(ROOM_TEMPERATURE_RAW);
+      push(0);
+      push(0);
+      push(0);
+      generated++;
+    }
+    nextSampleMicros += samplePeriodMicros;
+  }
+}
+
+// Appends a big endian 16 bit value to the FIFO
+void SimMpu6050::push(int16_t value) {
+  fifo[(fifoHead + fifoCount) % FIFO_BYTES] = (uint8_t) ((uint16_t) value >> 8);
+  fifo[(fifoHead + fifoCount + 1) % FIFO_BYTES] = (uint8_t) value;
+  fifoCount += 2;
+}
+
+// Removes the oldest byte from the FIFO (reads of an empty FIFO return 0)
+uint8_t SimMpu6050::pop() {
+  if (fifoCount == 0) { return 0; }
+  uint8_t value = fifo[fifoHead];
+  fifoHead = (fifoHead + 1) % FIFO_BYTES;
+  fifoCount--;
+  return value;
+}
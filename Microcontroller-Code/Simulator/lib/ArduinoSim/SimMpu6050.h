@@ -0,0 +1,56 @@
+/*
+  WasherWatcher Simulator
+  "SimMpu6050.h"
+
+  Register-level model of the MPU6050 in FIFO mode, so the unmodified MPU6050Fifo driver
+  can be exercised. Samples come from a VibrationSource at the configured sample rate.
+*/
+
+#ifndef SIM_MPU6050_H
+#define SIM_MPU6050_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Acceleration (m/s^2, gravity included) the simulated chip feels at a given virtual time
+class VibrationSource {
+  public:
+    virtual ~VibrationSource() {}
+    virtual void accelerationAt(uint64_t micros, float acceleration[3]) = 0;
+};
+
+/****************** SimMpu6050 Class Definition ***************************
+ * Supports what the driver touches: WHO_AM_I, the sample rate divider, the
+ * FIFO enable/reset bits, INT_STATUS (overflow, cleared on read), FIFO_COUNT
+ * and FIFO_R_W. Samples due since the last access are generated lazily, at
+ * ±4 g (8192 LSB/g), and a full 1024 byte FIFO raises the overflow flag
+ * instead of being overwritten.
+ *************************************************************************/
+class SimMpu6050 {
+  public:
+    static const uint8_t ADDRESS = 0x68;
+    static const size_t FIFO_BYTES = 1024;
+
+    explicit SimMpu6050(VibrationSource &source) : source(source) {}
+
+    void writeRegister(uint8_t reg, uint8_t value);
+    void readRegisters(uint8_t reg, uint8_t *buffer, size_t length);
+    uint32_t getGeneratedCount() const { return generated; }
+
+  private:
+    VibrationSource &source;
+    uint32_t samplePeriodMicros = 1000;
+    uint64_t nextSampleMicros = 0;
+    bool fifoEnabled = false;
+    bool overflow = false;
+    uint8_t fifo[FIFO_BYTES];
+    size_t fifoHead = 0;        // Next byte read
+    size_t fifoCount = 0;
+    uint32_t generated = 0;
+
+    void catchUp();
+    void push(int16_t value);
+    uint8_t pop();
+};
+
+#endif
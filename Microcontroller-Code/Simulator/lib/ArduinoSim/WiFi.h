@@ -0,0 +1,44 @@
+/*
+  WasherWatcher Simulator
+  "WiFi.h"
+
+  Arduino WiFi for the current board. Every board is "connected" at once. There is one access point, on the
+  channel set with Sim::setAccessPointChannel(); joining it moves the board to that channel, and a scan finds it
+  there (under whatever SSID was asked for) after blocking the board for as long as a real scan takes.
+*/
+
+#ifndef SIM_WIFI_H
+#define SIM_WIFI_H
+
+#include "Arduino.h"
+
+#define WIFI_OFF 0
+#define WIFI_STA 1
+#define WIFI_AP 2
+#define WIFI_AP_STA 3
+#define WL_CONNECTED 3
+
+class WiFiClass {
+  public:
+    void mode(int mode) {}
+    void begin(const char *ssid, const char *password);
+    void disconnect() {}
+    int status() { return WL_CONNECTED; }
+    int16_t scanNetworks(bool async = false, bool showHidden = false, bool passive = false, uint32_t msPerChannel = 300,
+                         uint8_t channel = 0, const char *ssid = NULL);
+    void scanDelete() {}
+    String SSID(uint8_t index) { return String(scannedSsid); }
+    int32_t channel(uint8_t index);
+    int32_t channel();
+    void printDiag(Print &out) {}
+    String macAddress();
+    uint8_t *macAddress(uint8_t *mac);
+    String softAPmacAddress() { return macAddress(); }
+    String localIP() { return String("127.0.0.1"); }
+
+  private:
+    std::string scannedSsid;
+};
+extern WiFiClass WiFi;
+
+#endif
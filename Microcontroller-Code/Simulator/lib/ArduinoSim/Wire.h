@@ -0,0 +1,41 @@
+/*
+  WasherWatcher Simulator
+  "Wire.h"
+
+  Arduino TwoWire, talking to the simulated MPU6050 on the current board.
+*/
+
+#ifndef SIM_WIRE_H
+#define SIM_WIRE_H
+
+#include "Arduino.h"
+
+#define I2C_BUFFER_LENGTH 128
+
+/*********************** TwoWire Class Definition *************************
+ * Supports the two transactions the MPU6050Fifo driver makes: a register
+ * write (register, value) and a register read (register, then requestFrom).
+ *************************************************************************/
+class TwoWire {
+  public:
+    bool begin() { return true; }
+    void setClock(uint32_t clockHz) {}
+    void beginTransmission(uint8_t address);
+    size_t write(uint8_t value);
+    uint8_t endTransmission(bool sendStop = true);
+    uint8_t requestFrom(uint8_t address, uint8_t length);
+    int available() { return rxLength - rxIndex; }
+    int read();
+
+  private:
+    uint8_t address = 0;
+    uint8_t txBuffer[I2C_BUFFER_LENGTH];
+    size_t txLength = 0;
+    uint8_t rxBuffer[I2C_BUFFER_LENGTH];
+    size_t rxLength = 0;
+    size_t rxIndex = 0;
+    uint8_t readRegister = 0;
+};
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,18 @@
+/*
+  WasherWatcher Simulator
+  "esp_wifi.h"
+
+  Channel control of the ESP32 core, moving the current board's radio (see Sim::Board::channel).
+*/
+
+#ifndef SIM_ESP_WIFI_H
+#define SIM_ESP_WIFI_H
+
+#include "esp_now.h"
+
+#define WIFI_SECOND_CHAN_NONE 0
+
+inline esp_err_t esp_wifi_set_promiscuous(bool) { return ESP_OK; }
+esp_err_t esp_wifi_set_channel(uint8_t primary, int second);
+
+#endif
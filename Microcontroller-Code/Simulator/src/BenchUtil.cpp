@@ -0,0 +1,26 @@
+/*
+  WasherWatcher Simulator
+  "BenchUtil.cpp"
+*/
+
+#include "BenchUtil.h"
+#include <stdio.h>
+
+namespace {
+  // Only one bench runs per process, so they all count here
+  unsigned checks = 0;
+  unsigned failures = 0;
+}
+
+void Bench::check(bool passed, const char *what) {
+  checks++;
+  if (!passed) {
+    failures++;
+    printf("FAILED: %s\n", what);
+  }
+}
+
+int Bench::reportChecks(const char *label) {
+  printf("%-25s%u of %u passed\n", label, checks - failures, checks);
+  return (failures == 0) ? 0 : 1;
+}
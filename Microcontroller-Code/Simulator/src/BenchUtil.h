@@ -0,0 +1,42 @@
+/*
+  WasherWatcher Simulator
+  "BenchUtil.h"
+
+  What the --bench-* runs share: counting their checks, a cheap random source, and timing.
+*/
+
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <stdint.h>
+#include <chrono>
+
+namespace Bench {
+
+  // Counts a check, printing what was expected if it failed
+  void check(bool passed, const char *what);
+
+  // Prints how many checks passed after label (e.g. "Journal checks:"). Returns 0 if all of them did, 1 otherwise.
+  int reportChecks(const char *label);
+
+  // Small xorshift32, so the timed loops aren't dominated by the generator
+  inline uint32_t nextRandom(uint32_t &state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  inline double millisSince(std::chrono::steady_clock::time_point start) {
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+  }
+
+  // Average ns for each of count operations timed from start
+  inline double nanosSince(std::chrono::steady_clock::time_point start, uint32_t count) {
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / count;
+  }
+}
+
+#endif
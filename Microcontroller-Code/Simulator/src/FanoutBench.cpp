@@ -0,0 +1,225 @@
+/*
+  WasherWatcher Simulator
+  "FanoutBench.cpp"
+*/
+
+#include "FanoutBench.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <EventFanout.h>
+
+using namespace Bench;
+
+namespace {
+  const size_t BENCH_CLIENTS = 1000;
+  const size_t BENCH_MACHINES = 24;
+  const uint32_t ROUNDS = 2000;             // Flushes timed (8 minutes of flushes every 250 ms)
+  const uint32_t UPDATES_PER_ROUND = 3;     // Machines changed per flush, far busier than a real laundry room
+  const size_t FAST_WINDOW = 5744;          // Bytes a browser's connection takes per flush (a full TCP send buffer)
+  const size_t SLOW_WINDOW = 160;           // ... for a phone on a poor link, about one event per flush
+
+  typedef EventFanout<BENCH_CLIENTS> BenchFanout;
+
+  // One machine's status as the receiver would write it, with a value counting its updates
+  std::string machineJson(size_t machine, uint32_t value) {
+    char json[128];
+    snprintf(json, sizeof(json), "{\"id\":\"MACHINE_%04X\",\"m\":%u,\"v\":%u,\"status\":true,\"phase\":2,\"remaining\":1234567}",
+             (unsigned) machine, (unsigned) machine, (unsigned) value);
+    return json;
+  }
+
+  /******************* BenchClient Class Definition *************************
+   * A browser's connection that takes up to window bytes per flush, and
+   * parses the events it is sent to follow the value of every machine.
+   *************************************************************************/
+  class BenchClient : public EventTransport {
+    public:
+      size_t window = FAST_WINDOW;
+      size_t room = 0;                // Bytes it still takes this flush
+      uint32_t events = 0;
+      bool wentBack = false;          // Was ever sent an older value of a machine after a newer one
+      std::vector<int64_t> values = std::vector<int64_t>(BENCH_MACHINES, -1);
+
+      size_t write(const char *data, size_t length) override {
+        size_t taken = (length < this->room) ? length : this->room;
+        this->room -= taken;
+        this->text.append(data, taken);
+        parse();
+        return taken;
+      }
+      void flush() override {}
+
+    private:
+      std::string text;
+
+      void parse() {
+        size_t end;
+        while ((end = this->text.find("\n\n")) != std::string::npos) {
+          this->events++;
+          const char *cursor = this->text.c_str();
+          const char *last = cursor + end;
+          while ((cursor = strstr(cursor, "\"m\":")) != NULL && cursor < last) {
+            size_t machine = strtoul(cursor + 4, NULL, 10);
+            cursor = strstr(cursor, "\"v\":");
+            int64_t value = strtol(cursor + 4, NULL, 10);
+            if (value < this->values[machine]) { this->wentBack = true; }
+            this->values[machine] = value;
+          }
+          this->text.erase(0, end + 2);
+        }
+      }
+  };
+
+  // Stalled browsers take nothing until the end, a few take a trickle, the rest all they are sent
+  size_t windowFor(size_t client) {
+    if (client % 20 == 0) { return 0; }
+    if (client % 20 <= 3) { return SLOW_WINDOW; }
+    return FAST_WINDOW;
+  }
+
+  // Connects every client to a snapshot built once, and turns away one client too many
+  void connectAll(BenchFanout &fanout, std::vector<BenchClient> &clients, std::vector<int> &slots,
+                  const std::vector<uint32_t> &values) {
+    std::string snapshot = "[";
+    for (size_t machine = 0; machine < BENCH_MACHINES; machine++) {
+      snapshot += (machine ? "," : "") + machineJson(machine, values[machine]);
+      fanout.publish(machine, ("[" + machineJson(machine, values[machine]) + "]").c_str(), 0);
+    }
+    snapshot += "]";
+
+    for (size_t i = 0; i < BENCH_CLIENTS; i++) {
+      if (fanout.snapshotDue(0)) { fanout.publishSnapshot(snapshot.c_str(), 0, 0); }
+      clients[i].window = windowFor(i);
+      clients[i].room = clients[i].window;
+      slots[i] = fanout.connect(&clients[i]);
+    }
+    BenchClient extra;
+    check(fanout.connect(&extra) < 0, "a client past the limit is refused");
+    check(fanout.getStats().rejected == 1, "refused clients are counted");
+    check(fanout.count() == BENCH_CLIENTS, "every client under the limit is connected");
+    check(fanout.getStats().snapshots == 1, "one snapshot is serialized for every client connecting at once");
+  }
+
+  // Per-browser message queues like AsyncEventSource's: every event copied for every browser, sent in order
+  // to the same simulated connections
+  double timeCopyPerClient(const std::vector<size_t> &updates, size_t &peakQueuedBytes) {
+    std::vector<BenchClient> clients(BENCH_CLIENTS);
+    std::vector<std::deque<std::string> > queues(BENCH_CLIENTS);
+    std::vector<uint32_t> values(BENCH_MACHINES, 0);
+    size_t totalQueued = 0;
+    peakQueuedBytes = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t round = 0; round < ROUNDS; round++) {
+      for (uint32_t u = 0; u < UPDATES_PER_ROUND; u++) {
+        size_t machine = updates[round * UPDATES_PER_ROUND + u];
+        char message[256];
+        snprintf(message, sizeof(message), "event: machine_status\nid: %u\ndata: [%s]\n\n",
+                 (unsigned) round, machineJson(machine, ++values[machine]).c_str());
+        for (size_t i = 0; i < BENCH_CLIENTS; i++) {
+          queues[i].push_back(message);
+          totalQueued += queues[i].back().size();
+        }
+      }
+      for (size_t i = 0; i < BENCH_CLIENTS; i++) {
+        clients[i].room = windowFor(i);
+        while (!queues[i].empty() && queues[i].front().size() <= clients[i].room) {
+          clients[i].write(queues[i].front().c_str(), queues[i].front().size());
+          totalQueued -= queues[i].front().size();
+          queues[i].pop_front();
+        }
+      }
+      if (totalQueued > peakQueuedBytes) { peakQueuedBytes = totalQueued; }
+    }
+    return millisSince(start);
+  }
+}
+
+int runFanoutBench() {
+  std::unique_ptr<BenchFanout> fanout(new BenchFanout());
+  std::vector<BenchClient> clients(BENCH_CLIENTS);
+  std::vector<int> slots(BENCH_CLIENTS);
+  std::vector<uint32_t> values(BENCH_MACHINES, 0);
+  connectAll(*fanout, clients, slots, values);
+
+  // Random machines change each flush; one changing twice in a flush is only sent once, even to fast clients
+  std::vector<size_t> updates;
+  uint32_t state = 1;
+  uint32_t distinctUpdates = 0;
+  for (uint32_t round = 0; round < ROUNDS; round++) {
+    uint32_t changed = 0;
+    for (uint32_t u = 0; u < UPDATES_PER_ROUND; u++) {
+      updates.push_back(nextRandom(state) % BENCH_MACHINES);
+      changed |= 1UL << updates.back();
+    }
+    distinctUpdates += __builtin_popcount(changed);
+  }
+
+  // Every flush, publish a few machines and write every client what its connection takes
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t round = 0; round < ROUNDS; round++) {
+    for (BenchClient &client : clients) { client.room = client.window; }
+    for (uint32_t u = 0; u < UPDATES_PER_ROUND; u++) {
+      size_t machine = updates[round * UPDATES_PER_ROUND + u];
+      fanout->publish(machine, ("[" + machineJson(machine, ++values[machine]) + "]").c_str(), round);
+    }
+    fanout->pumpAll();
+  }
+  double fanoutMs = millisSince(start);
+  FanoutStats during = fanout->getStats();
+
+  // The stalled clients catch up: they only need each machine's latest event
+  uint32_t catchUpRounds = 0;
+  uint32_t written;
+  do {
+    for (BenchClient &client : clients) { client.room = client.window = FAST_WINDOW; }
+    written = fanout->getStats().bytesWritten;
+    fanout->pumpAll();
+    catchUpRounds++;
+  } while (fanout->getStats().bytesWritten != written && catchUpRounds < 100);
+
+  bool allCurrent = true, wentBack = false, fastGotAll = true;
+  uint32_t stalledEvents = 0;
+  for (size_t i = 0; i < BENCH_CLIENTS; i++) {
+    for (size_t machine = 0; machine < BENCH_MACHINES; machine++) {
+      if (clients[i].values[machine] != (int64_t) values[machine]) { allCurrent = false; }
+    }
+    wentBack |= clients[i].wentBack;
+    if (windowFor(i) == FAST_WINDOW && clients[i].events != 1 + distinctUpdates) { fastGotAll = false; }
+    if (windowFor(i) == 0) { stalledEvents = clients[i].events; }
+  }
+  check(allCurrent, "every client ends up with every machine's latest value");
+  check(!wentBack, "no client is ever sent an older value after a newer one");
+  check(fastGotAll, "clients that keep up are sent every flush's event for every machine");
+  check(stalledEvents <= 1 + BENCH_MACHINES, "a stalled client catches up with at most one event per machine");
+  check(during.superseded > 0, "slow clients skip superseded events");
+
+  for (size_t i = 0; i < BENCH_CLIENTS; i += 2) { fanout->disconnect(slots[i]); }
+  check(fanout->count() == BENCH_CLIENTS / 2, "disconnected clients free their slots");
+  BenchClient late;
+  late.room = FAST_WINDOW;
+  check(fanout->connect(&late) >= 0, "a freed slot takes a new client");
+
+  size_t copyPeakBytes;
+  double copyMs = timeCopyPerClient(updates, copyPeakBytes);
+
+  uint32_t published = ROUNDS * UPDATES_PER_ROUND;
+  printf("Fan-out:                 %u clients (5%% stalled, 15%% slow), %u events: %.2f ms per flush, %.1f us per event (%.0f ns per client)\n",
+         (unsigned) BENCH_CLIENTS, (unsigned) published, fanoutMs / ROUNDS, fanoutMs * 1000 / published,
+         fanoutMs * 1e6 / published / BENCH_CLIENTS);
+  printf("                         %u superseded, stalled clients caught up in %u flushes with %u events each, %.1f MB written\n",
+         (unsigned) during.superseded, (unsigned) catchUpRounds, (unsigned) stalledEvents, fanout->getStats().bytesWritten / 1e6);
+  printf("                         %u bytes of fixed buffers (%u per client slot, %u per event)\n",
+         (unsigned) sizeof(BenchFanout), (unsigned) sizeof(FanoutClient), (unsigned) BenchFanout::EVENT_BYTES);
+  printf("Copy per client:         %.2f ms per flush, %.1f us per event, queues peaked at %.1f MB\n",
+         copyMs / ROUNDS, copyMs * 1000 / published, copyPeakBytes / 1e6);
+  return Bench::reportChecks("Fan-out checks:");
+}
@@ -0,0 +1,16 @@
+/*
+  WasherWatcher Simulator
+  "FanoutBench.h"
+
+  Feeds the receiver's Server-Sent Events fan-out to 1000 simulated browsers, some slow and some stalled,
+  checks every one ends up with every machine's latest status, and compares its time and memory with
+  queueing a copy of every event per browser.
+*/
+
+#ifndef FANOUT_BENCH_H
+#define FANOUT_BENCH_H
+
+// Runs the checks and timings, printing the results. Returns 0 if every check passed, 1 otherwise.
+int runFanoutBench();
+
+#endif
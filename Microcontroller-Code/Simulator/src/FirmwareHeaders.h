@@ -0,0 +1,57 @@
+/*
+  WasherWatcher Simulator
+  "FirmwareHeaders.h"
+
+  Every header the sender and receiver firmware include. The firmware's main.cpp files are compiled
+  inside a namespace (see SimSender.cpp and SimReceiver.cpp); including their headers here first, at
+  global scope, turns the #includes inside the namespace into no-ops through the include guards.
+  A header added to either firmware must be added here too.
+*/
+
+#ifndef FIRMWARE_HEADERS_H
+#define FIRMWARE_HEADERS_H
+
+// Simulated Arduino core
+#include <Arduino.h>
+#include <esp_now.h>
+#include <esp_wifi.h>
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <Wire.h>
+#include <Arduino_JSON.h>
+#include <AsyncTCP.h>
+#include <ESPAsyncWebServer.h>
+#include <SPIFFS.h>
+#include <Preferences.h>
+
+// Shared libraries
+#include <MPU6050Fifo.h>
+#include <WireBus.h>
+#include <VibrationKernel.h>
+#include <SampleWindow.h>
+#include <SpectralDetector.h>
+#include <MachineDetector.h>
+#include <TransmitPolicy.h>
+#include <LaundryProtocol.h>
+#include <TraceFormat.h>
+#include <SenderConfig.h>
+#include <ChannelSearch.h>
+#include <RetryBackoff.h>
+#include <DeliveryQueue.h>
+#include <PeriodicTimer.h>
+
+// Receiver libraries and generated files
+#include <SpscQueue.h>
+#include <MachineStateTable.h>
+#include <MachineRegistry.h>
+#include <JsonWriter.h>
+#include <HistoryRing.h>
+#include <UplinkQueue.h>
+#include <Metrics.h>
+#include <EventFanout.h>
+#include <StateJournal.h>
+#include <FsJournalStorage.h>
+#include <Log.h>
+#include <WebAssets.h>
+
+#endif
@@ -0,0 +1,445 @@
+/*
+  WasherWatcher Simulator
+  "JournalBench.cpp"
+*/
+
+#include "JournalBench.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <StateJournal.h>
+#include <LaundryProtocol.h>
+
+using namespace Bench;
+
+namespace {
+  const size_t BENCH_MACHINES = 24;
+  const size_t WORKLOAD_CHANGES = 1500;     // State changes in the crash runs, enough for a few checkpoints
+  const uint32_t MIN_GAP_MS = 200;          // Time between two changes, anywhere in the laundry room
+  const uint32_t MAX_GAP_MS = 4000;
+  const size_t CONTINUED_CHANGES = 40;      // Changes made after a restart, which must survive the next one
+  const unsigned RESTORES = 200;            // Restores of a full journal timed
+
+  const char *JOURNAL_FILES[] = {"/journal0.ckp", "/journal1.ckp", "/journal.log"};
+
+  /*
+    JournalStorage on real files in a directory, standing in for the receiver's flash. Every byte appended
+    and every file removed costs one unit; once the units given to cutPowerAfter() run out, the power is cut:
+    the append that ran out keeps only the bytes it had units for (then, on odd cut points, erased 0xFF bytes
+    for the rest, as a half-programmed page reads back), and every write after it fails until powerOn().
+  */
+  class FlashEmulator : public JournalStorage {
+    public:
+      // A write the journal made, in units from the start of the run
+      typedef struct {
+        uint64_t start;
+        uint64_t units;
+      } Write;
+
+      explicit FlashEmulator(const std::string &directory) : directory(directory) {}
+
+      void cutPowerAfter(uint64_t units) { this->budget = units; this->cutting = true; }
+      void powerOn() { this->powered = true; this->cutting = false; }
+      bool isPowered() const { return this->powered; }
+      uint64_t getUnits() const { return this->used; }
+      const std::vector<Write> &getWrites() const { return this->writes; }
+
+      // Removes every file and starts counting units from 0
+      void erase() {
+        for (const char *path : JOURNAL_FILES) { ::remove(file(path).c_str()); }
+        this->used = 0;
+        this->writes.clear();
+        powerOn();
+      }
+
+      // Flips every bit of one byte of a file
+      void corrupt(const char *path, size_t offset) {
+        FILE *handle = fopen(file(path).c_str(), "r+b");
+        if (handle == NULL) { return; }
+        fseek(handle, (long) offset, SEEK_SET);
+        int value = fgetc(handle);
+        fseek(handle, (long) offset, SEEK_SET);
+        fputc(~value & 0xFF, handle);
+        fclose(handle);
+      }
+
+      size_t size(const char *path) override {
+        struct stat info;
+        return (stat(file(path).c_str(), &info) == 0) ? (size_t) info.st_size : 0;
+      }
+
+      size_t read(const char *path, size_t offset, uint8_t *buffer, size_t length) override {
+        FILE *handle = fopen(file(path).c_str(), "rb");
+        if (handle == NULL) { return 0; }
+        size_t count = (fseek(handle, (long) offset, SEEK_SET) == 0) ? fread(buffer, 1, length, handle) : 0;
+        fclose(handle);
+        return count;
+      }
+
+      bool append(const char *path, const uint8_t *data, size_t length) override {
+        if (!this->powered) { return false; }
+        size_t allowed = take(length);
+        FILE *handle = fopen(file(path).c_str(), "ab");
+        if (handle == NULL) { return false; }
+        fwrite(data, 1, allowed, handle);
+        if (allowed < length && (this->budget & 1)) {
+          std::vector<uint8_t> erased(length - allowed, 0xFF);
+          fwrite(erased.data(), 1, erased.size(), handle);
+        }
+        fclose(handle);
+        return allowed == length;
+      }
+
+      bool remove(const char *path) override {
+        if (!this->powered || take(1) < 1) { return false; }
+        ::remove(file(path).c_str());
+        return true;
+      }
+
+    private:
+      std::string directory;
+      bool powered = true;
+      bool cutting = false;
+      uint64_t budget = 0;
+      uint64_t used = 0;
+      std::vector<Write> writes;
+
+      std::string file(const char *path) const { return this->directory + path; }
+
+      // Spends units on a write, cutting the power if there aren't enough. Returns how many it got.
+      size_t take(size_t units) {
+        this->writes.push_back({this->used, units});
+        if (this->cutting && this->used + units > this->budget) {
+          size_t allowed = (size_t) (this->budget - this->used);
+          this->used = this->budget;
+          this->powered = false;
+          return allowed;
+        }
+        this->used += units;
+        return units;
+      }
+  };
+
+  // Every machine's latest state, as the journal should hold it
+  class Model {
+    public:
+      std::vector<JournalEntry> machines;
+
+      void apply(const JournalEntry &entry) {
+        for (JournalEntry &machine : this->machines) {
+          if (memcmp(machine.mac, entry.mac, 6) == 0) {
+            machine = entry;
+            return;
+          }
+        }
+        if (this->machines.size() < StateJournal::MAX_MACHINES) { this->machines.push_back(entry); }
+      }
+
+      // True if the journal holds exactly these machines, in any order
+      bool matches(const StateJournal &journal) const {
+        if (journal.count() != this->machines.size()) { return false; }
+        for (size_t i = 0; i < journal.count(); i++) {
+          const JournalEntry &restored = journal.at(i);
+          bool found = false;
+          for (const JournalEntry &machine : this->machines) {
+            if (memcmp(machine.mac, restored.mac, 6) == 0) {
+              found = machine.machineId == restored.machineId && machine.state == restored.state &&
+                      machine.timeMs == restored.timeMs && strcmp(machine.name, restored.name) == 0;
+            }
+          }
+          if (!found) { return false; }
+        }
+        return true;
+      }
+  };
+
+  // Entries passed to the replay callback, which must add up to what the journal restored
+  Model replayed;
+
+  void onReplay(const JournalEntry &entry) {
+    replayed.apply(entry);
+  }
+
+  // A made up laundry room: machines going on, through their phases and off again, in random order
+  std::vector<JournalEntry> makeChanges(size_t count, uint32_t startMs, uint32_t seed) {
+    std::vector<JournalEntry> changes;
+    uint8_t states[BENCH_MACHINES] = {};
+    uint32_t timeMs = startMs;
+    for (size_t i = 0; i < count; i++) {
+      size_t machine = nextRandom(seed) % BENCH_MACHINES;
+      uint8_t state = states[machine];
+      while (state == states[machine]) {
+        uint32_t pick = nextRandom(seed) % 4;
+        state = (pick == 0) ? 0 : (uint8_t) (LaundryProtocol::STATE_ON_BIT | pick);
+      }
+      states[machine] = state;
+      timeMs += MIN_GAP_MS + nextRandom(seed) % (MAX_GAP_MS - MIN_GAP_MS);
+
+      JournalEntry entry;
+      uint8_t mac[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, (uint8_t) machine};
+      memcpy(entry.mac, mac, 6);
+      snprintf(entry.name, sizeof(entry.name), "FARRIS_%s_%u", (machine % 2) ? "DRYER" : "WASHER", (unsigned) machine / 2 + 1);
+      entry.machineId = LaundryProtocol::machineIdFromName(entry.name);
+      entry.state = state;
+      entry.timeMs = timeMs;
+      changes.push_back(entry);
+    }
+    return changes;
+  }
+
+  /*
+    Feeds changes to the journal the way the receiver's frame worker does, flushing whenever it asks to.
+    Stops early if the power goes. durable is raised to the number of changes a finished flush covered,
+    issued to the number handed to the journal.
+  */
+  void runChanges(StateJournal &journal, FlashEmulator &flash, const std::vector<JournalEntry> &changes,
+                  size_t &durable, size_t &issued) {
+    for (size_t i = 0; i < changes.size() && flash.isPowered(); i++) {
+      uint32_t nowMs = changes[i].timeMs;
+      if (journal.msUntilFlush(nowMs) == 0) {
+        journal.flush(nowMs);
+        if (flash.isPowered()) { durable = issued; }
+      }
+      if (!flash.isPowered()) { return; }
+      journal.record(changes[i]);
+      issued = i + 1;
+    }
+    if (flash.isPowered()) {
+      journal.flush(changes.back().timeMs + StateJournal::FLUSH_INTERVAL_MS);
+      if (flash.isPowered()) { durable = issued; }
+    }
+  }
+
+  // True if the journal holds the state after some number of changes between durable and issued
+  bool matchesPrefix(const StateJournal &journal, const std::vector<JournalEntry> &changes, size_t durable, size_t issued) {
+    Model model;
+    for (size_t i = 0; i < durable; i++) { model.apply(changes[i]); }
+    for (size_t i = durable; ; i++) {
+      if (model.matches(journal)) { return true; }
+      if (i >= issued) { return false; }
+      model.apply(changes[i]);
+    }
+  }
+
+  uint32_t latestTime(const StateJournal &journal) {
+    uint32_t latest = 0;
+    for (size_t i = 0; i < journal.count(); i++) {
+      if ((int32_t) (journal.at(i).timeMs - latest) > 0) { latest = journal.at(i).timeMs; }
+    }
+    return latest;
+  }
+
+  /*
+    Cuts the power at the start, the second unit, the middle and the last unit of every write the workload
+    makes, restarts, and checks that the restored state is one the receiver actually passed through, no
+    older than its last finished flush; that replay reported it; and that the journal carries on from there.
+  */
+  void checkPowerCuts(FlashEmulator &flash) {
+    std::vector<JournalEntry> changes = makeChanges(WORKLOAD_CHANGES, 1000, 7);
+
+    flash.erase();
+    StateJournal dry(flash);
+    dry.restore(NULL);
+    size_t durable = 0, issued = 0;
+    runChanges(dry, flash, changes, durable, issued);
+    check(dry.getStats().checkpoints >= 3, "the workload checkpoints a few times");
+    size_t writes = flash.getWrites().size();
+    uint64_t units = flash.getUnits();
+    std::vector<uint64_t> cuts;
+    for (const FlashEmulator::Write &write : flash.getWrites()) {
+      uint64_t points[4] = {write.start, write.start + 1, write.start + write.units / 2, write.start + write.units - 1};
+      for (uint64_t point : points) {
+        if (point < write.start + write.units && (cuts.empty() || point > cuts.back())) { cuts.push_back(point); }
+      }
+    }
+
+    unsigned lost = 0, badReplays = 0, stuck = 0, clocksBehind = 0;
+    uint32_t discarded = 0;
+    for (uint64_t cut : cuts) {
+      flash.erase();
+      StateJournal before(flash);
+      before.restore(NULL);
+      flash.cutPowerAfter(cut);
+      durable = issued = 0;
+      runChanges(before, flash, changes, durable, issued);
+
+      flash.powerOn();
+      StateJournal after(flash);
+      replayed = Model();
+      after.restore(onReplay);
+      discarded += after.getStats().discardedBytes;
+      if (!matchesPrefix(after, changes, durable, issued)) { lost++; }
+      if (!replayed.matches(after)) { badReplays++; }
+      uint32_t clockMs = after.getClockMs();
+      if (after.count() > 0 && (int32_t) (clockMs - latestTime(after)) < 0) { clocksBehind++; }
+
+      // Changes after the restart must not be hidden behind whatever the power cut left in the log
+      Model expected;
+      for (size_t i = 0; i < after.count(); i++) { expected.apply(after.at(i)); }
+      std::vector<JournalEntry> more = makeChanges(CONTINUED_CHANGES, clockMs, (uint32_t) cut + 1);
+      size_t moreDurable = 0, moreIssued = 0;
+      runChanges(after, flash, more, moreDurable, moreIssued);
+      for (const JournalEntry &entry : more) { expected.apply(entry); }
+      StateJournal again(flash);
+      again.restore(NULL);
+      if (!expected.matches(again)) { stuck++; }
+    }
+
+    printf("Journal power cuts:      %u cut points over %u writes (%llu units), %u bytes of torn records discarded\n",
+           (unsigned) cuts.size(), (unsigned) writes, (unsigned long long) units, (unsigned) discarded);
+    check(lost == 0, "after a power cut, the journal restores a state the room was in, as of the last flush or later");
+    check(badReplays == 0, "replay reports every machine's restored state");
+    check(clocksBehind == 0, "the restored clock isn't behind any restored state");
+    check(stuck == 0, "changes after the restart survive the next restart");
+  }
+
+  // Damaged files (not torn writes) are skipped, never taken in
+  void checkCorruption(FlashEmulator &flash) {
+    std::vector<JournalEntry> changes = makeChanges(WORKLOAD_CHANGES, 1000, 11);
+    size_t durable = 0, issued = 0;
+
+    flash.erase();
+    StateJournal journal(flash);
+    journal.restore(NULL);
+    runChanges(journal, flash, changes, durable, issued);
+    size_t logBytes = flash.size("/journal.log");
+    flash.corrupt("/journal.log", logBytes / 2);
+    StateJournal damagedLog(flash);
+    damagedLog.restore(NULL);
+    check(damagedLog.getStats().discardedBytes > 0 && damagedLog.getStats().discardedBytes < logBytes,
+          "a corrupt log record ends the replay there");
+    check(matchesPrefix(damagedLog, changes, 0, issued), "the log is replayed up to the corrupt record");
+
+    flash.erase();
+    StateJournal second(flash);
+    second.restore(NULL);
+    runChanges(second, flash, changes, durable, issued);
+    uint32_t generation = second.getStats().generation;
+    const char *newest = (generation & 1) ? "/journal1.ckp" : "/journal0.ckp";
+    flash.corrupt(newest, flash.size(newest) / 2);
+    StateJournal damagedCheckpoint(flash);
+    damagedCheckpoint.restore(NULL);
+    check(damagedCheckpoint.getStats().generation == generation,
+          "a corrupt checkpoint is passed over for the older one");
+    check(matchesPrefix(damagedCheckpoint, changes, 0, issued), "the older checkpoint's state is restored");
+  }
+
+  // The journal keeps MAX_MACHINES machines and turns the rest away; writes come in batches
+  void checkLimits(FlashEmulator &flash) {
+    flash.erase();
+    StateJournal journal(flash);
+    journal.restore(NULL);
+    JournalEntry entry = {};
+    for (uint32_t i = 0; i <= StateJournal::MAX_MACHINES; i++) {
+      entry.mac[4] = (uint8_t) (i >> 8);
+      entry.mac[5] = (uint8_t) i;
+      entry.timeMs = 1000 + i;
+      journal.record(entry);
+    }
+    check(journal.count() == StateJournal::MAX_MACHINES && journal.getStats().droppedRecords == 1,
+          "a machine beyond MAX_MACHINES isn't journaled");
+    check(journal.msUntilFlush(1000) == StateJournal::FLUSH_INTERVAL_MS, "changes wait FLUSH_INTERVAL_MS for the next flush");
+    size_t writes = flash.getWrites().size();
+    journal.flush(1000 + StateJournal::FLUSH_INTERVAL_MS);
+    check(flash.getWrites().size() == writes + 1, "a flush is one write");
+    check(journal.msUntilFlush(1000 + StateJournal::FLUSH_INTERVAL_MS) == StateJournal::CLOCK_INTERVAL_MS,
+          "with nothing pending, the next write is a clock mark");
+
+    std::vector<JournalEntry> changes = makeChanges(WORKLOAD_CHANGES, 1000, 3);
+    size_t durable = 0, issued = 0;
+    flash.erase();
+    StateJournal room(flash);
+    room.restore(NULL);
+    runChanges(room, flash, changes, durable, issued);
+    const JournalStats &stats = room.getStats();
+    printf("Journal writes:          %u writes (%u flushes, %u checkpoints) for %u changes, %.1f bytes per change\n",
+           (unsigned) flash.getWrites().size(), (unsigned) stats.flushes, (unsigned) stats.checkpoints,
+           (unsigned) stats.records, (double) stats.bytesWritten / stats.records);
+  }
+
+  /*
+    Restore time of the largest journal the receiver can have: a checkpoint of MAX_MACHINES machines with
+    long names, and a log one flush short of CHECKPOINT_LOG_BYTES. restore() writes a new checkpoint and
+    log, so the files are put back between runs (outside the timing).
+  */
+  void timeRestore(FlashEmulator &flash, const std::string &directory) {
+    flash.erase();
+    StateJournal journal(flash);
+    journal.restore(NULL);
+    JournalEntry entry = {};
+    memset(entry.name, 'M', sizeof(entry.name) - 1);
+    uint32_t timeMs = 1000;
+    for (uint32_t i = 0; i < StateJournal::MAX_MACHINES; i++) {
+      entry.mac[5] = (uint8_t) i;
+      entry.timeMs = timeMs++;
+      journal.record(entry);
+    }
+    journal.checkpoint(timeMs);
+    size_t changes = 0;
+    uint32_t seed = 5;
+    while (journal.getLogBytes() < StateJournal::CHECKPOINT_LOG_BYTES - 200) {
+      entry.mac[5] = (uint8_t) (nextRandom(seed) % StateJournal::MAX_MACHINES);
+      entry.state = (uint8_t) (nextRandom(seed) & 0x83);
+      entry.timeMs = timeMs += 1000;
+      journal.record(entry);
+      journal.flush(timeMs);
+      changes++;
+    }
+
+    std::vector<std::vector<uint8_t>> saved;
+    for (const char *path : JOURNAL_FILES) {
+      std::vector<uint8_t> bytes(flash.size(path));
+      flash.read(path, 0, bytes.data(), bytes.size());
+      saved.push_back(bytes);
+    }
+
+    double totalUs = 0, worstUs = 0;
+    bool restored = true;
+    for (unsigned run = 0; run < RESTORES; run++) {
+      for (size_t i = 0; i < saved.size(); i++) {
+        std::string path = directory + JOURNAL_FILES[i];
+        FILE *handle = fopen(path.c_str(), "wb");
+        if (handle != NULL) {
+          fwrite(saved[i].data(), 1, saved[i].size(), handle);
+          fclose(handle);
+        }
+      }
+      StateJournal timed(flash);
+      auto start = std::chrono::steady_clock::now();
+      timed.restore(NULL);
+      std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+      totalUs += elapsed.count();
+      if (elapsed.count() > worstUs) { worstUs = elapsed.count(); }
+      if (timed.count() != StateJournal::MAX_MACHINES || timed.getStats().logRecords != changes) { restored = false; }
+    }
+    check(restored, "a full journal restores every machine and change");
+    printf("Journal restore:         %.0f us average, %.0f us worst (%u machines, %u bytes of log, %u changes replayed, %u runs)\n",
+           totalUs / RESTORES, worstUs, (unsigned) StateJournal::MAX_MACHINES, (unsigned) saved[2].size(),
+           (unsigned) changes, RESTORES);
+  }
+}
+
+int runJournalBench() {
+  char directory[] = "/tmp/washerwatcher-journal-XXXXXX";
+  if (mkdtemp(directory) == NULL) {
+    printf("FAILED: no directory for the flash emulator\n");
+    return 1;
+  }
+  FlashEmulator flash(directory);
+
+  checkLimits(flash);
+  checkCorruption(flash);
+  checkPowerCuts(flash);
+  timeRestore(flash, directory);
+
+  flash.erase();
+  rmdir(directory);
+  return Bench::reportChecks("Journal checks:");
+}
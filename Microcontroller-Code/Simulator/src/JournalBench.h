@@ -0,0 +1,15 @@
+/*
+  WasherWatcher Simulator
+  "JournalBench.h"
+
+  Checks the receiver's state journal on the host against a file-backed flash emulator, cutting the power at
+  every write along a day of state changes and restarting, and times restoring a full journal.
+*/
+
+#ifndef JOURNAL_BENCH_H
+#define JOURNAL_BENCH_H
+
+// Runs the checks and timings, printing the results. Returns 0 if every check passed, 1 otherwise.
+int runJournalBench();
+
+#endif
@@ -0,0 +1,181 @@
+/*
+  WasherWatcher Simulator
+  "MetricsBench.cpp"
+*/
+
+#include "MetricsBench.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <Metrics.h>
+#include <MachineStateTable.h>
+
+using namespace Bench;
+
+namespace {
+  const uint32_t RECORDS = 20000000;      // Histogram records timed
+  const uint32_t FRAMES = 5000000;        // State table updates timed
+  const size_t BENCH_MACHINES = 24;
+
+  // Every bucket holds durations up to its bound, and the next one starts just after it
+  void checkBuckets() {
+    check(LatencyHistogram::bucketFor(0) == 0, "0 us goes in the first bucket");
+    check(LatencyHistogram::bucketFor(1) == 0, "1 us goes in the first bucket");
+    for (size_t bucket = 0; bucket + 1 < LatencyHistogram::BUCKETS; bucket++) {
+      uint32_t bound = LatencyHistogram::upperBound(bucket);
+      check(LatencyHistogram::bucketFor(bound) == bucket, "a bucket's bound goes in that bucket");
+      check(LatencyHistogram::bucketFor(bound + 1) == bucket + 1, "just over a bucket's bound goes in the next");
+    }
+    check(LatencyHistogram::bucketFor(0xFFFFFFFF) == LatencyHistogram::BUCKETS - 1, "the longest duration goes in the last bucket");
+    check(LatencyHistogram::upperBound(LatencyHistogram::BUCKETS - 1) == 0, "the last bucket has no bound");
+
+    LatencyHistogram histogram;
+    const uint32_t durations[] = {0, 3, 4, 5, 250, 1000000, 90000000};
+    uint64_t sum = 0;
+    for (uint32_t micros : durations) {
+      histogram.record(micros);
+      sum += micros;
+    }
+    check(histogram.getTotal() == 7, "the total counts every record");
+    check(histogram.getSumMicros() == sum, "the sum adds every record");
+    check(histogram.getCount(1) == 2 && histogram.getCount(2) == 1 && histogram.getCount(4) == 1, "records land in their buckets");
+    check(histogram.getCount(LatencyHistogram::BUCKETS - 1) == 1, "a record over every bound lands in the last bucket");
+  }
+
+  // The text format, including the cumulative buckets and seconds with microsecond precision
+  void checkFormat() {
+    char line[128];
+    Prometheus::bucket(line, sizeof(line), "x_seconds", 2, 5);
+    check(strcmp(line, "x_seconds_bucket{le=\"0.000016\"} 5\n") == 0, "bucket line");
+    Prometheus::bucket(line, sizeof(line), "x_seconds", LatencyHistogram::BUCKETS - 1, 9);
+    check(strcmp(line, "x_seconds_bucket{le=\"+Inf\"} 9\n") == 0, "+Inf bucket line");
+    Prometheus::seconds(line, sizeof(line), "x_seconds_sum", NULL, NULL, 5000001234ULL);
+    check(strcmp(line, "x_seconds_sum 5000.001234\n") == 0, "sum in seconds");
+    Prometheus::sample(line, sizeof(line), "x_total", "machine", "FARRIS_DRYER_2", 42);
+    check(strcmp(line, "x_total{machine=\"FARRIS_DRYER_2\"} 42\n") == 0, "labelled sample");
+    int length = Prometheus::header(line, 8, "x_total", "counter", "Things");
+    check(length > 8 && strlen(line) == 7, "a line that doesn't fit reports its full length");
+  }
+
+  // One task records while another reads, as on the receiver: totals and sums never go backwards
+  void checkConcurrentReads() {
+    LatencyHistogram histogram;
+    std::atomic<bool> done(false);
+    bool monotonic = true;
+    uint32_t reads = 0;
+
+    std::thread reader([&]() {
+      uint32_t lastTotal = 0;
+      uint64_t lastSum = 0;
+      while (!done.load()) {
+        uint64_t sum = histogram.getSumMicros();
+        uint32_t total = histogram.getTotal();
+        if (total < lastTotal || sum < lastSum) { monotonic = false; }
+        lastTotal = total;
+        lastSum = sum;
+        reads++;
+      }
+    });
+    uint32_t state = 7;
+    for (uint32_t i = 0; i < RECORDS / 4; i++) { histogram.record(0xFFFF0000 | (nextRandom(state) & 0xFFFF)); }
+    done.store(true);
+    reader.join();
+
+    check(monotonic, "totals and sums read while recording never go backwards");
+    check(histogram.getTotal() == RECORDS / 4, "no record is lost while another task reads");
+    printf("Concurrent reads:        %u reads while recording, sum carried past 32 bits %s\n", (unsigned) reads,
+           histogram.getSumMicros() > 0xFFFFFFFFULL ? "yes" : "no");
+  }
+
+  // Sequence gaps, duplicates and reordering are counted against the right machine
+  void checkMachineCounters() {
+    MachineStateTable table;
+    DecodedFrame frame = {};
+    frame.version = LaundryProtocol::VERSION_2;
+    const uint8_t mac[6] = {2, 0, 0, 0, 0, 1};
+
+    const uint16_t sequences[] = {10, 11, 11, 14, 13, 15};   // A duplicate, two lost, one late
+    for (size_t i = 0; i < sizeof(sequences) / sizeof(sequences[0]); i++) {
+      frame.machineId = 0x1234;
+      frame.sequence = sequences[i];
+      frame.uptimeMs = 1000 + sequences[i] * 100;
+      table.update(0, frame, mac, 5000 + i * 100);
+    }
+    frame.machineId = 0x4321;
+    table.update(1, frame, mac, 6000);
+
+    const MachineState &state = table.at(0);
+    check(state.frames == 6 && state.duplicates == 1, "frames and duplicates per machine");
+    check(state.lostFrames == 2, "sequence numbers skipped per machine");
+    check(state.outOfOrder == 1, "frames older than the last per machine");
+    check(table.at(1).frames == 1 && table.at(1).lostFrames == 0, "another machine's counters are its own");
+  }
+
+  // A machine restored after a receiver restart keeps its state, and its sender's next frame starts its counters over
+  void checkRestore() {
+    MachineStateTable table;
+    const uint8_t mac[6] = {2, 0, 0, 0, 0, 1};
+    table.restore(0, mac, 0x1234, "FARRIS_WASHER_1", LaundryProtocol::stateCode(true, 2), 1000);
+    check(table.has(0) && table.at(0).machineOn && table.at(0).phase == 2 && table.at(0).lastTransitionMs == 1000,
+          "a restored machine has its state from before the restart");
+    check(table.takeDirty() == 0, "restoring doesn't mark machines dirty");
+
+    DecodedFrame frame = {};
+    frame.version = LaundryProtocol::VERSION_2;
+    frame.machineId = 0x1234;
+    frame.machineOn = true;
+    frame.phase = 2;
+    frame.sequence = 3;
+    frame.uptimeMs = 500;
+    check(table.update(0, frame, mac, 90000) == STATE_REPEAT, "the sender's unchanged state is a repeat");
+    check(table.at(0).frames == 1 && table.at(0).duplicates == 0 && table.at(0).lostFrames == 0,
+          "the first frame after a restore starts the counters");
+    check(table.at(0).lastTransitionMs == 1000, "a repeat keeps the restored transition time");
+    check(table.update(0, frame, mac, 90100) == STATE_DUPLICATE, "duplicate tracking picks up from there");
+  }
+
+  // Per-record cost of a histogram and of a state table update (which keeps the per-machine counters)
+  void timeRecording() {
+    LatencyHistogram histogram;
+    uint32_t state = 1;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < RECORDS; i++) { histogram.record(nextRandom(state) >> (nextRandom(state) & 31)); }
+    double recordNs = nanosSince(start, RECORDS);
+    check(histogram.getTotal() == RECORDS, "every timed record is counted");
+
+    MachineStateTable table;
+    DecodedFrame frame = {};
+    frame.version = LaundryProtocol::VERSION_2;
+    const uint8_t mac[6] = {2, 0, 0, 0, 0, 1};
+    std::vector<uint16_t> sequences(BENCH_MACHINES, 0);
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < FRAMES; i++) {
+      size_t machine = nextRandom(state) % BENCH_MACHINES;
+      frame.machineId = (uint16_t) (machine + 1);
+      frame.sequence = ++sequences[machine];
+      frame.uptimeMs = i * 10;
+      frame.machineOn = (i & 0x400) != 0;
+      table.update(machine, frame, mac, i * 10 + 3);
+    }
+    double updateNs = nanosSince(start, FRAMES);
+
+    printf("Histogram record:        %.1f ns per record (%u records)\n", recordNs, (unsigned) RECORDS);
+    printf("State table update:      %.1f ns per frame with per-machine counters (%u frames over %u machines)\n",
+           updateNs, (unsigned) FRAMES, (unsigned) BENCH_MACHINES);
+  }
+}
+
+int runMetricsBench() {
+  checkBuckets();
+  checkFormat();
+  checkMachineCounters();
+  checkRestore();
+  checkConcurrentReads();
+  timeRecording();
+  return Bench::reportChecks("Metrics checks:");
+}
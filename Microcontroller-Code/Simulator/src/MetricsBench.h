@@ -0,0 +1,15 @@
+/*
+  WasherWatcher Simulator
+  "MetricsBench.h"
+
+  Checks the receiver's latency histograms and per-machine counters on the host, and times how much
+  recording them costs per frame.
+*/
+
+#ifndef METRICS_BENCH_H
+#define METRICS_BENCH_H
+
+// Runs the checks and timings, printing the results. Returns 0 if every check passed, 1 otherwise.
+int runMetricsBench();
+
+#endif
@@ -0,0 +1,183 @@
+/*
+  WasherWatcher Simulator
+  "RegistryBench.cpp"
+*/
+
+#include "RegistryBench.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include <MachineRegistry.h>
+
+using namespace Bench;
+
+namespace {
+  const size_t BENCH_SENDERS = 500;       // Senders registered for the timings
+  const uint32_t LOOKUPS = 20000000;      // MAC lookups timed
+
+  typedef MachineRegistry<8> SmallRegistry;
+  typedef MachineRegistry<BENCH_SENDERS> LargeRegistry;
+
+  volatile uint64_t sink;   // Keeps the timed lookups from being optimized away
+
+  // Espressif's prefix, then the sender's number, the way boards off one reel differ in their last bytes
+  void senderMac(uint32_t number, uint8_t mac[6]) {
+    mac[0] = 0x24;
+    mac[1] = 0x6F;
+    mac[2] = 0x28;
+    mac[3] = (uint8_t) (number >> 16);
+    mac[4] = (uint8_t) (number >> 8);
+    mac[5] = (uint8_t) number;
+  }
+
+  // Good lines are added in order, bad ones are skipped and counted
+  void checkConfig() {
+    static SmallRegistry registry;
+    const char *config =
+      "# room,label,id[,mac]\r\n"
+      "Farris Hall,Washer 1,FARRIS_WASHER_1,24:6f:28:00:00:01\r\n"
+      "\r\n"
+      "  Farris Hall , Dryer 1 , FARRIS_DRYER_1  \r\n"
+      "Baker Hall,Washer 1,BAKER_WASHER_1\r\n"
+      "Baker Hall,Washer 2,BAKER_WASHER_2,24:6F:28:00:00:01\n"    // MAC already listed
+      "Baker Hall,Washer 3,FARRIS_WASHER_1\n"                     // Id already listed
+      "Baker Hall,Washer 4,BAKER_WASHER_4,24:6F:28:00:00\n"       // Not a MAC address
+      "Baker Hall,,BAKER_WASHER_5\n"                              // No label
+      "Baker Hall,Washer 6,BAKER_WASHER_6,24:6F:28:00:00:06,x\n"  // Too many fields
+      "Baker Hall,Washer 7";                                      // No id, and no newline at the end
+
+    check(registry.loadConfig(config) == 3, "three good lines are added");
+    check(registry.getRejectedLines() == 6, "bad lines are counted, comments and blank lines aren't");
+    check(registry.count() == 3 && registry.roomCount() == 2, "machines and rooms are counted");
+    check(strcmp(registry.at(1).label, "Dryer 1") == 0 && strcmp(registry.at(1).id, "FARRIS_DRYER_1") == 0,
+          "fields are trimmed");
+    check(strcmp(registry.room(registry.at(2).room), "Baker Hall") == 0, "machines keep their room");
+
+    uint8_t mac[6];
+    senderMac(1, mac);
+    check(registry.at(0).hasMac && registry.lookup(mac) == 0, "a listed MAC is bound from the start");
+    check(!registry.at(1).hasMac && !registry.at(2).hasMac, "machines listed without a MAC are unbound");
+  }
+
+  // Frames reach the slot bound to their MAC, whatever id they carry; unlisted senders get slots of their own
+  void checkResolve() {
+    static SmallRegistry registry;
+    registry.loadConfig("Farris Hall,Washer 1,FARRIS_WASHER_1,24:6F:28:00:00:01\n"
+                        "Farris Hall,Dryer 1,FARRIS_DRYER_1\n");
+    uint16_t washerId = LaundryProtocol::machineIdFromName("FARRIS_WASHER_1");
+    uint16_t dryerId = LaundryProtocol::machineIdFromName("FARRIS_DRYER_1");
+    uint8_t listed[6], first[6], second[6], stranger[6];
+    senderMac(1, listed);
+    senderMac(2, first);
+    senderMac(3, second);
+    senderMac(4, stranger);
+
+    check(registry.resolve(listed, 0x1234, NULL) == 0, "a listed MAC gets its slot whatever id it sends");
+    check(registry.lookup(first) == -1, "an unheard MAC has no slot");
+    check(registry.resolve(first, dryerId, NULL) == 1, "the first sender of a listed id takes its slot");
+    check(registry.lookup(first) == 1, "and is bound to it from then on");
+    check(registry.resolve(first, 0x1234, NULL) == 1, "a bound sender keeps its slot if its id changes");
+
+    int copy = registry.resolve(second, dryerId, "FARRIS_DRYER_1");
+    check(copy == 2, "a second sender with a taken id gets a new slot");
+    check(strcmp(registry.room(registry.at(copy).room), "Other") == 0, "unlisted senders are shown under Other");
+    int unknown = registry.resolve(stranger, washerId ^ 1, NULL);
+    char expected[16];
+    snprintf(expected, sizeof(expected), "MACHINE_%04X", washerId ^ 1);
+    check(unknown == 3 && strcmp(registry.at(unknown).id, expected) == 0, "a v2 sender nobody listed is named after its machine id");
+
+    uint8_t mac[6];
+    for (uint32_t number = 10; number < 14; number++) {
+      senderMac(number, mac);
+      registry.resolve(mac, (uint16_t) number, NULL);
+    }
+    senderMac(20, mac);
+    check(registry.count() == 8 && registry.resolve(mac, 20, NULL) == -1, "a full registry turns new senders away");
+    check(registry.resolve(stranger, 0, NULL) == 3, "a full registry still finds bound senders");
+  }
+
+  // Rooms in the order they are listed, machines in slot order, "Other" always available
+  void checkLayout() {
+    static SmallRegistry registry;
+    registry.loadConfig("A,Washer \"1\",A_1\nB,Dryer,B_1\nA,Washer 2,A_2\n");
+    uint8_t mac[6];
+    senderMac(9, mac);
+    registry.resolve(mac, 0xBEEF, NULL);
+
+    char json[SmallRegistry::LAYOUT_BYTES];
+    JsonWriter writer(json, sizeof(json));
+    check(registry.writeLayout(writer), "the layout fits");
+    check(strcmp(json, "{\"rooms\":["
+                       "{\"name\":\"A\",\"machines\":[{\"slot\":0,\"id\":\"A_1\",\"label\":\"Washer \\\"1\\\"\"},"
+                       "{\"slot\":2,\"id\":\"A_2\",\"label\":\"Washer 2\"}]},"
+                       "{\"name\":\"B\",\"machines\":[{\"slot\":1,\"id\":\"B_1\",\"label\":\"Dryer\"}]},"
+                       "{\"name\":\"Other\",\"machines\":[{\"slot\":3,\"id\":\"MACHINE_BEEF\",\"label\":\"MACHINE_BEEF\"}]}]}") == 0,
+          "layout JSON");
+
+    static SmallRegistry rooms;
+    rooms.loadConfig("R1,M,M1\nR2,M,M2\nR3,M,M3\nR4,M,M4\nR5,M,M5\nR6,M,M6\nR7,M,M7\nR8,M,M8\n");
+    check(rooms.count() == 7 && rooms.getRejectedLines() == 1, "the last room is kept for Other");
+    check(rooms.resolve(mac, 0xBEEF, NULL) == 7, "senders nobody listed still have a room");
+  }
+
+  // Cost of finding a sender's slot by MAC, against the linear scan a table keyed by id or MAC would do
+  void timeLookups() {
+    static LargeRegistry registry;
+    std::vector<uint8_t> macs(BENCH_SENDERS * 6);
+    for (size_t i = 0; i < BENCH_SENDERS; i++) {
+      senderMac((uint32_t) (i * 7 + 1), &macs[i * 6]);
+      registry.resolve(&macs[i * 6], (uint16_t) i, NULL);
+    }
+    bool allBound = (registry.count() == BENCH_SENDERS);
+    for (size_t i = 0; i < BENCH_SENDERS; i++) {
+      if (registry.lookup(&macs[i * 6]) != (int) i) { allBound = false; }
+    }
+    check(allBound, "every one of hundreds of senders is found in its own slot");
+
+    uint32_t state = 1;
+    uint64_t found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < LOOKUPS; i++) {
+      found += registry.lookup(&macs[(nextRandom(state) % BENCH_SENDERS) * 6]);
+    }
+    double hashNs = nanosSince(start, LOOKUPS);
+
+    uint8_t missing[6];
+    senderMac(0xFFFFFF, missing);
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < LOOKUPS; i++) {
+      missing[5] = (uint8_t) nextRandom(state);   // No sender registered above has 0xFF in its fourth byte
+      found += registry.lookup(missing) + 1;
+    }
+    double missNs = nanosSince(start, LOOKUPS);
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < LOOKUPS / 10; i++) {
+      const uint8_t *mac = &macs[(nextRandom(state) % BENCH_SENDERS) * 6];
+      for (size_t slot = 0; slot < registry.count(); slot++) {
+        if (memcmp(registry.at(slot).mac, mac, 6) == 0) {
+          found += slot;
+          break;
+        }
+      }
+    }
+    double scanNs = nanosSince(start, LOOKUPS / 10);
+    sink = found;
+
+    printf("Registry lookup:         %.1f ns per frame from a known sender (%u senders, %u lookups)\n",
+           hashNs, (unsigned) BENCH_SENDERS, (unsigned) LOOKUPS);
+    printf("Registry miss:           %.1f ns per frame from an unknown sender\n", missNs);
+    printf("Linear scan:             %.1f ns per frame over the same senders (%u lookups)\n", scanNs, (unsigned) (LOOKUPS / 10));
+  }
+}
+
+int runRegistryBench() {
+  checkConfig();
+  checkResolve();
+  checkLayout();
+  timeLookups();
+  return Bench::reportChecks("Registry checks:");
+}
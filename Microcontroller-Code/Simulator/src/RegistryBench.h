@@ -0,0 +1,15 @@
+/*
+  WasherWatcher Simulator
+  "RegistryBench.h"
+
+  Checks the receiver's machine registry (config parsing, binding senders to slots, the dashboard layout)
+  on the host, and times looking a sender's MAC address up with hundreds of senders registered.
+*/
+
+#ifndef REGISTRY_BENCH_H
+#define REGISTRY_BENCH_H
+
+// Runs the checks and timings, printing the results. Returns 0 if every check passed, 1 otherwise.
+int runRegistryBench();
+
+#endif
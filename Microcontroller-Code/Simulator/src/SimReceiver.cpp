@@ -0,0 +1,80 @@
+/*
+  WasherWatcher Simulator
+  "SimReceiver.cpp"
+*/
+
+#include "FirmwareHeaders.h"
+
+namespace ReceiverFirmware {
+#include "../../LaundryReceiver/src/main.cpp"
+}
+
+#include "SimReceiver.h"
+
+// Constructor, given the MAC address the senders send to
+SimReceiver::SimReceiver(const uint8_t mac[6]) {
+  memcpy(this->board.mac, mac, 6);
+  this->board.chipId = 1;
+  Sim::addBoard(this->board);
+}
+
+// Runs the firmware's setup(), which registers its ESP-NOW callback and starts the frame worker
+void SimReceiver::boot() {
+  Sim::setCurrentBoard(&this->board);
+  ReceiverFirmware::setup();
+  Sim::setCurrentBoard(NULL);
+}
+
+// Reads the receiver's counters
+ReceiverStats SimReceiver::getStats() {
+  using namespace ReceiverFirmware;
+  ReceiverStats stats;
+  stats.received = frameQueue.getPushedCount();
+  stats.dropped = frameQueue.getDroppedCount();
+  stats.highWater = frameQueue.getHighWater();
+  stats.capacity = frameQueue.capacity();
+  stats.malformed = malformedFrames;
+
+  xSemaphoreTake(stateTableMutex, portMAX_DELAY);
+  stats.machines = stateTable.count();
+  stats.link = stateTable.getLinkStats();
+  stats.uplinkQueued = uplinkQueue.getQueuedCount();
+  stats.uplinkBacklog = uplinkQueue.count();
+  stats.uplinkDropped = uplinkQueue.getDroppedCount();
+  xSemaphoreGive(stateTableMutex);
+  stats.tableCapacity = MachineStateTable::MAX_MACHINES;
+  stats.uplinkSent = uplinkRecordsSent;
+  stats.uplinkBatches = uplinkBatchesSent;
+  stats.uplinkFailures = uplinkFailures;
+  return stats;
+}
+
+/*
+  Issues a GET request to one of the receiver's routes, e.g. get("/api/history", "machine=X&since=0", body).
+  Returns the HTTP status code.
+*/
+int SimReceiver::get(const char *url, const char *query, std::string &body) {
+  std::vector<AsyncWebParameter> params;
+  std::string remaining = (query != NULL) ? query : "";
+  while (!remaining.empty()) {
+    size_t end = remaining.find('&');
+    std::string pair = remaining.substr(0, end);
+    size_t equals = pair.find('=');
+    if (equals != std::string::npos) {
+      params.push_back(AsyncWebParameter(pair.substr(0, equals), pair.substr(equals + 1)));
+    }
+    remaining = (end == std::string::npos) ? "" : remaining.substr(end + 1);
+  }
+
+  Sim::setCurrentBoard(&this->board);
+  int code = ReceiverFirmware::server.simulateGet(url, params, body);
+  Sim::setCurrentBoard(NULL);
+  return code;
+}
+
+// Connects a simulated browser to /events, which is sent the "snapshot" event
+void SimReceiver::connectClient() {
+  Sim::setCurrentBoard(&this->board);
+  ReceiverFirmware::server.simulateConnect("/events");
+  Sim::setCurrentBoard(NULL);
+}
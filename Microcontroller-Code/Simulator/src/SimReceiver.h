@@ -0,0 +1,50 @@
+/*
+  WasherWatcher Simulator
+  "SimReceiver.h"
+
+  The simulated receiver board, running the unmodified LaundryReceiver firmware.
+*/
+
+#ifndef SIM_RECEIVER_H
+#define SIM_RECEIVER_H
+
+#include <SimBoard.h>
+#include <MachineStateTable.h>
+#include <string>
+
+// The receiver's own view of how well it kept up (its /api/stats numbers plus machine counts)
+typedef struct {
+  uint32_t received;        // Frames OnDataRecv queued
+  uint32_t dropped;         // Frames OnDataRecv had no queue slot for
+  uint32_t highWater;       // Most frames ever waiting in the queue at once
+  uint32_t capacity;
+  uint32_t malformed;
+  LinkStats link;           // Duplicates, sequence gaps and arrival delays of the senders' frames
+  uint32_t machines;        // Machines in the state table
+  uint32_t tableCapacity;
+  uint32_t uplinkQueued;    // Records queued for the server
+  uint32_t uplinkBacklog;   // Records still waiting to be sent
+  uint32_t uplinkDropped;   // Records dropped because the backlog was full
+  uint32_t uplinkSent;      // Records the server accepted
+  uint32_t uplinkBatches;
+  uint32_t uplinkFailures;  // Sends that failed and were retried
+} ReceiverStats;
+
+/****************** SimReceiver Class Definition **************************
+ * There is only ever one receiver, so its firmware globals are used as is.
+ * setup() starts the real frame worker task (a thread in the simulator).
+ *************************************************************************/
+class SimReceiver {
+  public:
+    explicit SimReceiver(const uint8_t mac[6]);
+
+    void boot();
+    ReceiverStats getStats();
+    int get(const char *url, const char *query, std::string &body);
+    void connectClient();
+
+  private:
+    Sim::Board board;
+};
+
+#endif
@@ -0,0 +1,169 @@
+/*
+  WasherWatcher Simulator
+  "SimSender.cpp"
+*/
+
+#include "FirmwareHeaders.h"
+
+namespace SenderFirmware {
+#include "../../LaundrySender/src/main.cpp"
+}
+
+#include "SimSender.h"
+
+// Every global the sender firmware changes after startup
+struct SenderImage {
+  alignas(SenderFirmware::SensorUnit) unsigned char unit[sizeof(SenderFirmware::SensorUnit)];
+  alignas(TransmitPolicy) unsigned char policy[sizeof(TransmitPolicy)];
+  alignas(DeliveryQueue) unsigned char delivery[sizeof(DeliveryQueue)];
+  alignas(ChannelSearch) unsigned char search[sizeof(ChannelSearch)];
+  alignas(ProvisioningConsole) unsigned char console[sizeof(ProvisioningConsole)];
+  SenderConfig config;
+  int8_t lastDelivery;
+  unsigned long lastDeliveryTime;
+  unsigned long firstDeliveryTime;
+  alignas(PeriodicTimer) unsigned char drain[sizeof(PeriodicTimer)];
+  alignas(PeriodicTimer) unsigned char evaluation[sizeof(PeriodicTimer)];
+  alignas(PeriodicTimer) unsigned char stats[sizeof(PeriodicTimer)];
+  alignas(DutyCycleMeter) unsigned char dutyCycle[sizeof(DutyCycleMeter)];
+};
+
+namespace {
+  // Copies the firmware's globals into image, or (restore) image back into the globals
+  void copyGlobals(SenderImage &image, bool restore) {
+    using namespace SenderFirmware;
+    if (restore) {
+      memcpy((void *) &machineUnit, image.unit, sizeof(image.unit));
+      memcpy((void *) &transmitPolicy, image.policy, sizeof(image.policy));
+      memcpy((void *) &deliveryQueue, image.delivery, sizeof(image.delivery));
+      memcpy((void *) &channelSearch, image.search, sizeof(image.search));
+      memcpy((void *) &console, image.console, sizeof(image.console));
+      senderConfig = image.config;
+      lastDelivery = image.lastDelivery;
+      lastDeliveryTime = image.lastDeliveryTime;
+      firstDeliveryTime = image.firstDeliveryTime;
+      memcpy((void *) &drainTimer, image.drain, sizeof(image.drain));
+      memcpy((void *) &evaluationTimer, image.evaluation, sizeof(image.evaluation));
+      memcpy((void *) &statsTimer, image.stats, sizeof(image.stats));
+      memcpy((void *) &dutyCycle, image.dutyCycle, sizeof(image.dutyCycle));
+    } else {
+      memcpy(image.unit, (const void *) &machineUnit, sizeof(image.unit));
+      memcpy(image.policy, (const void *) &transmitPolicy, sizeof(image.policy));
+      memcpy(image.delivery, (const void *) &deliveryQueue, sizeof(image.delivery));
+      memcpy(image.search, (const void *) &channelSearch, sizeof(image.search));
+      memcpy(image.console, (const void *) &console, sizeof(image.console));
+      image.config = senderConfig;
+      image.lastDelivery = lastDelivery;
+      image.lastDeliveryTime = lastDeliveryTime;
+      image.firstDeliveryTime = firstDeliveryTime;
+      memcpy(image.drain, (const void *) &drainTimer, sizeof(image.drain));
+      memcpy(image.evaluation, (const void *) &evaluationTimer, sizeof(image.evaluation));
+      memcpy(image.stats, (const void *) &statsTimer, sizeof(image.stats));
+      memcpy(image.dutyCycle, (const void *) &dutyCycle, sizeof(image.dutyCycle));
+    }
+  }
+
+  // The globals as they were before any sender ran setup(), captured the first time a SimSender is made
+  SenderImage &pristineImage() {
+    static SenderImage *pristine = NULL;
+    if (pristine == NULL) {
+      pristine = new SenderImage();
+      copyGlobals(*pristine, false);
+    }
+    return *pristine;
+  }
+}
+
+/*
+  Constructor. The board boots (runs setup()) at bootMicros on the virtual clock, with its accelerometer feeling
+  vibration. It comes provisioned, with its name and receiver stored in NVS as over the serial console, along with
+  storedChannel as the channel it last reached the receiver on (0 for a board that never has).
+*/
+SimSender::SimSender(const char *boardId, const uint8_t mac[6], const uint8_t receiverMac[6], uint8_t storedChannel,
+                     uint64_t bootMicros, VibrationSource &vibration)
+    : mpu(vibration), image(new SenderImage(pristineImage())) {
+  snprintf(this->boardId, sizeof(this->boardId), "%s", boardId);
+
+  SenderConfig config = {};
+  snprintf(config.boardId, sizeof(config.boardId), "%s", boardId);
+  memcpy(config.receiverMac, receiverMac, 6);
+  config.channel = storedChannel;
+  uint8_t record[SenderConfigRecord::RECORD_BYTES];
+  size_t length = SenderConfigRecord::encode(config, record, sizeof(record));
+  this->board.flash[std::string(SenderFirmware::PREFERENCES_NAMESPACE) + "/config"].assign(record, record + length);
+
+  memcpy(this->board.mac, mac, 6);
+  this->board.chipId = ((uint64_t) mac[0] << 40) | ((uint64_t) mac[1] << 32) | ((uint64_t) mac[2] << 24) |
+                       ((uint64_t) mac[3] << 16) | ((uint64_t) mac[4] << 8) | mac[5];
+  this->board.bootMicros = bootMicros;
+  this->board.mpu = &this->mpu;
+  Sim::addBoard(this->board);
+}
+
+SimSender::~SimSender() {
+  delete this->image;
+}
+
+// Machine id the receiver knows this board by
+uint16_t SimSender::getMachineId() const {
+  return LaundryProtocol::machineIdFromName(this->boardId);
+}
+
+// Runs the firmware's setup() once the virtual clock reaches the board's boot time. Returns true once booted.
+bool SimSender::boot() {
+  if (this->booted) { return true; }
+  if (Sim::now() < this->board.bootMicros) { return false; }
+
+  swapIn();
+  SenderFirmware::setup();
+  swapOut();
+  this->booted = true;
+  return true;
+}
+
+// Time from boot until the receiver first acknowledged a frame, as the firmware measured it. 0 if it hasn't yet.
+unsigned long SimSender::getFirstPacketMs() const {
+  return this->image->firstDeliveryTime;
+}
+
+// The firmware's retransmission totals
+DeliveryStats SimSender::getDeliveryStats() const {
+  return reinterpret_cast<const DeliveryQueue *>(this->image->delivery)->getStats();
+}
+
+// How punctually the firmware drained its sensor and evaluated the machine's state
+void SimSender::getScheduleStats(TimerStats &drains, TimerStats &evaluations) const {
+  drains = reinterpret_cast<const PeriodicTimer *>(this->image->drain)->getStats();
+  evaluations = reinterpret_cast<const PeriodicTimer *>(this->image->evaluation)->getStats();
+}
+
+// Runs one pass of the firmware's loop() at the current virtual time, unless the board is still busy
+// (scanning, or sleeping until its next deadline), and checks it didn't go to sleep past the delivery queue's next send
+void SimSender::step() {
+  if (!boot()) { return; }
+  if (Sim::now() < this->board.busyUntilMicros) { return; }
+
+  uint32_t scans = this->board.scans;
+  swapIn();
+  SenderFirmware::loop();
+  uint32_t deliveryMs = SenderFirmware::deliveryQueue.untilDue(millis());
+  swapOut();
+
+  // A pass that scanned was busy, not asleep, until the scan ended
+  if (deliveryMs != UINT32_MAX && this->board.scans == scans) {
+    uint64_t dueMicros = Sim::now() + (uint64_t) deliveryMs * 1000;
+    if (this->board.busyUntilMicros > dueMicros) {
+      this->oversleptMaxMicros = std::max(this->oversleptMaxMicros, this->board.busyUntilMicros - dueMicros);
+    }
+  }
+}
+
+void SimSender::swapIn() {
+  Sim::setCurrentBoard(&this->board);
+  copyGlobals(*this->image, true);
+}
+
+void SimSender::swapOut() {
+  copyGlobals(*this->image, false);
+  Sim::setCurrentBoard(NULL);
+}
@@ -0,0 +1,55 @@
+/*
+  WasherWatcher Simulator
+  "SimSender.h"
+
+  One simulated sender board running the unmodified LaundrySender (ESP32) firmware.
+*/
+
+#ifndef SIM_SENDER_H
+#define SIM_SENDER_H
+
+#include <SimBoard.h>
+#include <SimMpu6050.h>
+#include <DeliveryQueue.h>
+#include <PeriodicTimer.h>
+
+struct SenderImage;
+
+/******************* SimSender Class Definition ***************************
+ * The firmware keeps its state in globals (machineUnit, transmitPolicy, its
+ * settings, the delivery queue, the channel search and the loop timers), so there is only one copy of them in the process. Each
+ * SimSender keeps its own byte image of those globals and swaps it in around
+ * every setup()/loop() call. The images all start from the same pristine
+ * copy, so pointers inside them (e.g. the MPU driver's reference to its bus)
+ * always point back into the live globals.
+ *************************************************************************/
+class SimSender {
+  public:
+    SimSender(const char *boardId, const uint8_t mac[6], const uint8_t receiverMac[6], uint8_t storedChannel,
+              uint64_t bootMicros, VibrationSource &vibration);
+    ~SimSender();
+
+    bool boot();
+    void step();
+    const char *getBoardId() const { return boardId; }
+    uint16_t getMachineId() const;
+    unsigned long getFirstPacketMs() const;
+    uint32_t getScans() const { return board.scans; }
+    DeliveryStats getDeliveryStats() const;
+    void getScheduleStats(TimerStats &drains, TimerStats &evaluations) const;
+    uint64_t getOversleptMaxMicros() const { return oversleptMaxMicros; }
+    static const size_t MAX_BOARD_ID = 15;
+
+  private:
+    char boardId[MAX_BOARD_ID + 1];
+    Sim::Board board;
+    SimMpu6050 mpu;
+    SenderImage *image;
+    bool booted = false;
+    uint64_t oversleptMaxMicros = 0;     // Longest loop() slept past a due send, resend or ack timeout
+
+    void swapIn();
+    void swapOut();
+};
+
+#endif
@@ -0,0 +1,85 @@
+/*
+  WasherWatcher Simulator
+  "VibrationProfile.cpp"
+*/
+
+#include "VibrationProfile.h"
+#include <math.h>
+
+namespace {
+  const float GRAVITY_MS2 = 9.80665;
+  const float FULL_CIRCLE_RADIANS = 6.28318530718;
+  const uint64_t MICROS_PER_MINUTE = 60000000ULL;
+
+  // Share of a washer cycle in each phase, with its drum frequency and amplitude
+  const float WASH_SHARE = 0.5, WASH_HZ = 0.9, WASH_AMPLITUDE = 0.35;
+  const float RINSE_SHARE = 0.25, RINSE_HZ = 0.9, RINSE_AMPLITUDE = 0.25;
+  const float SPIN_HZ = 11.0, SPIN_AMPLITUDE = 1.2;
+  const float TUMBLE_HZ = 0.75, TUMBLE_AMPLITUDE = 0.25;
+}
+
+// Constructor, planning idle stretches and cycles until settings.durationMicros
+VibrationProfile::VibrationProfile(const ProfileSettings &settings)
+    : settings(settings), random(settings.seed), noise(0.0, settings.noise) {
+  std::exponential_distribution<float> idle(1.0 / settings.idleMinutes);
+  std::normal_distribution<float> length(settings.cycleMinutes, settings.cycleSpreadMinutes);
+
+  uint64_t time = 0;
+  segments.push_back({0, false, 0.0, 0.0});
+  time = settings.quietMicros + (uint64_t) (idle(random) * MICROS_PER_MINUTE);
+
+  while (time < settings.durationMicros) {
+    float minutes = length(random);
+    if (minutes < 5) { minutes = 5; }
+    uint64_t cycleMicros = (uint64_t) (minutes * MICROS_PER_MINUTE);
+
+    if (settings.kind == KIND_WASHER) {
+      uint64_t wash = (uint64_t) (cycleMicros * WASH_SHARE);
+      uint64_t rinse = (uint64_t) (cycleMicros * RINSE_SHARE);
+      segments.push_back({time, true, WASH_HZ, WASH_AMPLITUDE});
+      segments.push_back({time + wash, true, RINSE_HZ, RINSE_AMPLITUDE});
+      segments.push_back({time + wash + rinse, true, SPIN_HZ, SPIN_AMPLITUDE});
+    } else {
+      segments.push_back({time, true, TUMBLE_HZ, TUMBLE_AMPLITUDE});
+    }
+    time += cycleMicros;
+    cycles++;
+
+    segments.push_back({time, false, 0.0, 0.0});
+    time += (uint64_t) (idle(random) * MICROS_PER_MINUTE) + MICROS_PER_MINUTE;
+  }
+}
+
+// Gravity along z, the drum vibration along z, and noise on every axis
+void VibrationProfile::accelerationAt(uint64_t micros, float acceleration[3]) {
+  const ProfileSegment &segment = segmentAt(micros);
+  float seconds = (micros % (3600 * 1000000ULL)) / 1000000.0;   // Kept small so float phase stays precise
+
+  acceleration[0] = noise(random);
+  acceleration[1] = noise(random);
+  acceleration[2] = GRAVITY_MS2 + noise(random);
+  if (segment.running) {
+    acceleration[2] += segment.amplitude * sinf(FULL_CIRCLE_RADIANS * segment.frequencyHz * seconds);
+  }
+}
+
+// Ground truth: whether the machine is running at a given time
+bool VibrationProfile::isRunningAt(uint64_t micros) {
+  return segmentAt(micros).running;
+}
+
+// Time of the most recent on/off change at or before micros (0 if there was none)
+uint64_t VibrationProfile::lastTransitionBefore(uint64_t micros) {
+  segmentAt(micros);
+  size_t index = cursor;
+  bool running = segments[index].running;
+  while (index > 0 && segments[index - 1].running == running) { index--; }
+  return segments[index].startMicros;
+}
+
+// Finds the segment covering micros, starting from the last one found (queries are nearly monotonic)
+const ProfileSegment &VibrationProfile::segmentAt(uint64_t micros) {
+  while (cursor > 0 && segments[cursor].startMicros > micros) { cursor--; }
+  while (cursor + 1 < segments.size() && segments[cursor + 1].startMicros <= micros) { cursor++; }
+  return segments[cursor];
+}
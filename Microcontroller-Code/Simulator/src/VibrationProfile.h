@@ -0,0 +1,68 @@
+/*
+  WasherWatcher Simulator
+  "VibrationProfile.h"
+
+  Synthetic accelerometer signal for one machine: idle stretches and cycles drawn at random,
+  with the drum vibration of each phase on top of gravity and sensor noise.
+*/
+
+#ifndef VIBRATION_PROFILE_H
+#define VIBRATION_PROFILE_H
+
+#include <stdint.h>
+#include <random>
+#include <vector>
+#include <SimMpu6050.h>
+
+enum MachineKind : uint8_t {
+  KIND_WASHER,
+  KIND_DRYER
+};
+
+// Knobs for one machine's profile
+typedef struct {
+  MachineKind kind;
+  float idleMinutes;        // Mean idle time between cycles (exponentially distributed)
+  float cycleMinutes;       // Mean cycle length
+  float cycleSpreadMinutes; // Standard deviation of the cycle length
+  float noise;              // Sensor noise on each axis, m/s^2
+  uint64_t quietMicros;     // Time from the start before the first cycle may begin (the sender calibrates then)
+  uint64_t durationMicros;  // How far ahead to plan the schedule
+  uint32_t seed;
+} ProfileSettings;
+
+// A stretch of the schedule with one steady vibration
+typedef struct {
+  uint64_t startMicros;
+  bool running;
+  float frequencyHz;        // Drum vibration along the gravity axis (0 while idle)
+  float amplitude;          // m/s^2
+} ProfileSegment;
+
+/*************** VibrationProfile Class Definition ************************
+ * The whole schedule is planned up front, so the simulated chip (which asks
+ * for slightly older sample times) and the harness (which asks about "now")
+ * can query it in any order. A washer cycle is wash (slow agitation), rinse
+ * (the same, weaker) then spin (fast); a dryer tumbles slowly throughout.
+ *************************************************************************/
+class VibrationProfile : public VibrationSource {
+  public:
+    explicit VibrationProfile(const ProfileSettings &settings);
+
+    void accelerationAt(uint64_t micros, float acceleration[3]) override;
+    bool isRunningAt(uint64_t micros);
+    uint64_t lastTransitionBefore(uint64_t micros);
+    size_t getCycleCount() const { return cycles; }
+
+  private:
+    ProfileSettings settings;
+    std::vector<ProfileSegment> segments;
+    size_t cursor = 0;
+    size_t cycles = 0;
+    std::mt19937 random;
+    std::normal_distribution<float> noise;
+
+    const ProfileSegment &segmentAt(uint64_t micros);
+};
+
+#endif
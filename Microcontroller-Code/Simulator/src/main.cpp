@@ -0,0 +1,455 @@
+/*
+  WasherWatcher Simulator
+  "main.cpp"
+
+  Runs many simulated senders and one receiver against a virtual clock, all with their
+  unmodified firmware, and reports how well the receiver kept up and how long it took a
+  machine starting or stopping to reach the website.
+
+  Usage: simulator [--senders=N] [--hours=H] [--step=MS] [--washers=FRACTION] [--idle=MINUTES]
+                   [--cycle=MINUTES] [--loss=PROBABILITY] [--seed=N] [--channel=N] [--stored-channel=N]
+                   [--uplink=HOST:PORT] [--metrics] [--verbose]
+         simulator --bench-metrics
+         simulator --bench-fanout
+         simulator --bench-registry
+         simulator --bench-journal
+
+  --channel is the access point's WiFi channel (default 6), which the receiver joins. --stored-channel is the
+  channel every sender has stored from its last boot: by default the right one, 0 for freshly provisioned boards
+  that have to scan, or any other channel to make the stored one stale.
+  --uplink sends the receiver's uplink batches to a real back-end server (e.g. back-end/build/server.js
+  with INGEST_STORE=memory) instead of refusing them, to test the receiver -> server path end to end.
+  After the run every tracked machine's history is fetched from the receiver, and the simulator exits with 1
+  if any of them didn't come back whole (or there were none), or if a sender slept past a send or resend that
+  was due.
+  --metrics prints the receiver's /metrics page after the run. --bench-metrics only checks the receiver's
+  latency histograms and per-machine counters and times what recording them costs, then exits.
+  --bench-fanout only feeds the receiver's /events fan-out to 1000 simulated browsers, checks what each
+  was sent and times it against copying every event for every browser, then exits.
+  --bench-registry only checks the receiver's machine registry and times finding a sender's slot by MAC
+  address with 500 senders registered, then exits.
+  --bench-journal only checks the receiver's state journal against a file-backed flash emulator, cutting the
+  power at every write and restarting, times restoring a full journal, then exits.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <SimBoard.h>
+#include <LaundryProtocol.h>
+#include "SimSender.h"
+#include "SimReceiver.h"
+#include "MetricsBench.h"
+#include "FanoutBench.h"
+#include "RegistryBench.h"
+#include "JournalBench.h"
+#include "VibrationProfile.h"
+
+namespace {
+  const uint8_t RECEIVER_MAC[6] = {0x94, 0xB9, 0x7E, 0xFA, 0x5A, 0x3D};  // The receiverMacAddress the sender firmware sends to
+  const uint64_t MICROS_PER_SECOND = 1000000ULL;
+  const uint64_t BOOT_SPREAD_MICROS = 10 * MICROS_PER_SECOND;      // Senders power up at random over this long
+  const uint64_t CALIBRATION_QUIET_MICROS = 60 * MICROS_PER_SECOND; // Machines stay idle this long after boot (senders calibrate then)
+  const uint64_t UNDETECTED_AFTER_MICROS = 180 * MICROS_PER_SECOND;  // A change not shown by then counts as missed (senders wait 90 s to report a stop)
+  const float DRYER_CYCLE_FACTOR = 1.2;                              // Dryer cycles run this much longer than washer cycles
+  const uint64_t UPLINK_DRAIN_MICROS = 20 * MICROS_PER_SECOND;       // Time given to the uplink after the last step
+
+  // Command line options
+  typedef struct {
+    unsigned senders = 200;
+    float hours = 6;
+    unsigned stepMs = 50;
+    float washerFraction = 0.5;
+    float idleMinutes = 90;
+    float cycleMinutes = 45;
+    float loss = 0.0;
+    uint32_t seed = 1;
+    unsigned channel = 6;
+    int storedChannel = -1;         // -1: the access point's channel
+    std::string uplinkHost;
+    uint16_t uplinkPort = 0;
+    bool metrics = false;
+    bool benchMetrics = false;
+    bool benchFanout = false;
+    bool benchRegistry = false;
+    bool benchJournal = false;
+    bool verbose = false;
+  } Options;
+
+  // A change of a machine's real state, waiting to show up on the website
+  typedef struct {
+    uint64_t micros;
+    bool running;
+  } Transition;
+
+  // Everything the harness tracks per simulated machine
+  typedef struct {
+    VibrationProfile *profile;
+    SimSender *sender;
+    bool truth;                     // Real state at the last step
+    bool shown;                     // State the website was last told
+    bool seen;                      // Appeared in at least one event
+    bool collided;                  // Another board hashes to the same 16 bit machine id
+    uint32_t missed;                // Changes that never showed up on the website
+    std::deque<Transition> pending;
+  } Machine;
+
+  // An event the receiver sent, as parsed by the tap
+  typedef struct {
+    uint64_t micros;
+    uint16_t machineId;
+    bool running;
+  } Observation;
+
+  // Filled from the receiver's worker thread, drained by the main thread
+  std::mutex observationMutex;
+  std::vector<Observation> observations;
+  uint64_t eventCount = 0;
+  uint64_t eventBytes = 0;
+
+  // Pulls {"id":"MACHINE_XXXX","status":...} pairs out of a machine_status or snapshot event
+  void onEvent(const char *event, const char *data, uint32_t id) {
+    (void) id;
+    uint64_t now = Sim::now();
+    std::lock_guard<std::mutex> lock(observationMutex);
+    eventCount++;
+    eventBytes += strlen(data);
+    if (event == NULL || (strcmp(event, "machine_status") != 0 && strcmp(event, "snapshot") != 0)) { return; }
+
+    const char *cursor = data;
+    while ((cursor = strstr(cursor, "\"id\":\"MACHINE_")) != NULL) {
+      cursor += strlen("\"id\":\"MACHINE_");
+      Observation observation;
+      observation.micros = now;
+      observation.machineId = (uint16_t) strtoul(cursor, NULL, 16);
+      const char *status = strstr(cursor, "\"status\":");
+      if (status == NULL) { break; }
+      observation.running = strncmp(status + strlen("\"status\":"), "true", 4) == 0;
+      observations.push_back(observation);
+    }
+  }
+
+  // Parses --name=value options into options. Returns false on anything it doesn't recognize.
+  bool parseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; i++) {
+      const char *arg = argv[i];
+      const char *value = strchr(arg, '=');
+      value = (value != NULL) ? value + 1 : "";
+
+      if (strncmp(arg, "--senders=", 10) == 0) { options.senders = (unsigned) atoi(value); }
+      else if (strncmp(arg, "--hours=", 8) == 0) { options.hours = atof(value); }
+      else if (strncmp(arg, "--step=", 7) == 0) { options.stepMs = (unsigned) atoi(value); }
+      else if (strncmp(arg, "--washers=", 10) == 0) { options.washerFraction = atof(value); }
+      else if (strncmp(arg, "--idle=", 7) == 0) { options.idleMinutes = atof(value); }
+      else if (strncmp(arg, "--cycle=", 8) == 0) { options.cycleMinutes = atof(value); }
+      else if (strncmp(arg, "--loss=", 7) == 0) { options.loss = atof(value); }
+      else if (strncmp(arg, "--seed=", 7) == 0) { options.seed = (uint32_t) strtoul(value, NULL, 10); }
+      else if (strncmp(arg, "--channel=", 10) == 0) { options.channel = (unsigned) atoi(value); }
+      else if (strncmp(arg, "--stored-channel=", 17) == 0) { options.storedChannel = atoi(value); }
+      else if (strncmp(arg, "--uplink=", 9) == 0) {
+        const char *colon = strrchr(value, ':');
+        if (colon == NULL) { return false; }
+        options.uplinkHost.assign(value, colon - value);
+        options.uplinkPort = (uint16_t) atoi(colon + 1);
+      }
+      else if (strcmp(arg, "--metrics") == 0) { options.metrics = true; }
+      else if (strcmp(arg, "--bench-metrics") == 0) { options.benchMetrics = true; }
+      else if (strcmp(arg, "--bench-fanout") == 0) { options.benchFanout = true; }
+      else if (strcmp(arg, "--bench-registry") == 0) { options.benchRegistry = true; }
+      else if (strcmp(arg, "--bench-journal") == 0) { options.benchJournal = true; }
+      else if (strcmp(arg, "--verbose") == 0) { options.verbose = true; }
+      else { return false; }
+    }
+    return options.senders > 0 && options.hours > 0 && options.stepMs > 0 && options.idleMinutes > 0 && options.cycleMinutes > 0 &&
+           options.channel >= 1 && options.channel <= 13 && options.storedChannel >= -1 && options.storedChannel <= 13;
+  }
+
+  // Value at fraction q (0..1) of sorted values, or 0 if there are none
+  double percentile(const std::vector<double> &sorted, double q) {
+    if (sorted.empty()) { return 0.0; }
+    size_t index = (size_t) (q * (sorted.size() - 1) + 0.5);
+    return sorted[index];
+  }
+}
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    fprintf(stderr, "usage: %s [--senders=N] [--hours=H] [--step=MS] [--washers=FRACTION] [--idle=MINUTES]\n"
+                    "       [--cycle=MINUTES] [--loss=PROBABILITY] [--seed=N] [--channel=N] [--stored-channel=N]\n"
+                    "       [--uplink=HOST:PORT] [--metrics] [--verbose]\n"
+                    "       %s --bench-metrics\n", argv[0], argv[0]);
+    return 2;
+  }
+  if (options.benchMetrics) { return runMetricsBench(); }
+  if (options.benchFanout) { return runFanoutBench(); }
+  if (options.benchRegistry) { return runRegistryBench(); }
+  if (options.benchJournal) { return runJournalBench(); }
+
+  Sim::setVerbose(options.verbose);
+  Sim::setRadioLoss(options.loss, options.seed);
+  Sim::setAccessPointChannel((uint8_t) options.channel);
+  Sim::setEventTap(onEvent);
+  if (options.uplinkPort != 0) { Sim::setUplinkTarget(options.uplinkHost, options.uplinkPort); }
+
+  uint64_t durationMicros = (uint64_t) (options.hours * 3600.0 * MICROS_PER_SECOND);
+  uint64_t stepMicros = (uint64_t) options.stepMs * 1000;
+  std::mt19937 random(options.seed);
+  std::uniform_int_distribution<uint64_t> bootTime(0, BOOT_SPREAD_MICROS);
+  uint8_t storedChannel = (uint8_t) ((options.storedChannel < 0) ? options.channel : options.storedChannel);
+
+  SimReceiver receiver(RECEIVER_MAC);
+  receiver.boot();
+  receiver.connectClient();
+
+  // Build the machines, each with its own vibration schedule and sender board
+  std::vector<Machine> machines(options.senders);
+  std::map<uint16_t, size_t> byMachineId;
+  size_t collisions = 0;
+  for (unsigned i = 0; i < options.senders; i++) {
+    bool washer = (i + 0.5) / options.senders <= options.washerFraction;
+    uint64_t bootMicros = bootTime(random);
+
+    ProfileSettings settings;
+    settings.kind = washer ? KIND_WASHER : KIND_DRYER;
+    settings.idleMinutes = options.idleMinutes;
+    settings.cycleMinutes = washer ? options.cycleMinutes : options.cycleMinutes * DRYER_CYCLE_FACTOR;
+    settings.cycleSpreadMinutes = settings.cycleMinutes / 9;
+    settings.noise = 0.02;
+    settings.quietMicros = bootMicros + CALIBRATION_QUIET_MICROS;
+    settings.durationMicros = durationMicros;
+    settings.seed = (uint32_t) random();
+
+    char boardId[SimSender::MAX_BOARD_ID + 1];
+    snprintf(boardId, sizeof(boardId), "SIM_%c_%04u", washer ? 'W' : 'D', i % 10000);
+    uint8_t mac[6] = {0x02, 0x00, 0x00, 0x00, (uint8_t) (i >> 8), (uint8_t) i};
+
+    Machine &machine = machines[i];
+    machine.profile = new VibrationProfile(settings);
+    machine.sender = new SimSender(boardId, mac, RECEIVER_MAC, storedChannel, bootMicros, *machine.profile);
+    machine.truth = false;
+    machine.shown = false;
+    machine.seen = false;
+    machine.collided = false;
+    machine.missed = 0;
+
+    uint16_t machineId = machine.sender->getMachineId();
+    if (byMachineId.count(machineId)) {
+      machines[byMachineId[machineId]].collided = true;
+      machine.collided = true;
+      collisions++;
+    } else {
+      byMachineId[machineId] = i;
+    }
+  }
+
+  std::vector<double> latencies;
+  uint64_t spurious = 0;
+  auto started = std::chrono::steady_clock::now();
+
+  // Matches what the website was told against what the machines really did
+  auto drainObservations = [&]() {
+    std::vector<Observation> batch;
+    {
+      std::lock_guard<std::mutex> lock(observationMutex);
+      batch.swap(observations);
+    }
+    for (const Observation &observation : batch) {
+      auto found = byMachineId.find(observation.machineId);
+      if (found == byMachineId.end()) { continue; }
+      Machine &machine = machines[found->second];
+      machine.seen = true;
+      if (machine.collided || observation.running == machine.shown) { continue; }
+      machine.shown = observation.running;
+
+      // Changes the website skipped over (e.g. a cycle shorter than the detection delay) count as missed
+      while (!machine.pending.empty() && machine.pending.front().running != observation.running) {
+        machine.pending.pop_front();
+        machine.missed++;
+      }
+      if (machine.pending.empty()) {
+        spurious++;
+      } else {
+        latencies.push_back((observation.micros - machine.pending.front().micros) / 1e6);
+        machine.pending.pop_front();
+      }
+    }
+  };
+
+  for (uint64_t now = stepMicros; now <= durationMicros; now += stepMicros) {
+    Sim::advanceTo(now);
+    for (Machine &machine : machines) {
+      machine.sender->step();
+
+      bool running = machine.profile->isRunningAt(now);
+      if (running != machine.truth) {
+        machine.truth = running;
+        machine.pending.push_back({machine.profile->lastTransitionBefore(now), running});
+      }
+      while (!machine.pending.empty() && now - machine.pending.front().micros > UNDETECTED_AFTER_MICROS &&
+             machine.pending.size() > 1) {
+        machine.pending.pop_front();
+        machine.missed++;
+      }
+    }
+    drainObservations();
+    std::this_thread::yield();
+  }
+
+  // Let the receiver's worker finish what is queued before the last look
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  drainObservations();
+
+  // Give the uplink time to send its last batch (the senders are no longer stepped)
+  if (options.uplinkPort != 0) {
+    for (uint64_t now = durationMicros + stepMicros; now <= durationMicros + UPLINK_DRAIN_MICROS; now += stepMicros) {
+      Sim::advanceTo(now);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  double simSeconds = durationMicros / 1e6;
+
+  // Only machines the receiver had room for count towards missed changes
+  size_t seen = 0, cycles = 0, missed = 0, stillPending = 0;
+  for (Machine &machine : machines) {
+    cycles += machine.profile->getCycleCount();
+    if (!machine.seen || machine.collided) { continue; }
+    seen++;
+    missed += machine.missed;
+    for (const Transition &transition : machine.pending) {
+      if (durationMicros - transition.micros > UNDETECTED_AFTER_MICROS) { missed++; }
+      else { stillPending++; }
+    }
+  }
+  std::sort(latencies.begin(), latencies.end());
+
+  // Boot to the first acknowledged frame, which includes calibration and the first send's random delay
+  std::vector<double> firstPackets;
+  uint64_t scans = 0;
+  DeliveryStats delivery = {};
+  uint64_t oversleptMaxMicros = 0;
+  TimerStats drains = {}, evaluations = {};
+  for (Machine &machine : machines) {
+    TimerStats senderDrains, senderEvaluations;
+    machine.sender->getScheduleStats(senderDrains, senderEvaluations);
+    for (int i = 0; i < 2; i++) {
+      TimerStats &total = (i == 0) ? drains : evaluations;
+      const TimerStats &sender = (i == 0) ? senderDrains : senderEvaluations;
+      total.intervalMinMicros = (total.runs == 0 || sender.intervalMinMicros < total.intervalMinMicros) ?
+                                sender.intervalMinMicros : total.intervalMinMicros;
+      total.runs += sender.runs;
+      total.skipped += sender.skipped;
+      total.lateSumMicros += sender.lateSumMicros;
+      total.lateMaxMicros = std::max(total.lateMaxMicros, sender.lateMaxMicros);
+      total.intervalSumMicros += sender.intervalSumMicros;
+      total.intervalMaxMicros = std::max(total.intervalMaxMicros, sender.intervalMaxMicros);
+    }
+    scans += machine.sender->getScans();
+    oversleptMaxMicros = std::max(oversleptMaxMicros, machine.sender->getOversleptMaxMicros());
+    DeliveryStats senderDelivery = machine.sender->getDeliveryStats();
+    delivery.queued += senderDelivery.queued;
+    delivery.retries += senderDelivery.retries;
+    delivery.delivered += senderDelivery.delivered;
+    delivery.superseded += senderDelivery.superseded;
+    delivery.abandoned += senderDelivery.abandoned;
+    delivery.latencySumMs += senderDelivery.latencySumMs;
+    delivery.latencyMaxMs = std::max(delivery.latencyMaxMs, senderDelivery.latencyMaxMs);
+    if (machine.sender->getFirstPacketMs() != 0) { firstPackets.push_back(machine.sender->getFirstPacketMs() / 1e3); }
+  }
+  std::sort(firstPackets.begin(), firstPackets.end());
+
+  Sim::RadioStats radio = Sim::getRadioStats();
+  ReceiverStats stats = receiver.getStats();
+  uint64_t offered = (uint64_t) stats.received + stats.dropped;
+
+  printf("Simulated %.1f h with %u senders (%.0f%% washers) in %.1f s wall time (%.0fx real time)\n",
+         options.hours, options.senders, options.washerFraction * 100, wallSeconds, simSeconds / wallSeconds);
+  printf("Machine cycles run:      %lu\n", (unsigned long) cycles);
+  printf("Radio frames:            %lu sent, %lu delivered, %lu lost, %lu acks lost, %lu bytes (%.2f frames/s simulated, %.0f frames/s wall)\n",
+         (unsigned long) radio.sent, (unsigned long) radio.delivered, (unsigned long) radio.lost, (unsigned long) radio.acksLost,
+         (unsigned long) radio.bytes, radio.sent / simSeconds, radio.sent / wallSeconds);
+  printf("Sender retransmits:      %u frames queued, %u acked, %u retries, %u superseded, %u given up; queued -> ack avg %.0f ms, max %u ms\n",
+         (unsigned) delivery.queued, (unsigned) delivery.delivered, (unsigned) delivery.retries, (unsigned) delivery.superseded,
+         (unsigned) delivery.abandoned, delivery.delivered ? (double) delivery.latencySumMs / delivery.delivered : 0.0,
+         (unsigned) delivery.latencyMaxMs);
+  printf("Receiver link:           %u duplicates ignored, %u sequence gaps, %u late frames; delay avg %.0f ms, max %u ms\n",
+         (unsigned) stats.link.duplicates, (unsigned) stats.link.sequenceGaps, (unsigned) stats.link.lateFrames,
+         stats.link.frames ? (double) stats.link.delaySumMs / stats.link.frames : 0.0, (unsigned) stats.link.delayMaxMs);
+  printf("Receiver queue:          %u accepted, %u dropped (%.3f%%), high water %u of %u, %u malformed\n",
+         (unsigned) stats.received, (unsigned) stats.dropped, offered ? 100.0 * stats.dropped / offered : 0.0,
+         (unsigned) stats.highWater, (unsigned) stats.capacity, (unsigned) stats.malformed);
+  printf("Machines tracked:        %u of %u senders (table holds %u), %lu followed below\n",
+         (unsigned) stats.machines, options.senders, (unsigned) stats.tableCapacity, (unsigned long) seen);
+  printf("Machine id collisions:   %lu (ignored below)\n", (unsigned long) collisions);
+  printf("Events sent:             %lu, %lu bytes of JSON\n", (unsigned long) eventCount, (unsigned long) eventBytes);
+  printf("On/off changes shown:    %lu, %lu missed, %lu spurious, %lu still in flight\n",
+         (unsigned long) latencies.size(), (unsigned long) missed, (unsigned long) spurious, (unsigned long) stillPending);
+  printf("Change -> website (s):   p50 %.1f, p90 %.1f, p99 %.1f, max %.1f\n",
+         percentile(latencies, 0.5), percentile(latencies, 0.9), percentile(latencies, 0.99),
+         latencies.empty() ? 0.0 : latencies.back());
+  printf("Boot -> first ack (s):   p50 %.1f, p90 %.1f, max %.1f, %lu of %u senders reached the receiver, %lu scans\n",
+         percentile(firstPackets, 0.5), percentile(firstPackets, 0.9), firstPackets.empty() ? 0.0 : firstPackets.back(),
+         (unsigned long) firstPackets.size(), options.senders, (unsigned long) scans);
+  // Each sender's first run has no interval before it
+  for (int i = 0; i < 2; i++) {
+    const TimerStats &timer = (i == 0) ? drains : evaluations;
+    uint32_t intervals = (timer.runs > options.senders) ? timer.runs - options.senders : 0;
+    printf("%s every %.1f ms on average (min %.1f, max %.1f), late by avg %.1f ms, max %.1f ms, %u skipped\n",
+           (i == 0) ? "Sender drains:          " : "Sender evaluations:     ",
+           intervals ? timer.intervalSumMicros / 1e3 / intervals : 0.0, timer.intervalMinMicros / 1e3,
+           timer.intervalMaxMicros / 1e3, timer.runs ? timer.lateSumMicros / 1e3 / timer.runs : 0.0,
+           timer.lateMaxMicros / 1e3, (unsigned) timer.skipped);
+  }
+  // A sender wakes within a ms of a due send or resend (its sleep is rounded up to whole ticks); one sleeping
+  // through it would only wake for its next drain, up to 100 ms later
+  bool wokeInTime = oversleptMaxMicros <= 1000;
+  printf("Sender wake-ups:         slept past a due send or resend by max %.1f ms%s\n", oversleptMaxMicros / 1e3,
+         wokeInTime ? "" : ", TOO LATE");
+  printf("Uplink:                  %u records queued, %u sent in %u batches, %u failed sends, %u waiting, %u dropped\n",
+         (unsigned) stats.uplinkQueued, (unsigned) stats.uplinkSent, (unsigned) stats.uplinkBatches,
+         (unsigned) stats.uplinkFailures, (unsigned) stats.uplinkBacklog, (unsigned) stats.uplinkDropped);
+
+  std::string body;
+  int code = receiver.get("/api/stats", NULL, body);
+  printf("GET /api/stats:          %d %s\n", code, body.c_str());
+
+  // Fetch the history of every machine the receiver lists (senders past the registry's slots aren't tracked)
+  std::string state;
+  code = receiver.get("/api/state", NULL, state);
+  size_t histories = 0, complete = 0, records = 0, historyBytes = 0;
+  const char *ID_KEY = "\"id\":\"";
+  for (size_t at = state.find(ID_KEY); code == 200 && at != std::string::npos; at = state.find(ID_KEY, at)) {
+    at += strlen(ID_KEY);
+    std::string query = "machine=" + state.substr(at, state.find('"', at) - at);
+    int historyCode = receiver.get("/api/history", query.c_str(), body);
+    for (size_t record = body.find("{\"t\":"); record != std::string::npos; record = body.find("{\"t\":", record + 1)) { records++; }
+    bool closed = body.size() >= 2 && body.compare(body.size() - 2, 2, "]}") == 0;
+    if (historyCode == 200 && closed) { complete++; }
+    else { printf("GET /api/history:        %d for %s, CUT SHORT\n", historyCode, query.c_str() + strlen("machine=")); }
+    histories++;
+    historyBytes += body.size();
+  }
+  bool historyComplete = histories > 0 && complete == histories;
+  printf("GET /api/history:        %u of %u machines complete, %u records in %u bytes\n", (unsigned) complete,
+         (unsigned) histories, (unsigned) records, (unsigned) historyBytes);
+  if (options.metrics) {
+    code = receiver.get("/metrics", NULL, body);
+    printf("GET /metrics:            %d\n%s", code, body.c_str());
+  }
+
+  // The receiver's worker thread is blocked waiting for frames, so leave without running destructors
+  fflush(stdout);
+  _exit((historyComplete && wokeInTime) ? 0 : 1);
+}
@@ -0,0 +1,155 @@
+/*
+  WasherWatcher TraceTools
+  "Replay.cpp"
+*/
+
+#include "Replay.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string.h>
+#include <thread>
+
+const size_t Replay::BURST_SAMPLES;
+
+/*
+  Turns a trace's labels into the list of times the machine started or stopped.
+  Time no label covers counts as off, so marking only the cycles is enough.
+*/
+std::vector<LabelChange> Replay::labelChanges(const TraceReader &trace) {
+  std::vector<LabelChange> changes;
+  bool running = false;
+  uint64_t coveredUntil = 0;
+
+  for (uint64_t i = 0; i < trace.getLabelCount(); i++) {
+    const TraceLabel &label = trace.getLabels()[i];
+    if (running && label.startMicros > coveredUntil) {
+      changes.push_back({coveredUntil, false});
+      running = false;
+    }
+    if ((label.running != 0) != running) {
+      running = label.running != 0;
+      changes.push_back({label.startMicros, running});
+    }
+    if (label.endMicros > coveredUntil) { coveredUntil = label.endMicros; }
+  }
+  if (running) { changes.push_back({coveredUntil, false}); }
+  return changes;
+}
+
+// Replays one trace through a detector built from settings and scores it against the trace's labels
+ReplayScore Replay::replay(const TraceReader &trace, const ReplaySettings &settings) {
+  ReplayScore score;
+  memset(&score, 0, sizeof(score));
+
+  // A MachineDetector is several KB, so keep it off the (thread) stack
+  std::unique_ptr<MachineDetector> detector(new MachineDetector(settings.detector));
+  int16_t x[BURST_SAMPLES], y[BURST_SAMPLES], z[BURST_SAMPLES];
+  size_t evaluateEvery = settings.evaluateEvery ? settings.evaluateEvery : settings.detector.windowLength;
+  size_t sinceEvaluation = 0;
+  bool decision = false;
+
+  std::vector<LabelChange> changes = labelChanges(trace);
+  size_t change = 0;                    // First change not yet reached
+  bool labelledOn = false;              // What the labels say the machine is doing at the current evaluation
+  uint64_t pendingChange = UINT64_MAX;  // Time of the labelled change the decision hasn't followed yet
+
+  const TraceRecord *records = trace.getRecords();
+  for (uint64_t s = 0; s < trace.getSegmentCount(); s++) {
+    const TraceSegment &segment = trace.getSegments()[s];
+    const TraceRecord *record = records + segment.firstRecord;
+
+    for (uint64_t done = 0; done < segment.recordCount; ) {
+      size_t count = BURST_SAMPLES;
+      if (count > evaluateEvery - sinceEvaluation) { count = evaluateEvery - sinceEvaluation; }
+      if (count > segment.recordCount - done) { count = (size_t) (segment.recordCount - done); }
+
+      for (size_t i = 0; i < count; i++) {
+        x[i] = record[i].acc[0];
+        y[i] = record[i].acc[1];
+        z[i] = record[i].acc[2];
+      }
+      detector->addSamples(x, y, z, count);
+      record += count;
+      done += count;
+      sinceEvaluation += count;
+      if (sinceEvaluation < evaluateEvery) { continue; }
+      sinceEvaluation = 0;
+
+      // The board calibrates at its first evaluation and only decides from the next one on
+      if (!detector->isCalibrated()) {
+        detector->calibrate();
+        continue;
+      }
+      // Decide, and score the decision against the labels, at the time of the window's newest sample
+      uint64_t now = segment.startMicros + done * segment.periodNanos / 1000;
+      bool on = detector->evaluate((uint32_t) (now / 1000));
+      score.evaluations++;
+      if (on != decision && score.evaluations > 1) { score.flips++; }
+      decision = on;
+
+      while (change < changes.size() && changes[change].micros <= now) {
+        if (pendingChange != UINT64_MAX) { score.missed++; }
+        pendingChange = changes[change].micros;
+        labelledOn = changes[change].running;
+        change++;
+      }
+      if (on == labelledOn) { score.agreed++; }
+      else if (on) { score.falseOn++; }
+      else { score.falseOff++; }
+
+      if (pendingChange != UINT64_MAX && on == labelledOn) {
+        uint64_t latency = now - pendingChange;
+        score.detected++;
+        score.latencySumMicros += latency;
+        if (latency > score.latencyMaxMicros) { score.latencyMaxMicros = latency; }
+        pendingChange = UINT64_MAX;
+      }
+    }
+    score.samples += segment.recordCount;
+  }
+
+  if (pendingChange != UINT64_MAX) { score.missed++; }
+  return score;
+}
+
+// Replays every configuration over every trace on up to threads threads. Returns one merged score per configuration.
+std::vector<ReplayScore> Replay::run(const std::vector<const TraceReader *> &traces,
+                                     const std::vector<ReplaySettings> &settings, unsigned threads) {
+  std::vector<ReplayScore> scores(settings.size());
+  for (ReplayScore &score : scores) { memset(&score, 0, sizeof(score)); }
+
+  size_t jobs = traces.size() * settings.size();
+  std::atomic<size_t> nextJob(0);
+  std::mutex scoresMutex;
+  auto worker = [&]() {
+    for (size_t job = nextJob++; job < jobs; job = nextJob++) {
+      size_t config = job / traces.size();
+      ReplayScore score = replay(*traces[job % traces.size()], settings[config]);
+      std::lock_guard<std::mutex> lock(scoresMutex);
+      merge(scores[config], score);
+    }
+  };
+
+  if (threads < 1) { threads = 1; }
+  if (threads > jobs) { threads = (unsigned) jobs; }
+  std::vector<std::thread> pool;
+  for (unsigned i = 1; i < threads; i++) { pool.push_back(std::thread(worker)); }
+  worker();
+  for (std::thread &thread : pool) { thread.join(); }
+  return scores;
+}
+
+// Adds score's counts into total
+void Replay::merge(ReplayScore &total, const ReplayScore &score) {
+  total.samples += score.samples;
+  total.evaluations += score.evaluations;
+  total.agreed += score.agreed;
+  total.falseOn += score.falseOn;
+  total.falseOff += score.falseOff;
+  total.flips += score.flips;
+  total.detected += score.detected;
+  total.missed += score.missed;
+  total.latencySumMicros += score.latencySumMicros;
+  if (score.latencyMaxMicros > total.latencyMaxMicros) { total.latencyMaxMicros = score.latencyMaxMicros; }
+}
@@ -0,0 +1,60 @@
+/*
+  WasherWatcher TraceTools
+  "Replay.h"
+
+  Runs recorded traces through the Sender's MachineDetector and scores its decisions against the labels.
+*/
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+#include <vector>
+#include <MachineDetector.h>
+#include "TraceFile.h"
+
+// One detector configuration to replay, and how often it evaluates (the Sender's EVALDELAY, in samples)
+typedef struct {
+  DetectorConfig detector;
+  size_t evaluateEvery;
+} ReplaySettings;
+
+// A time the labels say the machine started (running) or stopped
+typedef struct {
+  uint64_t micros;
+  bool running;
+} LabelChange;
+
+// How one configuration did over one or more traces
+typedef struct {
+  uint64_t samples;
+  uint64_t evaluations;
+  uint64_t agreed;          // Evaluations that matched the labels
+  uint64_t falseOn;         // Said on while labelled off
+  uint64_t falseOff;        // Said off while labelled on
+  uint64_t flips;           // Times the decision changed
+  uint64_t detected;        // Labelled changes the decision followed
+  uint64_t missed;          // Labelled changes the decision never followed before the next one
+  uint64_t latencySumMicros;
+  uint64_t latencyMaxMicros;
+} ReplayScore;
+
+/*********************** Replay Class Definition **************************
+ * A replay is a single pass over a mapped trace: records are gathered into
+ * per-axis bursts the size of a sensor FIFO drain and fed to a fresh
+ * MachineDetector, which calibrates on its first evaluation just like the
+ * board does after booting. run() replays a whole list of configurations
+ * over a list of traces on several threads, one (configuration, trace) job each.
+ *************************************************************************/
+class Replay {
+  public:
+    static const size_t BURST_SAMPLES = 10;   // Samples per addSamples() call, as the Sender drains them (MEASUREDELAY at 100 Hz)
+
+    static ReplayScore replay(const TraceReader &trace, const ReplaySettings &settings);
+    static std::vector<ReplayScore> run(const std::vector<const TraceReader *> &traces,
+                                        const std::vector<ReplaySettings> &settings, unsigned threads);
+    static std::vector<LabelChange> labelChanges(const TraceReader &trace);
+    static void merge(ReplayScore &total, const ReplayScore &score);
+};
+
+#endif
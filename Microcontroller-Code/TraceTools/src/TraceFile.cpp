@@ -0,0 +1,276 @@
+/*
+  WasherWatcher TraceTools
+  "TraceFile.cpp"
+*/
+
+#include "TraceFile.h"
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const uint64_t TraceWriter::MAX_JITTER_MICROS;
+
+namespace {
+  // Rounds offset up to the next section boundary
+  uint64_t alignOffset(uint64_t offset) {
+    return (offset + TraceFormat::FILE_ALIGNMENT - 1) / TraceFormat::FILE_ALIGNMENT * TraceFormat::FILE_ALIGNMENT;
+  }
+
+  // True if the section [offset, offset + count * size) lies inside a file of fileBytes (an empty one always does)
+  bool sectionFits(uint64_t offset, uint64_t count, uint64_t size, uint64_t fileBytes) {
+    return count == 0 || (offset <= fileBytes && count <= (fileBytes - offset) / size);
+  }
+
+  std::string describeErrno(const char *what, const char *path) {
+    return std::string(what) + " " + path + ": " + strerror(errno);
+  }
+}
+
+TraceReader::~TraceReader() {
+  close();
+}
+
+// Maps the trace at path and checks its header. Returns false (with a reason in error) if it isn't a usable trace.
+bool TraceReader::open(const char *path, std::string &error) {
+  close();
+  this->path = path;
+
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    error = describeErrno("can't open", path);
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || (uint64_t) info.st_size < sizeof(TraceFileHeader)) {
+    error = std::string(path) + " is too short to be a trace";
+    ::close(fd);
+    return false;
+  }
+
+  this->mappedBytes = (size_t) info.st_size;
+  this->mapping = mmap(NULL, this->mappedBytes, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (this->mapping == MAP_FAILED) {
+    this->mapping = NULL;
+    error = describeErrno("can't map", path);
+    return false;
+  }
+  // Replays read front to back, so let the kernel read ahead aggressively
+  madvise(this->mapping, this->mappedBytes, MADV_SEQUENTIAL);
+
+  const uint8_t *base = (const uint8_t *) this->mapping;
+  this->header = (const TraceFileHeader *) base;
+  if (memcmp(this->header->magic, TraceFormat::FILE_MAGIC, sizeof(this->header->magic)) != 0 ||
+      this->header->version != TraceFormat::FILE_VERSION) {
+    error = std::string(path) + " is not a version 1 trace file";
+    close();
+    return false;
+  }
+  if (!sectionFits(this->header->recordsOffset, this->header->recordCount, sizeof(TraceRecord), this->mappedBytes) ||
+      !sectionFits(this->header->segmentsOffset, this->header->segmentCount, sizeof(TraceSegment), this->mappedBytes) ||
+      !sectionFits(this->header->labelsOffset, this->header->labelCount, sizeof(TraceLabel), this->mappedBytes)) {
+    error = std::string(path) + " is truncated (was the capture interrupted before it finished?)";
+    close();
+    return false;
+  }
+
+  this->records = (const TraceRecord *) (base + this->header->recordsOffset);
+  this->segments = (const TraceSegment *) (base + this->header->segmentsOffset);
+  this->labels = (const TraceLabel *) (base + this->header->labelsOffset);
+  for (uint64_t i = 0; i < this->header->segmentCount; i++) {
+    const TraceSegment &segment = this->segments[i];
+    if (segment.firstRecord > this->header->recordCount || segment.recordCount > this->header->recordCount - segment.firstRecord) {
+      error = std::string(path) + " has a segment outside its records";
+      close();
+      return false;
+    }
+  }
+  return true;
+}
+
+// Unmaps the trace, if one is open
+void TraceReader::close() {
+  if (this->mapping != NULL) { munmap(this->mapping, this->mappedBytes); }
+  this->mapping = NULL;
+  this->mappedBytes = 0;
+  this->header = NULL;
+  this->records = NULL;
+  this->segments = NULL;
+  this->labels = NULL;
+}
+
+// Time from the start of the trace to the end of its last sample
+uint64_t TraceReader::getDurationMicros() const {
+  if (this->header->segmentCount == 0) { return 0; }
+  const TraceSegment &last = this->segments[this->header->segmentCount - 1];
+  return last.startMicros + last.recordCount * last.periodNanos / 1000;
+}
+
+
+TraceWriter::~TraceWriter() {
+  if (this->file != NULL) { fclose(this->file); }
+}
+
+// Creates the trace file, leaving room for the header finish() writes
+bool TraceWriter::open(const char *path, const char *boardId, uint8_t machineType, int64_t startUnixMicros, std::string &error) {
+  this->file = fopen(path, "wb");
+  if (this->file == NULL) {
+    error = describeErrno("can't create", path);
+    return false;
+  }
+  setvbuf(this->file, NULL, _IOFBF, 1 << 20);
+
+  memset(&this->header, 0, sizeof(this->header));
+  memcpy(this->header.magic, TraceFormat::FILE_MAGIC, sizeof(this->header.magic));
+  this->header.version = TraceFormat::FILE_VERSION;
+  this->header.machineType = machineType;
+  snprintf(this->header.boardId, sizeof(this->header.boardId), "%s", boardId);
+  this->header.startUnixMicros = startUnixMicros;
+  this->header.recordsOffset = alignOffset(sizeof(TraceFileHeader));
+
+  if (fseek(this->file, (long) this->header.recordsOffset, SEEK_SET) != 0) {
+    error = describeErrno("can't write", path);
+    return false;
+  }
+  return true;
+}
+
+/*
+  Appends a burst decoded from the sender's serial output. hostMicros is when it arrived, on the capture's own
+  clock; it only places segments that start after the sender restarted, since its micros() began again from 0.
+*/
+void TraceWriter::addBurst(const TraceBurst &burst, uint64_t hostMicros) {
+  if (burst.count == 0 || burst.sampleRateHz == 0) { return; }
+  if (this->header.sampleRateHz == 0) { this->header.sampleRateHz = burst.sampleRateHz; }
+
+  bool first = (this->recordCount == 0);
+  uint64_t drainMicros;
+  bool continues = false;
+
+  if (first) {
+    // The trace starts at the first sample of the first burst
+    drainMicros = (uint64_t) (burst.count - 1) * 1000000 / burst.sampleRateHz;
+  } else if (burst.firstIndex >= this->anchor.nextIndex) {
+    // Same run of the sender: its clock is still good even if samples went missing
+    drainMicros = this->anchor.lastDrainMicros + (uint32_t) (burst.drainMicros - this->anchor.lastDrainRaw);
+    uint64_t predicted = this->anchor.lastDrainMicros + (uint64_t) burst.count * measuredPeriodNanos() / 1000;
+    uint64_t jitter = (drainMicros > predicted) ? drainMicros - predicted : predicted - drainMicros;
+    continues = (burst.firstIndex == this->anchor.nextIndex && jitter <= MAX_JITTER_MICROS &&
+                 burst.sampleRateHz == this->header.sampleRateHz);
+  } else {
+    // The sender restarted, so only the capture's clock says how long it was gone
+    drainMicros = std::max(hostMicros, this->latestMicros + (uint64_t) burst.count * 1000000 / burst.sampleRateHz);
+  }
+
+  if (!continues) {
+    if (!first) { closeSegment(); }
+    this->anchor.firstIndex = burst.firstIndex;
+    this->anchor.firstDrainMicros = drainMicros;
+    this->anchor.firstBurstCount = (uint32_t) burst.count;
+    TraceSegment segment = {this->recordCount, 0, 0, 0, 0};
+    this->segments.push_back(segment);
+  }
+  this->anchor.nextIndex = burst.firstIndex + (uint32_t) burst.count;
+  this->anchor.lastDrainRaw = burst.drainMicros;
+  this->anchor.lastDrainMicros = drainMicros;
+
+  fwrite(burst.samples, sizeof(TraceRecord), burst.count, this->file);
+  this->recordCount += burst.count;
+  this->segments.back().recordCount += burst.count;
+  this->latestMicros = drainMicros;
+}
+
+// Starts a label at the newest sample, ending the one before it
+void TraceWriter::mark(bool running, uint8_t phase) {
+  if (!this->labels.empty() && this->labels.back().endMicros == UINT64_MAX) {
+    this->labels.back().endMicros = this->latestMicros;
+  }
+  TraceLabel label;
+  memset(&label, 0, sizeof(label));
+  label.startMicros = this->latestMicros;
+  label.endMicros = UINT64_MAX;
+  label.running = running;
+  label.phase = phase;
+  this->labels.push_back(label);
+}
+
+// Writes the segments, labels and header, and closes the file
+bool TraceWriter::finish(std::string &error) {
+  if (this->recordCount > 0) { closeSegment(); }
+  if (!this->labels.empty() && this->labels.back().endMicros == UINT64_MAX) {
+    this->labels.back().endMicros = this->latestMicros;
+  }
+
+  this->header.recordCount = this->recordCount;
+  this->header.segmentCount = this->segments.size();
+  this->header.segmentsOffset = alignOffset(this->header.recordsOffset + this->recordCount * sizeof(TraceRecord));
+  this->header.labelCount = this->labels.size();
+  this->header.labelsOffset = alignOffset(this->header.segmentsOffset + this->segments.size() * sizeof(TraceSegment));
+
+  bool ok = fseek(this->file, (long) this->header.segmentsOffset, SEEK_SET) == 0 &&
+            fwrite(this->segments.data(), sizeof(TraceSegment), this->segments.size(), this->file) == this->segments.size() &&
+            fseek(this->file, (long) this->header.labelsOffset, SEEK_SET) == 0 &&
+            fwrite(this->labels.data(), sizeof(TraceLabel), this->labels.size(), this->file) == this->labels.size() &&
+            fseek(this->file, 0, SEEK_SET) == 0 &&
+            fwrite(&this->header, sizeof(this->header), 1, this->file) == 1;
+  ok = (fclose(this->file) == 0) && ok;
+  this->file = NULL;
+  if (!ok) { error = std::string("can't finish the trace: ") + strerror(errno); }
+  return ok;
+}
+
+// Fills in the open segment's timing from what was measured while it ran
+void TraceWriter::closeSegment() {
+  TraceSegment &segment = this->segments.back();
+  segment.periodNanos = measuredPeriodNanos();
+  uint64_t lead = (uint64_t) (this->anchor.firstBurstCount - 1) * segment.periodNanos / 1000;
+  segment.startMicros = (this->anchor.firstDrainMicros > lead) ? this->anchor.firstDrainMicros - lead : 0;
+
+  // Drain times wobble by a few milliseconds, so never let a segment start before the previous one ends
+  if (this->segments.size() > 1) {
+    const TraceSegment &previous = this->segments[this->segments.size() - 2];
+    uint64_t previousEnd = previous.startMicros + previous.recordCount * previous.periodNanos / 1000;
+    if (segment.startMicros < previousEnd) { segment.startMicros = previousEnd; }
+  }
+}
+
+// Sample period of the open segment, from its drain times once it has run long enough, otherwise the nominal rate
+uint32_t TraceWriter::measuredPeriodNanos() const {
+  uint32_t samples = this->anchor.nextIndex - (this->anchor.firstIndex + this->anchor.firstBurstCount);
+  uint32_t nominal = 1000000000UL / this->header.sampleRateHz;
+  if (samples < this->header.sampleRateHz * 10) { return nominal; }
+  return (uint32_t) ((this->anchor.lastDrainMicros - this->anchor.firstDrainMicros) * 1000 / samples);
+}
+
+// Replaces the labels of an existing trace file (labels are the last section, so only the tail is rewritten)
+bool writeTraceLabels(const char *path, const std::vector<TraceLabel> &labels, std::string &error) {
+  int fd = ::open(path, O_RDWR);
+  if (fd < 0) {
+    error = describeErrno("can't open", path);
+    return false;
+  }
+
+  TraceFileHeader header;
+  if (pread(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header) ||
+      memcmp(header.magic, TraceFormat::FILE_MAGIC, sizeof(header.magic)) != 0) {
+    error = std::string(path) + " is not a trace file";
+    ::close(fd);
+    return false;
+  }
+
+  std::vector<TraceLabel> sorted(labels);
+  std::sort(sorted.begin(), sorted.end(), [](const TraceLabel &a, const TraceLabel &b) { return a.startMicros < b.startMicros; });
+  header.labelCount = sorted.size();
+  size_t bytes = sorted.size() * sizeof(TraceLabel);
+
+  bool ok = ftruncate(fd, (off_t) header.labelsOffset) == 0 &&
+            pwrite(fd, sorted.data(), bytes, (off_t) header.labelsOffset) == (ssize_t) bytes &&
+            pwrite(fd, &header, sizeof(header), 0) == (ssize_t) sizeof(header);
+  if (!ok) { error = describeErrno("can't write", path); }
+  ::close(fd);
+  return ok;
+}
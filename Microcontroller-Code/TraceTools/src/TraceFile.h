@@ -0,0 +1,103 @@
+/*
+  WasherWatcher TraceTools
+  "TraceFile.h"
+
+  Reading and writing the indexed trace files described in TraceFormat.h.
+*/
+
+#ifndef TRACE_FILE_H
+#define TRACE_FILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <TraceFormat.h>
+
+/******************** TraceReader Class Definition ************************
+ * Maps a whole trace file read-only. Records, segments and labels are used
+ * straight from the mapping, so opening a month of samples costs nothing
+ * until they are read, and several replay threads can share one reader.
+ *************************************************************************/
+class TraceReader {
+  public:
+    TraceReader() {}
+    ~TraceReader();
+    TraceReader(const TraceReader &) = delete;
+    TraceReader &operator=(const TraceReader &) = delete;
+
+    bool open(const char *path, std::string &error);
+    void close();
+
+    const TraceFileHeader &getHeader() const { return *header; }
+    const TraceRecord *getRecords() const { return records; }
+    const TraceSegment *getSegments() const { return segments; }
+    const TraceLabel *getLabels() const { return labels; }
+    uint64_t getRecordCount() const { return header->recordCount; }
+    uint64_t getSegmentCount() const { return header->segmentCount; }
+    uint64_t getLabelCount() const { return header->labelCount; }
+    uint64_t getDurationMicros() const;
+    const char *getPath() const { return path.c_str(); }
+
+  private:
+    std::string path;
+    void *mapping = NULL;
+    size_t mappedBytes = 0;
+    const TraceFileHeader *header = NULL;
+    const TraceRecord *records = NULL;
+    const TraceSegment *segments = NULL;
+    const TraceLabel *labels = NULL;
+};
+
+
+/******************** TraceWriter Class Definition ************************
+ * Writes a trace file while a capture runs. Samples are appended as bursts
+ * arrive; the segments and labels are kept in memory and written, with the
+ * final header, by finish(). Bursts carry the sender's 32 bit micros(), which
+ * is unwrapped here, and a new segment starts wherever samples went missing
+ * (a lost serial frame, a FIFO overflow or the sender restarting).
+ *************************************************************************/
+class TraceWriter {
+  public:
+    static const uint64_t MAX_JITTER_MICROS = 250000;   // A burst arriving further than this from where its index puts it starts a new segment
+
+    TraceWriter() {}
+    ~TraceWriter();
+    TraceWriter(const TraceWriter &) = delete;
+    TraceWriter &operator=(const TraceWriter &) = delete;
+
+    bool open(const char *path, const char *boardId, uint8_t machineType, int64_t startUnixMicros, std::string &error);
+    void addBurst(const TraceBurst &burst, uint64_t hostMicros);
+    void mark(bool running, uint8_t phase);
+    bool finish(std::string &error);
+
+    uint64_t getRecordCount() const { return recordCount; }
+    uint64_t getSegmentCount() const { return segments.size(); }
+    uint64_t getLatestMicros() const { return latestMicros; }
+
+  private:
+    // Where a segment was anchored to the trace's timeline, and how far it has run since
+    typedef struct {
+      uint32_t firstIndex;          // Sender sample index of the segment's first sample
+      uint32_t nextIndex;           // Sender sample index the next burst should start at
+      uint32_t lastDrainRaw;        // Sender micros() of the latest burst, to unwrap the next one
+      uint64_t firstDrainMicros;    // Trace time of the first burst's drain
+      uint64_t lastDrainMicros;     // Trace time of the latest burst's drain (unwrapped)
+      uint32_t firstBurstCount;
+    } SegmentAnchor;
+
+    FILE *file = NULL;
+    TraceFileHeader header;
+    uint64_t recordCount = 0;
+    std::vector<TraceSegment> segments;
+    std::vector<TraceLabel> labels;
+    SegmentAnchor anchor;
+    uint64_t latestMicros = 0;      // Trace time of the newest sample written
+
+    void closeSegment();
+    uint32_t measuredPeriodNanos() const;
+};
+
+bool writeTraceLabels(const char *path, const std::vector<TraceLabel> &labels, std::string &error);
+
+#endif
@@ -0,0 +1,412 @@
+/*
+  WasherWatcher TraceTools
+  "main.cpp"
+
+  Records raw accelerometer traces from a Sender built with TRACE_MODE, and replays them through the
+  Sender's detection code to tune it without standing next to a washer.
+
+  Usage:
+    tracetool capture <serial device or file> <out.wwt> [--baud=921600] [--board=NAME] [--type=washer|dryer]
+        While capturing, type "on [wash|rinse|spin|tumble]" or "off" (then Enter) whenever the machine
+        starts or stops, to label the trace. "quit" or Ctrl-C finishes the file.
+    tracetool info <trace.wwt>...
+    tracetool label <trace.wwt> <startSeconds> <endSeconds> on|off [phase]
+    tracetool label <trace.wwt> --clear
+        Replays count any time no label covers as off, so marking just the cycles is enough.
+    tracetool replay <trace.wwt>... [--mode=mean|variance|spectral] [--threshold=FROM[:TO:STEP]]
+                     [--window=FROM[:TO:STEP]] [--every=SAMPLES] [--type=washer|dryer] [--threads=N]
+                     [--start-dwell=SECONDS] [--stop-dwell=SECONDS] [--exit=FRACTION] [--alpha=WEIGHT]
+        Replays every combination of threshold and window length over all the traces and prints a score for each.
+        The dwell times, hysteresis (--exit) and idle baseline weight (--alpha) default to the Sender's.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <MachineDetector.h>
+#include <TraceFormat.h>
+#include "Replay.h"
+#include "TraceFile.h"
+
+namespace {
+  const unsigned DEFAULT_BAUD = 921600;   // The Sender's SERIAL_BAUD in trace mode
+  const unsigned DEFAULT_WINDOW_SECONDS = 2;  // The Sender's EVALDELAY
+  const double DEFAULT_START_DWELL_SECONDS = 6;   // The rest match the Sender's DETECTOR_CONFIG
+  const double DEFAULT_STOP_DWELL_SECONDS = 90;
+  const double DEFAULT_EXIT_FRACTION = 0.5;
+  const double DEFAULT_BASELINE_ALPHA = 0.02;
+
+  volatile sig_atomic_t stopRequested = 0;
+
+  void onInterrupt(int) {
+    stopRequested = 1;
+  }
+
+  // Value of a --name=value option, or NULL if arg is a different option
+  const char *optionValue(const char *arg, const char *name) {
+    size_t length = strlen(name);
+    if (strncmp(arg, name, length) != 0 || arg[length] != '=') { return NULL; }
+    return arg + length + 1;
+  }
+
+  // Parses "FROM" or "FROM:TO:STEP" into the list of values it covers
+  bool parseRange(const char *text, std::vector<double> &values) {
+    double from, to, step;
+    values.clear();
+    if (sscanf(text, "%lf:%lf:%lf", &from, &to, &step) == 3) {
+      if (step <= 0 || to < from) { return false; }
+      for (double value = from; value <= to + step / 1000; value += step) { values.push_back(value); }
+      return true;
+    }
+    if (sscanf(text, "%lf", &from) == 1) {
+      values.push_back(from);
+      return true;
+    }
+    return false;
+  }
+
+  bool parseMachineType(const char *text, uint8_t &type) {
+    if (strcmp(text, "washer") == 0) { type = MACHINE_WASHER; }
+    else if (strcmp(text, "dryer") == 0) { type = MACHINE_DRYER; }
+    else { return false; }
+    return true;
+  }
+
+  bool parsePhase(const char *text, uint8_t &phase) {
+    static const char *const NAMES[] = {"idle", "wash", "rinse", "spin", "tumble"};
+    for (uint8_t i = 0; i < sizeof(NAMES) / sizeof(NAMES[0]); i++) {
+      if (strcmp(text, NAMES[i]) == 0) {
+        phase = i;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Puts a serial port into raw mode at baud. Anything that isn't a terminal (a file or pipe) is left alone.
+  bool configureSerial(int fd, unsigned baud) {
+    if (!isatty(fd)) { return true; }
+
+    speed_t speed;
+    switch (baud) {
+      case 115200: speed = B115200; break;
+      case 230400: speed = B230400; break;
+      case 460800: speed = B460800; break;
+      case 921600: speed = B921600; break;
+      default: return false;
+    }
+    struct termios settings;
+    if (tcgetattr(fd, &settings) != 0) { return false; }
+    cfmakeraw(&settings);
+    cfsetispeed(&settings, speed);
+    cfsetospeed(&settings, speed);
+    settings.c_cflag |= CLOCAL | CREAD;
+    return tcsetattr(fd, TCSANOW, &settings) == 0;
+  }
+
+  // Handles one line typed during a capture. Returns false on "quit".
+  bool handleCommand(char *line, TraceWriter &writer) {
+    char *command = strtok(line, " \t\r\n");
+    if (command == NULL) { return true; }
+    char *phaseName = strtok(NULL, " \t\r\n");
+    uint8_t phase = PHASE_IDLE;
+
+    if (strcmp(command, "quit") == 0) { return false; }
+    if (strcmp(command, "on") == 0 && (phaseName == NULL || parsePhase(phaseName, phase))) {
+      writer.mark(true, phase);
+    } else if (strcmp(command, "off") == 0) {
+      writer.mark(false, PHASE_IDLE);
+    } else {
+      fprintf(stderr, "commands: on [wash|rinse|spin|tumble], off, quit\n");
+      return true;
+    }
+    fprintf(stderr, "labelled %s at %.1f s\n", command, writer.getLatestMicros() / 1e6);
+    return true;
+  }
+
+  int capture(int argc, char **argv) {
+    if (argc < 2) { return 2; }
+    const char *source = argv[0];
+    const char *out = argv[1];
+    unsigned baud = DEFAULT_BAUD;
+    const char *board = "";
+    uint8_t type = MACHINE_WASHER;
+    for (int i = 2; i < argc; i++) {
+      const char *value;
+      if ((value = optionValue(argv[i], "--baud")) != NULL) { baud = (unsigned) atoi(value); }
+      else if ((value = optionValue(argv[i], "--board")) != NULL) { board = value; }
+      else if ((value = optionValue(argv[i], "--type")) == NULL || !parseMachineType(value, type)) { return 2; }
+    }
+
+    int fd = open(source, O_RDONLY | O_NOCTTY);
+    if (fd < 0 || !configureSerial(fd, baud)) {
+      fprintf(stderr, "can't open %s at %u baud: %s\n", source, baud, strerror(errno));
+      return 1;
+    }
+
+    std::string error;
+    TraceWriter writer;
+    auto started = std::chrono::steady_clock::now();
+    int64_t startUnixMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    if (!writer.open(out, board, type, startUnixMicros, error)) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+    signal(SIGINT, onInterrupt);
+    signal(SIGTERM, onInterrupt);
+    fprintf(stderr, "capturing from %s into %s (Ctrl-C to finish)\n", source, out);
+
+    SerialFrameParser parser;
+    std::string typed;
+    bool readStdin = true;
+    uint8_t buffer[4096];
+    uint64_t lastReport = 0;
+
+    while (!stopRequested) {
+      struct pollfd fds[2] = {{fd, POLLIN, 0}, {STDIN_FILENO, POLLIN, 0}};
+      if (poll(fds, readStdin ? 2 : 1, 1000) < 0) {
+        if (errno == EINTR) { continue; }
+        break;
+      }
+      uint64_t hostMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - started).count();
+
+      if (fds[0].revents & (POLLIN | POLLHUP)) {
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        if (length <= 0) { break; }   // End of a recorded file, or the device went away
+        for (ssize_t i = 0; i < length; i++) {
+          if (parser.push(buffer[i])) { writer.addBurst(parser.getBurst(), hostMicros); }
+        }
+      }
+
+      if (readStdin && (fds[1].revents & (POLLIN | POLLHUP))) {
+        char chunk[256];
+        ssize_t length = read(STDIN_FILENO, chunk, sizeof(chunk));
+        if (length <= 0) { readStdin = false; }
+        else { typed.append(chunk, (size_t) length); }
+
+        size_t newline;
+        bool keepGoing = true;
+        while (keepGoing && (newline = typed.find('\n')) != std::string::npos) {
+          std::string line = typed.substr(0, newline);
+          typed.erase(0, newline + 1);
+          keepGoing = handleCommand(&line[0], writer);
+        }
+        if (!keepGoing) { break; }
+      }
+
+      if (hostMicros - lastReport >= 10000000) {
+        fprintf(stderr, "%.0f s: %lu samples in %lu segments, %u CRC errors\n", writer.getLatestMicros() / 1e6,
+                (unsigned long) writer.getRecordCount(), (unsigned long) writer.getSegmentCount(),
+                (unsigned) parser.getCrcErrorCount());
+        lastReport = hostMicros;
+      }
+    }
+    close(fd);
+
+    if (!writer.finish(error)) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+    fprintf(stderr, "wrote %lu samples in %lu segments (%u frames, %u CRC errors, %u bytes of text skipped)\n",
+            (unsigned long) writer.getRecordCount(), (unsigned long) writer.getSegmentCount(), (unsigned) parser.getFrameCount(),
+            (unsigned) parser.getCrcErrorCount(), (unsigned) parser.getSkippedBytes());
+    return 0;
+  }
+
+  int info(int argc, char **argv) {
+    if (argc < 1) { return 2; }
+    for (int i = 0; i < argc; i++) {
+      TraceReader trace;
+      std::string error;
+      if (!trace.open(argv[i], error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+      }
+      const TraceFileHeader &header = trace.getHeader();
+      printf("%s: board \"%s\", %s, %u Hz\n", argv[i], header.boardId,
+             header.machineType == MACHINE_DRYER ? "dryer" : "washer", (unsigned) header.sampleRateHz);
+      printf("  %lu samples in %lu segments over %.1f s\n", (unsigned long) trace.getRecordCount(),
+             (unsigned long) trace.getSegmentCount(), trace.getDurationMicros() / 1e6);
+      for (uint64_t s = 0; s < trace.getSegmentCount(); s++) {
+        const TraceSegment &segment = trace.getSegments()[s];
+        printf("  segment %lu: %.1f s, %lu samples, period %.3f ms\n", (unsigned long) s, segment.startMicros / 1e6,
+               (unsigned long) segment.recordCount, segment.periodNanos / 1e6);
+      }
+      for (uint64_t l = 0; l < trace.getLabelCount(); l++) {
+        const TraceLabel &label = trace.getLabels()[l];
+        printf("  label: %.1f - %.1f s %s (phase %u)\n", label.startMicros / 1e6, label.endMicros / 1e6,
+               label.running ? "on" : "off", (unsigned) label.phase);
+      }
+    }
+    return 0;
+  }
+
+  int label(int argc, char **argv) {
+    if (argc < 2) { return 2; }
+    std::vector<TraceLabel> labels;
+    std::string error;
+
+    if (strcmp(argv[1], "--clear") != 0) {
+      if (argc < 4) { return 2; }
+      TraceReader trace;
+      if (!trace.open(argv[0], error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+      }
+      labels.assign(trace.getLabels(), trace.getLabels() + trace.getLabelCount());
+
+      TraceLabel added;
+      memset(&added, 0, sizeof(added));
+      added.startMicros = (uint64_t) (atof(argv[1]) * 1e6);
+      added.endMicros = (uint64_t) (atof(argv[2]) * 1e6);
+      added.running = strcmp(argv[3], "on") == 0;
+      if ((!added.running && strcmp(argv[3], "off") != 0) || added.endMicros <= added.startMicros ||
+          (argc > 4 && !parsePhase(argv[4], added.phase))) { return 2; }
+      labels.push_back(added);
+    }
+
+    if (!writeTraceLabels(argv[0], labels, error)) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+    return 0;
+  }
+
+  int replay(int argc, char **argv) {
+    std::vector<std::unique_ptr<TraceReader>> traces;
+    DetectionMode mode = DETECT_SPECTRAL;
+    std::vector<double> thresholds, windows;
+    size_t every = 0;
+    int type = -1;
+    unsigned threads = std::thread::hardware_concurrency();
+    double startDwell = DEFAULT_START_DWELL_SECONDS, stopDwell = DEFAULT_STOP_DWELL_SECONDS;
+    double exitFraction = DEFAULT_EXIT_FRACTION, alpha = DEFAULT_BASELINE_ALPHA;
+
+    for (int i = 0; i < argc; i++) {
+      const char *value;
+      uint8_t parsedType;
+      if ((value = optionValue(argv[i], "--mode")) != NULL) {
+        if (strcmp(value, "mean") == 0) { mode = DETECT_MEAN; }
+        else if (strcmp(value, "variance") == 0) { mode = DETECT_VARIANCE; }
+        else if (strcmp(value, "spectral") == 0) { mode = DETECT_SPECTRAL; }
+        else { return 2; }
+      } else if ((value = optionValue(argv[i], "--threshold")) != NULL) {
+        if (!parseRange(value, thresholds)) { return 2; }
+      } else if ((value = optionValue(argv[i], "--window")) != NULL) {
+        if (!parseRange(value, windows)) { return 2; }
+      } else if ((value = optionValue(argv[i], "--every")) != NULL) {
+        every = (size_t) atoi(value);
+      } else if ((value = optionValue(argv[i], "--type")) != NULL) {
+        if (!parseMachineType(value, parsedType)) { return 2; }
+        type = parsedType;
+      } else if ((value = optionValue(argv[i], "--threads")) != NULL) {
+        threads = (unsigned) atoi(value);
+      } else if ((value = optionValue(argv[i], "--start-dwell")) != NULL) {
+        startDwell = atof(value);
+      } else if ((value = optionValue(argv[i], "--stop-dwell")) != NULL) {
+        stopDwell = atof(value);
+      } else if ((value = optionValue(argv[i], "--exit")) != NULL) {
+        exitFraction = atof(value);
+      } else if ((value = optionValue(argv[i], "--alpha")) != NULL) {
+        alpha = atof(value);
+      } else if (argv[i][0] == '-') {
+        return 2;
+      } else {
+        std::unique_ptr<TraceReader> trace(new TraceReader());
+        std::string error;
+        if (!trace->open(argv[i], error)) {
+          fprintf(stderr, "%s\n", error.c_str());
+          return 1;
+        }
+        traces.push_back(std::move(trace));
+      }
+    }
+    if (traces.empty()) { return 2; }
+
+    // Defaults are the Sender's own settings, at the rate and for the kind of machine the first trace was recorded with
+    const TraceFileHeader &first = traces[0]->getHeader();
+    uint16_t rate = first.sampleRateHz ? first.sampleRateHz : 100;
+    if (type < 0) { type = first.machineType; }
+    if (thresholds.empty()) { thresholds.push_back(mode == DETECT_MEAN ? 0.01 : 0.05); }
+    if (windows.empty()) { windows.push_back(rate * DEFAULT_WINDOW_SECONDS); }
+
+    std::vector<ReplaySettings> settings;
+    for (double window : windows) {
+      if (window < 2 || window > MachineDetector::WINDOW_CAPACITY) {
+        fprintf(stderr, "window lengths must be 2 - %u samples\n", (unsigned) MachineDetector::WINDOW_CAPACITY);
+        return 2;
+      }
+      for (double threshold : thresholds) {
+        ReplaySettings setting;
+        setting.detector = {mode, (MachineType) type, rate, (size_t) window, (float) threshold, (float) threshold,
+                            (uint32_t) (startDwell * 1000), (uint32_t) (stopDwell * 1000), (float) exitFraction, (float) alpha};
+        setting.evaluateEvery = every ? every : (size_t) window;
+        settings.push_back(setting);
+      }
+    }
+
+    std::vector<const TraceReader *> readers;
+    uint64_t samples = 0;
+    for (const std::unique_ptr<TraceReader> &trace : traces) {
+      readers.push_back(trace.get());
+      samples += trace->getRecordCount();
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    std::vector<ReplayScore> scores = Replay::run(readers, settings, threads);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    printf("%9s %6s %8s %8s %8s %6s %8s %6s %9s %9s\n", "threshold", "window", "accuracy", "falseOn", "falseOff",
+           "flips", "detected", "missed", "latency_s", "worst_s");
+    for (size_t i = 0; i < settings.size(); i++) {
+      const ReplayScore &score = scores[i];
+      double accuracy = score.evaluations ? 100.0 * score.agreed / score.evaluations : 0.0;
+      double latency = score.detected ? score.latencySumMicros / 1e6 / score.detected : 0.0;
+      printf("%9.4f %6u %7.2f%% %8lu %8lu %6lu %8lu %6lu %9.1f %9.1f\n", settings[i].detector.thresholdPercent,
+             (unsigned) settings[i].detector.windowLength, accuracy, (unsigned long) score.falseOn,
+             (unsigned long) score.falseOff, (unsigned long) score.flips, (unsigned long) score.detected,
+             (unsigned long) score.missed, latency, score.latencyMaxMicros / 1e6);
+    }
+    fprintf(stderr, "replayed %lu samples x %lu configurations in %.2f s (%.1f M samples/s on %u threads)\n",
+            (unsigned long) samples, (unsigned long) settings.size(), seconds,
+            samples * settings.size() / seconds / 1e6, threads);
+    return 0;
+  }
+
+  void usage(const char *program) {
+    fprintf(stderr,
+            "usage: %s capture <serial device or file> <out.wwt> [--baud=921600] [--board=NAME] [--type=washer|dryer]\n"
+            "       %s info <trace.wwt>...\n"
+            "       %s label <trace.wwt> <startSeconds> <endSeconds> on|off [phase] | --clear\n"
+            "       %s replay <trace.wwt>... [--mode=mean|variance|spectral] [--threshold=FROM[:TO:STEP]]\n"
+            "                [--window=FROM[:TO:STEP]] [--every=SAMPLES] [--type=washer|dryer] [--threads=N]\n"
+            "                [--start-dwell=SECONDS] [--stop-dwell=SECONDS] [--exit=FRACTION] [--alpha=WEIGHT]\n",
+            program, program, program, program);
+  }
+}
+
+int main(int argc, char **argv) {
+  int result = 2;
+  if (argc >= 2) {
+    if (strcmp(argv[1], "capture") == 0) { result = capture(argc - 2, argv + 2); }
+    else if (strcmp(argv[1], "info") == 0) { result = info(argc - 2, argv + 2); }
+    else if (strcmp(argv[1], "label") == 0) { result = label(argc - 2, argv + 2); }
+    else if (strcmp(argv[1], "replay") == 0) { result = replay(argc - 2, argv + 2); }
+  }
+  if (result == 2) { usage(argv[0]); }
+  return result;
+}
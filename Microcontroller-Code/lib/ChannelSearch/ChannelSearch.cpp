@@ -0,0 +1,82 @@
+/*
+  WasherWatcher shared sender library
+  "ChannelSearch.cpp"
+*/
+
+#include "ChannelSearch.h"
+
+// Constructor. triesPerChannel: failed sends before moving on from an unconfirmed channel (one failure can
+// just be a collision). lostAfterFailures: failed sends in a row after which a confirmed channel is searched again.
+ChannelSearch::ChannelSearch(uint8_t triesPerChannel, uint8_t lostAfterFailures)
+    : triesPerChannel(triesPerChannel ? triesPerChannel : 1), lostAfterFailures(lostAfterFailures ? lostAfterFailures : 1) {}
+
+// Starts searching from the channel stored last time, or (0) with a scan
+void ChannelSearch::begin(uint8_t cachedChannel) {
+  this->failures = 0;
+  this->sweeps = 0;
+  this->startedCached = (cachedChannel >= 1 && cachedChannel <= MAX_CHANNEL);
+  if (this->startedCached) {
+    this->stage = STAGE_CACHED;
+    this->channel = cachedChannel;
+  } else {
+    this->stage = STAGE_SCAN;
+  }
+}
+
+// Records whether a send was acknowledged. Returns true if the radio should move to a new channel.
+bool ChannelSearch::recordDelivery(bool delivered) {
+  if (delivered) {
+    this->stage = STAGE_CONFIRMED;
+    this->failures = 0;
+    this->sweeps = 0;
+    return false;
+  }
+
+  this->failures++;
+  if (this->stage == STAGE_SCAN) { return false; }
+
+  if (this->stage == STAGE_CONFIRMED) {
+    // The access point (and so the receiver) may have moved: look for it again, fast retries included
+    if (this->failures >= this->lostAfterFailures) {
+      this->stage = STAGE_SCAN;
+      this->failures = 0;
+    }
+    return false;
+  }
+
+  // A channel the scan saw the network on is almost certainly right, so it gets as long as a confirmed one
+  uint8_t tries = (this->stage == STAGE_SCANNED) ? this->lostAfterFailures : this->triesPerChannel;
+  if (this->failures < tries) { return false; }
+  this->failures = 0;
+
+  if (this->stage == STAGE_CACHED) {
+    this->stage = STAGE_SCAN;
+    return false;
+  }
+  this->stage = STAGE_SWEEP;
+  this->stepChannel();
+  return true;
+}
+
+// Takes the channel a scan found the receiver's network on, or 0 if it wasn't seen
+void ChannelSearch::setScanResult(uint8_t foundChannel) {
+  this->scans++;
+  this->failures = 0;
+  if (foundChannel >= 1 && foundChannel <= MAX_CHANNEL) {
+    this->stage = STAGE_SCANNED;
+    this->channel = foundChannel;
+  } else {
+    this->stage = STAGE_SWEEP;
+    this->stepChannel();
+  }
+}
+
+// Moves to the next channel, wrapping from the last back to 1 (which completes a sweep)
+void ChannelSearch::stepChannel() {
+  if (this->channel >= MAX_CHANNEL) {
+    this->channel = 1;
+    if (this->sweeps < 255) { this->sweeps++; }
+  } else {
+    this->channel++;
+  }
+}
@@ -0,0 +1,55 @@
+/*
+  WasherWatcher shared sender library
+  "ChannelSearch.h"
+
+  Finds the WiFi channel the receiver listens on. ESP-NOW only reaches a receiver on the sender's own
+  channel, which is the channel of the access point the receiver joined. Scanning for that access point
+  blocks for seconds, so a sender first tries the channel it reached the receiver on last time, and only
+  scans (for the one SSID) when that channel stops working. If the scan doesn't find the network either,
+  it steps through every channel in turn. A delivered frame (ESP-NOW's MAC-level ack) confirms a channel.
+*/
+
+#ifndef CHANNEL_SEARCH_H
+#define CHANNEL_SEARCH_H
+
+#include <stdint.h>
+
+/***************** ChannelSearch Class Definition ************************
+ * Call recordDelivery() with the outcome of every send. When it returns
+ * true, tune the radio to getChannel(). When isScanDue(), scan for the
+ * receiver's network and pass the channel found (0 if none) to
+ * setScanResult(), then tune to getChannel().
+ *************************************************************************/
+class ChannelSearch {
+  public:
+    static const uint8_t MAX_CHANNEL = 13;
+
+    ChannelSearch(uint8_t triesPerChannel, uint8_t lostAfterFailures);
+    void begin(uint8_t cachedChannel);
+    bool recordDelivery(bool delivered);
+    void setScanResult(uint8_t foundChannel);
+
+    uint8_t getChannel() const { return channel; }
+    bool isScanDue() const { return stage == STAGE_SCAN; }
+    bool isConfirmed() const { return stage == STAGE_CONFIRMED; }
+    bool shouldRetrySoon() const { return stage != STAGE_CONFIRMED && sweeps == 0; }
+    bool wasCached() const { return startedCached; }
+    uint32_t getScans() const { return scans; }
+
+  private:
+    enum Stage { STAGE_CACHED, STAGE_SCAN, STAGE_SCANNED, STAGE_SWEEP, STAGE_CONFIRMED };
+
+    uint8_t triesPerChannel;
+    uint8_t lostAfterFailures;
+
+    Stage stage = STAGE_SCAN;
+    uint8_t channel = 1;
+    uint8_t failures = 0;        // Failed sends in a row on the current channel
+    uint8_t sweeps = 0;          // Times the sweep wrapped back to channel 1 since the last confirmed channel
+    bool startedCached = false;
+    uint32_t scans = 0;
+
+    void stepChannel();
+};
+
+#endif
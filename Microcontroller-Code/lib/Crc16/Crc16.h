@@ -0,0 +1,29 @@
+/*
+  WasherWatcher shared library
+  "Crc16.h"
+
+  The CRC every checked record in the project uses: the senders' serial trace frames (TraceFormat), their saved
+  settings (SenderConfig) and the receiver's state journal (StateJournal).
+*/
+
+#ifndef CRC16_H
+#define CRC16_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  CRC-16/CCITT-FALSE (polynomial 0x1021, starting at 0xFFFF, not reflected), bit by bit: everything checked is
+  under 1 KB, so a table isn't worth the flash. Pass an earlier result as crc to carry on over more data.
+*/
+inline uint16_t crc16(const uint8_t *data, size_t length, uint16_t crc = 0xFFFF) {
+  for (size_t i = 0; i < length; i++) {
+    crc ^= (uint16_t) data[i] << 8;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (uint16_t) ((crc << 1) ^ 0x1021) : (uint16_t) (crc << 1);
+    }
+  }
+  return crc;
+}
+
+#endif
@@ -0,0 +1,131 @@
+/*
+  WasherWatcher shared sender library
+  "DeliveryQueue.cpp"
+*/
+
+#include "DeliveryQueue.h"
+#include <string.h>
+
+// Constructor. firstRetryMs/maxRetryMs: backoff range between sends of one frame. maxAttempts: sends before a frame is
+// given up on. ackTimeoutMs: how long to wait for a send's outcome before counting it as failed.
+DeliveryQueue::DeliveryQueue(uint32_t firstRetryMs, uint32_t maxRetryMs, uint8_t maxAttempts, uint32_t ackTimeoutMs)
+    : backoff(firstRetryMs, maxRetryMs), maxAttempts(maxAttempts ? maxAttempts : 1), ackTimeoutMs(ackTimeoutMs) {}
+
+// Empties the queue and its totals. The seed should differ between boards (e.g. derived from the chip's MAC).
+void DeliveryQueue::begin(uint32_t seed) {
+  this->randomState = seed ? seed : 1;
+  this->hasCurrent = false;
+  this->hasWaiting = false;
+  this->inFlight = false;
+  this->backoff.reset();
+  this->stats = DeliveryStats();
+}
+
+// Queues a newly built frame, superseding any older frame that isn't on the air right now
+void DeliveryQueue::push(const uint8_t *frame, size_t length, uint32_t nowMs) {
+  if (length > LaundryProtocol::MAX_FRAME_BYTES) { return; }
+  this->stats.queued++;
+
+  if (this->inFlight) {
+    if (this->hasWaiting) { this->stats.superseded++; }
+    this->store(this->waiting, frame, length, nowMs);
+    this->hasWaiting = true;
+    return;
+  }
+  if (this->hasCurrent) { this->stats.superseded++; }
+  this->store(this->current, frame, length, nowMs);
+  this->hasCurrent = true;
+  this->backoff.reset();
+}
+
+// Returns the length of the frame due to be sent now (pointing frame at it), or 0 if nothing is due
+size_t DeliveryQueue::nextDue(uint32_t nowMs, const uint8_t *&frame) {
+  if (this->inFlight) {
+    if (nowMs - this->sentMs < this->ackTimeoutMs) { return 0; }
+    this->recordResult(false, nowMs);
+  }
+  if (!this->hasCurrent || (int32_t) (nowMs - this->current.nextAttemptMs) < 0) { return 0; }
+
+  frame = this->current.data;
+  return this->current.length;
+}
+
+/*
+  Returns the ms until nextDue() has something to do: send or resend the current frame, or give up waiting for the
+  outcome of the one on the air. 0 if that is now, UINT32_MAX if nothing is queued. A sender can sleep that long.
+*/
+uint32_t DeliveryQueue::untilDue(uint32_t nowMs) const {
+  int32_t remaining;
+  if (this->inFlight) {
+    remaining = (int32_t) (this->sentMs + this->ackTimeoutMs - nowMs);
+  } else if (this->hasCurrent) {
+    remaining = (int32_t) (this->current.nextAttemptMs - nowMs);
+  } else {
+    return UINT32_MAX;
+  }
+  return (remaining > 0) ? (uint32_t) remaining : 0;
+}
+
+// Records that the frame from nextDue() was handed to the radio
+void DeliveryQueue::recordTransmit(uint32_t nowMs) {
+  if (!this->hasCurrent || this->inFlight) { return; }
+  this->current.attempts++;
+  this->stats.transmissions++;
+  if (this->current.attempts > 1) { this->stats.retries++; }
+  this->inFlight = true;
+  this->sentMs = nowMs;
+}
+
+// Takes the outcome of the frame on the air. Returns true if it was delivered.
+bool DeliveryQueue::recordResult(bool delivered, uint32_t nowMs) {
+  if (!this->inFlight) { return false; }
+  this->inFlight = false;
+
+  if (delivered) {
+    this->lastLatencyMs = nowMs - this->current.queuedMs;
+    this->lastAttempts = this->current.attempts;
+    this->stats.delivered++;
+    this->stats.latencySumMs += this->lastLatencyMs;
+    if (this->lastLatencyMs > this->stats.latencyMaxMs) { this->stats.latencyMaxMs = this->lastLatencyMs; }
+    this->hasCurrent = false;
+    this->promoteWaiting();
+    return true;
+  }
+
+  if (this->hasWaiting) {
+    // A newer frame was built while this one was on the air, so send that instead of retrying this one
+    this->stats.superseded++;
+    this->promoteWaiting();
+  } else if (this->current.attempts >= this->maxAttempts) {
+    this->stats.abandoned++;
+    this->hasCurrent = false;
+  } else {
+    this->current.nextAttemptMs = nowMs + this->backoff.next(this->nextRandom());
+  }
+  return false;
+}
+
+void DeliveryQueue::store(Entry &entry, const uint8_t *frame, size_t length, uint32_t nowMs) {
+  memcpy(entry.data, frame, length);
+  entry.length = (uint8_t) length;
+  entry.attempts = 0;
+  entry.queuedMs = nowMs;
+  entry.nextAttemptMs = nowMs;
+}
+
+// Makes the waiting frame the current one, due right away with a fresh backoff
+void DeliveryQueue::promoteWaiting() {
+  if (!this->hasWaiting) { return; }
+  this->current = this->waiting;
+  this->hasCurrent = true;
+  this->hasWaiting = false;
+  this->backoff.reset();
+}
+
+// xorshift32, like TransmitPolicy's jitter (the senders have no other random source in common)
+uint32_t DeliveryQueue::nextRandom() {
+  this->randomState ^= this->randomState << 13;
+  this->randomState ^= this->randomState >> 17;
+  this->randomState ^= this->randomState << 5;
+  return this->randomState;
+}
@@ -0,0 +1,84 @@
+/*
+  WasherWatcher shared sender library
+  "DeliveryQueue.h"
+
+  Retransmits ESP-NOW frames the receiver didn't acknowledge. A frame that fails is sent again after an
+  exponential, jittered backoff, until it is delivered, a newer frame replaces it, or it has been tried
+  maxAttempts times. Every frame carries the machine's whole current state, so a newer frame supersedes any
+  older one still waiting: only the frame being sent and the newest frame behind it are ever kept. A
+  retransmission is the same frame (same sequence number), which the receiver recognises as a duplicate
+  if an earlier copy did arrive and only its ack was lost.
+*/
+
+#ifndef DELIVERY_QUEUE_H
+#define DELIVERY_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <LaundryProtocol.h>
+#include <RetryBackoff.h>
+
+// Totals since begin()
+typedef struct {
+  uint32_t queued;          // Frames pushed
+  uint32_t transmissions;   // Sends handed to ESP-NOW, retries included
+  uint32_t retries;
+  uint32_t delivered;
+  uint32_t superseded;      // Frames dropped for a newer one before they were delivered
+  uint32_t abandoned;       // Frames dropped after maxAttempts failed sends
+  uint32_t latencySumMs;    // Push to ack, summed over delivered frames
+  uint32_t latencyMaxMs;
+} DeliveryStats;
+
+
+/****************** DeliveryQueue Class Definition ***********************
+ * push() every frame built. Whenever nextDue() returns a frame, hand it to
+ * esp_now_send() and call recordTransmit(), then pass the send callback's
+ * outcome to recordResult(). A frame whose outcome never arrives is counted
+ * as failed after ackTimeoutMs. All times are millis().
+ *************************************************************************/
+class DeliveryQueue {
+  public:
+    DeliveryQueue(uint32_t firstRetryMs, uint32_t maxRetryMs, uint8_t maxAttempts, uint32_t ackTimeoutMs);
+    void begin(uint32_t seed);
+    void push(const uint8_t *frame, size_t length, uint32_t nowMs);
+    size_t nextDue(uint32_t nowMs, const uint8_t *&frame);
+    uint32_t untilDue(uint32_t nowMs) const;
+    void recordTransmit(uint32_t nowMs);
+    bool recordResult(bool delivered, uint32_t nowMs);
+
+    uint32_t getLastLatencyMs() const { return lastLatencyMs; }
+    uint8_t getLastAttempts() const { return lastAttempts; }
+    bool hasPending() const { return hasCurrent || hasWaiting; }
+    const DeliveryStats &getStats() const { return stats; }
+
+  private:
+    typedef struct {
+      uint8_t data[LaundryProtocol::MAX_FRAME_BYTES];
+      uint8_t length;
+      uint8_t attempts;         // Times it has been sent
+      uint32_t queuedMs;
+      uint32_t nextAttemptMs;
+    } Entry;
+
+    RetryBackoff backoff;
+    uint8_t maxAttempts;
+    uint32_t ackTimeoutMs;
+
+    Entry current;              // Being sent, or waiting to be sent again
+    Entry waiting;              // Newest frame, behind one in flight
+    bool hasCurrent = false;
+    bool hasWaiting = false;
+    bool inFlight = false;      // current was sent and its outcome hasn't arrived
+    uint32_t sentMs = 0;
+    uint32_t randomState = 1;
+    uint32_t lastLatencyMs = 0;
+    uint8_t lastAttempts = 0;
+    DeliveryStats stats = {};
+
+    void store(Entry &entry, const uint8_t *frame, size_t length, uint32_t nowMs);
+    void promoteWaiting();
+    uint32_t nextRandom();
+};
+
+#endif
@@ -0,0 +1,221 @@
+/*
+  WasherWatcher shared library
+  "LaundryProtocol.h"
+
+  Wire format of the ESP-NOW frames sent from the Senders to the Receiver, shared by both so they can't drift apart.
+
+  Version 1 is the original sensor_message struct: a 32 character id and a bool (33 bytes).
+  Version 2 is a packed little-endian frame:
+    offset  size  field
+         0     1  version (always 2, which can never start a printable v1 id)
+         1     2  machine id (16 bit hash of the board's name, see machineIdFromName())
+         3     2  sequence number
+         5     4  sender uptime in milliseconds
+         9     1  state: bit 7 = machine on, bits 0-6 = cycle phase
+        10     1  number of feature summaries that follow
+        11   6*n  feature summaries, oldest first (see FeatureSummary)
+  A v2 frame with no summaries is 11 bytes, a third of a v1 frame.
+*/
+
+#ifndef LAUNDRY_PROTOCOL_H
+#define LAUNDRY_PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Version 1 frame. Still decoded by the Receiver so older Senders keep working.
+typedef struct {
+  char id[32];
+  bool machineOn;
+} sensor_message;
+
+// Statistics of one evaluation window, several of which can share one v2 frame
+typedef struct {
+  uint8_t phase;          // Cycle phase found for this window
+  uint8_t peakFreqDeciHz; // Strongest vibration frequency, in 0.1 Hz
+  uint16_t meanCms2;      // Mean acceleration magnitude, in cm/s^2
+  uint16_t stdDevMms2;    // Standard deviation of the magnitude, in mm/s^2
+} FeatureSummary;
+
+namespace LaundryProtocol {
+
+  const uint8_t VERSION_2 = 2;
+  const size_t V1_FRAME_BYTES = sizeof(sensor_message);
+  const size_t V2_HEADER_BYTES = 11;
+  const size_t FEATURE_BYTES = 6;
+  const size_t MAX_FEATURES = 16;
+  const size_t MAX_FRAME_BYTES = V2_HEADER_BYTES + MAX_FEATURES * FEATURE_BYTES;   // 107, well under ESP-NOW's 250
+  const uint8_t STATE_ON_BIT = 0x80;
+  const uint8_t STATE_PHASE_MASK = 0x7F;
+
+}
+
+// A decoded frame of either version
+typedef struct {
+  uint8_t version;
+  uint16_t machineId;
+  char name[32];          // Only sent by v1 frames (empty for v2)
+  uint16_t sequence;
+  uint32_t uptimeMs;
+  bool machineOn;
+  uint8_t phase;
+  uint8_t featureCount;
+  FeatureSummary features[LaundryProtocol::MAX_FEATURES];
+} DecodedFrame;
+
+namespace LaundryProtocol {
+
+  // Packs the on/off flag and the cycle phase into a v2 state byte
+  inline uint8_t stateCode(bool machineOn, uint8_t phase) {
+    return (machineOn ? STATE_ON_BIT : 0) | (phase & STATE_PHASE_MASK);
+  }
+
+  // 16 bit machine id from a board name (FNV-1a folded to 16 bits). Never returns 0, which means "no id".
+  inline uint16_t machineIdFromName(const char *name) {
+    uint32_t hash = 2166136261UL;
+    for (const char *c = name; *c; c++) {
+      hash ^= (uint8_t) *c;
+      hash *= 16777619UL;
+    }
+    uint16_t id = (uint16_t) ((hash >> 16) ^ (hash & 0xFFFF));
+    return id ? id : 1;
+  }
+
+  inline void writeU16(uint8_t *out, uint16_t value) {
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+  }
+
+  inline void writeU32(uint8_t *out, uint32_t value) {
+    writeU16(out, value & 0xFFFF);
+    writeU16(out + 2, value >> 16);
+  }
+
+  inline uint16_t readU16(const uint8_t *in) {
+    return (uint16_t) (in[0] | (in[1] << 8));
+  }
+
+  inline uint32_t readU32(const uint8_t *in) {
+    return readU16(in) | ((uint32_t) readU16(in + 2) << 16);
+  }
+
+  // Encodes a v2 frame into out. Returns the frame length, or 0 if it doesn't fit in capacity.
+  inline size_t encodeV2(uint16_t machineId, uint16_t sequence, uint32_t uptimeMs, uint8_t state,
+                         const FeatureSummary *features, size_t featureCount, uint8_t *out, size_t capacity) {
+    if (featureCount > MAX_FEATURES) { featureCount = MAX_FEATURES; }
+    size_t length = V2_HEADER_BYTES + featureCount * FEATURE_BYTES;
+    if (length > capacity) { return 0; }
+
+    out[0] = VERSION_2;
+    writeU16(out + 1, machineId);
+    writeU16(out + 3, sequence);
+    writeU32(out + 5, uptimeMs);
+    out[9] = state;
+    out[10] = (uint8_t) featureCount;
+
+    uint8_t *cursor = out + V2_HEADER_BYTES;
+    for (size_t i = 0; i < featureCount; i++) {
+      cursor[0] = features[i].phase;
+      cursor[1] = features[i].peakFreqDeciHz;
+      writeU16(cursor + 2, features[i].meanCms2);
+      writeU16(cursor + 4, features[i].stdDevMms2);
+      cursor += FEATURE_BYTES;
+    }
+    return length;
+  }
+
+  // Decodes a received frame of either version. Returns false (leaving out unspecified) if the frame is malformed.
+  inline bool decode(const uint8_t *data, size_t length, DecodedFrame &out) {
+    if (length == 0) { return false; }
+
+    if (data[0] == VERSION_2) {
+      if (length < V2_HEADER_BYTES) { return false; }
+      size_t featureCount = data[10];
+      if (featureCount > MAX_FEATURES || length != V2_HEADER_BYTES + featureCount * FEATURE_BYTES) { return false; }
+
+      out.version = VERSION_2;
+      out.machineId = readU16(data + 1);
+      out.name[0] = '\0';
+      out.sequence = readU16(data + 3);
+      out.uptimeMs = readU32(data + 5);
+      out.machineOn = (data[9] & STATE_ON_BIT) != 0;
+      out.phase = data[9] & STATE_PHASE_MASK;
+      out.featureCount = (uint8_t) featureCount;
+
+      const uint8_t *cursor = data + V2_HEADER_BYTES;
+      for (size_t i = 0; i < featureCount; i++) {
+        out.features[i].phase = cursor[0];
+        out.features[i].peakFreqDeciHz = cursor[1];
+        out.features[i].meanCms2 = readU16(cursor + 2);
+        out.features[i].stdDevMms2 = readU16(cursor + 4);
+        cursor += FEATURE_BYTES;
+      }
+      return true;
+    }
+
+    // Anything else must be a complete v1 struct with a terminated id that starts printable (any other first byte is an unknown version)
+    if (length != V1_FRAME_BYTES || data[0] < ' ' || data[0] > '~' || memchr(data, '\0', sizeof(out.name)) == NULL) { return false; }
+
+    out.version = 1;
+    memcpy(out.name, data, sizeof(out.name));
+    out.machineId = machineIdFromName(out.name);
+    out.sequence = 0;
+    out.uptimeMs = 0;
+    out.machineOn = data[sizeof(out.name)] != 0;
+    out.phase = 0;
+    out.featureCount = 0;
+    return true;
+  }
+
+}
+
+
+/******************** FrameBuilder Class Definition ***********************
+ * Collects feature summaries between transmissions and packs them, with the
+ * current state, into v2 frames. When more summaries arrive than fit in a
+ * frame the oldest are dropped, so a frame always describes the latest windows.
+ *************************************************************************/
+class FrameBuilder {
+  public:
+    explicit FrameBuilder(size_t maxFeatures = LaundryProtocol::MAX_FEATURES);
+    void setMachineId(uint16_t machineId) { this->machineId = machineId; }
+    uint16_t getMachineId() const { return machineId; }
+    void addFeature(const FeatureSummary &feature);
+    size_t build(uint32_t uptimeMs, uint8_t state, uint8_t *out, size_t capacity);
+    uint16_t getLastSequence() const { return (uint16_t) (sequence - 1); }
+
+  private:
+    uint16_t machineId = 0;
+    uint16_t sequence = 0;
+    size_t maxFeatures;
+    size_t featureCount = 0;
+    FeatureSummary features[LaundryProtocol::MAX_FEATURES];
+};
+
+// Constructor, limiting how many summaries are batched into each frame
+inline FrameBuilder::FrameBuilder(size_t maxFeatures) : maxFeatures(maxFeatures) {
+  if (this->maxFeatures > LaundryProtocol::MAX_FEATURES) { this->maxFeatures = LaundryProtocol::MAX_FEATURES; }
+}
+
+// Queues a summary for the next frame, dropping the oldest one if the batch is full
+inline void FrameBuilder::addFeature(const FeatureSummary &feature) {
+  if (maxFeatures == 0) { return; }
+  if (featureCount == maxFeatures) {
+    memmove(features, features + 1, (featureCount - 1) * sizeof(FeatureSummary));
+    featureCount--;
+  }
+  features[featureCount++] = feature;
+}
+
+// Encodes the next frame (taking a new sequence number) and empties the batch. Returns the frame length.
+inline size_t FrameBuilder::build(uint32_t uptimeMs, uint8_t state, uint8_t *out, size_t capacity) {
+  size_t length = LaundryProtocol::encodeV2(machineId, sequence, uptimeMs, state, features, featureCount, out, capacity);
+  if (length > 0) {
+    sequence++;
+    featureCount = 0;
+  }
+  return length;
+}
+
+#endif
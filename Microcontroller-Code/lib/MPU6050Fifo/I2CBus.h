@@ -0,0 +1,27 @@
+/*
+  WasherWatcher shared sender library
+  "I2CBus.h"
+
+  Minimal register-level I2C interface used by the MPU6050 acquisition code.
+  The firmware implements it with Arduino's Wire (see WireBus.h); a mock device can implement it on a PC.
+*/
+
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/************************** I2CBus Interface ******************************
+ * Register reads and writes against a 7-bit device address.
+ * readRegisters() is a single bus transaction, so length must not exceed maxReadLength().
+ *************************************************************************/
+class I2CBus {
+  public:
+    virtual ~I2CBus() {}
+    virtual bool writeRegister(uint8_t address, uint8_t reg, uint8_t value) = 0;
+    virtual bool readRegisters(uint8_t address, uint8_t reg, uint8_t *buffer, size_t length) = 0;
+    virtual size_t maxReadLength() const = 0;
+};
+
+#endif
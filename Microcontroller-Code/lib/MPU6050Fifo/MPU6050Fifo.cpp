@@ -0,0 +1,172 @@
+/*
+  WasherWatcher shared sender library
+  "MPU6050Fifo.cpp"
+
+  Register map and scale factors are from the MPU-6000/6050 Register Map and Descriptions, revision 4.2.
+*/
+
+#include "MPU6050Fifo.h"
+
+namespace {
+  // Registers
+  const uint8_t REG_SMPLRT_DIV = 0x19;
+  const uint8_t REG_CONFIG = 0x1A;
+  const uint8_t REG_GYRO_CONFIG = 0x1B;
+  const uint8_t REG_ACCEL_CONFIG = 0x1C;
+  const uint8_t REG_FIFO_EN = 0x23;
+  const uint8_t REG_INT_ENABLE = 0x38;
+  const uint8_t REG_INT_STATUS = 0x3A;
+  const uint8_t REG_USER_CTRL = 0x6A;
+  const uint8_t REG_PWR_MGMT_1 = 0x6B;
+  const uint8_t REG_FIFO_COUNT_H = 0x72;
+  const uint8_t REG_FIFO_R_W = 0x74;
+  const uint8_t REG_WHO_AM_I = 0x75;
+
+  // Register values
+  const uint8_t PWR_CLOCK_PLL_XGYRO = 0x01;   // Wake up, clocked from the X gyro PLL (more stable than the internal oscillator)
+  const uint8_t CONFIG_DLPF_188HZ = 0x01;     // Keeps the gyro output rate at 1 kHz so SMPLRT_DIV spans 4-1000 Hz
+  const uint8_t GYRO_RANGE_500DPS = 0x08;
+  const uint8_t ACCEL_RANGE_4G = 0x08;
+  const uint8_t FIFO_EN_TEMP_GYRO_ACCEL = 0xF8;
+  const uint8_t INT_FIFO_OFLOW = 0x10;
+  const uint8_t USER_CTRL_FIFO_EN = 0x40;
+  const uint8_t USER_CTRL_FIFO_RESET = 0x04;
+
+  // Scale factors for the ranges above
+  const float ACCEL_LSB_PER_G = 8192.0;
+  const float GYRO_LSB_PER_DPS = 65.5;
+  const float STANDARD_GRAVITY = 9.80665;
+  const float RADIANS_PER_DEGREE = 0.01745329252;
+
+  const uint16_t GYRO_OUTPUT_RATE_HZ = 1000;
+  const size_t MAX_BURST_SAMPLES = 9;         // 126 bytes, just under the ESP32's 128 byte Wire buffer
+
+  int16_t bigEndian16(const uint8_t *bytes) {
+    return (int16_t) ((bytes[0] << 8) | bytes[1]);
+  }
+}
+
+// Constructor, given the bus the chip is on and an optional clock used to time bus traffic
+MPU6050Fifo::MPU6050Fifo(I2CBus &bus, MicrosClock clock, uint8_t address) : bus(bus), clock(clock), address(address) {}
+
+// Wakes the chip and starts filling the FIFO at sampleRateHz. Returns false if the chip is missing.
+bool MPU6050Fifo::begin(uint16_t sampleRateHz) {
+  uint8_t whoAmI = 0;
+  if (!read(REG_WHO_AM_I, &whoAmI, 1) || (whoAmI & 0x7E) != (DEFAULT_ADDRESS & 0x7E)) {
+    return false;
+  }
+
+  if (sampleRateHz < MIN_RATE_HZ) { sampleRateHz = MIN_RATE_HZ; }
+  if (sampleRateHz > MAX_RATE_HZ) { sampleRateHz = MAX_RATE_HZ; }
+  uint8_t divider = (uint8_t) (GYRO_OUTPUT_RATE_HZ / sampleRateHz - 1);
+  this->sampleRateHz = GYRO_OUTPUT_RATE_HZ / (divider + 1);
+
+  bool ok = write(REG_PWR_MGMT_1, PWR_CLOCK_PLL_XGYRO)
+         && write(REG_CONFIG, CONFIG_DLPF_188HZ)
+         && write(REG_SMPLRT_DIV, divider)
+         && write(REG_GYRO_CONFIG, GYRO_RANGE_500DPS)
+         && write(REG_ACCEL_CONFIG, ACCEL_RANGE_4G)
+         && write(REG_INT_ENABLE, INT_FIFO_OFLOW)
+         && write(REG_FIFO_EN, FIFO_EN_TEMP_GYRO_ACCEL)
+         && resetFifo();
+
+  overflowCount = 0;
+  sampleCount = 0;
+  busMicros = 0;
+  return ok;
+}
+
+// Discards everything in the FIFO and re-enables it
+bool MPU6050Fifo::resetFifo() {
+  return write(REG_USER_CTRL, USER_CTRL_FIFO_RESET) && write(REG_USER_CTRL, USER_CTRL_FIFO_EN);
+}
+
+// Copies up to maxSamples complete samples out of the FIFO, returning how many were read.
+// On overflow the FIFO contents are misaligned, so they are thrown away and 0 is returned.
+size_t MPU6050Fifo::drain(RawSample *samples, size_t maxSamples) {
+  uint32_t start = now();
+
+  uint8_t status = 0;
+  uint8_t countBytes[2];
+  if (!read(REG_INT_STATUS, &status, 1) || !read(REG_FIFO_COUNT_H, countBytes, 2)) {
+    return 0;
+  }
+
+  uint16_t fifoCount = (countBytes[0] << 8) | countBytes[1];
+  if ((status & INT_FIFO_OFLOW) || fifoCount >= FIFO_BYTES) {
+    overflowCount++;
+    resetFifo();
+    busMicros += now() - start;
+    return 0;
+  }
+
+  size_t available = fifoCount / SAMPLE_BYTES;
+  if (available > maxSamples) { available = maxSamples; }
+
+  // Read as many whole samples per transaction as the bus allows
+  size_t perBurst = bus.maxReadLength() / SAMPLE_BYTES;
+  if (perBurst == 0) { perBurst = 1; }
+  if (perBurst > MAX_BURST_SAMPLES) { perBurst = MAX_BURST_SAMPLES; }
+
+  uint8_t burst[MAX_BURST_SAMPLES * SAMPLE_BYTES];
+  size_t drained = 0;
+  while (drained < available) {
+    size_t count = available - drained;
+    if (count > perBurst) { count = perBurst; }
+
+    if (!read(REG_FIFO_R_W, burst, count * SAMPLE_BYTES)) { break; }
+
+    for (size_t i = 0; i < count; i++) {
+      const uint8_t *record = burst + i * SAMPLE_BYTES;
+      RawSample &sample = samples[drained + i];
+      sample.accX = bigEndian16(record);
+      sample.accY = bigEndian16(record + 2);
+      sample.accZ = bigEndian16(record + 4);
+      sample.temperature = bigEndian16(record + 6);
+      sample.gyroX = bigEndian16(record + 8);
+      sample.gyroY = bigEndian16(record + 10);
+      sample.gyroZ = bigEndian16(record + 12);
+    }
+    drained += count;
+  }
+
+  busMicros += now() - start;
+  sampleCount += drained;
+  return drained;
+}
+
+// Average bus time spent per drained sample, in microseconds (0 without a clock)
+float MPU6050Fifo::getBusMicrosPerSample() const {
+  if (sampleCount == 0) { return 0.0; }
+  return (float) busMicros / sampleCount;
+}
+
+// Converts a raw accelerometer reading (or a magnitude in the same LSB units) to m/s^2
+float MPU6050Fifo::accelToMs2(int32_t raw) {
+  return raw / ACCEL_LSB_PER_G * STANDARD_GRAVITY;
+}
+
+// m/s^2 of one accelerometer LSB, for scaling statistics that were kept in raw units
+float MPU6050Fifo::accelMs2PerLsb() {
+  return STANDARD_GRAVITY / ACCEL_LSB_PER_G;
+}
+
+// Converts a raw gyroscope reading to rad/s
+float MPU6050Fifo::gyroToRads(int16_t raw) {
+  return raw / GYRO_LSB_PER_DPS * RADIANS_PER_DEGREE;
+}
+
+// Converts a raw temperature reading to degrees Celsius
+float MPU6050Fifo::temperatureToC(int16_t raw) {
+  return raw / 340.0 + 36.53;
+}
+
+// Writes one of the chip's registers
+bool MPU6050Fifo::write(uint8_t reg, uint8_t value) {
+  return bus.writeRegister(address, reg, value);
+}
+
+// Reads consecutive registers from the chip
+bool MPU6050Fifo::read(uint8_t reg, uint8_t *buffer, size_t length) {
+  return bus.readRegisters(address, reg, buffer, length);
+}
@@ -0,0 +1,76 @@
+/*
+  WasherWatcher shared sender library
+  "MPU6050Fifo.h"
+
+  Burst acquisition from the MPU-6050's onboard 1024 byte FIFO.
+  The chip samples accel, temperature and gyro on its own clock at 100-1000 Hz, and we drain
+  whole batches of samples with a few large bus reads instead of one full transaction per reading.
+*/
+
+#ifndef MPU6050_FIFO_H
+#define MPU6050_FIFO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "I2CBus.h"
+
+// One FIFO record, exactly as the chip produces it (already converted from big-endian)
+typedef struct {
+  int16_t accX;
+  int16_t accY;
+  int16_t accZ;
+  int16_t temperature;
+  int16_t gyroX;
+  int16_t gyroY;
+  int16_t gyroZ;
+} RawSample;
+
+// Clock used to time bus transactions, in microseconds (micros() on the microcontrollers)
+typedef uint32_t (*MicrosClock)();
+
+
+/************************** MPU6050Fifo Class *****************************
+ * Configures the MPU-6050 for FIFO operation and drains it in bursts.
+ * Every sample in the FIFO carries accel, temperature and gyro together, so one
+ * burst feeds all three. Bus time is tracked so the cost per sample can be reported.
+ *************************************************************************/
+class MPU6050Fifo {
+  public:
+    static const uint8_t DEFAULT_ADDRESS = 0x68;
+    static const size_t SAMPLE_BYTES = 14;                        // accel (6) + temperature (2) + gyro (6)
+    static const size_t FIFO_BYTES = 1024;
+    static const size_t MAX_SAMPLES = FIFO_BYTES / SAMPLE_BYTES;  // 73 samples fit in the FIFO
+    static const uint16_t MIN_RATE_HZ = 4;
+    static const uint16_t MAX_RATE_HZ = 1000;
+
+    MPU6050Fifo(I2CBus &bus, MicrosClock clock = nullptr, uint8_t address = DEFAULT_ADDRESS);
+    bool begin(uint16_t sampleRateHz);
+    bool resetFifo();
+    size_t drain(RawSample *samples, size_t maxSamples);
+
+    uint16_t getSampleRate() const { return sampleRateHz; }
+    uint32_t getOverflowCount() const { return overflowCount; }
+    uint32_t getSampleCount() const { return sampleCount; }
+    float getBusMicrosPerSample() const;
+
+    static float accelToMs2(int32_t raw);
+    static float accelMs2PerLsb();
+    static float gyroToRads(int16_t raw);
+    static float temperatureToC(int16_t raw);
+
+  private:
+    I2CBus &bus;
+    MicrosClock clock;
+    uint8_t address;
+    uint16_t sampleRateHz = 0;
+
+    uint32_t overflowCount = 0;
+    uint32_t sampleCount = 0;     // Samples drained since begin()
+    uint32_t busMicros = 0;       // Bus time spent draining those samples
+
+    bool write(uint8_t reg, uint8_t value);
+    bool read(uint8_t reg, uint8_t *buffer, size_t length);
+    uint32_t now() const { return clock ? clock() : 0; }
+};
+
+#endif
@@ -0,0 +1,71 @@
+/*
+  WasherWatcher shared sender library
+  "WireBus.h"
+
+  I2CBus implementation on top of Arduino's TwoWire. Only used by the firmware builds.
+*/
+
+#ifndef WIRE_BUS_H
+#define WIRE_BUS_H
+
+#include <Arduino.h>
+#include <Wire.h>
+#include "I2CBus.h"
+
+/************************** WireBus Class *********************************
+ * Wraps a TwoWire instance. The MPU6050 supports 400 kHz fast mode, which
+ * cuts the time of a full 14 byte sample read to roughly a quarter of the 100 kHz default.
+ *************************************************************************/
+class WireBus : public I2CBus {
+  private:
+    TwoWire &wire;
+
+  public:
+    static const uint32_t FAST_MODE_HZ = 400000;
+
+    explicit WireBus(TwoWire &wire = Wire) : wire(wire) {}
+    void begin(uint32_t clockHz = FAST_MODE_HZ);
+    bool writeRegister(uint8_t address, uint8_t reg, uint8_t value) override;
+    bool readRegisters(uint8_t address, uint8_t reg, uint8_t *buffer, size_t length) override;
+    size_t maxReadLength() const override;
+};
+
+// Starts the Wire peripheral and raises the bus clock
+inline void WireBus::begin(uint32_t clockHz) {
+  wire.begin();
+  wire.setClock(clockHz);
+}
+
+// Writes a single register
+inline bool WireBus::writeRegister(uint8_t address, uint8_t reg, uint8_t value) {
+  wire.beginTransmission(address);
+  wire.write(reg);
+  wire.write(value);
+  return wire.endTransmission() == 0;
+}
+
+// Reads `length` consecutive bytes starting at `reg` in one repeated-start transaction
+inline bool WireBus::readRegisters(uint8_t address, uint8_t reg, uint8_t *buffer, size_t length) {
+  wire.beginTransmission(address);
+  wire.write(reg);
+  if (wire.endTransmission(false) != 0) { return false; }
+
+  if (wire.requestFrom(address, (uint8_t) length) != length) { return false; }
+  for (size_t i = 0; i < length; i++) {
+    buffer[i] = wire.read();
+  }
+  return true;
+}
+
+// Largest read the Wire receive buffer can hold in one transaction
+inline size_t WireBus::maxReadLength() const {
+#if defined(I2C_BUFFER_LENGTH)
+  return I2C_BUFFER_LENGTH;
+#elif defined(BUFFER_LENGTH)
+  return BUFFER_LENGTH;
+#else
+  return 32;
+#endif
+}
+
+#endif
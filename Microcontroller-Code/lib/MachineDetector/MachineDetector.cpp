@@ -0,0 +1,146 @@
+/*
+  WasherWatcher shared sender library
+  "MachineDetector.cpp"
+*/
+
+#include "MachineDetector.h"
+#include <math.h>
+
+constexpr float MachineDetector::BASELINE_DROP_ALPHA;
+
+// Constructor, sizing the window and spectral detector from the config
+MachineDetector::MachineDetector(const DetectorConfig &config)
+    : config(config), window(config.windowLength), detector(config.sampleRateHz, config.windowLength, config.type) {}
+
+// Adds a burst of samples drained from the sensor to the sliding window
+void MachineDetector::addSamples(const RawSample *samples, size_t count) {
+  while (count > 0) {
+    size_t batch = (count < BATCH_CAPACITY) ? count : BATCH_CAPACITY;
+    for (size_t i = 0; i < batch; i++) {
+      this->axes.x[i] = samples[i].accX;
+      this->axes.y[i] = samples[i].accY;
+      this->axes.z[i] = samples[i].accZ;
+    }
+    addSamples(this->axes.x, this->axes.y, this->axes.z, batch);
+    samples += batch;
+    count -= batch;
+  }
+}
+
+// Adds raw accelerometer axes (one array per axis) to the sliding window
+void MachineDetector::addSamples(const int16_t *x, const int16_t *y, const int16_t *z, size_t count) {
+  while (count > 0) {
+    size_t batch = (count < BATCH_CAPACITY) ? count : BATCH_CAPACITY;
+
+    // Every magnitude with integer math (no sqrt per sample), kept in LSB so the window does no float math either
+    VibrationKernel::magnitude(x, y, z, this->magnitudes, this->magnitudesSquared, batch);
+    for (size_t i = 0; i < batch; i++) {
+      this->window.add(this->magnitudes[i]);
+    }
+    x += batch;
+    y += batch;
+    z += batch;
+    count -= batch;
+  }
+}
+
+// Seeds the idle baseline from the current window, assuming the machine isn't running
+void MachineDetector::calibrate() {
+  this->calibrationAccAvg = windowMean();
+  this->calibrationAccStdDev = windowStdDev();
+  size_t count = this->window.copyTo(this->windowSamples, MPU6050Fifo::accelMs2PerLsb());
+  this->detector.calibrate(this->windowSamples, count);
+  this->calibrated = true;
+  this->state = DETECTOR_IDLE;
+}
+
+// Mean of the window in m/s^2
+float MachineDetector::windowMean() const {
+  return this->window.mean() * MPU6050Fifo::accelMs2PerLsb();
+}
+
+// Standard deviation of the window in m/s^2
+float MachineDetector::windowStdDev() const {
+  return this->window.stdDev() * MPU6050Fifo::accelMs2PerLsb();
+}
+
+// Classifies the current window, steps the state machine and returns whether the machine is (reported) on
+bool MachineDetector::evaluate(uint32_t nowMs) {
+  this->windowActive = isWindowActive();
+  step(this->windowActive, nowMs);
+  if (this->state == DETECTOR_IDLE && !this->windowActive) { adaptBaseline(); }
+  return isOn();
+}
+
+// True if the current window differs from the idle baseline. Once on, the bar is lowered to exitFraction of the threshold.
+bool MachineDetector::isWindowActive() {
+  float scale = isOn() ? this->config.exitFraction : 1.0;
+
+  if (this->config.mode == DETECT_SPECTRAL) {
+    // Only a periodic drum vibration counts, so bumps and people leaning on the machine are ignored
+    size_t count = this->window.copyTo(this->windowSamples, MPU6050Fifo::accelMs2PerLsb());
+    this->detector.setEnergyScale(scale);
+    MachinePhase phase = this->detector.classify(this->windowSamples, count);
+    if (phase != PHASE_IDLE) { this->runningPhase = phase; }
+    return phase != PHASE_IDLE;
+  } else if (this->config.mode == DETECT_VARIANCE && this->window.count() > 1) {
+    // A running machine shakes the sensor, which widens the spread of readings well before it moves the mean
+    return (windowStdDev() - this->calibrationAccStdDev) >= this->config.thresholdStdDev * scale;
+  }
+  return exceedsMeanThreshold(windowMean(), scale);
+}
+
+// Moves the state machine on by one window (a dwell of 0 moves straight through STARTING or STOPPING)
+void MachineDetector::step(bool active, uint32_t nowMs) {
+  switch (this->state) {
+    case DETECTOR_IDLE:
+      if (active) {
+        this->state = DETECTOR_STARTING;
+        this->stateSinceMs = nowMs;
+      }
+      break;
+    case DETECTOR_STARTING:
+      // A single quiet window means it was a bump, not a cycle starting
+      if (!active) { this->state = DETECTOR_IDLE; }
+      break;
+    case DETECTOR_RUNNING:
+      if (!active) {
+        this->state = DETECTOR_STOPPING;
+        this->stateSinceMs = nowMs;
+      }
+      break;
+    case DETECTOR_STOPPING:
+      if (active) { this->state = DETECTOR_RUNNING; }
+      break;
+  }
+
+  if (this->state == DETECTOR_STARTING && nowMs - this->stateSinceMs >= this->config.startDwellMs) {
+    this->state = DETECTOR_RUNNING;
+  } else if (this->state == DETECTOR_STOPPING && nowMs - this->stateSinceMs >= this->config.stopDwellMs) {
+    this->state = DETECTOR_IDLE;
+    this->runningPhase = PHASE_IDLE;
+  }
+}
+
+// Blends a confirmed-idle window into the baseline: quickly if it is quieter, slowly (baselineAlpha) otherwise
+void MachineDetector::adaptBaseline() {
+  float alpha = this->config.baselineAlpha;
+  if (alpha <= 0) { return; }
+
+  if (this->config.mode == DETECT_SPECTRAL) {
+    this->detector.adaptIdle(alpha, BASELINE_DROP_ALPHA);
+  }
+  float stdDev = windowStdDev();
+  this->calibrationAccStdDev += ((stdDev < this->calibrationAccStdDev) ? BASELINE_DROP_ALPHA : alpha) * (stdDev - this->calibrationAccStdDev);
+  this->calibrationAccAvg += alpha * (windowMean() - this->calibrationAccAvg);
+}
+
+// Mean mode: true if currentAvg is more than thresholdPercent (times scale) away from the calibration average
+bool MachineDetector::exceedsMeanThreshold(float currentAvg, float scale) const {
+  // Determine the percent difference between currentAvg and calibrationAvg
+  // Uses the equation %diff = |a - b| / ((a+b)/2) , where a and b are 2 numbers
+  double calcDifference = fabs(currentAvg - this->calibrationAccAvg);
+  double calcAverage = (currentAvg + this->calibrationAccAvg) / 2.0;
+
+  return (calcDifference / calcAverage) >= this->config.thresholdPercent * scale;
+}
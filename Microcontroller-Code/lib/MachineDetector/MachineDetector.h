@@ -0,0 +1,112 @@
+/*
+  WasherWatcher shared sender library
+  "MachineDetector.h"
+
+  Decides whether a machine is on from its accelerometer samples. This is the whole detection path
+  the Senders run (magnitudes, sliding window, idle baseline, the chosen statistic and the debouncing
+  state machine), kept free of Arduino and the sensor driver so trace replays on a PC give exactly
+  the answers the board would.
+*/
+
+#ifndef MACHINE_DETECTOR_H
+#define MACHINE_DETECTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "MPU6050Fifo.h"
+#include "SampleWindow.h"
+#include "SpectralDetector.h"
+#include "VibrationKernel.h"
+
+// Statistic MachineDetector::evaluate() uses to decide whether the machine is on
+enum DetectionMode : uint8_t {
+  DETECT_MEAN,        // Percent difference of the mean magnitude from calibration
+  DETECT_VARIANCE,    // Standard deviation above the calibrated noise floor
+  DETECT_SPECTRAL     // Periodic drum vibration found by the SpectralDetector
+};
+
+// Where the debouncing state machine is. The machine is reported on in DETECTOR_RUNNING and DETECTOR_STOPPING.
+enum DetectorState : uint8_t {
+  DETECTOR_IDLE,      // Off; quiet windows keep the idle baseline up to date
+  DETECTOR_STARTING,  // Vibrating, but not for startDwellMs yet (still reported off)
+  DETECTOR_RUNNING,   // On
+  DETECTOR_STOPPING   // Quiet, but not for stopDwellMs yet (still reported on)
+};
+
+// Everything that changes how a detector reaches its decision
+typedef struct {
+  DetectionMode mode;
+  MachineType type;
+  uint16_t sampleRateHz;
+  size_t windowLength;          // Readings the sliding window covers (one evaluation's worth)
+  float thresholdPercent;       // Mean mode: percent difference from the calibrated average
+  float thresholdStdDev;        // Variance mode: m/s^2 of standard deviation above the calibrated noise floor
+  uint32_t startDwellMs;        // Vibration must last this long before the machine counts as on...
+  uint32_t stopDwellMs;         // ...and quiet this long before it counts as off (a washer pauses between phases)
+  float exitFraction;           // While on, a window stays active down to this fraction of the threshold (hysteresis)
+  float baselineAlpha;          // Weight of each idle window in the idle baseline (0 keeps the first calibration forever)
+} DetectorConfig;
+
+
+/***************** MachineDetector Class Definition **********************
+ * Raw samples go in through addSamples() as they are drained from the sensor.
+ * The first evaluation calibrates against the (assumed idle) window, and every
+ * evaluation after that decides whether the latest window is active and feeds
+ * that to the state machine: IDLE -> STARTING -> RUNNING -> STOPPING -> IDLE,
+ * where STARTING and STOPPING only move on once their dwell time has passed,
+ * so one borderline window can't flip the reported state.
+ *
+ * The calibration is only a starting point. Every window the state machine
+ * confirms as idle moves the baseline towards it (an EWMA), and windows quieter
+ * than the baseline move it quickly, so the baseline follows the idle floor
+ * and recovers within a minute or so if the board booted mid-cycle.
+ *************************************************************************/
+class MachineDetector {
+  public:
+    static const size_t WINDOW_CAPACITY = 256;  // Max number of readings the statistics window can hold
+    static const size_t BATCH_CAPACITY = MPU6050Fifo::MAX_SAMPLES;
+    static constexpr float BASELINE_DROP_ALPHA = 0.5;  // Baseline weight of an idle window quieter than the baseline
+
+    explicit MachineDetector(const DetectorConfig &config);
+
+    void addSamples(const RawSample *samples, size_t count);
+    void addSamples(const int16_t *x, const int16_t *y, const int16_t *z, size_t count);
+    bool evaluate(uint32_t nowMs);
+    void calibrate();
+
+    bool isCalibrated() const { return calibrated; }
+    bool isOn() const { return state == DETECTOR_RUNNING || state == DETECTOR_STOPPING; }
+    bool wasWindowActive() const { return windowActive; }
+    DetectorState getState() const { return state; }
+    MachinePhase getPhase() const { return isOn() ? runningPhase : PHASE_IDLE; }
+    float getCalibrationMean() const { return calibrationAccAvg; }
+    float getCalibrationStdDev() const { return calibrationAccStdDev; }
+    const DetectorConfig &getConfig() const { return config; }
+    const SampleWindow<WINDOW_CAPACITY> &getWindow() const { return window; }
+    float windowMean() const;
+    float windowStdDev() const;
+    const SpectralDetector &getSpectral() const { return detector; }
+
+  private:
+    DetectorConfig config;
+    AccBatch<BATCH_CAPACITY> axes;              // Raw axes of the samples being added, one array per axis
+    uint16_t magnitudes[BATCH_CAPACITY];
+    uint32_t magnitudesSquared[BATCH_CAPACITY];
+    SampleWindow<WINDOW_CAPACITY> window;       // Magnitudes in raw sensor LSB, scaled to m/s^2 only when read
+    float windowSamples[WINDOW_CAPACITY];       // Chronological copy of the window for the spectral detector
+    SpectralDetector detector;
+    float calibrationAccAvg = 0.0;
+    float calibrationAccStdDev = 0.0;
+    bool calibrated = false;
+    bool windowActive = false;
+    DetectorState state = DETECTOR_IDLE;
+    uint32_t stateSinceMs = 0;
+    MachinePhase runningPhase = PHASE_IDLE;    // Latest phase of an active window, kept through STOPPING
+
+    bool isWindowActive();
+    void step(bool active, uint32_t nowMs);
+    void adaptBaseline();
+    bool exceedsMeanThreshold(float currentAvg, float scale) const;
+};
+
+#endif
@@ -0,0 +1,74 @@
+/*
+  WasherWatcher shared sender library
+  "PeriodicTimer.cpp"
+*/
+
+#include "PeriodicTimer.h"
+
+// Starts the schedule: the first deadline is one period from now
+void PeriodicTimer::start(uint32_t nowMicros) {
+  nextMicros = nowMicros + periodMicros;
+  lastRunMicros = nowMicros;
+  stats = {};
+}
+
+// True if the deadline has passed, in which case the run is counted and the next deadline set one period after it
+bool PeriodicTimer::poll(uint32_t nowMicros) {
+  uint32_t lateMicros = nowMicros - nextMicros;
+  if ((int32_t) lateMicros < 0) { return false; }
+
+  uint32_t missed = lateMicros / periodMicros;
+  stats.skipped += missed;
+  nextMicros += (missed + 1) * periodMicros;
+
+  stats.lateSumMicros += lateMicros % periodMicros;
+  if (lateMicros % periodMicros > stats.lateMaxMicros) { stats.lateMaxMicros = lateMicros % periodMicros; }
+  if (stats.runs > 0) {
+    uint32_t interval = nowMicros - lastRunMicros;
+    stats.intervalSumMicros += interval;
+    if (stats.runs == 1 || interval < stats.intervalMinMicros) { stats.intervalMinMicros = interval; }
+    if (interval > stats.intervalMaxMicros) { stats.intervalMaxMicros = interval; }
+  }
+  stats.runs++;
+  lastRunMicros = nowMicros;
+  return true;
+}
+
+// Returns the time left until the deadline, 0 if it has passed
+uint32_t PeriodicTimer::untilDue(uint32_t nowMicros) const {
+  int32_t remaining = (int32_t) (nextMicros - nowMicros);
+  return (remaining > 0) ? (uint32_t) remaining : 0;
+}
+
+// Starts measuring, awake
+void DutyCycleMeter::begin(uint32_t nowMicros) {
+  wakeMicros = nowMicros;
+  lastMicros = nowMicros;
+  awake = true;
+  awakeMicros = 0;
+  elapsedMicros = 0;
+}
+
+// The loop woke up and starts working (a loop that didn't sleep stays awake)
+void DutyCycleMeter::wake(uint32_t nowMicros) {
+  elapsedMicros += nowMicros - lastMicros;
+  lastMicros = nowMicros;
+  if (awake) { return; }
+  wakeMicros = nowMicros;
+  awake = true;
+}
+
+// The loop is about to block until its next deadline
+void DutyCycleMeter::sleep(uint32_t nowMicros) {
+  elapsedMicros += nowMicros - lastMicros;
+  lastMicros = nowMicros;
+  if (awake) { awakeMicros += nowMicros - wakeMicros; }
+  awake = false;
+}
+
+// Returns the share of the time since begin() the loop spent awake, in percent
+float DutyCycleMeter::getPercent(uint32_t nowMicros) const {
+  uint64_t elapsed = elapsedMicros + (nowMicros - lastMicros);
+  uint64_t busy = awakeMicros + (awake ? nowMicros - wakeMicros : 0);
+  return (elapsed == 0) ? 0.0f : 100.0f * busy / elapsed;
+}
@@ -0,0 +1,68 @@
+/*
+  WasherWatcher shared sender library
+  "PeriodicTimer.h"
+
+  Drift-free periodic deadlines for the sender's loop, so it can sleep until the next piece of work
+  instead of spinning on millis(). Each deadline is the last one plus the period, never "now" plus the
+  period, so time spent working or waking late doesn't push the schedule back.
+*/
+
+#ifndef PERIODIC_TIMER_H
+#define PERIODIC_TIMER_H
+
+#include <stdint.h>
+
+// How punctually a PeriodicTimer's work ran
+typedef struct {
+  uint32_t runs;
+  uint32_t skipped;           // Whole periods missed because a run came more than a period late
+  uint64_t lateSumMicros;     // How long after its deadline each run started, summed
+  uint32_t lateMaxMicros;
+  uint64_t intervalSumMicros; // Time between consecutive runs, summed (over runs - 1 intervals)
+  uint32_t intervalMinMicros;
+  uint32_t intervalMaxMicros;
+} TimerStats;
+
+/***************** PeriodicTimer Class Definition ************************
+ * Call start() once, then poll() whenever the loop wakes: it returns true
+ * (and schedules the next deadline) once the deadline has passed. A run so
+ * late that whole periods went by skips them rather than running back to
+ * back to catch up. All times are micros(), which may wrap.
+ *************************************************************************/
+class PeriodicTimer {
+  public:
+    explicit PeriodicTimer(uint32_t periodMicros) : periodMicros(periodMicros) {}
+    void start(uint32_t nowMicros);
+    bool poll(uint32_t nowMicros);
+    uint32_t untilDue(uint32_t nowMicros) const;
+
+    uint32_t getPeriodMicros() const { return periodMicros; }
+    const TimerStats &getStats() const { return stats; }
+
+  private:
+    uint32_t periodMicros;
+    uint32_t nextMicros = 0;
+    uint32_t lastRunMicros = 0;
+    TimerStats stats = {};
+};
+
+/***************** DutyCycleMeter Class Definition ***********************
+ * Measures the share of time the loop is awake: call wake() when it starts
+ * working and sleep() just before it blocks. Times are micros().
+ *************************************************************************/
+class DutyCycleMeter {
+  public:
+    void begin(uint32_t nowMicros);
+    void wake(uint32_t nowMicros);
+    void sleep(uint32_t nowMicros);
+    float getPercent(uint32_t nowMicros) const;
+
+  private:
+    uint32_t wakeMicros = 0;
+    bool awake = false;
+    uint64_t awakeMicros = 0;
+    uint64_t elapsedMicros = 0;   // Up to the last wake() or sleep()
+    uint32_t lastMicros = 0;
+};
+
+#endif
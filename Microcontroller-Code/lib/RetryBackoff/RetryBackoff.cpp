@@ -0,0 +1,22 @@
+/*
+  WasherWatcher shared library
+  "RetryBackoff.cpp"
+*/
+
+#include "RetryBackoff.h"
+
+// Delay before the next retry, in ms. random can be any 32 bit random number (e.g. esp_random()).
+uint32_t RetryBackoff::next(uint32_t random) {
+  uint32_t ceiling = this->ceilingMs;
+  this->failures++;
+  this->ceilingMs = (ceiling >= this->maxMs / 2) ? this->maxMs : ceiling * 2;
+
+  uint32_t half = ceiling / 2;
+  return half + (half ? random % (half + 1) : 0);
+}
+
+// Starts over from minMs after a successful send
+void RetryBackoff::reset() {
+  this->ceilingMs = this->minMs;
+  this->failures = 0;
+}
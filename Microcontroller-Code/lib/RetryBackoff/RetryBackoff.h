@@ -0,0 +1,34 @@
+/*
+  WasherWatcher shared library
+  "RetryBackoff.h"
+
+  Exponential backoff with jitter, used wherever a failed send is retried: the receiver's uplink to the
+  server and the senders' ESP-NOW frames.
+*/
+
+#ifndef RETRY_BACKOFF_H
+#define RETRY_BACKOFF_H
+
+#include <stdint.h>
+
+/******************* RetryBackoff Class Definition ************************
+ * Exponential backoff with jitter for retrying a failed send: each failure
+ * doubles the ceiling (from minMs up to maxMs), and the delay is picked at
+ * random in the upper half of it, so boards that failed at the same moment
+ * (e.g. receivers that lost the server) don't all come back at once either.
+ *************************************************************************/
+class RetryBackoff {
+  public:
+    RetryBackoff(uint32_t minMs, uint32_t maxMs) : minMs(minMs), maxMs(maxMs), ceilingMs(minMs) {}
+    uint32_t next(uint32_t random);
+    void reset();
+    uint32_t getFailures() const { return failures; }
+
+  private:
+    uint32_t minMs;
+    uint32_t maxMs;
+    uint32_t ceilingMs;
+    uint32_t failures = 0;
+};
+
+#endif
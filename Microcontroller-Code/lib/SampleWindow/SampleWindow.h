@@ -0,0 +1,221 @@
+/*
+  WasherWatcher shared sender library
+  "SampleWindow.h"
+
+  Fixed-capacity sliding window of accelerometer samples with O(1) incremental statistics.
+  Samples are integers (raw sensor LSB) and the window keeps exact integer sums, so adding a sample costs no
+  float math at all, which matters on the FPU-less ESP8266; statistics are only converted to float when read.
+  Nothing here allocates or depends on Arduino, so the same code runs on the ESP32, the ESP8266 and a host PC.
+*/
+
+#ifndef SAMPLE_WINDOW_H
+#define SAMPLE_WINDOW_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+
+/******************* SampleWindow Class Definition ************************
+ * Keeps the last `length` samples (length <= CAPACITY) in a ring buffer.
+ * The sum and the sum of squares of the window are updated exactly as
+ * samples come and go (64 bit, so samples of up to 16 bits, such as
+ * VibrationKernel magnitudes, can never overflow them), and the mean,
+ * variance and RMS are derived from them when read. Nothing drifts, so the
+ * window never has to be recomputed from the buffer.
+ * Min/max (and so peak-to-peak) use monotonic queues, so every statistic is
+ * available in O(1) time and every add() is amortized O(1).
+ *************************************************************************/
+template <size_t CAPACITY>
+class SampleWindow {
+  public:
+    SampleWindow();
+    explicit SampleWindow(size_t length);
+
+    void add(int32_t sample);
+    void clear();
+    bool setLength(size_t length);
+
+    size_t getLength() const { return length; }
+    size_t count() const { return filled; }
+    bool isFull() const { return filled == length; }
+    int32_t latest() const;
+    size_t copyTo(float *out, float scale = 1.0) const;
+
+    float mean() const;
+    float variance() const;
+    float sampleVariance() const;
+    float stdDev() const { return sqrtf(variance()); }
+    float rms() const;
+    int32_t min() const;
+    int32_t max() const;
+    int32_t peakToPeak() const { return max() - min(); }
+
+  private:
+    // Entry in a monotonic min/max queue: the value and the sequence number it was added with
+    struct Extreme {
+      int32_t value;
+      uint32_t seq;
+    };
+
+    int32_t samples[CAPACITY];
+    size_t length;
+    size_t head = 0;            // Index the next sample will be written to
+    size_t filled = 0;          // Number of valid samples in the window
+    uint32_t seq = 0;           // Total samples added since the last clear()
+
+    int64_t sum = 0;
+    uint64_t sumSquares = 0;
+
+    Extreme minQueue[CAPACITY];
+    Extreme maxQueue[CAPACITY];
+    size_t minFront = 0, minSize = 0;
+    size_t maxFront = 0, maxSize = 0;
+
+    uint64_t spread() const;
+    void pushExtreme(Extreme queue[], size_t &front, size_t &size, int32_t sample, bool keepMax);
+    void expireExtreme(Extreme queue[], size_t &front, size_t &size);
+};
+
+// Default constructor, the window spans the whole capacity
+template <size_t CAPACITY>
+SampleWindow<CAPACITY>::SampleWindow() : length(CAPACITY) {}
+
+// Constructor for a window shorter than the capacity (clamped to 1..CAPACITY)
+template <size_t CAPACITY>
+SampleWindow<CAPACITY>::SampleWindow(size_t length) : length(CAPACITY) {
+  setLength(length);
+}
+
+// Changes the sliding window length. The window is cleared, since old statistics no longer apply.
+template <size_t CAPACITY>
+bool SampleWindow<CAPACITY>::setLength(size_t length) {
+  if (length == 0 || length > CAPACITY) { return false; }
+  this->length = length;
+  clear();
+  return true;
+}
+
+// Empties the window without touching the length
+template <size_t CAPACITY>
+void SampleWindow<CAPACITY>::clear() {
+  head = 0;
+  filled = 0;
+  seq = 0;
+  sum = 0;
+  sumSquares = 0;
+  minFront = minSize = 0;
+  maxFront = maxSize = 0;
+}
+
+// Adds a sample, evicting the oldest one if the window is already full. Integer adds and one multiply, no divides.
+template <size_t CAPACITY>
+void SampleWindow<CAPACITY>::add(int32_t sample) {
+  if (filled < length) {
+    filled++;
+  } else {
+    int32_t oldest = samples[head];
+    sum -= oldest;
+    sumSquares -= (uint64_t) ((int64_t) oldest * oldest);
+  }
+  sum += sample;
+  sumSquares += (uint64_t) ((int64_t) sample * sample);
+
+  samples[head] = sample;
+  if (++head == length) { head = 0; }
+  seq++;
+
+  expireExtreme(minQueue, minFront, minSize);
+  expireExtreme(maxQueue, maxFront, maxSize);
+  pushExtreme(minQueue, minFront, minSize, sample, false);
+  pushExtreme(maxQueue, maxFront, maxSize, sample, true);
+}
+
+// Returns the most recently added sample (0 if the window is empty)
+template <size_t CAPACITY>
+int32_t SampleWindow<CAPACITY>::latest() const {
+  if (filled == 0) { return 0; }
+  return samples[(head == 0) ? length - 1 : head - 1];
+}
+
+// Copies the samples currently in the window, oldest first and multiplied by scale, into out (room for getLength() floats). Returns the count.
+template <size_t CAPACITY>
+size_t SampleWindow<CAPACITY>::copyTo(float *out, float scale) const {
+  size_t index = (filled < length) ? 0 : head;
+  for (size_t i = 0; i < filled; i++) {
+    out[i] = samples[index] * scale;
+    if (++index == length) { index = 0; }
+  }
+  return filled;
+}
+
+// Mean of the samples currently in the window
+template <size_t CAPACITY>
+float SampleWindow<CAPACITY>::mean() const {
+  if (filled == 0) { return 0.0; }
+  return (float) sum / filled;
+}
+
+// n^2 times the population variance, exactly: n * sum(x^2) - sum(x)^2
+template <size_t CAPACITY>
+uint64_t SampleWindow<CAPACITY>::spread() const {
+  return (uint64_t) filled * sumSquares - (uint64_t) (sum * sum);
+}
+
+// Population variance of the samples currently in the window
+template <size_t CAPACITY>
+float SampleWindow<CAPACITY>::variance() const {
+  if (filled == 0) { return 0.0; }
+  return (float) spread() / ((float) filled * filled);
+}
+
+// Unbiased (n - 1) variance of the samples currently in the window
+template <size_t CAPACITY>
+float SampleWindow<CAPACITY>::sampleVariance() const {
+  if (filled < 2) { return 0.0; }
+  return (float) spread() / ((float) filled * (filled - 1));
+}
+
+// Root mean square (sqrt of the mean of the squares)
+template <size_t CAPACITY>
+float SampleWindow<CAPACITY>::rms() const {
+  if (filled == 0) { return 0.0; }
+  return sqrtf((float) sumSquares / filled);
+}
+
+// Smallest sample currently in the window
+template <size_t CAPACITY>
+int32_t SampleWindow<CAPACITY>::min() const {
+  return minSize ? minQueue[minFront].value : 0;
+}
+
+// Largest sample currently in the window
+template <size_t CAPACITY>
+int32_t SampleWindow<CAPACITY>::max() const {
+  return maxSize ? maxQueue[maxFront].value : 0;
+}
+
+// Appends a sample to a monotonic queue, discarding entries it dominates
+template <size_t CAPACITY>
+void SampleWindow<CAPACITY>::pushExtreme(Extreme queue[], size_t &front, size_t &size, int32_t sample, bool keepMax) {
+  while (size > 0) {
+    size_t back = front + size - 1;
+    if (back >= CAPACITY) { back -= CAPACITY; }
+    if (keepMax ? (queue[back].value > sample) : (queue[back].value < sample)) { break; }
+    size--;
+  }
+  size_t tail = front + size;
+  if (tail >= CAPACITY) { tail -= CAPACITY; }
+  queue[tail] = { sample, seq };
+  size++;
+}
+
+// Removes entries from the front of a monotonic queue once they slide out of the window
+template <size_t CAPACITY>
+void SampleWindow<CAPACITY>::expireExtreme(Extreme queue[], size_t &front, size_t &size) {
+  while (size > 0 && seq - queue[front].seq >= length) {
+    if (++front == CAPACITY) { front = 0; }
+    size--;
+  }
+}
+
+#endif
@@ -0,0 +1,144 @@
+/*
+  WasherWatcher shared sender library
+  "SenderConfig.cpp"
+*/
+
+#include "SenderConfig.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <Crc16.h>
+
+/***** Stored record *****/
+
+// Writes config as a checksummed record. Returns its length, or 0 if capacity is too small.
+size_t SenderConfigRecord::encode(const SenderConfig &config, uint8_t *record, size_t capacity) {
+  if (capacity < RECORD_BYTES) { return 0; }
+
+  record[0] = 'W';
+  record[1] = 'C';
+  record[2] = VERSION;
+  record[3] = (config.channel <= MAX_CHANNEL) ? config.channel : 0;
+  memcpy(record + 4, config.receiverMac, 6);
+  memset(record + 10, 0, sizeof(config.boardId));
+  memcpy(record + 10, config.boardId, strnlen(config.boardId, sizeof(config.boardId) - 1));
+
+  uint16_t crc = crc16(record, RECORD_BYTES - 2);
+  record[RECORD_BYTES - 2] = crc & 0xFF;
+  record[RECORD_BYTES - 1] = crc >> 8;
+  return RECORD_BYTES;
+}
+
+// Reads a record written by encode(). Returns false, leaving config untouched, if it isn't a valid one.
+bool SenderConfigRecord::decode(const uint8_t *record, size_t length, SenderConfig &config) {
+  if (length < RECORD_BYTES || record[0] != 'W' || record[1] != 'C' || record[2] != VERSION) { return false; }
+  uint16_t crc = crc16(record, RECORD_BYTES - 2);
+  if (record[RECORD_BYTES - 2] != (crc & 0xFF) || record[RECORD_BYTES - 1] != (crc >> 8)) { return false; }
+  if (record[3] > MAX_CHANNEL || record[10] == '\0') { return false; }
+
+  config.channel = record[3];
+  memcpy(config.receiverMac, record + 4, 6);
+  memcpy(config.boardId, record + 10, sizeof(config.boardId));
+  config.boardId[sizeof(config.boardId) - 1] = '\0';
+  return true;
+}
+
+// Parses a MAC address written as six hex bytes separated by colons
+bool SenderConfigRecord::parseMac(const char *text, uint8_t mac[6]) {
+  uint8_t parsed[6];
+  for (int i = 0; i < 6; i++) {
+    char *end;
+    unsigned long value = strtoul(text, &end, 16);
+    if (end == text || end - text > 2 || value > 0xFF) { return false; }
+    if (*end != ((i < 5) ? ':' : '\0')) { return false; }
+    parsed[i] = (uint8_t) value;
+    text = end + 1;
+  }
+  memcpy(mac, parsed, 6);
+  return true;
+}
+
+
+/***** ProvisioningConsole *****/
+
+// Starts editing a copy of the board's current settings
+void ProvisioningConsole::begin(const SenderConfig &current) {
+  this->config = current;
+  this->lineLength = 0;
+  this->overflowed = false;
+  this->reply[0] = '\0';
+}
+
+// Takes one character from the serial port. Returns ACTION_NONE until a line ends.
+ProvisioningConsole::Action ProvisioningConsole::feed(char c) {
+  if (c != '\n' && c != '\r') {
+    if (this->lineLength < MAX_LINE) { this->line[this->lineLength++] = c; }
+    else { this->overflowed = true; }
+    return ACTION_NONE;
+  }
+  if (this->lineLength == 0 && !this->overflowed) { return ACTION_NONE; }   // Blank line, or the \n of a \r\n
+
+  this->line[this->lineLength] = '\0';
+  Action action = ACTION_REPLY;
+  if (this->overflowed) { snprintf(this->reply, sizeof(this->reply), "line too long"); }
+  else { action = this->runLine(); }
+  this->lineLength = 0;
+  this->overflowed = false;
+  return action;
+}
+
+// Carries out the command in line, leaving its answer in reply
+ProvisioningConsole::Action ProvisioningConsole::runLine() {
+  char *argument = strchr(this->line, ' ');
+  if (argument != NULL) {
+    *argument++ = '\0';
+    while (*argument == ' ') { argument++; }
+  }
+
+  if (strcmp(this->line, "show") == 0) {
+    this->describe();
+    return ACTION_REPLY;
+  }
+  if (strcmp(this->line, "save") == 0) {
+    this->describe();
+    return ACTION_SAVE;
+  }
+  if (argument == NULL || *argument == '\0') {
+    snprintf(this->reply, sizeof(this->reply), "commands: id NAME, receiver MAC, channel N, show, save");
+    return ACTION_REPLY;
+  }
+
+  if (strcmp(this->line, "id") == 0) {
+    if (strlen(argument) >= sizeof(this->config.boardId)) {
+      snprintf(this->reply, sizeof(this->reply), "id is limited to %u characters", (unsigned) sizeof(this->config.boardId) - 1);
+      return ACTION_REPLY;
+    }
+    strcpy(this->config.boardId, argument);
+  } else if (strcmp(this->line, "receiver") == 0) {
+    if (!SenderConfigRecord::parseMac(argument, this->config.receiverMac)) {
+      snprintf(this->reply, sizeof(this->reply), "receiver must look like AA:BB:CC:DD:EE:FF");
+      return ACTION_REPLY;
+    }
+  } else if (strcmp(this->line, "channel") == 0) {
+    char *end;
+    unsigned long channel = strtoul(argument, &end, 10);
+    if (*end != '\0' || channel > SenderConfigRecord::MAX_CHANNEL) {
+      snprintf(this->reply, sizeof(this->reply), "channel must be 0-%u", (unsigned) SenderConfigRecord::MAX_CHANNEL);
+      return ACTION_REPLY;
+    }
+    this->config.channel = (uint8_t) channel;
+  } else {
+    snprintf(this->reply, sizeof(this->reply), "unknown command \"%s\"", this->line);
+    return ACTION_REPLY;
+  }
+
+  this->describe();
+  return ACTION_REPLY;
+}
+
+// Writes the settings being edited into reply
+void ProvisioningConsole::describe() {
+  const uint8_t *mac = this->config.receiverMac;
+  snprintf(this->reply, sizeof(this->reply), "id=%s receiver=%02X:%02X:%02X:%02X:%02X:%02X channel=%u",
+           this->config.boardId, mac[0], mac[1], mac[2], mac[3], mac[4], mac[5], (unsigned) this->config.channel);
+}
@@ -0,0 +1,79 @@
+/*
+  WasherWatcher shared sender library
+  "SenderConfig.h"
+
+  The settings that tell one sender board from the next: its name, the receiver it reports to and the
+  WiFi channel that receiver was last reached on. Each firmware keeps them in flash as one small record
+  (NVS on the ESP32, the emulated EEPROM on the ESP8266), so a single build serves every machine and a
+  reboot can skip the WiFi scan. Boards are provisioned over serial with ProvisioningConsole.
+
+  Record layout (little-endian):
+    offset  size  field
+         0     2  magic "WC"
+         2     1  record version (1)
+         3     1  channel (0 = not known yet)
+         4     6  receiver MAC address
+        10    32  board name, NUL padded
+        42     2  CRC-16/CCITT of bytes 0 .. 41
+  A record that is missing, from another version or fails its CRC is ignored, and the firmware's built-in
+  defaults are used instead.
+*/
+
+#ifndef SENDER_CONFIG_H
+#define SENDER_CONFIG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+  char boardId[32];         // NUL terminated, so at most 31 characters
+  uint8_t receiverMac[6];
+  uint8_t channel;          // 1-13, or 0 if the receiver hasn't been reached yet
+} SenderConfig;
+
+namespace SenderConfigRecord {
+
+  const size_t RECORD_BYTES = 44;
+  const uint8_t VERSION = 1;
+  const uint8_t MAX_CHANNEL = 13;
+
+  size_t encode(const SenderConfig &config, uint8_t *record, size_t capacity);
+  bool decode(const uint8_t *record, size_t length, SenderConfig &config);
+  bool parseMac(const char *text, uint8_t mac[6]);
+
+}
+
+
+/************** ProvisioningConsole Class Definition *********************
+ * Line-based serial commands that edit a copy of the board's settings:
+ *   id NAME              board name (which the receiver hashes to a machine id)
+ *   receiver MAC         receiver address, as AA:BB:CC:DD:EE:FF
+ *   channel N            channel to try first (0 makes the next boot scan)
+ *   show                 prints the settings
+ *   save                 asks the firmware to store them and restart
+ * Feed it every character read from Serial. Once a line is complete,
+ * feed() returns what the firmware should do and getReply() the text to print.
+ *************************************************************************/
+class ProvisioningConsole {
+  public:
+    enum Action { ACTION_NONE, ACTION_REPLY, ACTION_SAVE };
+
+    void begin(const SenderConfig &current);
+    Action feed(char c);
+    const char *getReply() const { return reply; }
+    const SenderConfig &getConfig() const { return config; }
+
+  private:
+    static const size_t MAX_LINE = 64;
+
+    SenderConfig config = {};
+    char line[MAX_LINE + 1] = {};
+    size_t lineLength = 0;
+    bool overflowed = false;
+    char reply[96] = {};
+
+    Action runLine();
+    void describe();
+};
+
+#endif
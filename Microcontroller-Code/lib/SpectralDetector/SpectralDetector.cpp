@@ -0,0 +1,144 @@
+/*
+  WasherWatcher shared sender library
+  "SpectralDetector.cpp"
+*/
+
+#include "SpectralDetector.h"
+#include <math.h>
+
+namespace {
+  const float FULL_CIRCLE_RADIANS = 6.28318530718;
+}
+
+const size_t SpectralDetector::MAX_BINS;
+constexpr float SpectralDetector::MAX_FREQUENCY_HZ;
+constexpr float SpectralDetector::BAND_SPLIT_HZ;
+constexpr float SpectralDetector::ENERGY_RATIO;
+constexpr float SpectralDetector::ENERGY_FLOOR;
+constexpr float SpectralDetector::PEAK_FRACTION;
+const uint16_t SpectralDetector::RINSE_RESET_WINDOWS;
+
+// Constructor, precomputing the Goertzel coefficient of every bin up to MAX_FREQUENCY_HZ
+SpectralDetector::SpectralDetector(float sampleRateHz, size_t windowLength, MachineType type)
+    : sampleRateHz(sampleRateHz), windowLength(windowLength), type(type) {
+  float binWidthHz = sampleRateHz / windowLength;
+
+  binCount = (size_t) (MAX_FREQUENCY_HZ / binWidthHz);
+  if (binCount > MAX_BINS) { binCount = MAX_BINS; }
+  if (binCount > windowLength / 2) { binCount = windowLength / 2; }
+
+  // binPower[i] holds bin k = i + 1; bin 0 (DC) is removed by subtracting the mean instead
+  size_t splitBin = (size_t) (BAND_SPLIT_HZ / binWidthHz);
+  if (splitBin > binCount) { splitBin = binCount; }
+  bandStart[BAND_LOW] = 0;
+  bandStart[BAND_SPIN] = splitBin;
+  bandStart[BAND_COUNT] = binCount;
+
+  for (size_t i = 0; i < binCount; i++) {
+    coefficients[i] = 2.0 * cosf(FULL_CIRCLE_RADIANS * (i + 1) / windowLength);
+    binPower[i] = 0.0;
+  }
+}
+
+// Records the band energies of a window taken while the machine is known to be idle
+void SpectralDetector::calibrate(const float *samples, size_t count) {
+  analyze(samples, count);
+  for (size_t band = 0; band < BAND_COUNT; band++) {
+    idleEnergy[band] = bandEnergy[band];
+  }
+  phase = PHASE_IDLE;
+  spunThisCycle = false;
+  idleWindows = 0;
+}
+
+// Classifies one window of samples into a machine phase
+MachinePhase SpectralDetector::classify(const float *samples, size_t count) {
+  analyze(samples, count);
+
+  if (isBandActive(BAND_SPIN) && type == MACHINE_WASHER) {
+    phase = PHASE_SPIN;
+    spunThisCycle = true;
+  } else if (isBandActive(BAND_LOW)) {
+    if (type == MACHINE_DRYER) { phase = PHASE_TUMBLE; }
+    else { phase = spunThisCycle ? PHASE_RINSE : PHASE_WASH; }
+  } else if (isBandActive(BAND_SPIN)) {
+    // A dryer has no spin cycle, but its drum can still show up above 4 Hz through the cabinet
+    phase = PHASE_TUMBLE;
+  } else {
+    phase = PHASE_IDLE;
+  }
+
+  // A washer pauses between wash, drain and rinse, so only a long idle stretch ends the cycle
+  if (phase == PHASE_IDLE) {
+    if (idleWindows < RINSE_RESET_WINDOWS) { idleWindows++; }
+    else { spunThisCycle = false; }
+  } else {
+    idleWindows = 0;
+  }
+
+  return phase;
+}
+
+/*
+  Blends the last classified window's band energies into the idle baseline, for a window known to be idle.
+  A band quieter than its baseline moves by dropAlpha (usually much larger than alpha), so a baseline
+  taken while the machine was running falls to the real floor soon after the machine stops.
+*/
+void SpectralDetector::adaptIdle(float alpha, float dropAlpha) {
+  for (size_t band = 0; band < BAND_COUNT; band++) {
+    float weight = (bandEnergy[band] < idleEnergy[band]) ? dropAlpha : alpha;
+    idleEnergy[band] += weight * (bandEnergy[band] - idleEnergy[band]);
+  }
+}
+
+// Frequency, in Hz, of the strongest bin in a band during the last window
+float SpectralDetector::getPeakFrequency(SpectralBand band) const {
+  return (bandPeak[band] + 1) * sampleRateHz / windowLength;
+}
+
+// Runs the Goertzel bank over the window and sums the bin powers into bands
+void SpectralDetector::analyze(const float *samples, size_t count) {
+  if (count > windowLength) { count = windowLength; }
+
+  float mean = 0.0;
+  for (size_t n = 0; n < count; n++) { mean += samples[n]; }
+  if (count > 0) { mean /= count; }
+
+  for (size_t i = 0; i < binCount; i++) {
+    float coefficient = coefficients[i];
+    float s1 = 0.0, s2 = 0.0;
+    for (size_t n = 0; n < count; n++) {
+      float s0 = (samples[n] - mean) + coefficient * s1 - s2;
+      s2 = s1;
+      s1 = s0;
+    }
+    // |X[k]|^2, normalized by N^2 so energies don't depend on the window length
+    binPower[i] = (s1 * s1 + s2 * s2 - coefficient * s1 * s2) / ((float) windowLength * windowLength);
+  }
+
+  for (size_t band = 0; band < BAND_COUNT; band++) {
+    bandEnergy[band] = 0.0;
+    bandPeak[band] = bandStart[band];
+    for (size_t i = bandStart[band]; i < bandStart[band + 1]; i++) {
+      bandEnergy[band] += binPower[i];
+      if (binPower[i] > binPower[bandPeak[band]]) { bandPeak[band] = i; }
+    }
+  }
+}
+
+// True if a band carries clearly more energy than at idle, concentrated in a periodic peak
+bool SpectralDetector::isBandActive(SpectralBand band) const {
+  size_t first = bandStart[band];
+  size_t last = bandStart[band + 1];
+  if (first == last) { return false; }
+
+  if (bandEnergy[band] < (idleEnergy[band] * ENERGY_RATIO + ENERGY_FLOOR) * energyScale) { return false; }
+
+  // A drum frequency between two bins leaks into its neighbours, so count those with the peak
+  size_t peak = bandPeak[band];
+  float peakEnergy = binPower[peak];
+  if (peak > first) { peakEnergy += binPower[peak - 1]; }
+  if (peak + 1 < last) { peakEnergy += binPower[peak + 1]; }
+
+  return peakEnergy >= bandEnergy[band] * PEAK_FRACTION;
+}
@@ -0,0 +1,90 @@
+/*
+  WasherWatcher shared sender library
+  "SpectralDetector.h"
+
+  Frequency-domain machine phase detector. A bank of Goertzel filters measures the vibration
+  energy at every DFT bin from 0.5 Hz up to 20 Hz over one sample window, so a turning drum
+  (a strong periodic peak) can be told apart from a bump or someone leaning on the machine (broadband, no peak).
+*/
+
+#ifndef SPECTRAL_DETECTOR_H
+#define SPECTRAL_DETECTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Kind of machine the sender is attached to, which decides the phases it can be in
+enum MachineType : uint8_t {
+  MACHINE_WASHER,
+  MACHINE_DRYER
+};
+
+// Phase of the machine's cycle, as classified from one window of samples
+enum MachinePhase : uint8_t {
+  PHASE_IDLE,
+  PHASE_WASH,     // Washer agitating before its first spin
+  PHASE_RINSE,    // Washer agitating after a spin
+  PHASE_SPIN,     // Washer drum spinning (roughly 300-1200 rpm)
+  PHASE_TUMBLE    // Dryer drum turning
+};
+
+// Frequency bands the bins are grouped into
+enum SpectralBand : uint8_t {
+  BAND_LOW,       // Agitation and tumbling, 0.5-4 Hz
+  BAND_SPIN,      // Spinning, 4-20 Hz
+  BAND_COUNT
+};
+
+
+/*************** SpectralDetector Class Definition ***********************
+ * Runs one Goertzel filter per bin (k = 1 .. MAX_BINS) over a window of samples.
+ * For a 200 sample window at 100 Hz that is 40 bins x 200 samples = 8000 multiply-adds
+ * per evaluation, a few tens of microseconds on the ESP32 once every EVALDELAY.
+ * Because every filter sits exactly on a bin, the power it measures does not depend on
+ * where the window starts, so samples can be fed straight from a ring buffer.
+ ************************************************************************/
+class SpectralDetector {
+  public:
+    static const size_t MAX_BINS = 48;
+    static constexpr float MAX_FREQUENCY_HZ = 20.0;
+    static constexpr float BAND_SPLIT_HZ = 4.0;
+    static constexpr float ENERGY_RATIO = 4.0;        // A band is active once it carries this many times its idle energy...
+    static constexpr float ENERGY_FLOOR = 0.002;      // ...plus this much (m/s^2)^2, so a silent calibration isn't over-sensitive
+    static constexpr float PEAK_FRACTION = 0.6;       // ...and at least this share of that energy sits within one bin of its peak
+    static const uint16_t RINSE_RESET_WINDOWS = 150;  // Idle windows after which a washer is assumed to start a new cycle
+
+    SpectralDetector(float sampleRateHz, size_t windowLength, MachineType type);
+    void calibrate(const float *samples, size_t count);
+    MachinePhase classify(const float *samples, size_t count);
+    void adaptIdle(float alpha, float dropAlpha);
+    void setEnergyScale(float scale) { energyScale = scale; }
+
+    MachinePhase getPhase() const { return phase; }
+    float getBandEnergy(SpectralBand band) const { return bandEnergy[band]; }
+    float getIdleEnergy(SpectralBand band) const { return idleEnergy[band]; }
+    float getPeakFrequency(SpectralBand band) const;
+    size_t getBinCount() const { return binCount; }
+
+  private:
+    float sampleRateHz;
+    size_t windowLength;
+    MachineType type;
+    size_t binCount;
+    size_t bandStart[BAND_COUNT + 1];   // First bin index of each band, plus one past the end
+
+    float coefficients[MAX_BINS];       // 2cos(2*pi*k/N) for each bin, computed once
+    float binPower[MAX_BINS];
+    float bandEnergy[BAND_COUNT] = {};
+    size_t bandPeak[BAND_COUNT] = {};
+    float idleEnergy[BAND_COUNT] = {};
+    float energyScale = 1.0;            // Multiplies the energy a band needs to count as active (hysteresis)
+
+    MachinePhase phase = PHASE_IDLE;
+    bool spunThisCycle = false;
+    uint16_t idleWindows = 0;
+
+    void analyze(const float *samples, size_t count);
+    bool isBandActive(SpectralBand band) const;
+};
+
+#endif
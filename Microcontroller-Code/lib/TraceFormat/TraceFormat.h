@@ -0,0 +1,229 @@
+/*
+  WasherWatcher shared library
+  "TraceFormat.h"
+
+  Formats for raw accelerometer traces: the frames a Sender built with TRACE_MODE streams over serial,
+  and the indexed trace files the capture tool (Microcontroller-Code/TraceTools) writes from them.
+
+  A serial frame carries one FIFO burst, little-endian:
+    offset  size  field
+         0     2  sync bytes 0xA5 0x5A
+         2     1  format version (1)
+         3     1  number of samples n (at most MPU6050Fifo::MAX_SAMPLES)
+         4     2  sample rate in Hz
+         6     4  index of the first sample (samples drained since the sensor started)
+        10     4  sender micros() when the burst was drained
+        14  12*n  samples: accel x, y, z then gyro x, y, z as raw int16 registers
+   14+12n     2  CRC-16/CCITT of bytes 2 .. 13+12n
+  The Sender's ordinary text output shares the port, so a reader hunts for the sync bytes and trusts a
+  frame only once its CRC matches.
+
+  A trace file is meant to be mmap()ed:
+    TraceFileHeader, then recordCount TraceRecords (12 bytes each, at recordsOffset),
+    then segmentCount TraceSegments and labelCount TraceLabels (at their offsets).
+  Samples are stored back to back without timestamps. Each segment is a run of samples with no gap
+  and gives the time of its first sample and the measured sample period, so any sample's time is
+  startMicros + (i - firstRecord) * periodNanos / 1000. Labels are the ground truth typed in while recording.
+*/
+
+#ifndef TRACE_FORMAT_H
+#define TRACE_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <Crc16.h>
+
+// One sample in a trace file: raw accelerometer and gyro registers
+typedef struct {
+  int16_t acc[3];
+  int16_t gyro[3];
+} TraceRecord;
+
+// A gap-free run of samples in a trace file
+typedef struct {
+  uint64_t firstRecord;     // Index of the run's first TraceRecord
+  uint64_t recordCount;
+  uint64_t startMicros;     // Time of the first sample, in microseconds since the trace began
+  uint32_t periodNanos;     // Measured time between samples (the sensor's clock is only good to a few percent)
+  uint32_t reserved;
+} TraceSegment;
+
+// What the machine was really doing from startMicros until endMicros
+typedef struct {
+  uint64_t startMicros;
+  uint64_t endMicros;
+  uint8_t running;
+  uint8_t phase;            // A MachinePhase, or PHASE_IDLE if only on/off was noted
+  uint8_t reserved[6];
+} TraceLabel;
+
+// First bytes of a trace file
+typedef struct {
+  char magic[8];            // "WWTRACE" and a terminator
+  uint16_t version;
+  uint16_t sampleRateHz;    // Rate the sensor was configured for
+  uint8_t machineType;      // A MachineType
+  uint8_t reserved[3];
+  char boardId[32];
+  int64_t startUnixMicros;  // Wall clock time the trace began, for telling recordings apart
+  uint64_t recordCount;
+  uint64_t recordsOffset;
+  uint64_t segmentCount;
+  uint64_t segmentsOffset;
+  uint64_t labelCount;
+  uint64_t labelsOffset;
+} TraceFileHeader;
+
+namespace TraceFormat {
+
+  const uint8_t SYNC_0 = 0xA5;
+  const uint8_t SYNC_1 = 0x5A;
+  const uint8_t SERIAL_VERSION = 1;
+  const size_t SERIAL_HEADER_BYTES = 14;
+  const size_t SERIAL_SAMPLE_BYTES = 12;
+  const size_t SERIAL_CRC_BYTES = 2;
+  const size_t MAX_SERIAL_SAMPLES = 73;       // MPU6050Fifo::MAX_SAMPLES
+  const size_t MAX_SERIAL_FRAME_BYTES = SERIAL_HEADER_BYTES + MAX_SERIAL_SAMPLES * SERIAL_SAMPLE_BYTES + SERIAL_CRC_BYTES;
+
+  const char FILE_MAGIC[8] = "WWTRACE";
+  const uint16_t FILE_VERSION = 1;
+  const size_t FILE_ALIGNMENT = 64;           // Sections start on a cache line
+
+  inline void writeU16(uint8_t *out, uint16_t value) {
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+  }
+
+  inline void writeU32(uint8_t *out, uint32_t value) {
+    writeU16(out, value & 0xFFFF);
+    writeU16(out + 2, value >> 16);
+  }
+
+  inline uint16_t readU16(const uint8_t *in) {
+    return (uint16_t) (in[0] | (in[1] << 8));
+  }
+
+  inline uint32_t readU32(const uint8_t *in) {
+    return readU16(in) | ((uint32_t) readU16(in + 2) << 16);
+  }
+
+  // Encodes one burst into a serial frame. Returns the frame length, or 0 if it doesn't fit in capacity.
+  inline size_t encodeSerialFrame(const TraceRecord *samples, size_t count, uint16_t sampleRateHz,
+                                  uint32_t firstIndex, uint32_t drainMicros, uint8_t *out, size_t capacity) {
+    if (count > MAX_SERIAL_SAMPLES) { count = MAX_SERIAL_SAMPLES; }
+    size_t length = SERIAL_HEADER_BYTES + count * SERIAL_SAMPLE_BYTES + SERIAL_CRC_BYTES;
+    if (length > capacity) { return 0; }
+
+    out[0] = SYNC_0;
+    out[1] = SYNC_1;
+    out[2] = SERIAL_VERSION;
+    out[3] = (uint8_t) count;
+    writeU16(out + 4, sampleRateHz);
+    writeU32(out + 6, firstIndex);
+    writeU32(out + 10, drainMicros);
+
+    uint8_t *cursor = out + SERIAL_HEADER_BYTES;
+    for (size_t i = 0; i < count; i++) {
+      for (size_t axis = 0; axis < 3; axis++) {
+        writeU16(cursor + axis * 2, (uint16_t) samples[i].acc[axis]);
+        writeU16(cursor + 6 + axis * 2, (uint16_t) samples[i].gyro[axis]);
+      }
+      cursor += SERIAL_SAMPLE_BYTES;
+    }
+    writeU16(cursor, crc16(out + 2, cursor - (out + 2)));
+    return length;
+  }
+
+}
+
+// A burst decoded from a serial frame
+typedef struct {
+  uint16_t sampleRateHz;
+  uint32_t firstIndex;
+  uint32_t drainMicros;
+  size_t count;
+  TraceRecord samples[TraceFormat::MAX_SERIAL_SAMPLES];
+} TraceBurst;
+
+
+/***************** SerialFrameParser Class Definition *********************
+ * Finds serial frames in a byte stream that also carries text. Bytes are fed
+ * in as they arrive; push() returns true each time a frame with a good CRC is
+ * complete, and getBurst() then holds it. A bad frame is skipped one byte at a
+ * time, so a sync pattern inside text or a corrupted frame costs nothing more.
+ *************************************************************************/
+class SerialFrameParser {
+  public:
+    bool push(uint8_t byte);
+    const TraceBurst &getBurst() const { return burst; }
+    uint32_t getFrameCount() const { return frames; }
+    uint32_t getCrcErrorCount() const { return crcErrors; }
+    uint32_t getSkippedBytes() const { return skipped; }
+
+  private:
+    uint8_t buffer[TraceFormat::MAX_SERIAL_FRAME_BYTES];
+    size_t length = 0;
+    TraceBurst burst;
+    uint32_t frames = 0;
+    uint32_t crcErrors = 0;
+    uint32_t skipped = 0;
+
+    size_t expectedLength() const;
+    void resync();
+};
+
+// Adds one received byte. Returns true when it completes a valid frame.
+inline bool SerialFrameParser::push(uint8_t byte) {
+  buffer[length++] = byte;
+
+  // Hunt for the sync bytes, then wait for the header and finally the whole frame
+  while (length > 0) {
+    if (buffer[0] != TraceFormat::SYNC_0 || (length > 1 && buffer[1] != TraceFormat::SYNC_1) ||
+        (length > 3 && (buffer[2] != TraceFormat::SERIAL_VERSION || buffer[3] > TraceFormat::MAX_SERIAL_SAMPLES))) {
+      resync();
+      continue;
+    }
+    if (length < TraceFormat::SERIAL_HEADER_BYTES || length < expectedLength()) { return false; }
+
+    size_t crcAt = expectedLength() - TraceFormat::SERIAL_CRC_BYTES;
+    if (crc16(buffer + 2, crcAt - 2) != TraceFormat::readU16(buffer + crcAt)) {
+      crcErrors++;
+      resync();
+      continue;
+    }
+
+    burst.count = buffer[3];
+    burst.sampleRateHz = TraceFormat::readU16(buffer + 4);
+    burst.firstIndex = TraceFormat::readU32(buffer + 6);
+    burst.drainMicros = TraceFormat::readU32(buffer + 10);
+    const uint8_t *cursor = buffer + TraceFormat::SERIAL_HEADER_BYTES;
+    for (size_t i = 0; i < burst.count; i++) {
+      for (size_t axis = 0; axis < 3; axis++) {
+        burst.samples[i].acc[axis] = (int16_t) TraceFormat::readU16(cursor + axis * 2);
+        burst.samples[i].gyro[axis] = (int16_t) TraceFormat::readU16(cursor + 6 + axis * 2);
+      }
+      cursor += TraceFormat::SERIAL_SAMPLE_BYTES;
+    }
+    frames++;
+    length = 0;
+    return true;
+  }
+  return false;
+}
+
+// Length of the frame in the buffer, from its sample count
+inline size_t SerialFrameParser::expectedLength() const {
+  return TraceFormat::SERIAL_HEADER_BYTES + buffer[3] * TraceFormat::SERIAL_SAMPLE_BYTES + TraceFormat::SERIAL_CRC_BYTES;
+}
+
+// Drops the first buffered byte and looks for the next sync byte in the rest
+inline void SerialFrameParser::resync() {
+  size_t next = 1;
+  while (next < length && buffer[next] != TraceFormat::SYNC_0) { next++; }
+  skipped += next;
+  memmove(buffer, buffer + next, length - next);
+  length -= next;
+}
+
+#endif
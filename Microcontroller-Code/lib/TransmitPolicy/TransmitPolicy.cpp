@@ -0,0 +1,58 @@
+/*
+  WasherWatcher shared sender library
+  "TransmitPolicy.cpp"
+*/
+
+#include "TransmitPolicy.h"
+
+// Constructor. heartbeatMs: how often an unchanged state is repeated. minIntervalMs: the closest two sends may be.
+// jitterMs: random spread added to every heartbeat (and the first send) so senders that boot together drift apart.
+TransmitPolicy::TransmitPolicy(uint32_t heartbeatMs, uint32_t minIntervalMs, uint32_t jitterMs)
+    : heartbeatMs(heartbeatMs), minIntervalMs(minIntervalMs), jitterMs(jitterMs) {}
+
+// Starts the schedule. The seed should differ between boards (e.g. derived from the chip's MAC).
+void TransmitPolicy::begin(uint32_t nowMs, uint32_t seed) {
+  randomState = seed ? seed : 1;
+  hasSent = false;
+  transitionSends = 0;
+  heartbeatSends = 0;
+
+  // Announce the first state after a random delay, so a whole room powering up at once doesn't collide
+  nextHeartbeatMs = nowMs + nextJitter();
+}
+
+// True if the given state should be transmitted now
+bool TransmitPolicy::isSendDue(uint32_t nowMs, uint8_t state) const {
+  if (!hasSent || state == lastSentState) {
+    return (int32_t) (nowMs - nextHeartbeatMs) >= 0;
+  }
+
+  // A state change goes out right away, unless that would come too soon after the last send
+  return nowMs - lastSendMs >= minIntervalMs;
+}
+
+// Records that `state` was transmitted at nowMs and schedules the next heartbeat
+void TransmitPolicy::recordSend(uint32_t nowMs, uint8_t state) {
+  if (hasSent && state != lastSentState) { transitionSends++; }
+  else { heartbeatSends++; }
+
+  hasSent = true;
+  lastSentState = state;
+  lastSendMs = nowMs;
+  nextHeartbeatMs = nowMs + heartbeatMs + nextJitter();
+}
+
+// Brings the next send forward to minIntervalMs after the last one, e.g. because it wasn't acknowledged
+void TransmitPolicy::retrySoon() {
+  if (!hasSent) { return; }
+  nextHeartbeatMs = lastSendMs + minIntervalMs;
+}
+
+// Random delay in [0, jitterMs), from a xorshift32 generator (cheap and good enough to spread senders out)
+uint32_t TransmitPolicy::nextJitter() {
+  if (jitterMs == 0) { return 0; }
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState % jitterMs;
+}
@@ -0,0 +1,47 @@
+/*
+  WasherWatcher shared sender library
+  "TransmitPolicy.h"
+
+  Decides when a sender should transmit. State changes go out immediately (subject to a
+  minimum spacing), while an unchanged state is only repeated as a jittered heartbeat,
+  so a room full of idle senders doesn't fill the shared channel with identical packets.
+*/
+
+#ifndef TRANSMIT_POLICY_H
+#define TRANSMIT_POLICY_H
+
+#include <stdint.h>
+
+/**************** TransmitPolicy Class Definition ************************
+ * Call isSendDue() as often as convenient with the current time and state,
+ * and recordSend() after every transmission. All times are millis().
+ *************************************************************************/
+class TransmitPolicy {
+  public:
+    TransmitPolicy(uint32_t heartbeatMs, uint32_t minIntervalMs, uint32_t jitterMs);
+    void begin(uint32_t nowMs, uint32_t seed);
+    bool isSendDue(uint32_t nowMs, uint8_t state) const;
+    void recordSend(uint32_t nowMs, uint8_t state);
+    void retrySoon();
+
+    uint32_t getTransitionSends() const { return transitionSends; }
+    uint32_t getHeartbeatSends() const { return heartbeatSends; }
+
+  private:
+    uint32_t heartbeatMs;
+    uint32_t minIntervalMs;
+    uint32_t jitterMs;
+
+    bool hasSent = false;
+    uint8_t lastSentState = 0;
+    uint32_t lastSendMs = 0;
+    uint32_t nextHeartbeatMs = 0;
+    uint32_t randomState = 1;
+
+    uint32_t transitionSends = 0;
+    uint32_t heartbeatSends = 0;
+
+    uint32_t nextJitter();
+};
+
+#endif
@@ -0,0 +1,111 @@
+/*
+  WasherWatcher shared sender library
+  "VibrationKernel.h"
+
+  Acceleration magnitude kernels that work directly on raw int16 MPU-6050 registers.
+  The ESP8266 has no FPU, so a float sqrt() per sample is soft-float emulation; on the boards these kernels use only
+  integer multiplies, shifts and adds. Only host builds (VK_HARDWARE_SQRT) use float, in isqrt32Hardware(), which
+  corrects the FPU's square root to the same result as the integer isqrt32().
+  Samples are kept structure-of-arrays so that host builds can autovectorize the loops.
+*/
+
+#ifndef VIBRATION_KERNEL_H
+#define VIBRATION_KERNEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#define VK_RESTRICT __restrict__
+#else
+#define VK_RESTRICT
+#endif
+
+// PCs have a fast hardware square root, so host builds (the simulator and trace replays) take it instead of the digit loop
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+#define VK_HARDWARE_SQRT 1
+#include <math.h>
+#else
+#define VK_HARDWARE_SQRT 0
+#endif
+
+/************************** AccBatch Struct *******************************
+ * A batch of raw accelerometer readings split into one array per axis
+ *************************************************************************/
+template <size_t CAPACITY>
+struct AccBatch {
+  int16_t x[CAPACITY];
+  int16_t y[CAPACITY];
+  int16_t z[CAPACITY];
+  size_t count = 0;
+};
+
+namespace VibrationKernel {
+
+  // Squared magnitude of each (x, y, z) in raw LSB^2. 3 * 32768^2 still fits in 32 bits, so nothing overflows.
+  inline void magnitudeSquared(const int16_t * VK_RESTRICT x, const int16_t * VK_RESTRICT y, const int16_t * VK_RESTRICT z,
+                               uint32_t * VK_RESTRICT out, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+      int32_t sx = x[i], sy = y[i], sz = z[i];
+      out[i] = (uint32_t) (sx * sx) + (uint32_t) (sy * sy) + (uint32_t) (sz * sz);
+    }
+  }
+
+  // Integer square root rounded to the nearest integer, using the digit-by-digit method (shifts and adds only)
+  inline uint16_t isqrt32(uint32_t value) {
+    uint32_t remainder = value;
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+
+    while (bit > remainder) { bit >>= 2; }
+    while (bit != 0) {
+      if (remainder >= root + bit) {
+        remainder -= root + bit;
+        root = (root >> 1) + bit;
+      } else {
+        root >>= 1;
+      }
+      bit >>= 2;
+    }
+
+    // floor(sqrt) leaves remainder = value - root^2; round up when value > (root + 0.5)^2
+    if (remainder > root && root < 0xFFFF) { root++; }
+    return (uint16_t) root;
+  }
+
+  /*
+    Same result as isqrt32(), from the FPU's square root. A float root of a 32 bit value is within 0.01 of the
+    true one, so truncating it is at most one off and the two loops each run at most once.
+  */
+  inline uint16_t isqrt32Hardware(uint32_t value) {
+    uint32_t root = (uint32_t) sqrtf((float) value);
+    if (root > 0xFFFF) { root = 0xFFFF; }
+    while (root * root > value) { root--; }
+    while (root < 0xFFFF && (root + 1) * (root + 1) <= value) { root++; }
+
+    if (value - root * root > root && root < 0xFFFF) { root++; }
+    return (uint16_t) root;
+  }
+
+  // Magnitude of each (x, y, z) in raw LSB, within 0.5 LSB of the exact value
+  inline void magnitude(const int16_t * VK_RESTRICT x, const int16_t * VK_RESTRICT y, const int16_t * VK_RESTRICT z,
+                        uint16_t * VK_RESTRICT out, uint32_t * VK_RESTRICT scratch, size_t count) {
+    magnitudeSquared(x, y, z, scratch, count);
+    for (size_t i = 0; i < count; i++) {
+#if VK_HARDWARE_SQRT
+      out[i] = isqrt32Hardware(scratch[i]);
+#else
+      out[i] = isqrt32(scratch[i]);
+#endif
+    }
+  }
+
+  // Convenience overload for a whole AccBatch
+  template <size_t CAPACITY>
+  void magnitude(const AccBatch<CAPACITY> &batch, uint16_t *out, uint32_t *scratch) {
+    magnitude(batch.x, batch.y, batch.z, out, scratch, batch.count);
+  }
+
+}
+
+#endif
@@ -0,0 +1,55 @@
+"use strict";
+/*
+    In-process read-through cache for the server's database reads, so a dashboard refresh storm costs one query
+    per key instead of one per request.
+*/
+Object.defineProperty(exports, "__esModule", { value: true });
+exports.ReadThroughCache = void 0;
+/*
+    Caches load(key) for ttlMs. The promise itself is cached, so requests that miss while the first load is
+    still running share its query. A failed load isn't cached, so the next request tries the database again.
+    Once maxEntries keys are cached, adding another evicts the oldest.
+*/
+class ReadThroughCache {
+    constructor(ttlMs, maxEntries, load) {
+        this.ttlMs = ttlMs;
+        this.maxEntries = maxEntries;
+        this.load = load;
+        this.entries = new Map();
+        this.hits = 0;
+        this.misses = 0;
+        this.invalidations = 0;
+    }
+    get(key) {
+        const now = Date.now();
+        const cached = this.entries.get(key);
+        if (cached !== undefined && cached.expires > now) {
+            this.hits++;
+            return cached.value;
+        }
+        this.misses++;
+        this.entries.delete(key);
+        if (this.entries.size >= this.maxEntries) {
+            this.entries.delete(this.entries.keys().next().value);
+        }
+        const entry = { value: this.load(key), expires: now + this.ttlMs };
+        this.entries.set(key, entry);
+        entry.value.catch(() => {
+            if (this.entries.get(key) === entry) {
+                this.entries.delete(key);
+            }
+        });
+        return entry.value;
+    }
+    // Forgets a key whose data just changed. A load already running for it still answers its own requests,
+    // but isn't kept, so the next request reads the new data.
+    invalidate(key) {
+        if (this.entries.delete(key)) {
+            this.invalidations++;
+        }
+    }
+    get stats() {
+        return { entries: this.entries.size, hits: this.hits, misses: this.misses, invalidations: this.invalidations };
+    }
+}
+exports.ReadThroughCache = ReadThroughCache;
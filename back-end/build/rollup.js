@@ -0,0 +1,90 @@
+"use strict";
+Object.defineProperty(exports, "__esModule", { value: true });
+exports.mergeUtilization = exports.rollUp = exports.periodStart = exports.MAX_CYCLE_MS = exports.MACHINE_ON = void 0;
+/*
+    Incremental utilization rollups. Every stored batch adds to per-machine hourly and daily totals, so dashboards
+    read a few pre-aggregated rows instead of scanning raw events.
+*/
+exports.MACHINE_ON = 0x80; // State code bit set while a machine runs
+exports.MAX_CYCLE_MS = 6 * 60 * 60 * 1000;
+// Local start of the hour or day that time falls in
+function periodStart(time, resolution) {
+    if (resolution === 'hour') {
+        return new Date(time.getFullYear(), time.getMonth(), time.getDate(), time.getHours());
+    }
+    return new Date(time.getFullYear(), time.getMonth(), time.getDate());
+}
+exports.periodStart = periodStart;
+// Start of the hour or day after the one starting at start
+function nextPeriod(start, resolution) {
+    if (resolution === 'hour') {
+        return new Date(start.getFullYear(), start.getMonth(), start.getDate(), start.getHours() + 1);
+    }
+    return new Date(start.getFullYear(), start.getMonth(), start.getDate() + 1);
+}
+// Finds or adds the row of the period time falls in
+function rowFor(rows, resolution, machineId, time) {
+    const start = periodStart(time, resolution);
+    const key = `${machineId}/${start.getTime()}`;
+    let row = rows.get(key);
+    if (row === undefined) {
+        row = { machineId: machineId, start: start, onMs: 0, cycles: 0 };
+        rows.set(key, row);
+    }
+    return row;
+}
+// Adds the on-time between from and to, split at every period boundary it crosses
+function addOnTime(rows, resolution, machineId, from, to) {
+    let start = from;
+    while (start < to) {
+        const boundary = nextPeriod(periodStart(start, resolution), resolution);
+        const end = (boundary < to) ? boundary : to;
+        rowFor(rows, resolution, machineId, start).onMs += end.getTime() - start.getTime();
+        start = end;
+    }
+}
+/*
+    Folds a batch's state changes, oldest first, into rollup increments. latest holds every machine's previous
+    state change and is updated in place. A machine's on-time is counted when its next state change arrives, so
+    a running cycle shows up as it changes phase and ends. A cycle is counted in the hour it starts.
+    A change older than the machine's latest one (a late resend) is skipped, and a gap longer than MAX_CYCLE_MS
+    isn't counted as on-time, since the change that ended it was probably lost.
+*/
+function rollUp(latest, changes) {
+    const hourly = new Map();
+    const daily = new Map();
+    for (const change of changes) {
+        const previous = latest.get(change.machineId);
+        if (previous !== undefined && change.time < previous.time) {
+            continue;
+        }
+        const wasOn = previous !== undefined && (previous.state & exports.MACHINE_ON) !== 0;
+        const isOn = (change.state & exports.MACHINE_ON) !== 0;
+        if (previous !== undefined && wasOn && change.time.getTime() - previous.time.getTime() <= exports.MAX_CYCLE_MS) {
+            addOnTime(hourly, 'hour', change.machineId, previous.time, change.time);
+            addOnTime(daily, 'day', change.machineId, previous.time, change.time);
+        }
+        if (isOn && !wasOn) {
+            rowFor(hourly, 'hour', change.machineId, change.time).cycles++;
+            rowFor(daily, 'day', change.machineId, change.time).cycles++;
+        }
+        latest.set(change.machineId, { machineId: change.machineId, state: change.state, time: change.time });
+    }
+    return { hourly: Array.from(hourly.values()), daily: Array.from(daily.values()) };
+}
+exports.rollUp = rollUp;
+// Adds increments into running totals keyed the same way as rollUp()'s rows
+function mergeUtilization(totals, rows) {
+    for (const row of rows) {
+        const key = `${row.machineId}/${row.start.getTime()}`;
+        const total = totals.get(key);
+        if (total === undefined) {
+            totals.set(key, Object.assign({}, row));
+        }
+        else {
+            total.onMs += row.onMs;
+            total.cycles += row.cycles;
+        }
+    }
+}
+exports.mergeUtilization = mergeUtilization;
@@ -1,5 +1,8 @@
 "use strict";
 Object.defineProperty(exports, "__esModule", { value: true });
+const cache_1 = require("./cache");
+const rollup_1 = require("./rollup");
+const ingest_1 = require("./ingest");
 const express = require('express');
 const http = require('http');
 const path = require('path');
@@ -7,47 +10,123 @@ const mysql = require('mysql2/promise'); // Use mysql2 bc https://stackoverflow.
 const app = express();
 const port = process.env.PORT || 3000;
 const dbConfig = {
-    host: 'localhost',
+    host: process.env.DB_HOST || 'localhost',
+    port: Number(process.env.DB_PORT) || 3306,
     user: 'laundry_backend',
-    password: 'admin'
+    password: 'admin',
+    connectionLimit: 10,
+    waitForConnections: true
 };
+// Connections are opened as needed and then kept, along with the statements prepared on them by execute()
+const pool = mysql.createPool(dbConfig);
+// Sensor names hardly ever change, so they're cached for a while. Machine states are dropped from the cache
+// whenever their receiver's batch brings a state change, so the time limit is only a safety net.
+const SENSOR_CACHE_MS = 5 * 60 * 1000;
+const STATE_CACHE_MS = 60 * 1000;
+const CACHE_ENTRIES = 1000;
 // Go back (..) twice because the server is run through server.js in the /build directory
 // Host the Angular frontend statically on the home directory
 app.use('/', express.static(path.join(__dirname, '..', '..', 'front-end', 'dist', 'LaundrySensorSite')));
+const sensorNames = new cache_1.ReadThroughCache(SENSOR_CACHE_MS, CACHE_ENTRIES, querySensorName);
 app.get('/api', (req, res) => {
-    queryServer(1)
+    sensorNames.get(1)
         .then((sensor) => {
         res.status(200).send({ message: `Hi ${sensor}` });
+    })
+        .catch((error) => {
+        console.log("Query Error: ", error);
+        res.status(500).send({ error: 'could not read sensors' });
     });
 });
-// TODO: add connection pooling for higher efficiency
-// TODO: SSL implementation to allow for HTTPS certification
-// TODO: Decide how to best open/close connection
-async function queryServer(id) {
-    const query = 'SELECT (sensor_name) FROM laundrydb.sensors WHERE (sensor_id)=?;';
-    let sensorName = 'Unknown';
-    // Create the connection
-    const conn = await mysql.createConnection(dbConfig);
-    // Essentially just passes any errors that might have occurred when creating the connection above
-    await conn.connect(function (err) {
-        if (err)
-            throw err;
-        console.log("Connected to LaundryDB!");
-    });
-    // Using query in form of: execute(sqlString, values) to prevent injection attacks
-    //  internally, it runs connection.escape() and replaces all ?'s with appropriate values
+// Receivers batch their machines' state changes and send them here (see ingest.ts)
+// Set INGEST_STORE=memory to keep only the latest states in memory, e.g. to test receivers or load test without MySQL
+const eventStore = (process.env.INGEST_STORE === 'memory') ? new ingest_1.MemoryEventStore() : new ingest_1.MySqlEventStore(pool);
+const ingestReceivers = new Set(); // Receivers heard from since the server started
+const ingestStats = { batches: 0, events: 0, duplicates: 0, malformed: 0, failed: 0 };
+const machineStates = new cache_1.ReadThroughCache(STATE_CACHE_MS, CACHE_ENTRIES, (receiver) => eventStore.latestStates(receiver));
+// A malformed batch gets a 400, which the receiver drops; a batch that couldn't be stored gets a 503, which it retries
+app.post('/api/ingest', express.raw({ type: 'application/octet-stream', limit: ingest_1.MAX_BATCH_BYTES }), (req, res) => {
+    let batch;
     try {
-        const [rows, fields] = await conn.execute(query, [id]);
-        sensorName = rows[0]['sensor_name'];
+        if (!Buffer.isBuffer(req.body)) {
+            throw new Error('expected an application/octet-stream body');
+        }
+        batch = ingest_1.decodeBatch(req.body, new Date());
     }
     catch (error) {
+        ingestStats.malformed++;
+        res.status(400).send({ error: error.message });
+        return;
+    }
+    ingestReceivers.add(batch.receiver);
+    eventStore.insert(batch)
+        .then((stored) => {
+        // A retry of a batch that was stored, but whose response never reached the receiver
+        if (!stored) {
+            ingestStats.duplicates++;
+            res.status(200).send({ stored: 0, duplicate: true });
+            return;
+        }
+        if (batch.events.some((event) => event.kind === ingest_1.UPLINK_STATE)) {
+            machineStates.invalidate(batch.receiver);
+        }
+        ingestStats.batches++;
+        ingestStats.events += batch.events.length;
+        res.status(200).send({ stored: batch.events.length });
+    })
+        .catch((error) => {
+        ingestStats.failed++;
+        console.log("Ingest Error: ", error);
+        res.status(503).send({ error: 'could not store batch' });
+    });
+});
+app.get('/api/ingest/stats', (req, res) => {
+    res.status(200).send(Object.assign(Object.assign({}, ingestStats), { receivers: ingestReceivers.size }));
+});
+// Latest state of every machine behind a receiver, e.g. /api/receivers/94:B9:7E:FA:5A:3D/machines
+app.get('/api/receivers/:mac/machines', (req, res) => {
+    machineStates.get(req.params.mac.toUpperCase())
+        .then((machines) => {
+        res.status(200).send(machines);
+    })
+        .catch((error) => {
         console.log("Query Error: ", error);
+        res.status(500).send({ error: 'could not read machine states' });
+    });
+});
+// On-time and cycles per machine from the rollups, e.g. /api/receivers/94:B9:7E:FA:5A:3D/utilization?resolution=hour
+// from and to are dates (anything Date can parse); by default the last 7 days, or the last 24 hours by the hour
+app.get('/api/receivers/:mac/utilization', (req, res) => {
+    const resolution = (req.query.resolution === 'hour') ? 'hour' : 'day';
+    const to = (typeof req.query.to === 'string') ? new Date(req.query.to) : new Date();
+    const from = (typeof req.query.from === 'string') ? new Date(req.query.from) :
+        new Date(to.getTime() - ((resolution === 'hour') ? 24 : 7 * 24) * 60 * 60 * 1000);
+    if (isNaN(from.getTime()) || isNaN(to.getTime())) {
+        res.status(400).send({ error: 'from and to must be dates' });
+        return;
     }
-    await conn.end((err) => {
-        if (err)
-            return console.log('Error: ' + err.message);
-        console.log('Closed the laundrydb connection');
+    eventStore.utilization(req.params.mac.toUpperCase(), resolution, rollup_1.periodStart(from, resolution), to)
+        .then((rows) => {
+        res.status(200).send(rows);
+    })
+        .catch((error) => {
+        console.log("Query Error: ", error);
+        res.status(500).send({ error: 'could not read utilization' });
     });
+});
+app.get('/api/cache/stats', (req, res) => {
+    res.status(200).send({ sensorNames: sensorNames.stats, machineStates: machineStates.stats });
+});
+// TODO: SSL implementation to allow for HTTPS certification
+async function querySensorName(id) {
+    const query = 'SELECT (sensor_name) FROM laundrydb.sensors WHERE (sensor_id)=?;';
+    let sensorName = 'Unknown';
+    // Using query in form of: execute(sqlString, values) to prevent injection attacks
+    //  internally, it prepares the statement once per pooled connection and sends only the values after that
+    const [rows, fields] = await pool.execute(query, [id]);
+    if (rows.length > 0) {
+        sensorName = rows[0]['sensor_name'];
+    }
     return sensorName;
 }
 const server = http.createServer(app);
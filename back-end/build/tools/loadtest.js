@@ -0,0 +1,191 @@
+"use strict";
+var __importDefault = (this && this.__importDefault) || function (mod) {
+    return (mod && mod.__esModule) ? mod : { "default": mod };
+};
+Object.defineProperty(exports, "__esModule", { value: true });
+const http_1 = __importDefault(require("http"));
+const url_1 = require("url");
+const ingest_1 = require("../ingest");
+/*
+    Load generator for /api/ingest. Every simulated receiver keeps one batch in flight at a time, as the
+    firmware does, and the tool reports throughput and latency once the run ends.
+    With --get it instead stands in for dashboards refreshing, each client sending GET after GET to one path.
+
+    Usage: node build/tools/loadtest.js [options]   (or npm run loadtest -- [options])
+      --url=URL          Ingest endpoint (default http://127.0.0.1:3000/api/ingest)
+      --receivers=N      Simulated receivers sending at once (default 50)
+      --seconds=S        Length of the run (default 10)
+      --records=N        Records per batch, 1-255 (default 20)
+      --get=PATH         GET PATH on the --url server instead, e.g. --get=/api (--receivers sets the clients)
+*/
+function parseOptions(args) {
+    const options = {
+        url: new url_1.URL('http://127.0.0.1:3000/api/ingest'),
+        receivers: 50,
+        seconds: 10,
+        records: 20
+    };
+    for (const arg of args) {
+        const [name, value] = arg.split('=', 2);
+        if (name === '--url') {
+            options.url = new url_1.URL(value);
+        }
+        else if (name === '--receivers') {
+            options.receivers = Math.max(1, parseInt(value, 10));
+        }
+        else if (name === '--seconds') {
+            options.seconds = Math.max(1, parseFloat(value));
+        }
+        else if (name === '--records') {
+            options.records = Math.min(255, Math.max(1, parseInt(value, 10)));
+        }
+        else if (name === '--get') {
+            options.get = value;
+        }
+        else {
+            throw new Error(`unknown option ${arg}`);
+        }
+    }
+    return options;
+}
+// Appends an unsigned LEB128 varint, the same encoding as the receiver's UplinkQueue
+function pushVarint(bytes, value) {
+    while (value >= 0x80) {
+        bytes.push((value & 0x7F) | 0x80);
+        value = Math.floor(value / 128);
+    }
+    bytes.push(value);
+}
+// Builds a batch of synthetic records: mostly summaries, with a state change every fourth record
+function encodeBatch(mac, bootId, sequence, records) {
+    const sentMs = (sequence * 5000) >>> 0;
+    const header = Buffer.alloc(ingest_1.BATCH_HEADER_BYTES);
+    header.write('WB', 0, 'ascii');
+    header[2] = ingest_1.BATCH_VERSION;
+    header[3] = records;
+    mac.copy(header, 4);
+    header.writeUInt32LE(bootId, 10);
+    header.writeUInt32LE(sequence, 14);
+    header.writeUInt32LE(sentMs, 18);
+    header.writeUInt32LE(sentMs, 22);
+    header.writeUInt32LE(0, 26);
+    const body = [];
+    for (let i = 0; i < records; i++) {
+        const machineId = i % 16;
+        const kind = (i % 4 === 0) ? ingest_1.UPLINK_STATE : ingest_1.UPLINK_SUMMARY;
+        body.push(kind);
+        pushVarint(body, (i === 0) ? 0 : 250);
+        body.push(machineId & 0xFF, machineId >> 8, 0x80 | 2);
+        if (kind === ingest_1.UPLINK_SUMMARY) {
+            body.push(2, 9);
+            pushVarint(body, 1000 + i);
+            pushVarint(body, 300 + i);
+        }
+    }
+    return Buffer.concat([header, Buffer.from(body)]);
+}
+// POSTs one batch, resolving with the response status code
+function post(options, agent, batch) {
+    return new Promise((resolve, reject) => {
+        const req = http_1.default.request(options.url, {
+            method: 'POST',
+            agent: agent,
+            headers: { 'Content-Type': 'application/octet-stream', 'Content-Length': batch.length }
+        }, (res) => {
+            res.resume();
+            res.on('end', () => resolve(res.statusCode || 0));
+        });
+        req.on('error', reject);
+        req.end(batch);
+    });
+}
+// GETs a path, resolving with the response status code
+function get(url, agent) {
+    return new Promise((resolve, reject) => {
+        const req = http_1.default.get(url, { agent: agent }, (res) => {
+            res.resume();
+            res.on('end', () => resolve(res.statusCode || 0));
+        });
+        req.on('error', reject);
+    });
+}
+// One simulated dashboard: sends GET after GET until the deadline
+async function runReader(options, agent, deadline, results) {
+    const url = new url_1.URL(options.get || '/', options.url);
+    while (Date.now() < deadline) {
+        const start = process.hrtime.bigint();
+        try {
+            const status = await get(url, agent);
+            results.latenciesMs.push(Number(process.hrtime.bigint() - start) / 1e6);
+            if (status >= 200 && status < 300) {
+                results.batches++;
+            }
+            else {
+                results.errors++;
+            }
+        }
+        catch (error) {
+            results.errors++;
+        }
+    }
+}
+// One simulated receiver: sends batch after batch until the deadline
+async function runReceiver(options, agent, index, deadline, results) {
+    const mac = Buffer.from([0x02, 0x57, 0x57, (index >> 16) & 0xFF, (index >> 8) & 0xFF, index & 0xFF]);
+    const bootId = Math.floor(Math.random() * 0x100000000);
+    for (let sequence = 0; Date.now() < deadline; sequence++) {
+        const batch = encodeBatch(mac, bootId, sequence, options.records);
+        const start = process.hrtime.bigint();
+        try {
+            const status = await post(options, agent, batch);
+            results.latenciesMs.push(Number(process.hrtime.bigint() - start) / 1e6);
+            if (status >= 200 && status < 300) {
+                results.batches++;
+                results.records += options.records;
+            }
+            else {
+                results.errors++;
+            }
+        }
+        catch (error) {
+            results.errors++;
+        }
+    }
+}
+// Latency below which the given fraction of requests finished
+function percentile(sorted, fraction) {
+    if (sorted.length === 0) {
+        return 0;
+    }
+    return sorted[Math.min(sorted.length - 1, Math.floor(fraction * sorted.length))];
+}
+async function main() {
+    const options = parseOptions(process.argv.slice(2));
+    const agent = new http_1.default.Agent({ keepAlive: true, maxSockets: options.receivers });
+    const results = { batches: 0, records: 0, errors: 0, latenciesMs: [] };
+    const start = Date.now();
+    const deadline = start + options.seconds * 1000;
+    const receivers = [];
+    for (let i = 0; i < options.receivers; i++) {
+        receivers.push(options.get ? runReader(options, agent, deadline, results) : runReceiver(options, agent, i, deadline, results));
+    }
+    await Promise.all(receivers);
+    const elapsed = (Date.now() - start) / 1000;
+    agent.destroy();
+    const sorted = results.latenciesMs.sort((a, b) => a - b);
+    if (options.get) {
+        console.log(`${options.receivers} clients, GET ${options.get}, ${elapsed.toFixed(1)} s`);
+        console.log(`Requests: ${results.batches} (${(results.batches / elapsed).toFixed(0)}/s), errors: ${results.errors}`);
+    }
+    else {
+        console.log(`${options.receivers} receivers, ${options.records} records per batch, ${elapsed.toFixed(1)} s`);
+        console.log(`Batches: ${results.batches} (${(results.batches / elapsed).toFixed(0)}/s), ` +
+            `records: ${results.records} (${(results.records / elapsed).toFixed(0)}/s), errors: ${results.errors}`);
+    }
+    console.log(`Latency: p50 ${percentile(sorted, 0.5).toFixed(2)} ms, p99 ${percentile(sorted, 0.99).toFixed(2)} ms, ` +
+        `max ${percentile(sorted, 1).toFixed(2)} ms`);
+}
+main().catch((error) => {
+    console.error(error.message);
+    process.exit(1);
+});
@@ -0,0 +1,207 @@
+"use strict";
+Object.defineProperty(exports, "__esModule", { value: true });
+const ingest_1 = require("../ingest");
+const rollup_1 = require("../rollup");
+const mysql = require('mysql2/promise');
+/*
+    Seeds LaundryDB with synthetic history and times the dashboard queries against it, reading the utilization
+    rollups and, for comparison, recomputing the same figures from raw events.
+    Every batch goes through the server's own EventStore, so seeding also measures ingest with its rollups.
+    Seeded receivers have MAC addresses starting 02:5E:ED, to tell them apart from real ones.
+
+    Usage: node build/tools/seedbench.js [options]   (or npm run seedbench -- [options])
+      --machines=N       Machines to simulate (default 300)
+      --per-receiver=N   Machines behind each receiver (default 20)
+      --days=N           Days of history, ending last midnight (default 365)
+      --runs=N           Times each query runs; the median and slowest are reported (default 20)
+      --seed=N           Random seed, so runs are repeatable (default 1)
+      --memory           Use the in-memory store instead of MySQL (only the rollup queries run)
+    MySQL is reached as in server.ts, through DB_HOST and DB_PORT.
+*/
+const PHASE_WASH = 1;
+const PHASE_RINSE = 2;
+const PHASE_SPIN = 3;
+const PHASE_TUMBLE = 4;
+const SUMMARY_INTERVAL_MS = 3 * 60 * 1000;
+const EVENTS_PER_BATCH = 2000;
+const DAY_MS = 24 * 60 * 60 * 1000;
+function parseOptions(args) {
+    const options = { machines: 300, perReceiver: 20, days: 365, runs: 20, seed: 1, memory: false };
+    for (const arg of args) {
+        const [name, value] = arg.split('=', 2);
+        if (name === '--machines') {
+            options.machines = Math.max(1, parseInt(value, 10));
+        }
+        else if (name === '--per-receiver') {
+            options.perReceiver = Math.min(0xFFFF, Math.max(1, parseInt(value, 10)));
+        }
+        else if (name === '--days') {
+            options.days = Math.max(1, parseInt(value, 10));
+        }
+        else if (name === '--runs') {
+            options.runs = Math.max(1, parseInt(value, 10));
+        }
+        else if (name === '--seed') {
+            options.seed = parseInt(value, 10);
+        }
+        else if (name === '--memory') {
+            options.memory = true;
+        }
+        else {
+            throw new Error(`unknown option ${arg}`);
+        }
+    }
+    return options;
+}
+// Small seeded PRNG (mulberry32), returning numbers in [0, 1)
+function random(seed) {
+    let state = seed >>> 0;
+    return () => {
+        state = (state + 0x6D2B79F5) >>> 0;
+        let t = state;
+        t = Math.imul(t ^ (t >>> 15), t | 1);
+        t ^= t + Math.imul(t ^ (t >>> 7), t | 61);
+        return ((t ^ (t >>> 14)) >>> 0) / 0x100000000;
+    };
+}
+function receiverMac(index) {
+    return `02:5E:ED:00:${((index >> 8) & 0xFF).toString(16).toUpperCase().padStart(2, '0')}:` +
+           (index & 0xFF).toString(16).toUpperCase().padStart(2, '0');
+}
+// One day of one machine: 0-5 cycles between 7:00 and 23:00, with a phase change and a summary every few minutes
+function machineDay(machineId, washer, day, next) {
+    const events = [];
+    const cycles = Math.floor(next() * 6);
+    let earliest = day.getTime() + 7 * 60 * 60 * 1000;
+    for (let cycle = 0; cycle < cycles; cycle++) {
+        const start = earliest + Math.floor(next() * 2 * 60 * 60 * 1000);
+        const length = (35 + Math.floor(next() * 35)) * 60 * 1000;
+        if (start + length > day.getTime() + 23 * 60 * 60 * 1000) {
+            break;
+        }
+        const phases = washer ?
+            [[0, PHASE_WASH], [0.4, PHASE_RINSE], [0.75, PHASE_SPIN]] : [[0, PHASE_TUMBLE]];
+        let phase = 0;
+        for (let offset = 0; offset < length; offset += SUMMARY_INTERVAL_MS) {
+            while (phase < phases.length && phases[phase][0] * length <= offset) {
+                events.push({ machineId, kind: ingest_1.UPLINK_STATE, state: rollup_1.MACHINE_ON | phases[phase][1],
+                              time: new Date(start + Math.round(phases[phase][0] * length)) });
+                phase++;
+            }
+            const state = rollup_1.MACHINE_ON | phases[phase - 1][1];
+            events.push({ machineId, kind: ingest_1.UPLINK_SUMMARY, state: state, time: new Date(start + offset + 1000),
+                          summary: { phase: state & 0x7F, peakFreqDeciHz: 8 + Math.floor(next() * 100),
+                                     meanCms2: 980 + Math.floor(next() * 200), stdDevMms2: 200 + Math.floor(next() * 2000) } });
+        }
+        events.push({ machineId, kind: ingest_1.UPLINK_STATE, state: 0, time: new Date(start + length) });
+        earliest = start + length + 5 * 60 * 1000;
+    }
+    return events;
+}
+// Sends every day of one receiver's machines through the store, oldest first
+async function seedReceiver(store, options, receiver, first, totals) {
+    const next = random(options.seed * 7919 + receiver);
+    const machines = Math.min(options.perReceiver, options.machines - receiver * options.perReceiver);
+    let sequence = 0;
+    for (let day = 0; day < options.days; day++) {
+        const date = new Date(first.getFullYear(), first.getMonth(), first.getDate() + day);
+        let events = [];
+        for (let machine = 1; machine <= machines; machine++) {
+            events = events.concat(machineDay(machine, machine % 2 === 1, date, next));
+        }
+        events.sort((a, b) => a.time.getTime() - b.time.getTime());
+        for (let i = 0; i < events.length; i += EVENTS_PER_BATCH) {
+            const batch = { receiver: receiverMac(receiver), bootId: options.seed, sequence: sequence++,
+                                         droppedRecords: 0, events: events.slice(i, i + EVENTS_PER_BATCH) };
+            // Seeding again with the same seed resends the same batches, which the store skips as repeats
+            if (await store.insert(batch)) {
+                totals.events += batch.events.length;
+                totals.batches++;
+            }
+        }
+    }
+}
+// Runs query runs times, printing the rows it returned and its median and slowest time
+async function time(name, runs, query) {
+    const times = [];
+    let rows = 0;
+    for (let run = 0; run < runs; run++) {
+        const start = process.hrtime.bigint();
+        rows = (await query()).length;
+        times.push(Number(process.hrtime.bigint() - start) / 1e6);
+    }
+    times.sort((a, b) => a - b);
+    console.log(`${name.padEnd(48)} ${String(rows).padStart(7)} rows  median ${times[Math.floor(runs / 2)].toFixed(2).padStart(9)} ms` +
+                `  max ${times[runs - 1].toFixed(2).padStart(9)} ms`);
+}
+// Per-machine daily on-time and cycles worked out from raw state changes, as a dashboard would without rollups
+const RAW_DAILY_QUERY =
+    'SELECT machine_id, DATE(event_time) AS day, ' +
+    'SUM(IF(prev_state >= 128, TIMESTAMPDIFF(MICROSECOND, prev_time, event_time) DIV 1000, 0)) AS on_ms, ' +
+    'SUM(state >= 128 AND (prev_state IS NULL OR prev_state < 128)) AS cycles FROM ' +
+    '(SELECT machine_id, event_time, state, LAG(state) OVER w AS prev_state, LAG(event_time) OVER w AS prev_time ' +
+    'FROM LaundryDB.events WHERE receiver_id = ? AND kind = 0 AND event_time >= ? AND event_time < ? ' +
+    'WINDOW w AS (PARTITION BY machine_id ORDER BY event_time)) e GROUP BY machine_id, day;';
+// Site-wide daily totals from raw state changes
+const RAW_SITE_QUERY =
+    'SELECT DATE(event_time) AS day, ' +
+    'SUM(IF(prev_state >= 128, TIMESTAMPDIFF(MICROSECOND, prev_time, event_time) DIV 1000, 0)) AS on_ms, ' +
+    'SUM(state >= 128 AND (prev_state IS NULL OR prev_state < 128)) AS cycles FROM ' +
+    '(SELECT event_time, state, LAG(state) OVER w AS prev_state, LAG(event_time) OVER w AS prev_time ' +
+    'FROM LaundryDB.events WHERE kind = 0 AND event_time >= ? AND event_time < ? ' +
+    'WINDOW w AS (PARTITION BY receiver_id, machine_id ORDER BY event_time)) e GROUP BY day;';
+async function main() {
+    const options = parseOptions(process.argv.slice(2));
+    const pool = options.memory ? undefined : mysql.createPool({
+        host: process.env.DB_HOST || 'localhost',
+        port: Number(process.env.DB_PORT) || 3306,
+        user: 'laundry_backend',
+        password: 'admin',
+        connectionLimit: 10
+    });
+    const store = (pool === undefined) ? new ingest_1.MemoryEventStore() : new ingest_1.MySqlEventStore(pool);
+    const today = new Date();
+    const end = new Date(today.getFullYear(), today.getMonth(), today.getDate());
+    const first = new Date(end.getFullYear(), end.getMonth(), end.getDate() - options.days);
+    const receivers = Math.ceil(options.machines / options.perReceiver);
+    // Seed up to 10 receivers at a time, like the pool's connections
+    const totals = { events: 0, batches: 0 };
+    const started = Date.now();
+    let nextReceiver = 0;
+    const workers = [];
+    for (let worker = 0; worker < Math.min(10, receivers); worker++) {
+        workers.push((async () => {
+            while (nextReceiver < receivers) {
+                await seedReceiver(store, options, nextReceiver++, first, totals);
+            }
+        })());
+    }
+    await Promise.all(workers);
+    const seconds = (Date.now() - started) / 1000;
+    console.log(`Seeded ${options.machines} machines behind ${receivers} receivers, ${options.days} days: ` +
+                `${totals.events} events in ${totals.batches} batches, ${seconds.toFixed(1)} s ` +
+                `(${(totals.events / seconds).toFixed(0)} events/s)`);
+    const mac = receiverMac(0);
+    const monthAgo = new Date(end.getTime() - 30 * DAY_MS);
+    const dayAgo = new Date(end.getTime() - DAY_MS);
+    await time('Latest states, one receiver', options.runs, () => store.latestStates(mac));
+    await time('Last 24 h by the hour, one receiver (rollup)', options.runs, () => store.utilization(mac, 'hour', dayAgo, end));
+    await time('Last 30 days by day, one receiver (rollup)', options.runs, () => store.utilization(mac, 'day', monthAgo, end));
+    if (pool !== undefined) {
+        const [ids] = await pool.execute('SELECT receiver_id FROM LaundryDB.receivers WHERE receiver_mac = ?;', [mac]);
+        const receiverId = ids[0]['receiver_id'];
+        await time('Last 30 days by day, one receiver (raw events)', options.runs,
+                   async () => (await pool.execute(RAW_DAILY_QUERY, [receiverId, monthAgo, end]))[0]);
+        await time(`${options.days} days by day, whole site (rollup)`, options.runs,
+                   async () => (await pool.execute(
+                       'SELECT day, SUM(on_ms) AS on_ms, SUM(cycles) AS cycles FROM LaundryDB.utilization_daily ' +
+                       'WHERE day >= ? AND day < ? GROUP BY day;', [first, end]))[0]);
+        await time(`${options.days} days by day, whole site (raw events)`, Math.min(options.runs, 3),
+                   async () => (await pool.execute(RAW_SITE_QUERY, [first, end]))[0]);
+        await pool.end();
+    }
+}
+main().catch((error) => {
+    console.error(error.message);
+    process.exit(1);
+});
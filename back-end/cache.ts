@@ -0,0 +1,66 @@
+/*
+    In-process read-through cache for the server's database reads, so a dashboard refresh storm costs one query
+    per key instead of one per request.
+*/
+
+interface CacheEntry<V> {
+    value: Promise<V>;
+    expires: number;
+}
+
+// Hit and miss totals reported by /api/cache/stats
+export interface CacheStats {
+    entries: number;
+    hits: number;
+    misses: number;
+    invalidations: number;
+}
+
+/*
+    Caches load(key) for ttlMs. The promise itself is cached, so requests that miss while the first load is
+    still running share its query. A failed load isn't cached, so the next request tries the database again.
+    Once maxEntries keys are cached, adding another evicts the oldest.
+*/
+export class ReadThroughCache<K, V> {
+    private entries = new Map<K, CacheEntry<V>>();
+    private hits = 0;
+    private misses = 0;
+    private invalidations = 0;
+
+    constructor(private ttlMs: number, private maxEntries: number, private load: (key: K) => Promise<V>) {}
+
+    get(key: K): Promise<V> {
+        const now = Date.now();
+        const cached = this.entries.get(key);
+        if (cached !== undefined && cached.expires > now) {
+            this.hits++;
+            return cached.value;
+        }
+
+        this.misses++;
+        this.entries.delete(key);
+        if (this.entries.size >= this.maxEntries) {
+            this.entries.delete(this.entries.keys().next().value);
+        }
+        const entry: CacheEntry<V> = { value: this.load(key), expires: now + this.ttlMs };
+        this.entries.set(key, entry);
+        entry.value.catch(() => {
+            if (this.entries.get(key) === entry) {
+                this.entries.delete(key);
+            }
+        });
+        return entry.value;
+    }
+
+    // Forgets a key whose data just changed. A load already running for it still answers its own requests,
+    // but isn't kept, so the next request reads the new data.
+    invalidate(key: K): void {
+        if (this.entries.delete(key)) {
+            this.invalidations++;
+        }
+    }
+
+    get stats(): CacheStats {
+        return { entries: this.entries.size, hits: this.hits, misses: this.misses, invalidations: this.invalidations };
+    }
+}
@@ -24,9 +24,126 @@ CREATE TABLE IF NOT EXISTS `LaundryDB`.`sensors` (
   UNIQUE INDEX `sensor_name_UNIQUE` (`sensor_name` ASC) VISIBLE)
 ENGINE = InnoDB;
 
+-- -----------------------------------------------------
+-- Table `LaundryDB`.`receivers`
+-- Gives every receiver a compact id for the tables below, and remembers the boot id and sequence number of the
+-- last batch stored from it, so a batch the receiver resends isn't stored twice (NULL until its first batch)
+-- -----------------------------------------------------
+CREATE TABLE IF NOT EXISTS `LaundryDB`.`receivers` (
+  `receiver_id` SMALLINT UNSIGNED AUTO_INCREMENT,
+  `receiver_mac` CHAR(17) NOT NULL,
+  `last_boot_id` INT UNSIGNED NULL,
+  `last_sequence` INT UNSIGNED NULL,
+  PRIMARY KEY (`receiver_id`),
+  UNIQUE INDEX `receiver_mac_UNIQUE` (`receiver_mac` ASC) VISIBLE)
+ENGINE = InnoDB;
+
+-- -----------------------------------------------------
+-- Table `LaundryDB`.`events`
+-- Append-only history of every state change and feature summary. The clustered key leads with event_time,
+-- so inserts land at the end of the newest partition, and each month is its own partition (see
+-- add_event_partitions below) so old months can be dropped whole. machine_id is only unique per receiver.
+-- -----------------------------------------------------
+CREATE TABLE IF NOT EXISTS `LaundryDB`.`events` (
+  `event_time` DATETIME(3) NOT NULL,
+  `event_id` BIGINT UNSIGNED NOT NULL AUTO_INCREMENT,
+  `receiver_id` SMALLINT UNSIGNED NOT NULL,
+  `machine_id` SMALLINT UNSIGNED NOT NULL,
+  `kind` TINYINT UNSIGNED NOT NULL,
+  `state` TINYINT UNSIGNED NOT NULL,
+  `peak_freq_deci_hz` TINYINT UNSIGNED NULL,
+  `mean_cms2` SMALLINT UNSIGNED NULL,
+  `std_dev_mms2` SMALLINT UNSIGNED NULL,
+  PRIMARY KEY (`event_time`, `event_id`),
+  INDEX `event_id` (`event_id` ASC) VISIBLE,
+  INDEX `machine_time` (`receiver_id` ASC, `machine_id` ASC, `event_time` ASC) VISIBLE)
+ENGINE = InnoDB
+PARTITION BY RANGE (TO_DAYS(`event_time`)) (
+  PARTITION `p_before` VALUES LESS THAN (TO_DAYS('2025-01-01')),
+  PARTITION `p_future` VALUES LESS THAN MAXVALUE);
+
+-- -----------------------------------------------------
+-- Table `LaundryDB`.`machine_states`
+-- Latest state change of every machine, moved forward by each batch the back-end stores
+-- -----------------------------------------------------
+CREATE TABLE IF NOT EXISTS `LaundryDB`.`machine_states` (
+  `receiver_id` SMALLINT UNSIGNED NOT NULL,
+  `machine_id` SMALLINT UNSIGNED NOT NULL,
+  `state` TINYINT UNSIGNED NOT NULL,
+  `changed_at` DATETIME(3) NOT NULL,
+  PRIMARY KEY (`receiver_id`, `machine_id`))
+ENGINE = InnoDB;
+
+-- -----------------------------------------------------
+-- Table `LaundryDB`.`utilization_hourly`
+-- Time each machine spent on and cycles it started, per local hour (kept up to date by back-end/rollup.ts)
+-- -----------------------------------------------------
+CREATE TABLE IF NOT EXISTS `LaundryDB`.`utilization_hourly` (
+  `receiver_id` SMALLINT UNSIGNED NOT NULL,
+  `machine_id` SMALLINT UNSIGNED NOT NULL,
+  `hour_start` DATETIME NOT NULL,
+  `on_ms` INT UNSIGNED NOT NULL,
+  `cycles` SMALLINT UNSIGNED NOT NULL,
+  PRIMARY KEY (`receiver_id`, `machine_id`, `hour_start`),
+  INDEX `hour_start` (`hour_start` ASC) VISIBLE)
+ENGINE = InnoDB;
+
+-- -----------------------------------------------------
+-- Table `LaundryDB`.`utilization_daily`
+-- The same totals per local day
+-- -----------------------------------------------------
+CREATE TABLE IF NOT EXISTS `LaundryDB`.`utilization_daily` (
+  `receiver_id` SMALLINT UNSIGNED NOT NULL,
+  `machine_id` SMALLINT UNSIGNED NOT NULL,
+  `day` DATE NOT NULL,
+  `on_ms` INT UNSIGNED NOT NULL,
+  `cycles` SMALLINT UNSIGNED NOT NULL,
+  PRIMARY KEY (`receiver_id`, `machine_id`, `day`),
+  INDEX `day` (`day` ASC) VISIBLE)
+ENGINE = InnoDB;
+
+-- -----------------------------------------------------
+-- Procedure `LaundryDB`.`add_event_partitions`
+-- Splits a partition per month off p_future, up to and including the month of `until`
+-- -----------------------------------------------------
+DROP PROCEDURE IF EXISTS `LaundryDB`.`add_event_partitions`;
+
+DELIMITER $$
+CREATE PROCEDURE `LaundryDB`.`add_event_partitions` (IN `until` DATE)
+BEGIN
+  DECLARE next_month DATE;
+
+  SELECT FROM_DAYS(MAX(CAST(`PARTITION_DESCRIPTION` AS UNSIGNED))) INTO next_month
+    FROM `information_schema`.`PARTITIONS`
+    WHERE `TABLE_SCHEMA` = 'LaundryDB' AND `TABLE_NAME` = 'events' AND `PARTITION_DESCRIPTION` <> 'MAXVALUE';
+
+  WHILE next_month <= `until` DO
+    SET @partition_sql = CONCAT('ALTER TABLE `LaundryDB`.`events` REORGANIZE PARTITION `p_future` INTO (',
+                                'PARTITION `p', DATE_FORMAT(next_month, '%Y_%m'), '` VALUES LESS THAN (TO_DAYS(''',
+                                next_month + INTERVAL 1 MONTH, ''')), PARTITION `p_future` VALUES LESS THAN MAXVALUE)');
+    PREPARE partition_stmt FROM @partition_sql;
+    EXECUTE partition_stmt;
+    DEALLOCATE PREPARE partition_stmt;
+    SET next_month = next_month + INTERVAL 1 MONTH;
+  END WHILE;
+END$$
+DELIMITER ;
+
+CALL `LaundryDB`.`add_event_partitions`(CURDATE() + INTERVAL 3 MONTH);
+
+-- Keeps three months of partitions ready (needs the event scheduler, which MySQL 8 runs by default)
+CREATE EVENT IF NOT EXISTS `LaundryDB`.`extend_event_partitions`
+  ON SCHEDULE EVERY 1 MONTH
+  DO CALL `LaundryDB`.`add_event_partitions`(CURDATE() + INTERVAL 3 MONTH);
+
 CREATE USER 'laundry_backend' IDENTIFIED BY 'admin';
 
 GRANT SELECT ON TABLE `LaundryDB`.* TO 'laundry_backend';
+GRANT INSERT ON TABLE `LaundryDB`.`events` TO 'laundry_backend';
+GRANT INSERT, UPDATE ON TABLE `LaundryDB`.`receivers` TO 'laundry_backend';
+GRANT INSERT, UPDATE ON TABLE `LaundryDB`.`machine_states` TO 'laundry_backend';
+GRANT INSERT, UPDATE ON TABLE `LaundryDB`.`utilization_hourly` TO 'laundry_backend';
+GRANT INSERT, UPDATE ON TABLE `LaundryDB`.`utilization_daily` TO 'laundry_backend';
 
 SET SQL_MODE=@OLD_SQL_MODE;
 SET FOREIGN_KEY_CHECKS=@OLD_FOREIGN_KEY_CHECKS;
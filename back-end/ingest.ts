@@ -0,0 +1,326 @@
+import { Pool, PoolConnection, ResultSetHeader, RowDataPacket } from 'mysql2/promise';
+import { mergeUtilization, Resolution, rollUp, UtilizationRow } from './rollup';
+
+/*
+    Bulk ingestion of the batches every laundry room's receiver sends to /api/ingest.
+    The batch layout is documented next to its encoder, in
+    Microcontroller-Code/LaundryReceiver/lib/UplinkQueue/UplinkQueue.h, and the two must change together.
+*/
+
+export const BATCH_VERSION = 1;
+export const BATCH_HEADER_BYTES = 30;
+export const MAX_BATCH_BYTES = 16 * 1024;
+export const UPLINK_STATE = 0;
+export const UPLINK_SUMMARY = 1;
+
+export interface FeatureSummary {
+    phase: number;
+    peakFreqDeciHz: number;     // Strongest vibration frequency, in 0.1 Hz
+    meanCms2: number;           // Mean acceleration magnitude, in cm/s^2
+    stdDevMms2: number;         // Standard deviation of the magnitude, in mm/s^2
+}
+
+export interface UplinkEvent {
+    machineId: number;          // 16 bit hash of the sender's BOARD_ID
+    kind: number;               // UPLINK_STATE or UPLINK_SUMMARY
+    state: number;              // Bit 7 = machine on, bits 0-6 = cycle phase
+    time: Date;                 // When the receiver recorded it, on the server's clock
+    summary?: FeatureSummary;
+}
+
+export interface UplinkBatch {
+    receiver: string;           // Receiver MAC address, e.g. "94:B9:7E:FA:5A:3D"
+    bootId: number;
+    sequence: number;
+    droppedRecords: number;     // Records the receiver had to drop since it booted
+    events: UplinkEvent[];
+}
+
+// Reads the varint at offset, returning it and the offset after it
+function readVarint(data: Buffer, offset: number): [number, number] {
+    let value = 0;
+    for (let shift = 0; shift < 35; shift += 7) {
+        if (offset >= data.length) {
+            throw new Error('batch truncated');
+        }
+        const byte = data[offset++];
+        value += (byte & 0x7F) * 2 ** shift;
+        if ((byte & 0x80) === 0) {
+            return [value, offset];
+        }
+    }
+    throw new Error('varint too long');
+}
+
+/*
+    Decodes a batch received at receivedAt. Record times are receiver uptimes, so they are placed on the
+    server's clock by how long before the batch was sent they were recorded.
+    Throws an Error describing the problem if the batch is malformed.
+*/
+export function decodeBatch(data: Buffer, receivedAt: Date): UplinkBatch {
+    if (data.length < BATCH_HEADER_BYTES || data[0] !== 0x57 || data[1] !== 0x42) {
+        throw new Error('not an uplink batch');
+    }
+    if (data[2] !== BATCH_VERSION) {
+        throw new Error(`unsupported batch version ${data[2]}`);
+    }
+
+    const count = data[3];
+    const receiver = Array.from(data.subarray(4, 10), (byte) => byte.toString(16).toUpperCase().padStart(2, '0')).join(':');
+    const sentMs = data.readUInt32LE(18);
+    let timeMs = data.readUInt32LE(22);
+
+    const events: UplinkEvent[] = [];
+    let offset = BATCH_HEADER_BYTES;
+    for (let i = 0; i < count; i++) {
+        if (offset + 1 > data.length) {
+            throw new Error('batch truncated');
+        }
+        const kind = data[offset++];
+        if (kind !== UPLINK_STATE && kind !== UPLINK_SUMMARY) {
+            throw new Error(`unknown record kind ${kind}`);
+        }
+        let delta: number;
+        [delta, offset] = readVarint(data, offset);
+        timeMs = (timeMs + delta) >>> 0;
+        if (offset + 3 > data.length) {
+            throw new Error('batch truncated');
+        }
+
+        const event: UplinkEvent = {
+            machineId: data.readUInt16LE(offset),
+            kind: kind,
+            state: data[offset + 2],
+            time: new Date(receivedAt.getTime() - ((sentMs - timeMs) >>> 0))
+        };
+        offset += 3;
+
+        if (kind === UPLINK_SUMMARY) {
+            if (offset + 2 > data.length) {
+                throw new Error('batch truncated');
+            }
+            const phase = data[offset];
+            const peakFreqDeciHz = data[offset + 1];
+            let meanCms2: number, stdDevMms2: number;
+            [meanCms2, offset] = readVarint(data, offset + 2);
+            [stdDevMms2, offset] = readVarint(data, offset);
+            event.summary = { phase, peakFreqDeciHz, meanCms2, stdDevMms2 };
+        }
+        events.push(event);
+    }
+    if (offset !== data.length) {
+        throw new Error('trailing bytes after the last record');
+    }
+
+    return {
+        receiver: receiver,
+        bootId: data.readUInt32LE(10),
+        sequence: data.readUInt32LE(14),
+        droppedRecords: data.readUInt32LE(26),
+        events: events
+    };
+}
+
+// Sequence number of the last batch stored from a receiver, and the boot it came from
+export interface BatchPosition {
+    bootId: number;
+    sequence: number;
+}
+
+/*
+    Whether batch repeats one already stored, given the last batch stored from its receiver. A receiver resends a
+    batch (same boot id and sequence) whenever it didn't hear back, so anything at or before the last sequence of
+    the same boot is a repeat. Only stored batches move last on, so a retry of one that failed to store is taken.
+*/
+export function isRepeat(last: BatchPosition | undefined, batch: UplinkBatch): boolean {
+    return last !== undefined && last.bootId === batch.bootId && batch.sequence <= last.sequence;
+}
+
+// Latest known state of one machine behind a receiver
+export interface MachineState {
+    machineId: number;
+    state: number;
+    time: Date;
+}
+
+// Where ingested events end up. insert() stores a batch unless it repeats one already stored, resolving to whether it did.
+export interface EventStore {
+    insert(batch: UplinkBatch): Promise<boolean>;
+    latestStates(receiver: string): Promise<MachineState[]>;
+    utilization(receiver: string, resolution: Resolution, from: Date, to: Date): Promise<UtilizationRow[]>;
+}
+
+// The state changes of a batch, oldest first
+function stateChanges(batch: UplinkBatch): UplinkEvent[] {
+    return batch.events.filter((event) => event.kind === UPLINK_STATE);
+}
+
+interface MemoryReceiver {
+    last?: BatchPosition;
+    latest: Map<number, MachineState>;
+    hourly: Map<string, UtilizationRow>;
+    daily: Map<string, UtilizationRow>;
+}
+
+/*
+    Stand-in store that only keeps each machine's latest state and the rollups, for running the server (and load
+    tests) without MySQL. The rollups are never trimmed, so it isn't meant to run for months.
+*/
+export class MemoryEventStore implements EventStore {
+    events = 0;
+    private receivers = new Map<string, MemoryReceiver>();
+
+    async insert(batch: UplinkBatch): Promise<boolean> {
+        let receiver = this.receivers.get(batch.receiver);
+        if (receiver === undefined) {
+            receiver = { latest: new Map(), hourly: new Map(), daily: new Map() };
+            this.receivers.set(batch.receiver, receiver);
+        }
+        if (isRepeat(receiver.last, batch)) {
+            return false;
+        }
+        this.events += batch.events.length;
+        const delta = rollUp(receiver.latest, stateChanges(batch));
+        mergeUtilization(receiver.hourly, delta.hourly);
+        mergeUtilization(receiver.daily, delta.daily);
+        receiver.last = { bootId: batch.bootId, sequence: batch.sequence };
+        return true;
+    }
+
+
+    async latestStates(receiver: string): Promise<MachineState[]> {
+        const stored = this.receivers.get(receiver);
+        return (stored === undefined) ? [] : Array.from(stored.latest.values());
+    }
+
+    async utilization(receiver: string, resolution: Resolution, from: Date, to: Date): Promise<UtilizationRow[]> {
+        const stored = this.receivers.get(receiver);
+        if (stored === undefined) {
+            return [];
+        }
+        const rows = (resolution === 'hour') ? stored.hourly : stored.daily;
+        return Array.from(rows.values()).filter((row) => row.start >= from && row.start < to);
+    }
+}
+
+/*
+    Stores batches in LaundryDB (see database/create_db.sql). Each batch is one transaction that appends its events,
+    moves its machines' latest states forward, adds its share of the hourly and daily utilization rollups and
+    records it as its receiver's last batch. The receiver's row is locked first, so its batches take turns: a resent
+    batch is seen as a repeat even while the original is still being stored (or by another server), and two
+    batches can't count the same on-time twice.
+*/
+export class MySqlEventStore implements EventStore {
+    private receiverIds = new Map<string, number>();
+
+    constructor(private pool: Pool) {}
+
+    async insert(batch: UplinkBatch): Promise<boolean> {
+        if (batch.events.length === 0) {
+            return true;
+        }
+        const conn: PoolConnection = await this.pool.getConnection();
+        try {
+            const receiverId = await this.receiverId(conn, batch.receiver);
+            await conn.beginTransaction();
+
+            const [receiverRows] = await conn.execute<RowDataPacket[]>(
+                'SELECT last_boot_id, last_sequence FROM LaundryDB.receivers WHERE receiver_id = ? FOR UPDATE;', [receiverId]);
+            const last: BatchPosition | undefined = (receiverRows.length === 0 || receiverRows[0]['last_boot_id'] === null) ?
+                undefined : { bootId: receiverRows[0]['last_boot_id'], sequence: receiverRows[0]['last_sequence'] };
+            if (isRepeat(last, batch)) {
+                await conn.rollback();
+                return false;
+            }
+
+            const [cursorRows] = await conn.execute<RowDataPacket[]>(
+                'SELECT machine_id, state, changed_at FROM LaundryDB.machine_states WHERE receiver_id = ? FOR UPDATE;',
+                [receiverId]);
+            const latest = new Map<number, MachineState>();
+            for (const row of cursorRows) {
+                latest.set(row['machine_id'], { machineId: row['machine_id'], state: row['state'], time: row['changed_at'] });
+            }
+            const changes = stateChanges(batch);
+            const delta = rollUp(latest, changes);
+
+            // query() rather than execute(): a prepared statement can't expand VALUES ? into many rows
+            const rows = batch.events.map((event) => [
+                event.time, receiverId, event.machineId, event.kind, event.state,
+                event.summary ? event.summary.peakFreqDeciHz : null,
+                event.summary ? event.summary.meanCms2 : null,
+                event.summary ? event.summary.stdDevMms2 : null
+            ]);
+            await conn.query('INSERT INTO LaundryDB.events (event_time, receiver_id, machine_id, kind, state, ' +
+                             'peak_freq_deci_hz, mean_cms2, std_dev_mms2) VALUES ?;', [rows]);
+
+            if (changes.length > 0) {
+                const states = Array.from(latest.values(), (state) => [receiverId, state.machineId, state.state, state.time]);
+                await conn.query('INSERT INTO LaundryDB.machine_states (receiver_id, machine_id, state, changed_at) VALUES ? ' +
+                                 'ON DUPLICATE KEY UPDATE state = VALUES(state), changed_at = VALUES(changed_at);', [states]);
+            }
+            await this.addUtilization(conn, 'utilization_hourly', 'hour_start', receiverId, delta.hourly);
+            await this.addUtilization(conn, 'utilization_daily', 'day', receiverId, delta.daily);
+            await conn.execute('UPDATE LaundryDB.receivers SET last_boot_id = ?, last_sequence = ? WHERE receiver_id = ?;',
+                               [batch.bootId, batch.sequence, receiverId]);
+
+            await conn.commit();
+            return true;
+        } catch (error) {
+            await conn.rollback();
+            throw error;
+        } finally {
+            conn.release();
+        }
+    }
+
+    async latestStates(receiver: string): Promise<MachineState[]> {
+        const query = 'SELECT m.machine_id, m.state, m.changed_at FROM LaundryDB.machine_states m ' +
+                      'JOIN LaundryDB.receivers r USING (receiver_id) WHERE r.receiver_mac = ?;';
+        const [rows] = await this.pool.execute<RowDataPacket[]>(query, [receiver]);
+        return rows.map((row) => ({ machineId: row['machine_id'], state: row['state'], time: row['changed_at'] }));
+    }
+
+    async utilization(receiver: string, resolution: Resolution, from: Date, to: Date): Promise<UtilizationRow[]> {
+        const query = (resolution === 'hour') ?
+            'SELECT u.machine_id, u.hour_start AS start, u.on_ms, u.cycles FROM LaundryDB.utilization_hourly u ' +
+            'JOIN LaundryDB.receivers r USING (receiver_id) WHERE r.receiver_mac = ? AND u.hour_start >= ? AND u.hour_start < ?;' :
+            'SELECT u.machine_id, u.day AS start, u.on_ms, u.cycles FROM LaundryDB.utilization_daily u ' +
+            'JOIN LaundryDB.receivers r USING (receiver_id) WHERE r.receiver_mac = ? AND u.day >= ? AND u.day < ?;';
+        const [rows] = await this.pool.execute<RowDataPacket[]>(query, [receiver, from, to]);
+        return rows.map((row) => ({ machineId: row['machine_id'], start: row['start'], onMs: row['on_ms'], cycles: row['cycles'] }));
+    }
+
+    // Compact id of a receiver, added to LaundryDB.receivers the first time its MAC address shows up
+    private async receiverId(conn: PoolConnection, mac: string): Promise<number> {
+        let id = this.receiverIds.get(mac);
+        if (id === undefined) {
+            // LAST_INSERT_ID(receiver_id) makes insertId the existing id when the MAC is already there
+            const [result] = await conn.execute<ResultSetHeader>(
+                'INSERT INTO LaundryDB.receivers (receiver_mac) VALUES (?) ' +
+                'ON DUPLICATE KEY UPDATE receiver_id = LAST_INSERT_ID(receiver_id);', [mac]);
+            id = result.insertId;
+            this.receiverIds.set(mac, id);
+        }
+        return id;
+    }
+
+    // Adds a batch's rollup increments to the totals already in table
+    private async addUtilization(conn: PoolConnection, table: string, startColumn: string, receiverId: number,
+                                 rows: UtilizationRow[]): Promise<void> {
+        if (rows.length === 0) {
+            return;
+        }
+        const values = rows.map((row) => [receiverId, row.machineId, row.start, row.onMs, row.cycles]);
+        await conn.query(`INSERT INTO LaundryDB.${table} (receiver_id, machine_id, ${startColumn}, on_ms, cycles) VALUES ? ` +
+                         'ON DUPLICATE KEY UPDATE on_ms = on_ms + VALUES(on_ms), cycles = cycles + VALUES(cycles);', [values]);
+    }
+}
+
+// Running totals reported by /api/ingest/stats
+export interface IngestStats {
+    batches: number;
+    events: number;
+    duplicates: number;
+    malformed: number;
+    failed: number;
+}
@@ -1,5 +1,10 @@
 import {Request, Response} from 'express';
 import { QueryError, RowDataPacket, FieldPacket } from 'mysql2';
+import { Pool } from 'mysql2/promise';
+import { ReadThroughCache } from './cache';
+import { periodStart, Resolution } from './rollup';
+import { decodeBatch, EventStore, IngestStats, MachineState, MAX_BATCH_BYTES, MemoryEventStore,
+         MySqlEventStore, UPLINK_STATE, UplinkBatch } from './ingest';
 
 const express = require('express');
 const http = require('http');
@@ -10,54 +15,139 @@ const app = express();
 const port = process.env.PORT || 3000
 
 const dbConfig = {    
-    host: 'localhost',
+    host: process.env.DB_HOST || 'localhost',
+    port: Number(process.env.DB_PORT) || 3306,
     user: 'laundry_backend',
-    password: 'admin'
+    password: 'admin',
+    connectionLimit: 10,        // Requests beyond this wait in the pool's queue for a free connection
+    waitForConnections: true
 }
 
+// Connections are opened as needed and then kept, along with the statements prepared on them by execute()
+const pool: Pool = mysql.createPool(dbConfig);
+
+// Sensor names hardly ever change, so they're cached for a while. Machine states are dropped from the cache
+// whenever their receiver's batch brings a state change, so the time limit is only a safety net.
+const SENSOR_CACHE_MS = 5 * 60 * 1000;
+const STATE_CACHE_MS = 60 * 1000;
+const CACHE_ENTRIES = 1000;
+
 // Go back (..) twice because the server is run through server.js in the /build directory
 // Host the Angular frontend statically on the home directory
 app.use('/', express.static(path.join(__dirname, '..', '..', 'front-end', 'dist', 'LaundrySensorSite')));
 
+const sensorNames = new ReadThroughCache<number, string>(SENSOR_CACHE_MS, CACHE_ENTRIES, querySensorName);
+
 app.get('/api', (req: Request, res: Response) => {
-    queryServer(1)
+    sensorNames.get(1)
         .then((sensor) => {
             res.status(200).send({message: `Hi ${sensor}`});
+        })
+        .catch((error: Error) => {
+            console.log("Query Error: ", error);
+            res.status(500).send({error: 'could not read sensors'});
+        });
+});
+
+// Receivers batch their machines' state changes and send them here (see ingest.ts)
+// Set INGEST_STORE=memory to keep only the latest states in memory, e.g. to test receivers or load test without MySQL
+const eventStore: EventStore = (process.env.INGEST_STORE === 'memory') ? new MemoryEventStore() : new MySqlEventStore(pool);
+const ingestReceivers = new Set<string>();    // Receivers heard from since the server started
+const ingestStats: IngestStats = { batches: 0, events: 0, duplicates: 0, malformed: 0, failed: 0 };
+const machineStates = new ReadThroughCache<string, MachineState[]>(STATE_CACHE_MS, CACHE_ENTRIES,
+                                                                   (receiver) => eventStore.latestStates(receiver));
+
+// A malformed batch gets a 400, which the receiver drops; a batch that couldn't be stored gets a 503, which it retries
+app.post('/api/ingest', express.raw({ type: 'application/octet-stream', limit: MAX_BATCH_BYTES }), (req: Request, res: Response) => {
+    let batch: UplinkBatch;
+    try {
+        if (!Buffer.isBuffer(req.body)) {
+            throw new Error('expected an application/octet-stream body');
+        }
+        batch = decodeBatch(req.body, new Date());
+    } catch (error) {
+        ingestStats.malformed++;
+        res.status(400).send({error: (error as Error).message});
+        return;
+    }
+
+    ingestReceivers.add(batch.receiver);
+    eventStore.insert(batch)
+        .then((stored) => {
+            // A retry of a batch that was stored, but whose response never reached the receiver
+            if (!stored) {
+                ingestStats.duplicates++;
+                res.status(200).send({stored: 0, duplicate: true});
+                return;
+            }
+            if (batch.events.some((event) => event.kind === UPLINK_STATE)) {
+                machineStates.invalidate(batch.receiver);
+            }
+            ingestStats.batches++;
+            ingestStats.events += batch.events.length;
+            res.status(200).send({stored: batch.events.length});
+        })
+        .catch((error: Error) => {
+            ingestStats.failed++;
+            console.log("Ingest Error: ", error);
+            res.status(503).send({error: 'could not store batch'});
+        });
+});
+
+app.get('/api/ingest/stats', (req: Request, res: Response) => {
+    res.status(200).send({...ingestStats, receivers: ingestReceivers.size});
+});
+
+// Latest state of every machine behind a receiver, e.g. /api/receivers/94:B9:7E:FA:5A:3D/machines
+app.get('/api/receivers/:mac/machines', (req: Request, res: Response) => {
+    machineStates.get(req.params.mac.toUpperCase())
+        .then((machines) => {
+            res.status(200).send(machines);
+        })
+        .catch((error: Error) => {
+            console.log("Query Error: ", error);
+            res.status(500).send({error: 'could not read machine states'});
+        });
+});
+
+// On-time and cycles per machine from the rollups, e.g. /api/receivers/94:B9:7E:FA:5A:3D/utilization?resolution=hour
+// from and to are dates (anything Date can parse); by default the last 7 days, or the last 24 hours by the hour
+app.get('/api/receivers/:mac/utilization', (req: Request, res: Response) => {
+    const resolution: Resolution = (req.query.resolution === 'hour') ? 'hour' : 'day';
+    const to = (typeof req.query.to === 'string') ? new Date(req.query.to) : new Date();
+    const from = (typeof req.query.from === 'string') ? new Date(req.query.from) :
+                 new Date(to.getTime() - ((resolution === 'hour') ? 24 : 7 * 24) * 60 * 60 * 1000);
+    if (isNaN(from.getTime()) || isNaN(to.getTime())) {
+        res.status(400).send({error: 'from and to must be dates'});
+        return;
+    }
+
+    eventStore.utilization(req.params.mac.toUpperCase(), resolution, periodStart(from, resolution), to)
+        .then((rows) => {
+            res.status(200).send(rows);
+        })
+        .catch((error: Error) => {
+            console.log("Query Error: ", error);
+            res.status(500).send({error: 'could not read utilization'});
         });
 });
 
-// TODO: add connection pooling for higher efficiency
+app.get('/api/cache/stats', (req: Request, res: Response) => {
+    res.status(200).send({sensorNames: sensorNames.stats, machineStates: machineStates.stats});
+});
+
 // TODO: SSL implementation to allow for HTTPS certification
-// TODO: Decide how to best open/close connection
-async function queryServer(id: number): Promise<string> {
+async function querySensorName(id: number): Promise<string> {
     const query='SELECT (sensor_name) FROM laundrydb.sensors WHERE (sensor_id)=?;'
     let sensorName = 'Unknown';
-    
-    // Create the connection
-    const conn = await mysql.createConnection(dbConfig);
-
-    // Essentially just passes any errors that might have occurred when creating the connection above
-    await conn.connect(function(err: Error) {
-        if (err) throw err;
-        console.log("Connected to LaundryDB!");
-    });
 
     // Using query in form of: execute(sqlString, values) to prevent injection attacks
-    //  internally, it runs connection.escape() and replaces all ?'s with appropriate values
-    try {
-        const [rows, fields]: [RowDataPacket[], FieldPacket] = await conn.execute(query, [id]);
+    //  internally, it prepares the statement once per pooled connection and sends only the values after that
+    const [rows, fields]: [RowDataPacket[], FieldPacket[]] = await pool.execute<RowDataPacket[]>(query, [id]);
+    if (rows.length > 0) {
         sensorName = rows[0]['sensor_name'];
-    } catch (error) {
-        console.log("Query Error: ", error);
     }
 
-    
-
-    await conn.end((err: Error) => {
-        if (err) return console.log('Error: ' + err.message);
-        console.log('Closed the laundrydb connection');
-    });
-
     return sensorName;
 }
 